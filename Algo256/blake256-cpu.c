@@ -0,0 +1,296 @@
+/**
+ * Blake-256 cpu midstate, used to check the gpu results of the blake
+ * family (blake, blakecoin, vanilla, decred) and for cpu nonce scans.
+ *
+ * The blocks before the nonce are compressed once per work, a hash is then
+ * only the last block compression. The rounds are a parameter, so unlike
+ * sph_blake256_set_rounds() the 8 and 14 rounds variants can be used by
+ * several threads at once.
+ *
+ * With AVX2, hash8 runs 8 nonces in the lanes of the state vectors.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "blake256-cpu.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+static const uint32_t blake256_iv[8] = {
+	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+	0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+static const uint32_t blake256_c[16] = {
+	0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344,
+	0xA4093822, 0x299F31D0, 0x082EFA98, 0xEC4E6C89,
+	0x452821E6, 0x38D01377, 0xBE5466CF, 0x34E90C6C,
+	0xC0AC29B7, 0xC97C50DD, 0x3F84D5B5, 0xB5470917
+};
+
+static const uint8_t blake256_sigma[10][16] = {
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+	{ 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+	{  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+	{  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+	{  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+	{ 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+	{ 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+	{  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+	{ 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 }
+};
+
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static inline uint32_t be32_get(const uint8_t *p)
+{
+	return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static inline void be32_put(uint8_t *p, uint32_t x)
+{
+	p[0] = (uint8_t) (x >> 24); p[1] = (uint8_t) (x >> 16);
+	p[2] = (uint8_t) (x >> 8);  p[3] = (uint8_t) x;
+}
+
+/* unrolled, the sigma indexes are then constants */
+#define ROUND(G, r) { \
+	G(0, 4,  8, 12, blake256_sigma[r],  0); \
+	G(1, 5,  9, 13, blake256_sigma[r],  2); \
+	G(2, 6, 10, 14, blake256_sigma[r],  4); \
+	G(3, 7, 11, 15, blake256_sigma[r],  6); \
+	G(0, 5, 10, 15, blake256_sigma[r],  8); \
+	G(1, 6, 11, 12, blake256_sigma[r], 10); \
+	G(2, 7,  8, 13, blake256_sigma[r], 12); \
+	G(3, 4,  9, 14, blake256_sigma[r], 14); \
+}
+
+#define ROUNDS(G, rounds) { \
+	ROUND(G, 0); ROUND(G, 1); ROUND(G, 2); ROUND(G, 3); \
+	ROUND(G, 4); ROUND(G, 5); ROUND(G, 6); ROUND(G, 7); \
+	if (rounds > 8) { \
+		ROUND(G, 8); ROUND(G, 9); ROUND(G, 0); \
+		ROUND(G, 1); ROUND(G, 2); ROUND(G, 3); \
+	} \
+}
+
+#define G(a,b,c,d,s,e) { \
+	v[a] += (m[s[e]] ^ blake256_c[s[e+1]]) + v[b]; \
+	v[d] = ROTR32(v[d] ^ v[a], 16); \
+	v[c] += v[d]; \
+	v[b] = ROTR32(v[b] ^ v[c], 12); \
+	v[a] += (m[s[e+1]] ^ blake256_c[s[e]]) + v[b]; \
+	v[d] = ROTR32(v[d] ^ v[a], 8); \
+	v[c] += v[d]; \
+	v[b] = ROTR32(v[b] ^ v[c], 7); \
+}
+
+static void blake256_compress(uint32_t *h, const uint32_t *m, uint32_t t0, uint32_t t1, int rounds)
+{
+	uint32_t v[16];
+	int i;
+
+	for (i = 0; i < 8; i++)
+		v[i] = h[i];
+	for (i = 0; i < 4; i++)
+		v[8 + i] = blake256_c[i];
+	v[12] = t0 ^ blake256_c[4];
+	v[13] = t0 ^ blake256_c[5];
+	v[14] = t1 ^ blake256_c[6];
+	v[15] = t1 ^ blake256_c[7];
+
+	ROUNDS(G, rounds);
+
+	for (i = 0; i < 8; i++)
+		h[i] ^= v[i] ^ v[i + 8];
+}
+
+int blake256_mid_init(blake256_midstate *ms, const void *data, size_t len, size_t nonce_off, int rounds)
+{
+	const uint8_t *p = (const uint8_t*) data;
+	size_t full = len & ~(size_t) 63, rem = len & 63;
+	uint8_t last[64];
+	uint32_t m[16];
+	uint64_t bits = (uint64_t) len << 3;
+	int i;
+
+	if (rounds != 8 && rounds != 14)
+		return -1;
+	if (!rem || rem > 55 || (nonce_off & 3) || nonce_off < full || nonce_off + 4 > len)
+		return -1;
+
+	memcpy(ms->h, blake256_iv, sizeof(ms->h));
+	for (size_t off = 0; off < full; off += 64) {
+		uint64_t t = (uint64_t) (off + 64) << 3;
+		for (i = 0; i < 16; i++)
+			m[i] = be32_get(&p[off + 4 * i]);
+		blake256_compress(ms->h, m, (uint32_t) t, (uint32_t) (t >> 32), rounds);
+	}
+
+	// the padding always fits in the last block
+	memset(last, 0, sizeof(last));
+	memcpy(last, &p[full], rem);
+	last[rem] = 0x80;
+	last[55] |= 0x01;
+	be32_put(&last[56], (uint32_t) (bits >> 32));
+	be32_put(&last[60], (uint32_t) bits);
+	for (i = 0; i < 16; i++)
+		ms->m[i] = be32_get(&last[4 * i]);
+
+	ms->t0 = (uint32_t) bits;
+	ms->t1 = (uint32_t) (bits >> 32);
+	ms->nonce_word = (int) ((nonce_off - full) >> 2);
+	ms->rounds = rounds;
+	return 0;
+}
+
+void blake256_mid_hash(const blake256_midstate *ms, void *hash, uint32_t nonce)
+{
+	uint32_t h[8], m[16];
+	uint8_t *out = (uint8_t*) hash;
+
+	memcpy(h, ms->h, sizeof(h));
+	memcpy(m, ms->m, sizeof(m));
+	m[ms->nonce_word] = nonce;
+	blake256_compress(h, m, ms->t0, ms->t1, ms->rounds);
+	for (int i = 0; i < 8; i++)
+		be32_put(&out[4 * i], h[i]);
+}
+
+#if defined(__AVX2__)
+
+#define ADD8(a, b) _mm256_add_epi32(a, b)
+#define XOR8(a, b) _mm256_xor_si256(a, b)
+#define ROR8_12(x) _mm256_or_si256(_mm256_srli_epi32(x, 12), _mm256_slli_epi32(x, 20))
+#define ROR8_7(x)  _mm256_or_si256(_mm256_srli_epi32(x, 7), _mm256_slli_epi32(x, 25))
+
+#define G8(a,b,c,d,s,e) { \
+	v[a] = ADD8(ADD8(v[a], v[b]), XOR8(vm[s[e]], vc[s[e+1]])); \
+	v[d] = _mm256_shuffle_epi8(XOR8(v[d], v[a]), rot16); \
+	v[c] = ADD8(v[c], v[d]); \
+	v[b] = ROR8_12(XOR8(v[b], v[c])); \
+	v[a] = ADD8(ADD8(v[a], v[b]), XOR8(vm[s[e+1]], vc[s[e]])); \
+	v[d] = _mm256_shuffle_epi8(XOR8(v[d], v[a]), rot8); \
+	v[c] = ADD8(v[c], v[d]); \
+	v[b] = ROR8_7(XOR8(v[b], v[c])); \
+}
+
+/* the 8 lanes only differ by the nonce word */
+static void blake256_mid_lanes8(const blake256_midstate *ms, uint32_t out[8][8], const uint32_t *nonces)
+{
+	const __m256i rot16 = _mm256_setr_epi8(
+		2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+		2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+	const __m256i rot8 = _mm256_setr_epi8(
+		1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12,
+		1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+	__m256i v[16], vm[16], vc[16];
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		vm[i] = _mm256_set1_epi32((int) ms->m[i]);
+		vc[i] = _mm256_set1_epi32((int) blake256_c[i]);
+	}
+	vm[ms->nonce_word] = _mm256_loadu_si256((const __m256i*) nonces);
+
+	for (i = 0; i < 8; i++)
+		v[i] = _mm256_set1_epi32((int) ms->h[i]);
+	for (i = 0; i < 4; i++)
+		v[8 + i] = vc[i];
+	v[12] = _mm256_set1_epi32((int) (ms->t0 ^ blake256_c[4]));
+	v[13] = _mm256_set1_epi32((int) (ms->t0 ^ blake256_c[5]));
+	v[14] = _mm256_set1_epi32((int) (ms->t1 ^ blake256_c[6]));
+	v[15] = _mm256_set1_epi32((int) (ms->t1 ^ blake256_c[7]));
+
+	ROUNDS(G8, ms->rounds);
+
+	// out[word][lane]
+	for (i = 0; i < 8; i++) {
+		__m256i x = XOR8(_mm256_set1_epi32((int) ms->h[i]), XOR8(v[i], v[i + 8]));
+		_mm256_storeu_si256((__m256i*) out[i], x);
+	}
+}
+
+void blake256_mid_hash8(const blake256_midstate *ms, void *hash, const uint32_t *nonces)
+{
+	uint32_t w[8][8];
+	uint8_t *out = (uint8_t*) hash;
+
+	blake256_mid_lanes8(ms, w, nonces);
+	for (int lane = 0; lane < 8; lane++)
+		for (int i = 0; i < 8; i++)
+			be32_put(&out[32 * lane + 4 * i], w[i][lane]);
+}
+
+#else
+
+void blake256_mid_hash8(const blake256_midstate *ms, void *hash, const uint32_t *nonces)
+{
+	for (int lane = 0; lane < 8; lane++)
+		blake256_mid_hash(ms, (uint8_t*) hash + 32 * lane, nonces[lane]);
+}
+
+#endif
+
+/* same order as fulltest(), on the little endian words of the hash */
+static int blake256_below_target(const uint8_t *hash, const uint32_t *target)
+{
+	for (int i = 7; i >= 0; i--) {
+		const uint8_t *p = &hash[4 * i];
+		uint32_t w = ((uint32_t) p[3] << 24) | ((uint32_t) p[2] << 16) | ((uint32_t) p[1] << 8) | p[0];
+		if (w > target[i])
+			return 0;
+		if (w < target[i])
+			return 1;
+	}
+	return 1;
+}
+
+uint32_t blake256_mid_scan(const blake256_midstate *ms, uint32_t first, uint32_t count,
+	const uint32_t *target, uint32_t *found, uint32_t max_found)
+{
+	uint8_t hash[32];
+	uint32_t nfound = 0;
+	uint32_t n = 0;
+
+#if defined(__AVX2__)
+	// the last word of a hash is h[7] byte swapped, check it before the others
+	const uint32_t high = target[7];
+	for (; n + 8 <= count && nfound < max_found; n += 8) {
+		uint32_t w[8][8], nonces[8];
+		for (int lane = 0; lane < 8; lane++)
+			nonces[lane] = first + n + lane;
+		blake256_mid_lanes8(ms, w, nonces);
+		for (int lane = 0; lane < 8 && nfound < max_found; lane++) {
+			uint32_t h7 = w[7][lane];
+			h7 = (h7 >> 24) | ((h7 >> 8) & 0xff00) | ((h7 << 8) & 0xff0000) | (h7 << 24);
+			if (h7 > high)
+				continue;
+			for (int i = 0; i < 8; i++)
+				be32_put(&hash[4 * i], w[i][lane]);
+			if (blake256_below_target(hash, target))
+				found[nfound++] = nonces[lane];
+		}
+	}
+#endif
+	for (; n < count && nfound < max_found; n++) {
+		blake256_mid_hash(ms, hash, first + n);
+		if (blake256_below_target(hash, target))
+			found[nfound++] = first + n;
+	}
+	return nfound;
+}
+
+void blake256_rounds_hash(void *output, const void *input, size_t len, int rounds)
+{
+	blake256_midstate ms;
+
+	if (blake256_mid_init(&ms, input, len, len - 4, rounds) < 0) {
+		memset(output, 0xff, 32);
+		return;
+	}
+	blake256_mid_hash(&ms, output, ms.m[ms.nonce_word]);
+}
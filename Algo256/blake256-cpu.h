@@ -0,0 +1,45 @@
+#ifndef BLAKE256_CPU_H
+#define BLAKE256_CPU_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if (__cplusplus)
+extern "C" {
+#endif
+
+/**
+ * Blake-256 state before the last block of a work, the nonce is the only
+ * message word which changes between two hashes.
+ */
+typedef struct {
+	uint32_t h[8];     /* chain value, also the gpu midstate */
+	uint32_t m[16];    /* last block with the padding, be32 decoded */
+	uint32_t t0, t1;   /* bit counter of the last block */
+	int nonce_word;    /* index of the nonce in m[] */
+	int rounds;        /* 14 (blake, decred) or 8 (blakecoin, vanilla) */
+} blake256_midstate;
+
+/* the last block must contain 1 to 55 bytes and the 4-byte aligned nonce,
+ * returns -1 for other layouts or rounds */
+int blake256_mid_init(blake256_midstate *ms, const void *data, size_t len, size_t nonce_off, int rounds);
+
+/* the nonce is the be32 decoded word, the value given to be32enc() */
+void blake256_mid_hash(const blake256_midstate *ms, void *hash, uint32_t nonce);
+
+/* 8 nonces at once (AVX2), 8 hashes of 32 bytes */
+void blake256_mid_hash8(const blake256_midstate *ms, void *hash, const uint32_t *nonces);
+
+/* sweep [first, first+count) until max_found nonces are below the target,
+ * return their count */
+uint32_t blake256_mid_scan(const blake256_midstate *ms, uint32_t first, uint32_t count,
+	const uint32_t *target, uint32_t *found, uint32_t max_found);
+
+/* one-shot hash of 80 or 180 bytes inputs, thread safe unlike sph_blake256_set_rounds() */
+void blake256_rounds_hash(void *output, const void *input, size_t len, int rounds);
+
+#if (__cplusplus)
+}
+#endif
+
+#endif
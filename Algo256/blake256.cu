@@ -12,6 +12,7 @@
 extern "C" {
 #include "sph/sph_blake.h"
 }
+#include "Algo256/blake256-cpu.h"
 
 /* threads per block */
 #define TPB 512
@@ -19,16 +20,7 @@ extern "C" {
 /* hash by cpu with blake 256 */
 extern "C" void blake256hash(void *output, const void *input, int8_t rounds = 14)
 {
-	uchar hash[64];
-	sph_blake256_context ctx;
-
-	sph_blake256_set_rounds(rounds);
-
-	sph_blake256_init(&ctx);
-	sph_blake256(&ctx, input, 80);
-	sph_blake256_close(&ctx, hash);
-
-	memcpy(output, hash, 32);
+	blake256_rounds_hash(output, input, 80, rounds);
 }
 
 #include "cuda_helper.h"
@@ -443,19 +435,6 @@ static uint32_t blake256_cpu_hash_16(const int thr_id, const uint32_t threads, c
 	return result;
 }
 
-__host__
-static void blake256mid(uint32_t *output, const uint32_t *input, int8_t rounds = 14)
-{
-	sph_blake256_context ctx;
-
-	sph_blake256_set_rounds(rounds);
-
-	sph_blake256_init(&ctx);
-	sph_blake256(&ctx, input, 64);
-
-	memcpy(output, (void*)ctx.H, 32);
-}
-
 __host__
 void blake256_cpu_setBlock_16(uint32_t *penddata, const uint32_t *midstate, const uint32_t *ptarget)
 {
@@ -472,7 +451,7 @@ static bool init[MAX_GPUS] = { 0 };
 extern "C" int scanhash_blake256(int thr_id, struct work* work, uint32_t max_nonce, unsigned long *hashes_done, int8_t blakerounds=14)
 {
 	uint32_t _ALIGN(64) endiandata[20];
-	uint32_t _ALIGN(64) midstate[8];
+	blake256_midstate mid;
 
 	uint32_t *pdata = work->data;
 	uint32_t *ptarget = work->target;
@@ -513,11 +492,12 @@ extern "C" int scanhash_blake256(int thr_id, struct work* work, uint32_t max_non
 		init[thr_id] = true;
 	}
 
-	for (int k = 0; k < 16; k++)
+	for (int k = 0; k < 20; k++)
 		be32enc(&endiandata[k], pdata[k]);
 
-	blake256mid(midstate, endiandata, blakerounds);
-	blake256_cpu_setBlock_16(&pdata[16], midstate, ptarget);
+	// first block for the gpu, last one to check the results
+	blake256_mid_init(&mid, endiandata, 80, 76, blakerounds);
+	blake256_cpu_setBlock_16(&pdata[16], mid.h, ptarget);
 
 	do {
 		// GPU HASH (second block only, first is midstate)
@@ -530,11 +510,7 @@ extern "C" int scanhash_blake256(int thr_id, struct work* work, uint32_t max_non
 			uint32_t _ALIGN(64) vhashcpu[8];
 			const uint32_t Htarg = ptarget[6];
 
-			for (int k=16; k < 19; k++)
-				be32enc(&endiandata[k], pdata[k]);
-
-			be32enc(&endiandata[19], work->nonces[0]);
-			blake256hash(vhashcpu, endiandata, blakerounds);
+			vstats_hash(thr_id, blake256_mid_hash(&mid, vhashcpu, work->nonces[0]));
 
 			if (vhashcpu[6] <= Htarg && fulltest(vhashcpu, ptarget))
 			{
@@ -543,8 +519,7 @@ extern "C" int scanhash_blake256(int thr_id, struct work* work, uint32_t max_non
 #if NBN > 1
 				if (extra_results[0] != UINT32_MAX) {
 					work->nonces[1] = extra_results[0];
-					be32enc(&endiandata[19], work->nonces[1]);
-					blake256hash(vhashcpu, endiandata, blakerounds);
+					vstats_hash(thr_id, blake256_mid_hash(&mid, vhashcpu, work->nonces[1]));
 					if (vhashcpu[6] <= Htarg && fulltest(vhashcpu, ptarget)) {
 						if (bn_hash_target_ratio(vhashcpu, ptarget) > work->shareratio[0]) {
 							work_set_target_ratio(work, vhashcpu);
@@ -8,7 +8,7 @@
 #include <string.h>
 #include <stdint.h>
 
-#include "sph/blake2s.h"
+#include "sph/blake2-simd.h"
 #include "sph/sph_types.h"
 
 #ifdef __INTELLISENSE__
@@ -46,108 +46,9 @@ uint32_t xor3x(uint32_t a, uint32_t b, uint32_t c)
 	return result;
 }
 
-static const uint32_t blake2s_IV[8] = {
-	0x6A09E667UL, 0xBB67AE85UL, 0x3C6EF372UL, 0xA54FF53AUL,
-	0x510E527FUL, 0x9B05688CUL, 0x1F83D9ABUL, 0x5BE0CD19UL
-};
-
-static const uint8_t blake2s_sigma[10][16] = {
-	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
-	{ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
-	{ 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
-	{  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
-	{  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
-	{  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
-	{ 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
-	{ 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
-	{  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
-	{ 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13 , 0 },
-};
-
-#define G(r,i,a,b,c,d) \
-	do { \
-		a = a + b + m[blake2s_sigma[r][2*i+0]]; \
-		d = SPH_ROTR32(d ^ a, 16); \
-		c = c + d; \
-		b = SPH_ROTR32(b ^ c, 12); \
-		a = a + b + m[blake2s_sigma[r][2*i+1]]; \
-		d = SPH_ROTR32(d ^ a, 8); \
-		c = c + d; \
-		b = SPH_ROTR32(b ^ c, 7); \
-	} while(0)
-#define ROUND(r)  \
-	do { \
-		G(r,0,v[0],v[4],v[ 8],v[12]); \
-		G(r,1,v[1],v[5],v[ 9],v[13]); \
-		G(r,2,v[2],v[6],v[10],v[14]); \
-		G(r,3,v[3],v[7],v[11],v[15]); \
-		G(r,4,v[0],v[5],v[10],v[15]); \
-		G(r,5,v[1],v[6],v[11],v[12]); \
-		G(r,6,v[2],v[7],v[ 8],v[13]); \
-		G(r,7,v[3],v[4],v[ 9],v[14]); \
-	} while(0)
-
 extern "C" void blake2s_hash(void *output, const void *input)
 {
-	uint32_t m[16];
-	uint32_t v[16];
-	uint32_t h[8];
-
-	uint32_t *in = (uint32_t*)input;
-//	COMPRESS
-	for(int i = 0; i < 16; ++i )
-		m[i] = in[i];
-
-	h[0] = 0x01010020 ^ blake2s_IV[0];
-	h[1] = blake2s_IV[1];
-	h[2] = blake2s_IV[2];
-	h[3] = blake2s_IV[3];
-	h[4] = blake2s_IV[4];
-	h[5] = blake2s_IV[5];
-	h[6] = blake2s_IV[6];
-	h[7] = blake2s_IV[7];
-
-	for(int i = 0; i < 8; ++i )
-		v[i] = h[i];
-
-	v[ 8] = blake2s_IV[0];		v[ 9] = blake2s_IV[1];
-	v[10] = blake2s_IV[2];		v[11] = blake2s_IV[3];
-	v[12] = 64 ^ blake2s_IV[4];	v[13] = blake2s_IV[5];
-	v[14] = blake2s_IV[6];		v[15] = blake2s_IV[7];
-
-	ROUND( 0 ); ROUND( 1 );
-	ROUND( 2 ); ROUND( 3 );
-	ROUND( 4 ); ROUND( 5 );
-	ROUND( 6 ); ROUND( 7 );
-	ROUND( 8 ); ROUND( 9 );
-
-	for(size_t i = 0; i < 8; ++i)
-		h[i] ^= v[i] ^ v[i + 8];
-
-//	COMPRESS
-	m[0] = in[16]; m[1] = in[17];
-	m[2] = in[18]; m[3] = in[19];
-	for(size_t i = 4; i < 16; ++i)
-		m[i] = 0;
-
-	for(size_t i = 0; i < 8; ++i)
-		v[i] = h[i];
-
-	v[ 8] = blake2s_IV[0];		v[ 9] = blake2s_IV[1];
-	v[10] = blake2s_IV[2];		v[11] = blake2s_IV[3];
-	v[12] = 0x50 ^ blake2s_IV[4];	v[13] = blake2s_IV[5];
-	v[14] = ~blake2s_IV[6];		v[15] = blake2s_IV[7];
-
-	ROUND( 0 ); ROUND( 1 );
-	ROUND( 2 ); ROUND( 3 );
-	ROUND( 4 ); ROUND( 5 );
-	ROUND( 6 ); ROUND( 7 );
-	ROUND( 8 ); ROUND( 9 );
-
-	for(size_t i = 0; i < 8; ++i)
-		h[i] ^= v[i] ^ v[i + 8];
-
-	memcpy(output, h, 32);
+	blake2s_simd(output, 32, input, 80);
 }
 
 #define TPB 1024
@@ -339,42 +240,17 @@ void blake2s_gpu_hash_nonce(const uint32_t threads, const uint32_t startNonce, u
 	}
 }
 
-static void blake2s_setBlock(const uint32_t* input,const uint32_t ptarget7)
+static void blake2s_setBlock(const blake2s_midstate *mid, const uint32_t ptarget7)
 {
-	uint32_t _ALIGN(64) m[16];
-	uint32_t _ALIGN(64) v[16];
 	uint32_t _ALIGN(64) h[21];
 
-//	COMPRESS
-	for(int i = 0; i < 16; ++i )
-		m[i] = input[i];
-
-	h[0] = 0x01010020 ^ blake2s_IV[0];
-	h[1] = blake2s_IV[1];
-	h[2] = blake2s_IV[2]; h[3] = blake2s_IV[3];
-	h[4] = blake2s_IV[4]; h[5] = blake2s_IV[5];
-	h[6] = blake2s_IV[6]; h[7] = blake2s_IV[7];
-
+	// chain value after the first block, then the nonce block words
 	for(int i = 0; i < 8; ++i )
-		v[i] = h[i];
+		h[i] = mid->h[i];
 
-	v[ 8] = blake2s_IV[0];		v[ 9] = blake2s_IV[1];
-	v[10] = blake2s_IV[2];		v[11] = blake2s_IV[3];
-	v[12] = 64 ^ blake2s_IV[4];	v[13] = blake2s_IV[5];
-	v[14] = blake2s_IV[6];		v[15] = blake2s_IV[7];
-
-	ROUND( 0 ); ROUND( 1 );
-	ROUND( 2 ); ROUND( 3 );
-	ROUND( 4 ); ROUND( 5 );
-	ROUND( 6 ); ROUND( 7 );
-	ROUND( 8 ); ROUND( 9 );
-
-	for(int i = 0; i < 8; ++i )
-		h[i] ^= v[i] ^ v[i + 8];
-
-	h[16] = input[16];
-	h[17] = input[17];
-	h[18] = input[18];
+	h[16] = mid->m[0];
+	h[17] = mid->m[1];
+	h[18] = mid->m[2];
 
 	h[ 8] = 0x6A09E667; h[ 9] = 0xBB67AE85;
 	h[10] = 0x3C6EF372; h[11] = 0xA54FF53A;
@@ -431,6 +307,7 @@ static bool init[MAX_GPUS] = { 0 };
 extern "C" int scanhash_blake2s(int thr_id, struct work *work, uint32_t max_nonce, unsigned long *hashes_done)
 {
 	uint32_t _ALIGN(64) endiandata[20];
+	blake2s_midstate mid;
 
 	uint32_t *pdata = work->data;
 	uint32_t *ptarget = work->target;
@@ -466,10 +343,11 @@ extern "C" int scanhash_blake2s(int thr_id, struct work *work, uint32_t max_nonc
 	}
 	resNonces = h_resNonce[thr_id];
 
-	for (int i=0; i < 19; i++) {
+	for (int i=0; i < 20; i++) {
 		be32enc(&endiandata[i], pdata[i]);
 	}
-	blake2s_setBlock(endiandata,ptarget[7]);
+	blake2s_mid_init(&mid, endiandata, 80, 76, 32);
+	blake2s_setBlock(&mid, ptarget[7]);
 
 	cudaMemset(d_resNonce[thr_id], 0x00, maxResults*sizeof(uint32_t));
 
@@ -491,10 +369,19 @@ extern "C" int scanhash_blake2s(int thr_id, struct work *work, uint32_t max_nonc
 				resNonces[0] = maxResults-1;
 			}
 
-			uint32_t vhashcpu[8];
+			// several candidates are hashed 8 at once (unused lanes repeat the last)
+			const uint32_t count = resNonces[0];
+			uint32_t _ALIGN(64) vhashes[maxResults + 8][8];
+			if (count == 1) {
+				vstats_hash(thr_id, blake2s_mid_hash(&mid, vhashes[1], resNonces[1]));
+			} else for (uint32_t j = 1; j <= count; j += 8) {
+				uint32_t lanes[8];
+				for (uint32_t l = 0; l < 8; l++)
+					lanes[l] = resNonces[min(j + l, count)];
+				vstats_hash(thr_id, blake2s_mid_hash8(&mid, vhashes[j], lanes));
+			}
+			uint32_t *vhashcpu = vhashes[1];
 			uint32_t nonce = sph_bswap32(resNonces[1]);
-			be32enc(&endiandata[19], nonce);
-			blake2s_hash(vhashcpu, endiandata);
 
 			*hashes_done = pdata[19] - first_nonce + throughput;
 
@@ -508,8 +395,7 @@ extern "C" int scanhash_blake2s(int thr_id, struct work *work, uint32_t max_nonc
 				for(uint32_t j=2; j <= resNonces[0]; j++)
 				{
 					nonce = sph_bswap32(resNonces[j]);
-					be32enc(&endiandata[19], nonce);
-					blake2s_hash(vhashcpu, endiandata);
+					vhashcpu = vhashes[j];
 					if(vhashcpu[6] <= ptarget[6] && fulltest(vhashcpu, ptarget))
 					{
 						gpulog(LOG_DEBUG, thr_id, "Multiple nonces: 1/%08x - %u/%08x", work->nonces[0], j, nonce);
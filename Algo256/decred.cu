@@ -11,6 +11,7 @@
 extern "C" {
 #include <sph/sph_blake.h>
 }
+#include "Algo256/blake256-cpu.h"
 
 /* threads per block */
 #define TPB 640
@@ -21,13 +22,7 @@ extern "C" {
 /* hash by cpu with blake 256 */
 extern "C" void decred_hash(void *output, const void *input)
 {
-	sph_blake256_context ctx;
-
-	sph_blake256_set_rounds(14);
-
-	sph_blake256_init(&ctx);
-	sph_blake256(&ctx, input, 180);
-	sph_blake256_close(&ctx, output);
+	blake256_rounds_hash(output, input, 180, 14);
 }
 
 #include <cuda_helper.h>
@@ -177,7 +172,7 @@ void decred_gpu_hash_nonce(const uint32_t threads, const uint32_t startNonce, ui
 }
 
 __host__
-void decred_cpu_setBlock_52(const uint32_t *input)
+void decred_cpu_setBlock_52(const uint32_t *input, const uint32_t *midstate)
 {
 /*
 	Precompute everything possible and pass it on constant memory
@@ -195,21 +190,16 @@ void decred_cpu_setBlock_52(const uint32_t *input)
 	uint32_t _ALIGN(64)      m[16];
 	uint32_t _ALIGN(64)      h[ 2];
 
-	sph_blake256_context ctx;
-	sph_blake256_set_rounds(14);
-	sph_blake256_init(&ctx);
-	sph_blake256(&ctx, input, 128);
-
-	data[ 0] = ctx.H[0];
-	data[ 1] = ctx.H[1];
-	data[ 2] = ctx.H[2];
-	data[ 3] = ctx.H[3];
-	data[ 4] = ctx.H[4];
-	data[ 5] = ctx.H[5];
-	data[ 8] = ctx.H[6];
+	data[ 0] = midstate[0];
+	data[ 1] = midstate[1];
+	data[ 2] = midstate[2];
+	data[ 3] = midstate[3];
+	data[ 4] = midstate[4];
+	data[ 5] = midstate[5];
+	data[ 8] = midstate[6];
 
 	data[12] = swab32(input[35]);
-	data[13] = ctx.H[7];
+	data[13] = midstate[7];
 
 	// pre swab32
 	m[ 0] = swab32(input[32]);	m[ 1] = swab32(input[33]);
@@ -345,6 +335,7 @@ static bool init[MAX_GPUS] = { 0 };
 extern "C" int scanhash_decred(int thr_id, struct work* work, uint32_t max_nonce, unsigned long *hashes_done)
 {
 	uint32_t _ALIGN(64) endiandata[48];
+	blake256_midstate mid;
 
 	uint32_t *pdata = work->data;
 	uint32_t *ptarget = work->target;
@@ -382,7 +373,9 @@ extern "C" int scanhash_decred(int thr_id, struct work* work, uint32_t max_nonce
 	}
 	memcpy(endiandata, pdata, 180);
 
-	decred_cpu_setBlock_52(endiandata);
+	// first two blocks for the gpu, last one to check the results
+	blake256_mid_init(&mid, endiandata, 180, DCR_NONCE_OFT32 * 4, 14);
+	decred_cpu_setBlock_52(endiandata, mid.h);
 	cudaMemset(d_resNonce[thr_id], 0x00, sizeof(uint32_t));
 
 	do {
@@ -404,8 +397,7 @@ extern "C" int scanhash_decred(int thr_id, struct work* work, uint32_t max_nonce
 
 			cudaMemcpy(resNonces, d_resNonce[thr_id], (resNonces[0]+1)*sizeof(uint32_t), cudaMemcpyDeviceToHost);
 
-			be32enc(&endiandata[DCR_NONCE_OFT32], resNonces[1]);
-			decred_hash(vhash, endiandata);
+			vstats_hash(thr_id, blake256_mid_hash(&mid, vhash, resNonces[1]));
 			if (vhash[6] <= ptarget[6] && fulltest(vhash, ptarget))
 			{
 				work->valid_nonces = 1;
@@ -416,8 +408,7 @@ extern "C" int scanhash_decred(int thr_id, struct work* work, uint32_t max_nonce
 				// search for another nonce
 				for(uint32_t n=2; n <= resNonces[0]; n++)
 				{
-					be32enc(&endiandata[DCR_NONCE_OFT32], resNonces[n]);
-					decred_hash(vhash, endiandata);
+					vstats_hash(thr_id, blake256_mid_hash(&mid, vhash, resNonces[n]));
 					if (vhash[6] <= ptarget[6] && fulltest(vhash, ptarget)) {
 						work->nonces[1] = swab32(resNonces[n]);
 						if (bn_hash_target_ratio(vhash, ptarget) > work->shareratio[0]) {
@@ -7,7 +7,7 @@ extern "C"
 {
 #include "sph/sph_shavite.h"
 #include "sph/sph_simd.h"
-#include "sph/sph_keccak.h"
+#include "sph/keccak-simd.h"
 
 #include "miner.h"
 }
@@ -30,14 +30,7 @@ extern void keccak256_sm3_hash_80(int thr_id, uint32_t threads, uint32_t startNo
 // CPU Hash
 extern "C" void keccak256_hash(void *state, const void *input)
 {
-	uint32_t _ALIGN(64) hash[16];
-	sph_keccak_context ctx_keccak;
-
-	sph_keccak256_init(&ctx_keccak);
-	sph_keccak256 (&ctx_keccak, input, 80);
-	sph_keccak256_close(&ctx_keccak, (void*) hash);
-
-	memcpy(state, hash, 32);
+	keccak_simd(state, 32, input, 80);
 }
 
 static bool init[MAX_GPUS] = { 0 };
@@ -112,20 +105,20 @@ extern "C" int scanhash_keccak256(int thr_id, struct work* work, uint32_t max_no
 		if (work->nonces[0] != UINT32_MAX && bench_algo < 0)
 		{
 			const uint32_t Htarg = ptarget[7];
-			uint32_t _ALIGN(64) vhash[8];
+			uint32_t _ALIGN(64) vhash[2][8];
+			// both candidates in one batch, the nonce words are big endian
+			const uint32_t vnonces[2] = { swab32(work->nonces[0]), swab32(work->nonces[1]) };
+			const bool second = !use_compat_kernels[thr_id] && work->nonces[1] != UINT32_MAX;
 
-			be32enc(&endiandata[19], work->nonces[0]);
-			keccak256_hash(vhash, endiandata);
+			vstats_hash(thr_id, keccak256_hash_n(vhash, endiandata, 80, 76, vnonces, second ? 2 : 1));
 
-			if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
+			if (vhash[0][7] <= ptarget[7] && fulltest(vhash[0], ptarget)) {
 				work->valid_nonces = 1;
-				work_set_target_ratio(work, vhash);
-				if (!use_compat_kernels[thr_id] && work->nonces[1] != UINT32_MAX) {
-					be32enc(&endiandata[19], work->nonces[1]);
-					keccak256_hash(vhash, endiandata);
-					if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
+				work_set_target_ratio(work, vhash[0]);
+				if (second) {
+					if (vhash[1][7] <= ptarget[7] && fulltest(vhash[1], ptarget)) {
 						work->valid_nonces++;
-						bn_set_target_ratio(work, vhash, 1);
+						bn_set_target_ratio(work, vhash[1], 1);
 					}
 					pdata[19] = max(work->nonces[0], work->nonces[1]) + 1;
 				} else {
@@ -133,7 +126,7 @@ extern "C" int scanhash_keccak256(int thr_id, struct work* work, uint32_t max_no
 				}
 				return work->valid_nonces;
 			}
-			else if (vhash[7] > Htarg) {
+			else if (vhash[0][7] > Htarg) {
 				gpu_increment_reject(thr_id);
 				if (!opt_quiet)
 				gpulog(LOG_WARNING, thr_id, "result for %08x does not validate on CPU!", work->nonces[0]);
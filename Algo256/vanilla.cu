@@ -20,6 +20,7 @@
 extern "C" {
 #include "sph/sph_blake.h"
 }
+#include "Algo256/blake256-cpu.h"
 
 #include "cuda_helper.h"
 
@@ -41,16 +42,7 @@ static cudaStream_t	streams[MAX_GPUS];
 
 /* hash by cpu with blake 256 */
 extern "C" void vanillahash(void *output, const void *input, int8_t blakerounds){
-	uchar hash[64];
-	sph_blake256_context ctx;
-
-	sph_blake256_set_rounds(blakerounds);
-
-	sph_blake256_init(&ctx);
-	sph_blake256(&ctx, input, 80);
-	sph_blake256_close(&ctx, hash);
-
-	memcpy(output, hash, 32);
+	blake256_rounds_hash(output, input, 80, blakerounds);
 }
 #define GS4(a,b,c,d,x,y,a1,b1,c1,d1,x1,y1,a2,b2,c2,d2,x2,y2,a3,b3,c3,d3,x3,y3) { \
 	v[ a]+= (m[ x] ^ z[ y]) + v[ b]; \
@@ -291,7 +283,7 @@ loopstart:
 }
 
 __host__
-void vanilla_cpu_setBlock_16(const int thr_id,const uint32_t* endiandata, uint32_t *penddata){
+void vanilla_cpu_setBlock_16(const int thr_id,const uint32_t* midstate, uint32_t *penddata){
 
 	const uint32_t _ALIGN(64) z[16] = {
 		SPH_C32(0x243F6A88), SPH_C32(0x85A308D3), SPH_C32(0x13198A2E), SPH_C32(0x03707344),
@@ -301,17 +293,10 @@ void vanilla_cpu_setBlock_16(const int thr_id,const uint32_t* endiandata, uint32
 	};
 	uint32_t _ALIGN(64) h[22];
 
-	sph_blake256_context ctx;
-
-	sph_blake256_set_rounds(8);
-
-	sph_blake256_init(&ctx);
-	sph_blake256(&ctx, endiandata, 64);
-
-	h[ 0] = ctx.H[0];	h[ 1] = ctx.H[1];
-	h[ 2] = ctx.H[2];	h[21] = ctx.H[3];
-	h[ 4] = ctx.H[4];	h[20] = ctx.H[5];
-	h[19] = ctx.H[6];	h[16] = ctx.H[7];
+	h[ 0] = midstate[0];	h[ 1] = midstate[1];
+	h[ 2] = midstate[2];	h[21] = midstate[3];
+	h[ 4] = midstate[4];	h[20] = midstate[5];
+	h[19] = midstate[6];	h[16] = midstate[7];
 
 	uint32_t tmp = h[20];
 	h[20] = h[19];
@@ -403,13 +388,16 @@ extern "C" int scanhash_vanilla(int thr_id, struct work* work, uint32_t max_nonc
 	}
 
 	uint32_t _ALIGN(64) endiandata[20];
+	blake256_midstate mid;
 
-	for (int k = 0; k < 16; k++)
+	for (int k = 0; k < 20; k++)
 		be32enc(&endiandata[k], pdata[k]);
 
 	cudaMemsetAsync(d_resNonce[thr_id], 0xff, sizeof(uint32_t),streams[thr_id]);
 
-	vanilla_cpu_setBlock_16(thr_id,endiandata,&pdata[16]);
+	// first block for the gpu, last one to check the results
+	blake256_mid_init(&mid, endiandata, 80, 76, blakerounds);
+	vanilla_cpu_setBlock_16(thr_id,mid.h,&pdata[16]);
 
 	const dim3 grid((throughput + (NPT*TPB)-1)/(NPT*TPB));
 	const dim3 block(TPB);
@@ -425,11 +413,7 @@ extern "C" int scanhash_vanilla(int thr_id, struct work* work, uint32_t max_nonc
 			uint32_t vhashcpu[8];
 			uint32_t Htarg = (uint32_t)targetHigh;
 
-			for (int k=0; k < 19; k++)
-				be32enc(&endiandata[k], pdata[k]);
-
-			be32enc(&endiandata[19], h_resNonce[thr_id][0]);
-			vanillahash(vhashcpu, endiandata, blakerounds);
+			vstats_hash(thr_id, blake256_mid_hash(&mid, vhashcpu, h_resNonce[thr_id][0]));
 
 			if (vhashcpu[6] <= Htarg && fulltest(vhashcpu, ptarget)) {
 				work->valid_nonces = 1;
@@ -438,8 +422,7 @@ extern "C" int scanhash_vanilla(int thr_id, struct work* work, uint32_t max_nonc
 #if NBN > 1
 				if (h_resNonce[thr_id][1] != UINT32_MAX) {
 					work->nonces[1] = h_resNonce[thr_id][1];
-					be32enc(&endiandata[19], h_resNonce[thr_id][1]);
-					vanillahash(vhashcpu, endiandata, blakerounds);
+					blake256_mid_hash(&mid, vhashcpu, h_resNonce[thr_id][1]);
 					if (bn_hash_target_ratio(vhashcpu, ptarget) > work->shareratio[0]) {
 						work_set_target_ratio(work, vhashcpu);
 						xchg(work->nonces[0], work->nonces[1]);
@@ -221,7 +221,7 @@ extern "C" int scanhash_jackpot(int thr_id, struct work *work, uint32_t max_nonc
 			be32enc(&endiandata[19], work->nonces[0]);
 
 			// jackpothash function gibt die Zahl der Runden zurück
-			jackpothash(vhash, endiandata);
+			vstats_hash(thr_id, jackpothash(vhash, endiandata));
 
 			if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
@@ -230,7 +230,7 @@ extern "C" int scanhash_jackpot(int thr_id, struct work *work, uint32_t max_nonc
 				work->nonces[1] = cuda_check_hash_suppl(thr_id, throughput, pdata[19], d_hash[thr_id], 1);
 				if (work->nonces[1] != 0) {
 					be32enc(&endiandata[19], work->nonces[1]);
-					jackpothash(vhash, endiandata);
+					vstats_hash(thr_id, jackpothash(vhash, endiandata));
 					bn_set_target_ratio(work, vhash, 1);
 					work->valid_nonces++;
 					pdata[19] = max(work->nonces[0], work->nonces[1]) + 1;
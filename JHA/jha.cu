@@ -200,7 +200,7 @@ extern "C" int scanhash_jha(int thr_id, struct work *work, uint32_t max_nonce, u
 			uint32_t _ALIGN(64) vhash[8];
 
 			be32enc(&endiandata[19], work->nonces[0]);
-			jha_hash(vhash, endiandata);
+			vstats_hash(thr_id, jha_hash(vhash, endiandata));
 
 			if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
@@ -208,7 +208,7 @@ extern "C" int scanhash_jha(int thr_id, struct work *work, uint32_t max_nonce, u
 				work->nonces[1] = cuda_check_hash_suppl(thr_id, throughput, pdata[19], d_hash[thr_id], 1);
 				if (work->nonces[1] != 0) {
 					be32enc(&endiandata[19], work->nonces[1]);
-					jha_hash(vhash, endiandata);
+					vstats_hash(thr_id, jha_hash(vhash, endiandata));
 					bn_set_target_ratio(work, vhash, 1);
 					work->valid_nonces++;
 					pdata[19] = max(work->nonces[0], work->nonces[1]) + 1;
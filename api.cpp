@@ -201,12 +201,12 @@ static char *getsummary(char *params)
 	sprintf(buffer, "NAME=%s;VER=%s;API=%s;"
 		"ALGO=%s;GPUS=%d;KHS=%.2f;SOLV=%d;ACC=%d;REJ=%d;"
 		"ACCMN=%.3f;DIFF=%.6f;NETKHS=%.0f;"
-		"POOLS=%u;WAIT=%u;UPTIME=%.0f;TS=%u|",
+		"POOLS=%u;WAIT=%u;UPTIME=%.0f;TS=%u;LOGDROP=%u|",
 		PACKAGE_NAME, PACKAGE_VERSION, APIVERSION,
 		algo, active_gpus, (double)global_hashrate / 1000.,
 		solved_count, accepted_count, rejected_count,
 		accps, net_diff > 1e-6 ? net_diff : stratum_diff, (double)net_hashrate / 1000.,
-		num_pools, wait_time, uptime, (uint32_t) ts);
+		num_pools, wait_time, uptime, (uint32_t) ts, (uint32_t) applog_dropped());
 	return buffer;
 }
 
@@ -226,27 +226,33 @@ static char *getpoolnfo(char *params)
 
 	*s = '\0';
 
-	if (stratum.job.job_id)
-		strncpy(jobid, stratum.job.job_id, sizeof(stratum.job.job_id));
-	if (stratum.job.xnonce2) {
+	// consistent view of the job, without blocking the stratum thread
+	struct stratum_job *job = stratum_job_acquire(&stratum);
+	uchar xnonce2[32];
+	uint32_t height = job && job->height ? job->height : stratum.block_height;
+	if (job) {
+		strncpy(jobid, job->job_id, sizeof(jobid) - 1);
+		if (!stratum_job_xnonce2(job, xnonce2, false))
+			memcpy(xnonce2, job->xnonce2, job->xnonce2_size);
 		/* used temporary to be sure all is ok */
 		sprintf(extra, "0x");
 		if (p->algo == ALGO_DECRED) {
 			char compat[32] = { 0 };
-			cbin2hex(&extra[2], (const char*) stratum.xnonce1, min(36, stratum.xnonce2_size));
-			cbin2hex(compat, (const char*) stratum.job.xnonce2, 4);
+			cbin2hex(&extra[2], (const char*) job->xnonce2 - job->xnonce1_size, min(36, job->xnonce2_size));
+			cbin2hex(compat, (const char*) xnonce2, 4);
 			memcpy(&extra[2], compat, 8); // compat extranonce
 		} else {
-			cbin2hex(&extra[2], (const char*) stratum.job.xnonce2, stratum.xnonce2_size);
+			cbin2hex(&extra[2], (const char*) xnonce2, job->xnonce2_size);
 		}
 	}
+	stratum_job_release();
 
 	snprintf(s, MYBUFSIZ, "POOL=%s;ALGO=%s;URL=%s;USER=%s;SOLV=%d;ACC=%d;REJ=%d;STALE=%u;H=%u;JOB=%s;DIFF=%.6f;"
 		"BEST=%.6f;N2SZ=%d;N2=%s;PING=%u;DISCO=%u;WAIT=%u;UPTIME=%u;LAST=%u|",
 		strlen(p->name) ? p->name : p->short_url, algo_names[p->algo],
 		p->url, p->type & POOL_STRATUM ? p->user : "",
 		p->solved_count, p->accepted_count, p->rejected_count, p->stales_count,
-		stratum.job.height, jobid, stratum_diff, p->best_share,
+		height, jobid, stratum_diff, p->best_share,
 		(int) stratum.xnonce2_size, extra, stratum.answer_msec,
 		p->disconnects, p->wait_time, p->work_time, last_share);
 
@@ -384,6 +390,32 @@ static char *gethistory(char *params)
 	return buffer;
 }
 
+/**
+ * Returns the cpu verification counters (per thread and algo)
+ */
+static char *getvstats(char *params)
+{
+	struct vstats_data data[32];
+	int thrid = params ? atoi(params) : -1;
+	char *p = buffer;
+	int records = vstats_get(thrid, data, ARRAY_SIZE(data));
+	*buffer = '\0';
+	for (int i = 0; i < records; i++) {
+		struct vstats_data *d = &data[i];
+		double avg = d->candidates ? (double) d->time_ns / d->candidates / 1000. : 0.;
+		p += sprintf(p, "GPU=%d;ALGO=%s;CAND=%llu;FP=%llu;DUP=%llu;STALE=%llu;"
+				"TIME=%.3f;AVG=%.1f;HIST=",
+			device_map[d->thr_id], algo_names[d->algo],
+			(unsigned long long) d->candidates, (unsigned long long) d->false_pos,
+			(unsigned long long) d->duplicates, (unsigned long long) d->stales,
+			(double) d->time_ns / 1e6, avg);
+		for (int n = 0; n < VSTATS_BUCKETS; n++)
+			p += sprintf(p, n ? ",%u" : "%u", d->hist[n]);
+		p += sprintf(p, "|");
+	}
+	return buffer;
+}
+
 /**
  * Returns the job scans ranges (debug purpose, only with -D)
  */
@@ -424,6 +456,22 @@ static char *getmeminfo(char *params)
 	return buffer;
 }
 
+/**
+ * Timings of the getwork/gbt rpc calls (solo and getwork pools)
+ */
+static char *getrpcinfos(char *params)
+{
+	struct rpc_timing t;
+	char *p = buffer;
+	*buffer = '\0';
+	for (int i = 0; rpc_timing_get(i, &t); i++) {
+		p += sprintf(p, "METHOD=%s;COUNT=%u;FAILS=%u;LAST=%.2f;AVG=%.2f;MAX=%.2f|",
+			t.method, t.count, t.fails, t.last_ms,
+			t.count ? t.total_ms / t.count : 0., t.max_ms);
+	}
+	return buffer;
+}
+
 /*****************************************************************************/
 
 /**
@@ -492,6 +540,8 @@ struct CMDS {
 	{ "hwinfo",  gethwinfos, false },
 	{ "meminfo", getmeminfo, false },
 	{ "scanlog", getscanlog, false },
+	{ "vstats",  getvstats, false },
+	{ "rpc",     getrpcinfos, false },
 
 	/* remote functions */
 	{ "seturl",  remote_seturl, true }, /* prefer switchpool, deprecated */
@@ -0,0 +1,345 @@
+/**
+ * Asynchronous console log
+ *
+ * Each thread which logs gets its own single producer ring, the messages
+ * are only formatted by the caller (vsnprintf), the time prefix, colors and
+ * the console write are done by a single writer thread which drains all the
+ * rings and batch the lines with writev(). When a ring is full, the message
+ * is dropped and counted, hash threads never wait on the console.
+ *
+ * The rings are sized at start for the mining, validation and service
+ * threads. A thread beyond that limit logs synchronously, so its lines can
+ * be printed before older lines still queued by the other threads.
+ *
+ * The binary mode (--log-binary) writes fixed headers followed by the raw
+ * message instead of the text lines, to be parsed by external tools.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <atomic>
+#ifndef WIN32
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include "miner.h"
+
+#define LOGQ_SLOTS    128 /* per thread, power of 2 */
+#define LOGQ_MSGLEN   496
+#define LOGQ_MINRINGS 64
+#define LOGQ_MAXRINGS 256 /* tid is 8 bits */
+#define LOGQ_BATCH    64  /* lines per writev */
+#define LOGQ_IDLE_MS  20
+
+#define LOGQ_BIN_MAGIC 0x314c4343 /* "CCL1" */
+
+struct logq_rec {
+	uint64_t tm_us;
+	uint16_t len;
+	uint8_t prio;
+	uint8_t tid;
+	uint32_t reserved;
+	char msg[LOGQ_MSGLEN];
+};
+
+struct logq_ring {
+	std::atomic<uint32_t> head; /* producer */
+	std::atomic<uint32_t> tail; /* writer */
+	std::atomic<uint32_t> dropped;
+	uint8_t tid;
+	struct logq_rec rec[LOGQ_SLOTS];
+};
+
+/* binary record header, little endian */
+struct logq_bin_hdr {
+	uint32_t magic;
+	uint16_t len;
+	uint8_t prio;
+	uint8_t tid;
+	uint64_t tm_us;
+};
+
+bool opt_log_async = false;
+bool opt_log_binary = false;
+
+static std::atomic<struct logq_ring*> *rings = NULL;
+static int maxrings = 0;
+static std::atomic<int> nrings(0);
+static std::atomic<int> producers(0);
+static __thread struct logq_ring *tls_ring = NULL;
+static __thread bool tls_no_ring = false;
+
+static std::atomic<bool> writer_running(false);
+static std::atomic<bool> writer_sleeping(false);
+static std::atomic<bool> writer_stop(false);
+static std::atomic<uint64_t> total_dropped(0);
+static pthread_t writer_thr;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_cond = PTHREAD_COND_INITIALIZER;
+
+static uint64_t logq_now_us()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint64_t) tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+static struct logq_ring* logq_get_ring()
+{
+	if (tls_ring || tls_no_ring)
+		return tls_ring;
+
+	int idx = nrings.fetch_add(1);
+	if (idx >= maxrings) {
+		tls_no_ring = true;
+		return NULL;
+	}
+	struct logq_ring *r = (struct logq_ring*) calloc(1, sizeof(struct logq_ring));
+	if (!r) {
+		tls_no_ring = true;
+		return NULL;
+	}
+	r->tid = (uint8_t) idx;
+	rings[idx].store(r, std::memory_order_release);
+	tls_ring = r;
+	return r;
+}
+
+static bool logq_push(int prio, const char *fmt, va_list ap)
+{
+	struct logq_ring *r = logq_get_ring();
+	if (!r) return false;
+
+	uint32_t head = r->head.load(std::memory_order_relaxed);
+	uint32_t tail = r->tail.load(std::memory_order_acquire);
+	if (head - tail >= LOGQ_SLOTS) {
+		r->dropped.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	struct logq_rec *rec = &r->rec[head & (LOGQ_SLOTS - 1)];
+	int len = vsnprintf(rec->msg, LOGQ_MSGLEN, fmt, ap);
+	if (len < 0) len = 0;
+	if (len >= LOGQ_MSGLEN) len = LOGQ_MSGLEN - 1;
+	rec->len = (uint16_t) len;
+	rec->prio = (uint8_t) prio;
+	rec->tid = r->tid;
+	rec->tm_us = logq_now_us();
+	r->head.store(head + 1, std::memory_order_release);
+
+	if (writer_sleeping.load(std::memory_order_relaxed))
+		pthread_cond_signal(&writer_cond);
+	return true;
+}
+
+/* called by applog(), false if the message should be written synchronously */
+bool applog_async(int prio, const char *fmt, va_list ap)
+{
+	// registered before the check, applog_async_stop() waits for it
+	producers.fetch_add(1);
+	bool queued = writer_running.load() && logq_push(prio, fmt, ap);
+	producers.fetch_sub(1, std::memory_order_release);
+	return queued;
+}
+
+uint64_t applog_dropped()
+{
+	uint64_t n = total_dropped.load();
+	int cnt = min(nrings.load(), maxrings);
+	for (int i = 0; i < cnt; i++) {
+		struct logq_ring *r = rings[i].load(std::memory_order_acquire);
+		if (r) n += r->dropped.load(std::memory_order_relaxed);
+	}
+	return n;
+}
+
+#ifdef WIN32
+struct iovec {
+	void *iov_base;
+	size_t iov_len;
+};
+#endif
+
+static void logq_write(struct iovec *iov, int cnt)
+{
+#ifndef WIN32
+	int fd = fileno(stdout);
+	while (cnt > 0) {
+		ssize_t n = writev(fd, iov, cnt);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return;
+		}
+		/* partial write */
+		while (cnt > 0 && (size_t) n >= iov->iov_len) {
+			n -= iov->iov_len;
+			iov++; cnt--;
+		}
+		if (cnt > 0) {
+			iov->iov_base = (char*) iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+#else
+	for (int i = 0; i < cnt; i++)
+		fwrite(iov[i].iov_base, 1, iov[i].iov_len, stdout);
+	fflush(stdout);
+#endif
+}
+
+/* text line prefix, same format as the synchronous applog() */
+static int logq_prefix(char *buf, size_t sz, const struct logq_rec *rec)
+{
+	static time_t last_sec = 0;
+	static struct tm tm;
+	const char *color = "";
+	time_t sec = (time_t) (rec->tm_us / 1000000ULL);
+
+	if (rec->prio == LOG_RAW)
+		return 0;
+
+	if (sec != last_sec) {
+		localtime_r(&sec, &tm);
+		last_sec = sec;
+	}
+	if (use_colors) switch (rec->prio) {
+		case LOG_ERR:     color = CL_RED; break;
+		case LOG_WARNING: color = CL_YLW; break;
+		case LOG_NOTICE:  color = CL_WHT; break;
+		case LOG_DEBUG:   color = CL_GRY; break;
+		case LOG_BLUE:    color = CL_CYN; break;
+	}
+	return snprintf(buf, sz, "[%d-%02d-%02d %02d:%02d:%02d]%s ",
+		tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+		tm.tm_hour, tm.tm_min, tm.tm_sec, color);
+}
+
+/* drain all the rings once, return the number of lines written */
+static int logq_drain()
+{
+	static char prefix[LOGQ_BATCH][48];
+	static struct logq_bin_hdr hdr[LOGQ_BATCH];
+	static char dropmsg[LOGQ_MSGLEN];
+	struct iovec iov[LOGQ_BATCH * 3];
+	static const char eol_color[] = CL_N "\n";
+	const char *eol = use_colors ? eol_color : "\n";
+	int total = 0;
+
+	int cnt = min(nrings.load(), maxrings);
+	for (int i = 0; i < cnt; i++) {
+		struct logq_ring *r = rings[i].load(std::memory_order_acquire);
+		if (!r) continue;
+
+		uint32_t tail = r->tail.load(std::memory_order_relaxed);
+		uint32_t head = r->head.load(std::memory_order_acquire);
+		while (tail != head) {
+			int n = 0, v = 0;
+			uint32_t t = tail;
+			while (t != head && n < LOGQ_BATCH) {
+				struct logq_rec *rec = &r->rec[t & (LOGQ_SLOTS - 1)];
+				if (opt_log_binary) {
+					hdr[n].magic = LOGQ_BIN_MAGIC;
+					hdr[n].len = rec->len;
+					hdr[n].prio = rec->prio;
+					hdr[n].tid = rec->tid;
+					hdr[n].tm_us = rec->tm_us;
+					iov[v].iov_base = &hdr[n]; iov[v++].iov_len = sizeof(hdr[n]);
+					iov[v].iov_base = rec->msg; iov[v++].iov_len = rec->len;
+				} else {
+					int plen = logq_prefix(prefix[n], sizeof(prefix[n]), rec);
+					if (plen > 0) {
+						iov[v].iov_base = prefix[n]; iov[v++].iov_len = plen;
+					}
+					iov[v].iov_base = rec->msg; iov[v++].iov_len = rec->len;
+					if (rec->prio == LOG_RAW) {
+						iov[v].iov_base = (void*) eol_color; iov[v++].iov_len = strlen(eol_color);
+					} else {
+						iov[v].iov_base = (void*) eol; iov[v++].iov_len = strlen(eol);
+					}
+				}
+				n++; t++;
+			}
+			logq_write(iov, v);
+			r->tail.store(t, std::memory_order_release);
+			total += n;
+			tail = t;
+			head = r->head.load(std::memory_order_acquire);
+		}
+
+		uint32_t dropped = r->dropped.exchange(0);
+		if (dropped) {
+			total_dropped += dropped;
+			if (opt_log_binary) continue;
+			struct logq_rec rec = { 0 };
+			rec.tm_us = logq_now_us();
+			rec.prio = LOG_WARNING;
+			int plen = logq_prefix(prefix[0], sizeof(prefix[0]), &rec);
+			int len = snprintf(dropmsg, sizeof(dropmsg), "log: %u messages dropped (thread %u)%s",
+				dropped, (uint32_t) r->tid, eol);
+			iov[0].iov_base = prefix[0]; iov[0].iov_len = plen;
+			iov[1].iov_base = dropmsg; iov[1].iov_len = len;
+			logq_write(iov, 2);
+		}
+	}
+	return total;
+}
+
+static void *logq_writer_thread(void *userdata)
+{
+	while (!writer_stop.load()) {
+		if (logq_drain())
+			continue;
+
+		struct timespec abstime;
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		uint64_t ns = (uint64_t) now.tv_usec * 1000 + LOGQ_IDLE_MS * 1000000ULL;
+		abstime.tv_sec = now.tv_sec + (time_t) (ns / 1000000000ULL);
+		abstime.tv_nsec = (long) (ns % 1000000000ULL);
+
+		pthread_mutex_lock(&writer_lock);
+		writer_sleeping = true;
+		pthread_cond_timedwait(&writer_cond, &writer_lock, &abstime);
+		writer_sleeping = false;
+		pthread_mutex_unlock(&writer_lock);
+	}
+	logq_drain();
+	return NULL;
+}
+
+bool applog_async_start()
+{
+	if (writer_running.load())
+		return true;
+	// previous messages are still in the stdio buffer
+	fflush(stdout);
+	if (!rings) {
+		maxrings = opt_n_threads + opt_validate_threads + 32;
+		maxrings = max(LOGQ_MINRINGS, min(maxrings, LOGQ_MAXRINGS));
+		rings = new std::atomic<struct logq_ring*>[maxrings]();
+	}
+	writer_stop = false;
+	if (pthread_create(&writer_thr, NULL, logq_writer_thread, NULL)) {
+		applog(LOG_ERR, "log thread create failed");
+		return false;
+	}
+	writer_running = true;
+	return true;
+}
+
+/* stop the writer, pending messages are written before */
+void applog_async_stop()
+{
+	if (!writer_running.load())
+		return;
+	writer_running = false;
+	// a producer which still saw the writer running queues before the last drain
+	while (producers.load(std::memory_order_acquire))
+		usleep(100);
+	writer_stop = true;
+	pthread_cond_signal(&writer_cond);
+	pthread_join(writer_thr, NULL);
+	fflush(stdout);
+}
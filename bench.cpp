@@ -249,6 +249,20 @@ void bench_set_throughput(int thr_id, uint32_t throughput)
 	algo_throughput[thr_id][opt_algo] = throughput;
 }
 
+// also measured outside of the benchmark mode (profit switching)
+void bench_set_algo_hashrate(int thr_id, int algo, double hashrate)
+{
+	algo_hashrates[thr_id][algo] = hashrate;
+}
+
+double bench_get_algo_hashrate(int algo)
+{
+	double hashrate = 0.;
+	for (int n=0; n < opt_n_threads; n++)
+		hashrate += algo_hashrates[n][algo];
+	return hashrate;
+}
+
 void bench_display_results()
 {
 	for (int n=0; n < opt_n_threads; n++)
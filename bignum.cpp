@@ -13,22 +13,22 @@
 #include "bignum.hpp"
 #endif
 
-#include "miner.h" // hex2bin
+#include "miner.h"
+#include "u256.h"
 
 extern "C" double bn_convert_nbits(const uint32_t nBits)
 {
-	uint256 bn = CBigNum().SetCompact(nBits).getuint256();
-	return bn.getdouble();
+	struct u256 bn;
+	u256_from_compact(&bn, nBits);
+	return u256_getdouble(bn);
 }
 
-// copy the big number to 32-bytes uchar
+// copy the big number to 32-bytes uchar (big endian)
 extern "C" void bn_nbits_to_uchar(const uint32_t nBits, unsigned char *target)
 {
-	char buff[65];
-	uint256 bn = CBigNum().SetCompact(nBits).getuint256();
-
-	snprintf(buff, 65, "%s\n", bn.ToString().c_str()); buff[64] = '\0';
-	hex2bin(target, buff, 32);
+	struct u256 bn;
+	u256_from_compact(&bn, nBits);
+	u256_to_be(target, &bn);
 }
 
 // unused, but should allow more than 256bits targets
@@ -59,20 +59,10 @@ extern "C" double bn_hash_target_ratio(uint32_t* hash, uint32_t* target)
 // compute the diff ratio between a found hash and the target
 extern "C" double bn_hash_target_ratio(uint32_t* hash, uint32_t* target)
 {
-	uint256 h, t;
-	double dhash;
-
 	if (!opt_showdiff)
 		return 0.0;
 
-	memcpy(&t, (void*) target, 32);
-	memcpy(&h, (void*) hash, 32);
-
-	dhash = h.getdouble();
-	if (dhash > 0.)
-		return t.getdouble() / dhash;
-	else
-		return dhash;
+	return u256_target_ratio(hash, target);
 }
 
 // store ratio in work struct
@@ -10,7 +10,7 @@
 #include <string.h>
 #include <stdint.h>
 
-#include <sph/blake2b.h>
+#include <sph/blake2-simd.h>
 
 #include <cuda_helper.h>
 #include <cuda_vector_uint2x4.h>
@@ -42,14 +42,7 @@ static __constant__ const int8_t blake2b_sigma[12][16] = {
 
 extern "C" void blake2b_hash(void *output, const void *input)
 {
-	uint8_t _ALIGN(A) hash[32];
-	blake2b_ctx ctx;
-
-	blake2b_init(&ctx, 32, NULL, 0);
-	blake2b_update(&ctx, input, 80);
-	blake2b_final(&ctx, hash);
-
-	memcpy(output, hash, 32);
+	blake2b_simd(output, 32, input, 80);
 }
 
 // ----------------------------------------------------------------
@@ -163,6 +156,7 @@ static bool init[MAX_GPUS] = { 0 };
 int scanhash_blake2b(int thr_id, struct work *work, uint32_t max_nonce, unsigned long *hashes_done)
 {
 	uint32_t _ALIGN(A) endiandata[20];
+	blake2b_midstate mid;
 	uint32_t *pdata = work->data;
 	uint32_t *ptarget = work->target;
 
@@ -196,6 +190,7 @@ int scanhash_blake2b(int thr_id, struct work *work, uint32_t max_nonce, unsigned
 
 	const uint2 target = make_uint2(ptarget[6], ptarget[7]);
 	blake2b_setBlock(endiandata);
+	blake2b_mid_init(&mid, endiandata, 80, 76, 32);
 
 	do {
 		work->nonces[0] = blake2b_hash_cuda(thr_id, throughput, pdata[19], target, work->nonces[1]);
@@ -207,8 +202,7 @@ int scanhash_blake2b(int thr_id, struct work *work, uint32_t max_nonce, unsigned
 			const uint32_t Htarg = ptarget[7];
 			uint32_t _ALIGN(A) vhash[8];
 			work->valid_nonces = 0;
-			endiandata[19] = work->nonces[0];
-			blake2b_hash(vhash, endiandata);
+			vstats_hash(thr_id, blake2b_mid_hash(&mid, vhash, work->nonces[0]));
 			if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
 				work_set_target_ratio(work, vhash);
 				work->valid_nonces++;
@@ -218,8 +212,7 @@ int scanhash_blake2b(int thr_id, struct work *work, uint32_t max_nonce, unsigned
 			}
 
 			if (work->nonces[1] != UINT32_MAX) {
-				endiandata[19] = work->nonces[1];
-				blake2b_hash(vhash, endiandata);
+				vstats_hash(thr_id, blake2b_mid_hash(&mid, vhash, work->nonces[1]));
 				if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
 					if (bn_hash_target_ratio(vhash, ptarget) > work->shareratio[0]) {
 						work->sharediff[1] = work->sharediff[0];
@@ -42,6 +42,7 @@
 
 #include "miner.h"
 #include "algos.h"
+#include "u256.h"
 #include "sia/sia-rpc.h"
 #include "crypto/xmr-rpc.h"
 #include "equi/equihash.h"
@@ -97,7 +98,6 @@ bool have_stratum = false;
 bool allow_gbt = true;
 bool allow_mininginfo = true;
 bool check_dups = true; //false;
-bool check_stratum_jobs = false;
 bool opt_submit_stale = false;
 bool submit_old = false;
 bool use_syslog = false;
@@ -340,11 +340,33 @@ Options:\n\
   -n, --ndevs           list cuda devices\n\
   -N, --statsavg        number of samples used to compute hashrate (default: 30)\n\
       --no-gbt          disable getblocktemplate support (height check in solo)\n\
+      --coinbase-addr=ADDR solo mine with getblocktemplate, pay the blocks to ADDR\n\
+      --coinbase-sig=TEXT  text to put in the coinbase of the solo blocks\n\
+      --coinbase-xnonce=HEX extranonce prefix (4 bytes), to split the work of\n\
+                        many rigs on the same address (default: random)\n\
+      --proxy-server=[IP:]PORT serve the pool jobs to other miners (stratum\n\
+                        proxy), the shares are checked before being sent\n\
+      --cpu-validate=N  check the gpu results with N cpu threads while the\n\
+                        gpus continue to scan (default: 0, in the gpu thread)\n\
+      --cpu-equihash=N  solve equihash with N cpu threads instead of the gpu\n\
+                        (all the cores if there is no cuda device)\n\
+      --cpu-wildkeccak=N  scan wildkeccak with N cpu threads instead of the gpu\n\
+      --profit-feed=FILE|URL switch to the most profitable pool (json table\n\
+                        of the algos profit per MH/s, or yiimp api/status)\n\
+      --profit-interval=N minimum time [s] on a pool, feed refresh (default: 300)\n\
+      --profit-margin=N required profit increase [%%] to switch (default: 5)\n\
       --no-longpoll     disable X-Long-Polling support\n\
       --no-stratum      disable X-Stratum support\n\
       --no-extranonce   disable extranonce subscribe on stratum\n\
   -q, --quiet           disable per-thread hashmeter output\n\
       --no-color        disable colored output\n\
+      --log-async       write the console log from a dedicated thread\n\
+      --log-binary      binary structured log records (imply --log-async)\n\
+      --cpu-bench[=FILE] benchmark the cpu hash functions (json report)\n\
+      --selftest        check the cpu hash functions with known answers\n\
+      --fake-pool[=SPEC] mine on a local test stratum server, SPEC is a list\n\
+                        of port=,job=ms,clean=,reconnect=,vardiff=,diff=,\n\
+                        delay=ms,replay=FILE,seed=,report=sec\n\
   -D, --debug           enable debug output\n\
   -P, --protocol-dump   verbose dump of protocol-level activities\n\
       --cpu-affinity    set process affinity to cpu core(s), mask 0x3 for cores 0 and 1\n\
@@ -461,6 +483,21 @@ struct option options[] = {
 	{ "tlimit", 1, NULL, 1075 },
 	{ "led", 1, NULL, 1080 },
 	{ "max-log-rate", 1, NULL, 1019 },
+	{ "log-async", 0, NULL, 1040 },
+	{ "log-binary", 0, NULL, 1041 },
+	{ "cpu-bench", 2, NULL, 1042 },
+	{ "selftest", 0, NULL, 1043 },
+	{ "fake-pool", 2, NULL, 1044 },
+	{ "coinbase-addr", 1, NULL, 1081 },
+	{ "coinbase-sig", 1, NULL, 1082 },
+	{ "coinbase-xnonce", 1, NULL, 1083 },
+	{ "proxy-server", 1, NULL, 1084 },
+	{ "cpu-validate", 1, NULL, 1085 },
+	{ "profit-feed", 1, NULL, 1086 },
+	{ "profit-interval", 1, NULL, 1087 },
+	{ "profit-margin", 1, NULL, 1088 },
+	{ "cpu-equihash", 1, NULL, 1089 },
+	{ "cpu-wildkeccak", 1, NULL, 1090 },
 #ifdef HAVE_SYSLOG_H
 	{ "syslog", 0, NULL, 'S' },
 	{ "syslog-prefix", 1, NULL, 1018 },
@@ -579,7 +616,18 @@ static inline void drop_policy(void) { }
 static void affine_to_cpu_mask(int id, uint8_t mask) { }
 #endif
 
-static bool get_blocktemplate(CURL *curl, struct work *work);
+/* solo mining infos (height, net diff), refreshed on a new block or longpoll */
+static struct {
+	uint32_t prevhash[8];
+	uint32_t height;
+	int pooln;
+	volatile bool valid;
+} rpc_infos = { 0 };
+
+/* workio thread handles, the multi one keeps the connections alive.
+ * the getwork uses the thread curl, these are for the infos requests */
+static CURLM *workio_multi = NULL;
+static CURL *workio_curls[RPC_MULTI_MAX - 1] = { 0 };
 
 void get_currentalgo(char* buf, int sz)
 {
@@ -638,6 +686,20 @@ void proper_exit(int reason)
 #	endif
 	}
 #endif
+	if (opt_fake_pool)
+		fakepool_stop();
+	if (opt_proxy_server)
+		proxy_stop();
+	if (opt_validate_threads)
+		validate_stop();
+
+	if (opt_log_async) {
+		uint64_t dropped = applog_dropped();
+		if (dropped)
+			applog(LOG_WARNING, "%llu log messages were dropped", (unsigned long long) dropped);
+		applog_async_stop();
+	}
+
 	free(opt_syslog_pfx);
 	free(opt_api_bind);
 	if (opt_api_allow) free(opt_api_allow);
@@ -688,11 +750,7 @@ static void calc_network_diff(struct work *work)
 	uint32_t bits = (nbits & 0xffffff);
 	int16_t shift = (swab32(nbits) & 0xff); // 0x1c = 28
 
-	uint64_t diffone = 0x0000FFFF00000000ull;
-	double d = (double)0x0000ffff / (double)bits;
-
-	for (int m=shift; m < 29; m++) d *= 256.0;
-	for (int m=29; m < shift; m++) d /= 256.0;
+	double d = u256_nbits_to_diff(nbits);
 	if (opt_algo == ALGO_DECRED && shift == 28) d *= 256.0;
 	if (opt_debug_diff)
 		applog(LOG_DEBUG, "net diff: %f -> shift %u, bits %08x", d, shift, bits);
@@ -897,7 +955,7 @@ int share_result(int result, int pooln, double sharediff, const char *reason)
 	return 1;
 }
 
-static bool submit_upstream_work(CURL *curl, struct work *work)
+static bool submit_upstream_work(CURL *curl, struct work *work, int thr_id)
 {
 	char s[512];
 	struct pool_infos *pool = &pools[work->pooln];
@@ -911,7 +969,9 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 		if (!hashlog_already_submittted(submit_work.job_id, submit_work.nonces[idnonce])) {
 			if (rpc2_stratum_submit(pool, &submit_work))
 				hashlog_remember_submit(&submit_work, submit_work.nonces[idnonce]);
-			stratum.job.shares_count++;
+			stratum.shares_count++;
+		} else {
+			vstats_duplicate(thr_id);
 		}
 		return true;
 	}
@@ -922,7 +982,7 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 		//if (!hashlog_already_submittted(submit_work.job_id, submit_work.nonces[idnonce])) {
 			if (equi_stratum_submit(pool, &submit_work))
 				hashlog_remember_submit(&submit_work, submit_work.nonces[idnonce]);
-			stratum.job.shares_count++;
+			stratum.shares_count++;
 		//}
 		return true;
 	}
@@ -937,22 +997,17 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 			pool->stales_count++;
 			if (opt_debug) applog(LOG_DEBUG, "outdated job %s, new %s stales=%d",
 				work->job_id + 8 , g_work.job_id + 8, pool->stales_count);
-			if (!check_stratum_jobs && pool->stales_count > 5) {
-				if (!opt_quiet) applog(LOG_WARNING, "Enabled stratum stale jobs workaround");
-				check_stratum_jobs = true;
-			}
 		}
 		pthread_mutex_unlock(&g_work_lock);
 	}
 
-	if (!have_stratum && !stale_work && allow_gbt) {
-		struct work wheight = { 0 };
-		if (get_blocktemplate(curl, &wheight)) {
-			if (work->height && work->height < wheight.height) {
-				if (opt_debug)
-					applog(LOG_WARNING, "block %u was already solved", work->height);
-				return true;
-			}
+	if (!have_stratum && !stale_work && allow_gbt && rpc_infos.valid) {
+		// no gbt call here, the cached height follows the new blocks
+		if (work->height && work->height < rpc_infos.height) {
+			if (opt_debug)
+				applog(LOG_WARNING, "block %u was already solved", work->height);
+			vstats_stale(thr_id);
+			return true;
 		}
 	}
 
@@ -963,13 +1018,14 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 	if (!submit_old && stale_work) {
 		if (opt_debug)
 			applog(LOG_WARNING, "stale work detected, discarding");
+		vstats_stale(thr_id);
 		return true;
 	}
 
 	if (pool->type & POOL_STRATUM) {
 		uint32_t sent = 0;
 		uint32_t ntime, nonce = work->nonces[idnonce];
-		char *ntimestr, *noncestr, *xnonce2str, *nvotestr;
+		char ntimestr[9], noncestr[9], xnonce2str[2*64+1], nvotestr[5];
 		uint16_t nvote = 0;
 
 		switch (opt_algo) {
@@ -1014,32 +1070,33 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 			le32enc(&ntime, work->data[17]);
 			le32enc(&nonce, work->data[19]);
 		}
-		noncestr = bin2hex((const uchar*)(&nonce), 4);
+		cbin2hex(noncestr, (const char*)(&nonce), 4);
 
 		if (check_dups)
 			sent = hashlog_already_submittted(work->job_id, nonce);
 		if (sent > 0) {
+			vstats_duplicate(thr_id);
 			sent = (uint32_t) time(NULL) - sent;
 			if (!opt_quiet) {
 				applog(LOG_WARNING, "nonce %s was already sent %u seconds ago", noncestr, sent);
 				hashlog_dump_job(work->job_id);
 			}
-			free(noncestr);
 			// prevent useless computing on some pools
 			g_work_time = 0;
 			restart_threads();
 			return true;
 		}
 
-		ntimestr = bin2hex((const uchar*)(&ntime), 4);
+		cbin2hex(ntimestr, (const char*)(&ntime), 4);
 
+		xnonce2str[0] = '\0';
 		if (opt_algo == ALGO_DECRED) {
-			xnonce2str = bin2hex((const uchar*)&work->data[36], stratum.xnonce1_size);
+			cbin2hex(xnonce2str, (const char*)&work->data[36], min(stratum.xnonce1_size, (size_t) 48));
 		} else if (opt_algo == ALGO_SIA) {
 			uint16_t high_nonce = swab32(work->data[9]) >> 16;
-			xnonce2str = bin2hex((unsigned char*)(&high_nonce), 2);
+			cbin2hex(xnonce2str, (const char*)(&high_nonce), 2);
 		} else {
-			xnonce2str = bin2hex(work->xnonce2, work->xnonce2_len);
+			cbin2hex(xnonce2str, (const char*)work->xnonce2, min(work->xnonce2_len, sizeof(work->xnonce2)));
 		}
 
 		// store to keep/display the solved ratio/diff
@@ -1053,19 +1110,15 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 				stratum.sharediff, work->shareratio[idnonce]);
 
 		if (opt_vote) { // ALGO_HEAVY
-			nvotestr = bin2hex((const uchar*)(&nvote), 2);
+			cbin2hex(nvotestr, (const char*)(&nvote), 2);
 			sprintf(s, "{\"method\": \"mining.submit\", \"params\": ["
 					"\"%s\", \"%s\", \"%s\", \"%s\", \"%s\", \"%s\"], \"id\":%u}",
-					pool->user, work->job_id + 8, xnonce2str, ntimestr, noncestr, nvotestr, stratum.job.shares_count + 10);
-			free(nvotestr);
+					pool->user, work->job_id + 8, xnonce2str, ntimestr, noncestr, nvotestr, stratum.shares_count + 10);
 		} else {
 			sprintf(s, "{\"method\": \"mining.submit\", \"params\": ["
 					"\"%s\", \"%s\", \"%s\", \"%s\", \"%s\"], \"id\":%u}",
-					pool->user, work->job_id + 8, xnonce2str, ntimestr, noncestr, stratum.job.shares_count + 10);
+					pool->user, work->job_id + 8, xnonce2str, ntimestr, noncestr, stratum.shares_count + 10);
 		}
-		free(xnonce2str);
-		free(ntimestr);
-		free(noncestr);
 
 		gettimeofday(&stratum.tv_submit, NULL);
 		if (unlikely(!stratum_send_line(&stratum, s))) {
@@ -1075,7 +1128,7 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 
 		if (check_dups || opt_showdiff)
 			hashlog_remember_submit(work, nonce);
-		stratum.job.shares_count++;
+		stratum.shares_count++;
 
 	} else {
 
@@ -1097,6 +1150,9 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 		else if (opt_algo == ALGO_SIA) {
 			return sia_submit(curl, pool, work);
 		}
+		else if (opt_coinbase_addr) {
+			return gbt_submit(curl, pool, work);
+		}
 
 		if (opt_algo != ALGO_HEAVY && opt_algo != ALGO_MJOLLNIR) {
 			for (int i = 0; i < adata_sz; i++)
@@ -1182,15 +1238,8 @@ static const char *gbt_req =
 	//	"\"capabilities\": " GBT_CAPABILITIES ""
 	"}], \"id\":9}\r\n";
 
-static bool get_blocktemplate(CURL *curl, struct work *work)
+static bool gbt_reply_decode(json_t *val, int curl_err, struct work *work)
 {
-	struct pool_infos *pool = &pools[work->pooln];
-	if (!allow_gbt)
-		return false;
-
-	int curl_err = 0;
-	json_t *val = json_rpc_call_pool(curl, pool, gbt_req, false, false, &curl_err);
-
 	if (!val && curl_err == -1) {
 		// when getblocktemplate is not supported, disable it
 		allow_gbt = false;
@@ -1200,27 +1249,15 @@ static bool get_blocktemplate(CURL *curl, struct work *work)
 		return false;
 	}
 
-	bool rc = gbt_work_decode(json_object_get(val, "result"), work);
-
-	json_decref(val);
-
-	return rc;
+	return gbt_work_decode(json_object_get(val, "result"), work);
 }
 
 // good alternative for wallet mining, difficulty and net hashrate
 static const char *info_req =
 	"{\"method\": \"getmininginfo\", \"params\": [], \"id\":8}\r\n";
 
-static bool get_mininginfo(CURL *curl, struct work *work)
+static bool mininginfo_reply_decode(json_t *val, int curl_err)
 {
-	struct pool_infos *pool = &pools[work->pooln];
-	int curl_err = 0;
-
-	if (have_stratum || have_longpoll || !allow_mininginfo)
-		return false;
-
-	json_t *val = json_rpc_call_pool(curl, pool, info_req, false, false, &curl_err);
-
 	if (!val && curl_err == -1) {
 		allow_mininginfo = false;
 		if (opt_debug) {
@@ -1255,10 +1292,33 @@ static bool get_mininginfo(CURL *curl, struct work *work)
 			}
 		}
 	}
-	json_decref(val);
 	return true;
 }
 
+/* requests completing the getwork infos, return the count */
+static int rpc_infos_reqs(const char **reqs)
+{
+	int n = 0;
+	if (!have_stratum && !have_longpoll && allow_mininginfo)
+		reqs[n++] = info_req;
+	if (allow_gbt)
+		reqs[n++] = gbt_req;
+	return n;
+}
+
+static void rpc_infos_decode(const char **reqs, json_t **vals, int *errs, int count, struct work *work)
+{
+	// mininginfo first, the gbt block notice shows the net diff
+	for (int i = 0; i < count; i++) {
+		if (reqs[i] == info_req)
+			mininginfo_reply_decode(vals[i], errs[i]);
+		else if (reqs[i] == gbt_req)
+			gbt_reply_decode(vals[i], errs[i], work);
+		if (vals[i])
+			json_decref(vals[i]);
+	}
+}
+
 static const char *json_rpc_getwork =
 	"{\"method\":\"getwork\",\"params\":[],\"id\":0}\r\n";
 
@@ -1267,7 +1327,11 @@ static bool get_upstream_work(CURL *curl, struct work *work)
 	bool rc = false;
 	struct timeval tv_start, tv_end, diff;
 	struct pool_infos *pool = &pools[work->pooln];
-	const char *rpc_req = json_rpc_getwork;
+	const char *reqs[RPC_MULTI_MAX];
+	CURL *curls[RPC_MULTI_MAX] = { curl };
+	json_t *vals[RPC_MULTI_MAX] = { 0 };
+	int errs[RPC_MULTI_MAX] = { 0 };
+	int nreqs = 1;
 	json_t *val;
 
 	gettimeofday(&tv_start, NULL);
@@ -1285,23 +1349,40 @@ static bool get_upstream_work(CURL *curl, struct work *work)
 		return rc;
 	}
 
+	if (opt_coinbase_addr) {
+		rc = gbt_get_work(curl, pool, work);
+		if (opt_protocol && rc) {
+			gettimeofday(&tv_end, NULL);
+			timeval_subtract(&diff, &tv_end, &tv_start);
+			applog(LOG_DEBUG, "got new gbt work in %.2f ms",
+			       (1000.0 * diff.tv_sec) + (0.001 * diff.tv_usec));
+		}
+		return rc;
+	}
+
 	if (opt_debug_threads)
 		applog(LOG_DEBUG, "%s: want_longpoll=%d have_longpoll=%d",
 			__func__, want_longpoll, have_longpoll);
 
-	/* want_longpoll/have_longpoll required here to init/unlock the lp thread */
-	val = json_rpc_call_pool(curl, pool, rpc_req, want_longpoll, have_longpoll, NULL);
+	// the infos are only requested with the getwork of a new block
+	bool need_infos = !rpc_infos.valid || rpc_infos.pooln != work->pooln;
+	reqs[0] = json_rpc_getwork;
+	if (need_infos)
+		nreqs += rpc_infos_reqs(&reqs[1]);
+	memcpy(&curls[1], workio_curls, sizeof(workio_curls));
+
+	/* want_longpoll required here to init/unlock the lp thread, the longpoll
+	 * arg was already ignored by json_rpc_call_pool(), see the multi call */
+	json_rpc_call_multi(workio_multi, curls, pool, reqs, vals, errs, nreqs, true);
 	gettimeofday(&tv_end, NULL);
+	val = vals[0];
 
-	if (have_stratum || unlikely(work->pooln != cur_pooln)) {
-		if (val)
-			json_decref(val);
+	if (have_stratum || unlikely(work->pooln != cur_pooln) || !val) {
+		for (int i = 0; i < nreqs; i++)
+			if (vals[i]) json_decref(vals[i]);
 		return false;
 	}
 
-	if (!val)
-		return false;
-
 	rc = work_decode(json_object_get(val, "result"), work);
 
 	if (opt_protocol && rc) {
@@ -1313,8 +1394,25 @@ static bool get_upstream_work(CURL *curl, struct work *work)
 
 	json_decref(val);
 
-	get_mininginfo(curl, work);
-	get_blocktemplate(curl, work);
+	if (rc && !need_infos && memcmp(rpc_infos.prevhash, &work->data[1], 32)) {
+		// new block without longpoll
+		nreqs = 1 + rpc_infos_reqs(&reqs[1]);
+		if (nreqs > 1)
+			json_rpc_call_multi(workio_multi, &curls[1], pool, &reqs[1], &vals[1], &errs[1], nreqs - 1, false);
+		need_infos = true;
+	}
+
+	if (need_infos) {
+		rpc_infos_decode(&reqs[1], &vals[1], &errs[1], nreqs - 1, work);
+		if (rc) {
+			memcpy(rpc_infos.prevhash, &work->data[1], 32);
+			rpc_infos.height = work->height;
+			rpc_infos.pooln = work->pooln;
+			rpc_infos.valid = true;
+		}
+	} else if (!work->height) {
+		work->height = rpc_infos.height;
+	}
 
 	return rc;
 }
@@ -1402,7 +1500,7 @@ static bool workio_submit_work(struct workio_cmd *wc, CURL *curl)
 	// applog(LOG_DEBUG, "%s: pool %d", __func__, wc->pooln);
 
 	/* submit solution to bitcoin via JSON-RPC */
-	while (!submit_upstream_work(curl, wc->u.work)) {
+	while (!submit_upstream_work(curl, wc->u.work, wc->thr ? wc->thr->id : -1)) {
 		if (pooln != cur_pooln) {
 			applog(LOG_DEBUG, "work from pool %u discarded", pooln);
 			return true;
@@ -1428,10 +1526,18 @@ static void *workio_thread(void *userdata)
 	bool ok = true;
 
 	curl = curl_easy_init();
-	if (unlikely(!curl)) {
+	workio_multi = curl_multi_init();
+	if (unlikely(!curl || !workio_multi)) {
 		applog(LOG_ERR, "CURL initialization failed");
 		return NULL;
 	}
+	for (int i = 0; i < RPC_MULTI_MAX - 1; i++) {
+		workio_curls[i] = curl_easy_init();
+		if (unlikely(!workio_curls[i])) {
+			applog(LOG_ERR, "CURL initialization failed");
+			return NULL;
+		}
+	}
 
 	while (ok && !abort_flag) {
 		struct workio_cmd *wc;
@@ -1473,6 +1579,9 @@ static void *workio_thread(void *userdata)
 
 	if (opt_debug_threads)
 		applog(LOG_DEBUG, "%s() died", __func__);
+	for (int i = 0; i < RPC_MULTI_MAX - 1; i++)
+		curl_easy_cleanup(workio_curls[i]);
+	curl_multi_cleanup(workio_multi);
 	curl_easy_cleanup(curl);
 	tq_freeze(mythr->q);
 	return NULL;
@@ -1499,6 +1608,10 @@ bool get_work(struct thr_info *thr, struct work *work)
 		return true;
 	}
 
+	/* solo gbt, next extranonce of the current template without rpc */
+	if (opt_coinbase_addr && gbt_gen_work(work, cur_pooln))
+		return true;
+
 	/* fill out work request message */
 	wc = (struct workio_cmd *)calloc(1, sizeof(*wc));
 	if (!wc)
@@ -1554,29 +1667,96 @@ err_out:
 	return false;
 }
 
-static bool stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
+/* submit a nonce validated outside of the miner thread (--cpu-validate) */
+bool submit_gpu_nonce(int thr_id, struct work *work, uint32_t nonce)
 {
-	uchar merkle_root[64] = { 0 };
-	int i;
+	struct cgpu_info *cgpu = &thr_info[thr_id].gpu;
 
-	if (sctx->rpc2)
-		return rpc2_stratum_gen_work(sctx, work);
+	// called by the validation threads
+	pthread_mutex_lock(&stats_lock);
+	cgpu->accepted++;
+	pthread_mutex_unlock(&stats_lock);
+	if (opt_benchmark)
+		return true;
 
-	if (!sctx->job.job_id) {
-		// applog(LOG_WARNING, "stratum_gen_work: job not yet retrieved");
+	work->nonces[0] = nonce;
+	work->valid_nonces = 1;
+	work->submit_nonce_id = 0;
+	work->data[19] = nonce;
+	if (!submit_work(&thr_info[thr_id], work))
 		return false;
+
+	// prevent stale work in solo
+	if (!have_stratum && !have_longpoll) {
+		pthread_mutex_lock(&g_work_lock);
+		g_work_time = 0;
+		pthread_mutex_unlock(&g_work_lock);
+	}
+	return true;
+}
+
+/* stratum difficulty multiplier of the algo (1 for diff 1 = 0x00000000ffff0000) */
+double stratum_diff_factor(int algo)
+{
+	switch (algo) {
+		case ALGO_HMQ1725:
+		case ALGO_JACKPOT:
+		case ALGO_JHA:
+		case ALGO_NEOSCRYPT:
+		case ALGO_SCRYPT:
+		case ALGO_SCRYPT_JANE:
+			return 65536.0;
+		case ALGO_ALLIUM:
+		case ALGO_DMD_GR:
+		case ALGO_FRESH:
+		case ALGO_FUGUE256:
+		case ALGO_GROESTL:
+		case ALGO_KECCAKC:
+		case ALGO_LBRY:
+		case ALGO_LYRA2v2:
+		case ALGO_LYRA2v3:
+		case ALGO_LYRA2Z:
+		case ALGO_PHI2:
+		case ALGO_TIMETRAVEL:
+		case ALGO_BITCORE:
+		case ALGO_EXOSIS:
+		case ALGO_X16R:
+		case ALGO_X16S:
+			return 256.0;
+		case ALGO_KECCAK:
+		case ALGO_LYRA2:
+			return 128.0;
 	}
+	return 1.0;
+}
 
-	pthread_mutex_lock(&stratum_work_lock);
+/* assemble the work of a job, with the extranonce2 set in work->xnonce2 */
+static bool stratum_build_work(struct stratum_ctx *sctx, struct stratum_job *job, struct work *work, bool netdiff)
+{
+	uchar merkle_root[64] = { 0 };
+	uchar cb_buf[2048], *coinbase;
+	const uchar *xnonce1;
+	size_t xnonce1_size;
+	int i;
+
+	// local coinbase with the extranonce2 of this work
+	coinbase = job->coinbase_size <= sizeof(cb_buf) ? cb_buf : (uchar*) malloc(job->coinbase_size);
+	if (!coinbase) {
+		applog(LOG_ERR, "stratum_gen_work: coinbase alloc failed");
+		return false;
+	}
+	memcpy(coinbase, job->coinbase, job->coinbase_size);
+	memcpy(coinbase + (job->xnonce2 - job->coinbase), work->xnonce2, job->xnonce2_size);
+	xnonce1 = job->xnonce2 - job->xnonce1_size;
+	xnonce1_size = job->xnonce1_size;
 
 	// store the job ntime as high part of jobid
 	snprintf(work->job_id, sizeof(work->job_id), "%07x %s",
-		be32dec(sctx->job.ntime) & 0xfffffff, sctx->job.job_id);
-	work->xnonce2_len = sctx->xnonce2_size;
-	memcpy(work->xnonce2, sctx->job.xnonce2, sctx->xnonce2_size);
+		be32dec(job->ntime) & 0xfffffff, job->job_id);
+	work->xnonce2_len = job->xnonce2_size;
 
 	// also store the block number
-	work->height = sctx->job.height;
+	work->height = job->height ? job->height : sctx->block_height;
 	// and the pool of the current stratum
 	work->pooln = sctx->pooln;
 
@@ -1590,7 +1770,7 @@ static bool stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 #ifdef WITH_HEAVY_ALGO
 		case ALGO_HEAVY:
 		case ALGO_MJOLLNIR:
-			heavycoin_hash(merkle_root, sctx->job.coinbase, (int)sctx->job.coinbase_size);
+			heavycoin_hash(merkle_root, coinbase, (int)job->coinbase_size);
 			break;
 #endif
 		case ALGO_FUGUE256:
@@ -1598,15 +1778,15 @@ static bool stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 		case ALGO_KECCAK:
 		case ALGO_BLAKECOIN:
 		case ALGO_WHIRLCOIN:
-			SHA256((uchar*)sctx->job.coinbase, sctx->job.coinbase_size, (uchar*)merkle_root);
+			SHA256(coinbase, job->coinbase_size, (uchar*)merkle_root);
 			break;
 		case ALGO_WHIRLPOOL:
 		default:
-			sha256d(merkle_root, sctx->job.coinbase, (int)sctx->job.coinbase_size);
+			sha256d(merkle_root, coinbase, (int)job->coinbase_size);
 	}
 
-	for (i = 0; i < sctx->job.merkle_count; i++) {
-		memcpy(merkle_root + 32, sctx->job.merkle[i], 32);
+	for (i = 0; i < job->merkle_count; i++) {
+		memcpy(merkle_root + 32, job->merkle[i], 32);
 #ifdef WITH_HEAVY_ALGO
 		if (opt_algo == ALGO_HEAVY || opt_algo == ALGO_MJOLLNIR)
 			heavycoin_hash(merkle_root, merkle_root, 64);
@@ -1614,82 +1794,78 @@ static bool stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 #endif
 			sha256d(merkle_root, merkle_root, 64);
 	}
-	
-	/* Increment extranonce2 */
-	for (i = 0; i < (int)sctx->xnonce2_size && !++sctx->job.xnonce2[i]; i++);
 
 	/* Assemble block header */
 	memset(work->data, 0, sizeof(work->data));
-	work->data[0] = le32dec(sctx->job.version);
+	work->data[0] = le32dec(job->version);
 	for (i = 0; i < 8; i++)
-		work->data[1 + i] = le32dec((uint32_t *)sctx->job.prevhash + i);
+		work->data[1 + i] = le32dec((uint32_t *)job->prevhash + i);
 
 	if (opt_algo == ALGO_DECRED) {
 		uint16_t vote;
 		for (i = 0; i < 8; i++) // reversed prevhash
 			work->data[1 + i] = swab32(work->data[1 + i]);
 		// decred header (coinb1) [merkle...nonce]
-		memcpy(&work->data[9], sctx->job.coinbase, 108);
+		memcpy(&work->data[9], coinbase, 108);
 		// last vote bit should never be changed
 		memcpy(&vote, &work->data[25], 2);
 		vote = (opt_vote << 1) | (vote & 1);
 		memcpy(&work->data[25], &vote, 2);
 		// extradata
-		if (sctx->xnonce1_size > sizeof(work->data)-(32*4)) {
+		if (xnonce1_size > sizeof(work->data)-(32*4)) {
 			// should never happen...
 			applog(LOG_ERR, "extranonce size overflow!");
-			sctx->xnonce1_size = sizeof(work->data)-(32*4);
+			xnonce1_size = sizeof(work->data)-(32*4);
 		}
-		memcpy(&work->data[36], sctx->xnonce1, sctx->xnonce1_size);
+		memcpy(&work->data[36], xnonce1, xnonce1_size);
 		work->data[37] = (rand()*4) << 8; // random work data
 		// block header suffix from coinb2 (stake version)
-		memcpy(&work->data[44], &sctx->job.coinbase[sctx->job.coinbase_size-4], 4);
-		sctx->job.height = work->data[32];
+		memcpy(&work->data[44], &coinbase[job->coinbase_size-4], 4);
 		//applog_hex(work->data, 180);
 	} else if (opt_algo == ALGO_EQUIHASH) {
-		memcpy(&work->data[9], sctx->job.coinbase, 32+32); // merkle [9..16] + reserved
-		work->data[25] = le32dec(sctx->job.ntime);
-		work->data[26] = le32dec(sctx->job.nbits);
-		memcpy(&work->data[27], sctx->xnonce1, sctx->xnonce1_size & 0x1F); // pool extranonce
+		memcpy(&work->data[9], coinbase, 32+32); // merkle [9..16] + reserved
+		work->data[25] = le32dec(job->ntime);
+		work->data[26] = le32dec(job->nbits);
+		memcpy(&work->data[27], xnonce1, xnonce1_size & 0x1F); // pool extranonce
 		work->data[35] = 0x80;
 		//applog_hex(work->data, 140);
 	} else if (opt_algo == ALGO_LBRY) {
 		for (i = 0; i < 8; i++)
 			work->data[9 + i] = be32dec((uint32_t *)merkle_root + i);
 		for (i = 0; i < 8; i++)
-			work->data[17 + i] = ((uint32_t*)sctx->job.extra)[i];
-		work->data[25] = le32dec(sctx->job.ntime);
-		work->data[26] = le32dec(sctx->job.nbits);
+			work->data[17 + i] = ((uint32_t*)job->extra)[i];
+		work->data[25] = le32dec(job->ntime);
+		work->data[26] = le32dec(job->nbits);
 		work->data[28] = 0x80000000;
 	} else if (opt_algo == ALGO_PHI2) {
 		for (i = 0; i < 8; i++)
 			work->data[9 + i] = be32dec((uint32_t *)merkle_root + i);
-		work->data[17] = le32dec(sctx->job.ntime);
-		work->data[18] = le32dec(sctx->job.nbits);
+		work->data[17] = le32dec(job->ntime);
+		work->data[18] = le32dec(job->nbits);
 		for (i = 0; i < 16; i++)
-			work->data[20 + i] = ((uint32_t*)sctx->job.extra)[i];
+			work->data[20 + i] = ((uint32_t*)job->extra)[i];
 	} else if (opt_algo == ALGO_SIA) {
 		uint32_t extra = 0;
-		memcpy(&extra, &sctx->job.coinbase[32], 2);
+		memcpy(&extra, &coinbase[32], 2);
 		for (i = 0; i < 8; i++) // reversed hash
-			work->data[i] = ((uint32_t*)sctx->job.prevhash)[7-i];
+			work->data[i] = ((uint32_t*)job->prevhash)[7-i];
 		work->data[8] = 0; // nonce
 		work->data[9] = swab32(extra) | ((rand() << 8) & 0xffff);
-		work->data[10] = be32dec(sctx->job.ntime);
-		work->data[11] = be32dec(sctx->job.nbits);
-		memcpy(&work->data[12], sctx->job.coinbase, 32); // merkle_root
+		work->data[10] = be32dec(job->ntime);
+		work->data[11] = be32dec(job->nbits);
+		memcpy(&work->data[12], coinbase, 32); // merkle_root
 		work->data[20] = 0x80000000;
 		if (opt_debug) applog_hex(work->data, 80);
 	} else {
 		for (i = 0; i < 8; i++)
 			work->data[9 + i] = be32dec((uint32_t *)merkle_root + i);
-		work->data[17] = le32dec(sctx->job.ntime);
-		work->data[18] = le32dec(sctx->job.nbits);
+		work->data[17] = le32dec(job->ntime);
+		work->data[18] = le32dec(job->nbits);
 		work->data[20] = 0x80000000;
 		work->data[31] = (opt_algo == ALGO_MJOLLNIR) ? 0x000002A0 : 0x00000280;
 	}
 
-	if (opt_showdiff || opt_max_diff > 0.)
+	if (netdiff && (opt_showdiff || opt_max_diff > 0.))
 		calc_network_diff(work);
 
 	switch (opt_algo) {
@@ -1706,17 +1882,49 @@ static bool stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 		work->maxvote = 2048;
 		uint16_t *ext = (uint16_t*)(&work->data[20]);
 		ext[0] = opt_vote;
-		ext[1] = be16dec(sctx->job.nreward);
+		ext[1] = be16dec(job->nreward);
 		// applog(LOG_DEBUG, "DEBUG: vote=%hx reward=%hx", ext[0], ext[1]);
 	}
 
-	pthread_mutex_unlock(&stratum_work_lock);
+	if (coinbase != cb_buf)
+		free(coinbase);
+	return true;
+}
+
+static bool stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
+{
+	struct stratum_job *job;
+	double diff;
+
+	if (sctx->rpc2)
+		return rpc2_stratum_gen_work(sctx, work);
+
+	// the published job is never changed, only replaced
+	for (;;) {
+		job = stratum_job_acquire(sctx);
+		if (!job) {
+			// applog(LOG_WARNING, "stratum_gen_work: job not yet retrieved");
+			stratum_job_release();
+			return false;
+		}
+		if (stratum_job_xnonce2(job, work->xnonce2, true))
+			break;
+		stratum_job_release();
+	}
+
+	if (!stratum_build_work(sctx, job, work, true)) {
+		stratum_job_release();
+		return false;
+	}
+
+	diff = job->diff;
+	stratum_job_release();
 
 	if (opt_debug && opt_algo != ALGO_DECRED && opt_algo != ALGO_EQUIHASH && opt_algo != ALGO_SIA) {
 		uint32_t utm = work->data[17];
 		if (opt_algo != ALGO_ZR5) utm = swab32(utm);
 		char *tm = atime2str(utm - sctx->srvtime_diff);
-		char *xnonce2str = bin2hex(work->xnonce2, sctx->xnonce2_size);
+		char *xnonce2str = bin2hex(work->xnonce2, work->xnonce2_len);
 		applog(LOG_DEBUG, "DEBUG: job_id=%s xnonce2=%s time=%s",
 		       work->job_id, xnonce2str, tm);
 		free(tm);
@@ -1726,48 +1934,15 @@ static bool stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 	if (opt_difficulty == 0.)
 		opt_difficulty = 1.;
 
-	switch (opt_algo) {
-		case ALGO_HMQ1725:
-		case ALGO_JACKPOT:
-		case ALGO_JHA:
-		case ALGO_NEOSCRYPT:
-		case ALGO_SCRYPT:
-		case ALGO_SCRYPT_JANE:
-			work_set_target(work, sctx->job.diff / (65536.0 * opt_difficulty));
-			break;
-		case ALGO_ALLIUM:
-		case ALGO_DMD_GR:
-		case ALGO_FRESH:
-		case ALGO_FUGUE256:
-		case ALGO_GROESTL:
-		case ALGO_KECCAKC:
-		case ALGO_LBRY:
-		case ALGO_LYRA2v2:
-		case ALGO_LYRA2v3:
-		case ALGO_LYRA2Z:
-		case ALGO_PHI2:
-		case ALGO_TIMETRAVEL:
-		case ALGO_BITCORE:
-		case ALGO_EXOSIS:
-		case ALGO_X16R:
-		case ALGO_X16S:
-			work_set_target(work, sctx->job.diff / (256.0 * opt_difficulty));
-			break;
-		case ALGO_KECCAK:
-		case ALGO_LYRA2:
-			work_set_target(work, sctx->job.diff / (128.0 * opt_difficulty));
-			break;
-		case ALGO_EQUIHASH:
-			equi_work_set_target(work, sctx->job.diff / opt_difficulty);
-			break;
-		default:
-			work_set_target(work, sctx->job.diff / opt_difficulty);
-	}
+	if (opt_algo == ALGO_EQUIHASH)
+		equi_work_set_target(work, diff / opt_difficulty);
+	else
+		work_set_target(work, diff / (stratum_diff_factor(opt_algo) * opt_difficulty));
 
-	if (stratum_diff != sctx->job.diff) {
+	if (stratum_diff != diff) {
 		char sdiff[32] = { 0 };
 		// store for api stats
-		stratum_diff = sctx->job.diff;
+		stratum_diff = diff;
 		if (opt_showdiff && work->targetdiff != stratum_diff)
 			snprintf(sdiff, 32, " (%.5f)", work->targetdiff);
 		applog(LOG_WARNING, "Stratum difficulty set to %g%s", stratum_diff, sdiff);
@@ -1776,6 +1951,26 @@ static bool stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 	return true;
 }
 
+/* a new extranonce2 of the work job, false if the job was replaced */
+bool stratum_roll_work(struct work *work)
+{
+	struct stratum_job *job;
+	char job_id[128];
+	bool rc = false;
+
+	if (!have_stratum || stratum.rpc2)
+		return false;
+
+	job = stratum_job_acquire(&stratum);
+	if (job && work->pooln == stratum.pooln) {
+		snprintf(job_id, sizeof(job_id), "%07x %s", be32dec(job->ntime) & 0xfffffff, job->job_id);
+		if (!strcmp(job_id, work->job_id) && stratum_job_xnonce2(job, work->xnonce2, true))
+			rc = stratum_build_work(&stratum, job, work, false);
+	}
+	stratum_job_release();
+	return rc;
+}
+
 void restart_threads(void)
 {
 	if (opt_debug && !opt_quiet)
@@ -1842,13 +2037,14 @@ static void *miner_thread(void *userdata)
 {
 	struct thr_info *mythr = (struct thr_info *)userdata;
 	int switchn = pool_switch_count;
+	int mined_algo = (int) opt_algo;
 	int thr_id = mythr->id;
 	int dev_id = device_map[thr_id % MAX_GPUS];
 	struct cgpu_info * cgpu = &thr_info[thr_id].gpu;
 	struct work work;
 	uint64_t loopcnt = 0;
 	uint32_t max_nonce;
-	uint32_t end_nonce = UINT32_MAX / opt_n_threads * (thr_id + 1) - (thr_id + 1);
+	uint32_t *nonceptr;
 	time_t tm_rate_log = 0;
 	bool work_done = false;
 	bool extrajob = false;
@@ -1915,36 +2111,13 @@ static void *miner_thread(void *userdata)
 		int nodata_check_oft = 0;
 		bool regen = false;
 
-		// &work.data[19]
-		int wcmplen = (opt_algo == ALGO_DECRED) ? 140 : 76;
-		int wcmpoft = 0;
-
-		if (opt_algo == ALGO_LBRY) wcmplen = 108;
-		else if (opt_algo == ALGO_SIA) {
-			wcmpoft = (32+16)/4;
-			wcmplen = 32;
-		}
-
-		uint32_t *nonceptr = (uint32_t*) (((char*)work.data) + wcmplen);
-
-		if (opt_algo == ALGO_WILDKECCAK) {
-			nonceptr = (uint32_t*) (((char*)work.data) + 1);
-			wcmpoft = 2;
-			wcmplen = 32;
-		} else if (opt_algo == ALGO_CRYPTOLIGHT || opt_algo == ALGO_CRYPTONIGHT) {
-			nonceptr = (uint32_t*) (((char*)work.data) + 39);
-			wcmplen = 39;
-		} else if (opt_algo == ALGO_EQUIHASH) {
-			nonceptr = &work.data[EQNONCE_OFFSET]; // 27 is pool extranonce (256bits nonce space)
-			wcmplen = 4+32+32;
-		}
-
 		if (have_stratum) {
 			uint32_t sleeptime = 0;
 
-			if (opt_algo == ALGO_DECRED || opt_algo == ALGO_WILDKECCAK /* getjob */)
+			if (opt_algo == ALGO_WILDKECCAK /* getjob */)
 				work_done = true; // force "regen" hash
-			while (!work_done && time(NULL) >= (g_work_time + opt_scantime)) {
+			// the threads roll their own extranonce, no need of fresh work
+			while (!work_done && !nonce_space_can_roll(thr_id) && time(NULL) >= (g_work_time + opt_scantime)) {
 				usleep(100*1000);
 				if (sleeptime > 4) {
 					extrajob = true;
@@ -1954,31 +2127,25 @@ static void *miner_thread(void *userdata)
 			}
 			if (sleeptime && opt_debug && !opt_quiet)
 				applog(LOG_DEBUG, "sleeptime: %u ms", sleeptime*100);
-			//nonceptr = (uint32_t*) (((char*)work.data) + wcmplen);
 			pthread_mutex_lock(&g_work_lock);
 			extrajob |= work_done;
 
-			regen = (nonceptr[0] >= end_nonce);
-			if (opt_algo == ALGO_SIA) {
-				regen = ((nonceptr[1] & 0xFF00) >= 0xF000);
-			}
-			regen = regen || extrajob;
+			regen = extrajob || nonce_space_exhausted(thr_id);
 
 			if (regen) {
 				work_done = false;
 				extrajob = false;
 				if (stratum_gen_work(&stratum, &g_work))
 					g_work_time = time(NULL);
-				if (opt_algo == ALGO_CRYPTONIGHT || opt_algo == ALGO_CRYPTOLIGHT)
-					nonceptr[0] += 0x100000;
 			}
 		} else {
 			uint32_t secs = 0;
 			pthread_mutex_lock(&g_work_lock);
 			secs = (uint32_t) (time(NULL) - g_work_time);
-			if (secs >= scan_time || nonceptr[0] >= (end_nonce - 0x100)) {
+			if (secs >= scan_time || nonce_space_exhausted(thr_id)) {
 				if (opt_debug && g_work_time && !opt_quiet)
-					applog(LOG_DEBUG, "work time %u/%us nonce %x/%x", secs, scan_time, nonceptr[0], end_nonce);
+					applog(LOG_DEBUG, "work time %u/%us%s", secs, scan_time,
+						nonce_space_exhausted(thr_id) ? ", nonces used" : "");
 				/* obtain new work from internal workio thread */
 				if (unlikely(!get_work(mythr, &g_work))) {
 					pthread_mutex_unlock(&g_work_lock);
@@ -1996,7 +2163,7 @@ static void *miner_thread(void *userdata)
 
 		// reset shares id counter on new job
 		if (strcmp(work.job_id, g_work.job_id))
-			stratum.job.shares_count = 0;
+			stratum.shares_count = 0;
 
 		if (!opt_benchmark && (g_work.height != work.height || memcmp(work.target, g_work.target, sizeof(work.target))))
 		{
@@ -2007,90 +2174,12 @@ static void *miner_thread(void *userdata)
 			memcpy(work.target, g_work.target, sizeof(work.target));
 			work.targetdiff = g_work.targetdiff;
 			work.height = g_work.height;
-			//nonceptr[0] = (UINT32_MAX / opt_n_threads) * thr_id; // 0 if single thr
-		}
-
-		if (opt_algo == ALGO_ZR5) {
-			// ignore pok/version header
-			wcmpoft = 1;
-			wcmplen -= 4;
 		}
 
-		if (opt_algo == ALGO_CRYPTONIGHT || opt_algo == ALGO_CRYPTOLIGHT) {
-			uint32_t oldpos = nonceptr[0];
-			bool nicehash = strstr(pools[cur_pooln].url, "nicehash") != NULL;
-			if (memcmp(&work.data[wcmpoft], &g_work.data[wcmpoft], wcmplen)) {
-				memcpy(&work, &g_work, sizeof(struct work));
-				if (!nicehash) nonceptr[0] = (rand()*4) << 24;
-				nonceptr[0] &=  0xFF000000u; // nicehash prefix hack
-				nonceptr[0] |= (0x00FFFFFFu / opt_n_threads) * thr_id;
-			}
-			// also check the end, nonce in the middle
-			else if (memcmp(&work.data[44/4], &g_work.data[0], 76-44)) {
-				memcpy(&work, &g_work, sizeof(struct work));
-			}
-			if (oldpos & 0xFFFF) {
-				if (!nicehash) nonceptr[0] = oldpos + 0x1000000u;
-				else {
-					uint32_t pfx = nonceptr[0] & 0xFF000000u;
-					nonceptr[0] = pfx | ((oldpos + 0x8000u) & 0xFFFFFFu);
-				}
-			}
-		}
-
-		else if (memcmp(&work.data[wcmpoft], &g_work.data[wcmpoft], wcmplen)) {
-			#if 0
-			if (opt_debug) {
-				for (int n=0; n <= (wcmplen-8); n+=8) {
-					if (memcmp(work.data + n, g_work.data + n, 8)) {
-						applog(LOG_DEBUG, "job %s work updated at offset %d:", g_work.job_id, n);
-						applog_hash((uchar*) &work.data[n]);
-						applog_compare_hash((uchar*) &g_work.data[n], (uchar*) &work.data[n]);
-					}
-				}
-			}
-			#endif
+		// new template (or algo), the thread leases restart
+		if (nonce_space_update(thr_id, &g_work))
 			memcpy(&work, &g_work, sizeof(struct work));
-			nonceptr[0] = (UINT32_MAX / opt_n_threads) * thr_id; // 0 if single thr
-		} else
-			nonceptr[0]++; //??
-
-		if (opt_algo == ALGO_DECRED) {
-			// suprnova job_id check without data/target/height change...
-			if (check_stratum_jobs && strcmp(work.job_id, g_work.job_id)) {
-				pthread_mutex_unlock(&g_work_lock);
-				continue;
-			}
-
-			// use the full range per loop
-			nonceptr[0] = 0;
-			end_nonce = UINT32_MAX;
-			// and make an unique work (extradata)
-			nonceptr[1] += 1;
-			nonceptr[2] |= thr_id;
-
-		} else if (opt_algo == ALGO_EQUIHASH) {
-			nonceptr[1]++;
-			nonceptr[1] |= thr_id << 24;
-			//applog_hex(&work.data[27], 32);
-		} else if (opt_algo == ALGO_WILDKECCAK) {
-			//nonceptr[1] += 1;
-		} else if (opt_algo == ALGO_SIA) {
-			// suprnova job_id check without data/target/height change...
-			if (have_stratum && strcmp(work.job_id, g_work.job_id)) {
-				pthread_mutex_unlock(&g_work_lock);
-				work_done = true;
-				continue;
-			}
-			nonceptr[1] += opt_n_threads;
-			nonceptr[1] |= thr_id;
-			// range max
-			nonceptr[0] = 0;
-			end_nonce = UINT32_MAX;
-		} else if (opt_benchmark) {
-			// randomize work
-			nonceptr[-1] += 1;
-		}
+		nonceptr = nonce_space_ptr(thr_id, &work);
 
 		pthread_mutex_unlock(&g_work_lock);
 
@@ -2169,6 +2258,13 @@ static void *miner_thread(void *userdata)
 
 		pool_on_hold = false;
 
+		// pools of different algos, free the previous one
+		if ((int) opt_algo != mined_algo) {
+			algo_free_all(thr_id);
+			cuda_clear_lasterror();
+			mined_algo = (int) opt_algo;
+		}
+
 		work_restart[thr_id].restart = 0;
 
 		/* adjust max_nonce to meet target scan time */
@@ -2327,24 +2423,18 @@ static void *miner_thread(void *userdata)
 		// we can't scan more than uint32 capacity
 		max64 = min(UINT32_MAX, max64);
 
-		start_nonce = nonceptr[0];
-
-		/* never let small ranges at end */
-		if (end_nonce >= UINT32_MAX - 256)
-			end_nonce = UINT32_MAX;
-
-		if ((max64 + start_nonce) >= end_nonce)
-			max_nonce = end_nonce;
-		else
-			max_nonce = (uint32_t) (max64 + start_nonce);
-
-		// todo: keep it rounded to a multiple of 256 ?
-
-		if (unlikely(start_nonce > max_nonce)) {
-			// should not happen but seen in skein2 benchmark with 2 gpus
-			max_nonce = end_nonce = UINT32_MAX;
+		rc = nonce_lease(thr_id, &work, max64 + 1, &max_nonce);
+		if (rc < 0)
+			continue; // template replaced
+		if (rc == 0) {
+			// all used, wait for a new job
+			work_done = true;
+			if (have_stratum)
+				usleep(100*1000);
+			continue;
 		}
 
+		start_nonce = nonceptr[0];
 		work.scanned_from = start_nonce;
 
 		gpulog(LOG_DEBUG, thr_id, "start=%08x end=%08x range=%08x",
@@ -2361,6 +2451,9 @@ static void *miner_thread(void *userdata)
 		hashes_done = 0;
 		gettimeofday(&tv_start, NULL);
 
+		if (opt_fake_pool)
+			fakepool_job_started(thr_id, work.job_id + 8);
+
 		// check (and reset) previous errors
 		cudaError_t err = cudaGetLastError();
 		if (err != cudaSuccess && !opt_quiet)
@@ -2625,6 +2718,9 @@ static void *miner_thread(void *userdata)
 				work.nonces[1] = nonceptr[2];
 		}
 
+		// drop the results of other leases, keep the rest of this one
+		rc = nonce_lease_done(thr_id, &work, rc);
+
 		if (stratum.rpc2 && (rc == -EBUSY || work_restart[thr_id].restart)) {
 			// bbr scratchpad download or stale result
 			sleep(1);
@@ -2677,9 +2773,6 @@ static void *miner_thread(void *userdata)
 				// to debug nonce ranges
 				gpulog(LOG_DEBUG, thr_id, "ends=%08x range=%08x", nonceptr[0], (nonceptr[0] - start_nonce));
 			}
-			// prevent low scan ranges on next loop on fast algos (blake)
-			if (nonceptr[0] > UINT32_MAX - 64)
-				nonceptr[0] = UINT32_MAX;
 		}
 
 		// only required to debug purpose
@@ -2715,7 +2808,11 @@ static void *miner_thread(void *userdata)
 		if (firstwork_time == 0)
 			firstwork_time = time(NULL);
 
-		if (cgpu) cgpu->accepted += work.valid_nonces;
+		if (cgpu) {
+			pthread_mutex_lock(&stats_lock);
+			cgpu->accepted += work.valid_nonces;
+			pthread_mutex_unlock(&stats_lock);
+		}
 
 		/* if nonce found, submit work */
 		if (rc > 0 && !opt_benchmark) {
@@ -2864,6 +2961,7 @@ longpoll_retry:
 			submit_old = soval ? json_is_true(soval) : false;
 			pthread_mutex_lock(&g_work_lock);
 			if (work_decode(json_object_get(val, "result"), &g_work)) {
+				rpc_infos.valid = false;
 				restart_threads();
 				if (!opt_quiet) {
 					char netinfo[64] = { 0 };
@@ -2919,31 +3017,58 @@ need_reinit:
 
 static bool stratum_handle_response(char *buf)
 {
-	json_t *val, *err_val, *res_val, *id_val;
+	json_t *val = NULL, *err_val = NULL, *res_val = NULL, *id_val;
 	json_error_t err;
+	struct stratum_msg msg;
 	struct timeval tv_answer, diff;
 	int num = 0, job_nonce_id = 0;
 	double sharediff = stratum.sharediff;
+	char reason_buf[128];
+	const char *reason = NULL;
+	bool has_result, accepted;
 	bool ret = false;
 
-	val = JSON_LOADS(buf, &err);
-	if (!val) {
-		applog(LOG_INFO, "JSON decode failed(%d): %s", err.line, err.text);
-		goto out;
-	}
+	if (stratum_fast_json && !stratum.rpc2 && stratum_msg_parse(buf, &msg)) {
+		// {"id":10,"result":true,"error":null}
+		struct sjson_val err_items[2];
+		if (msg.id.type == SJSON_INVALID || msg.id.type == SJSON_NULL)
+			goto out;
+		num = (int) sjson_integer(&msg.id);
+		has_result = (msg.result.type != SJSON_INVALID);
+		accepted = (msg.result.type == SJSON_TRUE);
+		if (sjson_array_get(&msg.error, err_items, 2) > 1)
+			reason = sjson_string(&err_items[1], reason_buf, sizeof(reason_buf));
+	} else {
+		val = JSON_LOADS(buf, &err);
+		if (!val) {
+			applog(LOG_INFO, "JSON decode failed(%d): %s", err.line, err.text);
+			goto out;
+		}
 
-	res_val = json_object_get(val, "result");
-	err_val = json_object_get(val, "error");
-	id_val = json_object_get(val, "id");
+		res_val = json_object_get(val, "result");
+		err_val = json_object_get(val, "error");
+		id_val = json_object_get(val, "id");
 
-	if (!id_val || json_is_null(id_val))
-		goto out;
+		if (!id_val || json_is_null(id_val))
+			goto out;
+
+		num = (int) json_integer_value(id_val);
+		has_result = (res_val != NULL);
+		accepted = json_is_true(res_val);
+		if (err_val && !stratum.rpc2)
+			reason = json_string_value(json_array_get(err_val, 1));
+	}
 
 	// ignore late login answers
-	num = (int) json_integer_value(id_val);
 	if (num < 4)
 		goto out;
 
+	if (num >= PROXY_SUBMIT_ID) {
+		proxy_share_result(num, accepted, reason);
+		ret = true;
+		goto out;
+	}
+
 	// We dont have the work anymore, so use the hashlog to get the right sharediff for multiple nonces
 	job_nonce_id = num - 10;
 	if (opt_showdiff && check_dups)
@@ -2953,6 +3078,8 @@ static bool stratum_handle_response(char *buf)
 	timeval_subtract(&diff, &tv_answer, &stratum.tv_submit);
 	// store time required to the pool to answer to a submit
 	stratum.answer_msec = (1000 * diff.tv_sec) + (uint32_t) (0.001 * diff.tv_usec);
+	if (opt_fake_pool)
+		fakepool_submit_rtt(stratum.answer_msec);
 
 	if (stratum.rpc2) {
 		const char* reject_reason = err_val ? json_string_value(json_object_get(err_val, "message")) : NULL;
@@ -2963,10 +3090,9 @@ static bool stratum_handle_response(char *buf)
 			restart_threads();
 		}
 	} else {
-		if (!res_val)
+		if (!has_result)
 			goto out;
-		share_result(json_is_true(res_val), stratum.pooln, sharediff,
-			err_val ? json_string_value(json_array_get(err_val, 1)) : NULL);
+		share_result(accepted, stratum.pooln, sharediff, reason);
 	}
 
 	ret = true;
@@ -3049,21 +3175,21 @@ wait_stratum_url:
 
 		if (switchn != pool_switch_count) goto pool_switched;
 
-		if (stratum.job.job_id &&
-		    (!g_work_time || strncmp(stratum.job.job_id, g_work.job_id + 8, sizeof(g_work.job_id)-8))) {
+		struct stratum_job *job = stratum_job_acquire(&stratum);
+		if (job && (!g_work_time || strncmp(job->job_id, g_work.job_id + 8, sizeof(g_work.job_id)-8))) {
 			pthread_mutex_lock(&g_work_lock);
 			if (stratum_gen_work(&stratum, &g_work))
 				g_work_time = time(NULL);
-			if (stratum.job.clean) {
+			if (job->clean) {
 				static uint32_t last_block_height;
-				if ((!opt_quiet || !firstwork_time) && stratum.job.height != last_block_height) {
-					last_block_height = stratum.job.height;
+				if ((!opt_quiet || !firstwork_time) && g_work.height != last_block_height) {
+					last_block_height = g_work.height;
 					if (net_diff > 0.)
 						applog(LOG_BLUE, "%s block %d, diff %.3f", algo_names[opt_algo],
-							stratum.job.height, net_diff);
+							g_work.height, net_diff);
 					else
 						applog(LOG_BLUE, "%s %s block %d", pool->short_url, algo_names[opt_algo],
-							stratum.job.height);
+							g_work.height);
 				}
 				restart_threads();
 				if (check_dups || opt_showdiff)
@@ -3071,10 +3197,13 @@ wait_stratum_url:
 				stats_purge_old();
 			} else if (opt_debug && !opt_quiet) {
 					applog(LOG_BLUE, "%s asks job %d for block %d", pool->short_url,
-						strtoul(stratum.job.job_id, NULL, 16), stratum.job.height);
+						strtoul(job->job_id, NULL, 16), g_work.height);
 			}
 			pthread_mutex_unlock(&g_work_lock);
+			if (opt_proxy_server)
+				proxy_notify(&stratum);
 		}
+		stratum_job_release();
 		
 		// check we are on the right pool
 		if (switchn != pool_switch_count) goto pool_switched;
@@ -3674,6 +3803,74 @@ void parse_arg(int key, char *arg)
 	case 1019: // max-log-rate
 		opt_maxlograte = atoi(arg);
 		break;
+	case 1040: // log-async
+		opt_log_async = true;
+		break;
+	case 1041: // log-binary
+		opt_log_async = true;
+		opt_log_binary = true;
+		use_colors = false;
+		break;
+	case 1042: // cpu-bench
+		free(opt_cpu_bench);
+		opt_cpu_bench = strdup(arg ? arg : "");
+		break;
+	case 1043: // selftest
+		opt_selftest = true;
+		break;
+	case 1044: // fake-pool
+		free(opt_fake_pool);
+		opt_fake_pool = strdup(arg ? arg : "");
+		break;
+	case 1081: // coinbase-addr
+		free(opt_coinbase_addr);
+		opt_coinbase_addr = strdup(arg);
+		break;
+	case 1082: // coinbase-sig
+		free(opt_coinbase_sig);
+		opt_coinbase_sig = strdup(arg);
+		break;
+	case 1083: // coinbase-xnonce
+		opt_coinbase_xnonce = (uint32_t) strtoul(arg, NULL, 16);
+		break;
+	case 1084: // proxy-server
+		free(opt_proxy_server);
+		opt_proxy_server = strdup(arg);
+		break;
+	case 1085: // cpu-validate
+		v = atoi(arg);
+		if (v < 0 || v > 64)
+			show_usage_and_exit(1);
+		opt_validate_threads = v;
+		break;
+	case 1086: // profit-feed
+		free(opt_profit_feed);
+		opt_profit_feed = strdup(arg);
+		break;
+	case 1087: // profit-interval
+		v = atoi(arg);
+		if (v < 30 || v > 86400)
+			show_usage_and_exit(1);
+		opt_profit_interval = v;
+		break;
+	case 1088: // profit-margin
+		v = atoi(arg);
+		if (v < 0 || v > 1000)
+			show_usage_and_exit(1);
+		opt_profit_margin = v;
+		break;
+	case 1089: // cpu-equihash
+		v = atoi(arg);
+		if (v < 0 || v > 256)
+			show_usage_and_exit(1);
+		opt_equihash_cpu = v;
+		break;
+	case 1090: // cpu-wildkeccak
+		v = atoi(arg);
+		if (v < 0 || v > 256)
+			show_usage_and_exit(1);
+		opt_wildkeccak_cpu = v;
+		break;
 	case 1020:
 		p = strstr(arg, "0x");
 		ul = p ? strtoul(p, NULL, 16) : atol(arg);
@@ -3973,9 +4170,13 @@ int main(int argc, char *argv[])
 
 	// get opt_quiet early
 	parse_single_opt('q', argc, argv);
+	// offline modes, no banner with the cpu-bench json on stdout
+	parse_single_opt(1042, argc, argv);
+	parse_single_opt(1043, argc, argv);
 
-	printf("*** ccminer " PACKAGE_VERSION " for nVidia GPUs by tpruvot@github ***\n");
-	if (!opt_quiet) {
+	if (!opt_cpu_bench)
+		printf("*** ccminer " PACKAGE_VERSION " for nVidia GPUs by tpruvot@github ***\n");
+	if (!opt_quiet && !opt_cpu_bench) {
 		const char* arch = is_x64() ? "64-bits" : "32-bits";
 #ifdef _MSC_VER
 		printf("    Built with VC++ %d and nVidia CUDA SDK %d.%d %s\n\n", msver(),
@@ -4016,11 +4217,21 @@ int main(int argc, char *argv[])
 	if (num_cpus < 1)
 		num_cpus = 1;
 
+	// offline cpu benchmark, no gpu required
+	if (opt_cpu_bench) {
+		parse_single_opt('a', argc, argv);
+		exit(cpu_bench_run(num_cpus));
+	}
+	if (opt_selftest) {
+		parse_single_opt('a', argc, argv);
+		exit(selftest_run(num_cpus));
+	}
+
 	// number of gpus
 	active_gpus = cuda_num_devices();
 
 	for (i = 0; i < MAX_GPUS; i++) {
-		device_map[i] = i % active_gpus;
+		device_map[i] = active_gpus ? i % active_gpus : 0;
 		device_name[i] = NULL;
 		device_config[i] = NULL;
 		device_backoff[i] = is_windows() ? 12 : 2;
@@ -4039,6 +4250,17 @@ int main(int argc, char *argv[])
 	/* parse command line */
 	parse_cmdline(argc, argv);
 
+	if (opt_fake_pool && !opt_benchmark) {
+		int port = fakepool_start(opt_fake_pool);
+		if (!port)
+			proper_exit(EXIT_CODE_USAGE);
+		if (!strlen(rpc_url)) {
+			char url[64];
+			snprintf(url, sizeof(url), "stratum+tcp://fakepool:x@127.0.0.1:%d", port);
+			parse_arg('o', url);
+		}
+	}
+
 	if (!opt_benchmark && !strlen(rpc_url)) {
 		// try default config file (user then binary folder)
 		char defconfig[MAX_PATH] = { 0 };
@@ -4076,6 +4298,32 @@ int main(int argc, char *argv[])
 		allow_mininginfo = false;
 	}
 
+	if (opt_coinbase_addr) {
+		if (!gbt_algo_supported(opt_algo)) {
+			applog(LOG_ERR, "--coinbase-addr is not supported with %s", algo_names[opt_algo]);
+			proper_exit(EXIT_CODE_USAGE);
+		}
+		if (!opt_coinbase_xnonce)
+			opt_coinbase_xnonce = (uint32_t) time(NULL) ^ ((uint32_t) getpid() << 16);
+	}
+
+	if (opt_proxy_server) {
+		if (opt_benchmark || strncasecmp(rpc_url, "stratum", 7)) {
+			applog(LOG_ERR, "--proxy-server requires a stratum pool");
+			proper_exit(EXIT_CODE_USAGE);
+		}
+		if (!proxy_start(opt_proxy_server))
+			proper_exit(EXIT_CODE_USAGE);
+	}
+
+	if (opt_validate_threads && !validate_algo_supported(opt_algo)) {
+		applog(LOG_WARNING, "--cpu-validate is not supported with %s, the gpu threads check their results",
+			algo_names[opt_algo]);
+		opt_validate_threads = 0;
+	}
+	if (opt_validate_threads && !validate_start(opt_validate_threads))
+		proper_exit(EXIT_CODE_SW_INIT_ERROR);
+
 	if (opt_algo == ALGO_EQUIHASH) {
 		opt_extranonce = false; // disable subscribe
 	}
@@ -4160,6 +4408,14 @@ int main(int argc, char *argv[])
 			applog(LOG_DEBUG, "Binding process to cpu mask %x", opt_affinity);
 		affine_to_cpu_mask(-1, (unsigned long)opt_affinity);
 	}
+	if (active_gpus == 0 && opt_algo == ALGO_EQUIHASH) {
+		// one miner thread, the solver uses the cores
+		if (!opt_equihash_cpu)
+			opt_equihash_cpu = num_cpus;
+		applog(LOG_WARNING, "No CUDA devices found, solving equihash with %d cpu threads", opt_equihash_cpu);
+		device_name[0] = strdup("CPU");
+		active_gpus = opt_n_threads = 1;
+	}
 	if (active_gpus == 0) {
 		applog(LOG_ERR, "No CUDA devices found! terminating.");
 		exit(1);
@@ -4185,6 +4441,12 @@ int main(int argc, char *argv[])
 		openlog(opt_syslog_pfx, LOG_PID, LOG_USER);
 #endif
 
+	if (opt_log_async && !use_syslog) {
+		if (!applog_async_start())
+			opt_log_async = false;
+	} else
+		opt_log_async = false;
+
 	work_restart = (struct work_restart *)calloc(opt_n_threads, sizeof(*work_restart));
 	if (!work_restart)
 		return EXIT_CODE_SW_INIT_ERROR;
@@ -4347,6 +4609,9 @@ int main(int argc, char *argv[])
 		opt_n_threads, opt_n_threads > 1 ? "s":"",
 		algo_names[opt_algo]);
 
+	if (opt_profit_feed && !opt_benchmark && !profit_start())
+		return EXIT_CODE_SW_INIT_ERROR;
+
 	/* main loop - simply wait for workio thread to exit */
 	pthread_join(thr_info[work_thr_id].pth, NULL);
 
@@ -0,0 +1,552 @@
+/**
+ * Offline benchmark of the cpu hash functions (--cpu-bench)
+ *
+ * Measure for each algo of the cpuhash.cpp table the single thread and
+ * all cores hashrates, the per hash latency percentiles and, in a build
+ * with CPUBENCH_ALLOCS defined, the heap allocations per hash. The blake
+ * family also has the rate of the midstate nonce scan (scan_hps), keccak
+ * and wildkeccak (on a 64MB scratchpad) the one of their multi-lane
+ * batches. The chained primitives are also measured alone on 64 bytes
+ * inputs, and the full benchmark replays a stratum session to compare the
+ * jansson and the allocation free decoding of the messages. No gpu is
+ * required, the result is written as json with fixed keys and rounding to
+ * be diffed by scripts.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#ifndef WIN32
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "miner.h"
+#include "algos.h"
+#include "Algo256/blake256-cpu.h"
+#include "sph/keccak-simd.h"
+#include "sph/sph_streebog.h"
+#include "sph/sph_whirlpool.h"
+#include "x13/sm3.h"
+
+#define CPUB_PHASE_MS    500
+#define CPUB_MAX_SAMPLES 65536
+
+char *opt_cpu_bench = NULL;
+
+static volatile bool cpub_stop = false;
+
+static uint64_t cpub_now_ns()
+{
+#ifdef WIN32
+	static LARGE_INTEGER freq = { 0 };
+	LARGE_INTEGER cnt;
+	if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&cnt);
+	return (uint64_t) ((double) cnt.QuadPart * 1e9 / (double) freq.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/**
+ * allocation counters, only in a bench build (glibc, -DCPUBENCH_ALLOCS):
+ * malloc is then wrapped for the whole process, never in the shipped miner
+ */
+#if defined(__GLIBC__) && defined(CPUBENCH_ALLOCS)
+#define CPUB_ALLOCS 1
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static bool cpub_counting = false;
+static __thread bool tls_count = false;
+static __thread uint64_t tls_allocs = 0;
+static __thread uint64_t tls_bytes = 0;
+
+extern "C" void *malloc(size_t size)
+{
+	if (cpub_counting && tls_count) {
+		tls_allocs++; tls_bytes += size;
+	}
+	return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+	if (cpub_counting && tls_count) {
+		tls_allocs++; tls_bytes += n * size;
+	}
+	return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+	if (cpub_counting && tls_count) {
+		tls_allocs++; tls_bytes += size;
+	}
+	return __libc_realloc(ptr, size);
+}
+#endif
+
+struct cpub_thread {
+	pthread_t pth;
+	const struct cpu_hash_algo *algo;
+	pthread_barrier_t *barrier;
+	uint32_t first_nonce;
+	uint64_t hashes;
+};
+
+/* as the miner scans it (cryptonight blob, decred header...) */
+static int cpub_nonce_offset(const struct cpu_hash_algo *algo)
+{
+	int oft = nonce_space_offset(algo->algo);
+	return oft + 4 <= algo->datalen ? oft : 76;
+}
+
+static void *cpub_thread_fn(void *userdata)
+{
+	struct cpub_thread *t = (struct cpub_thread*) userdata;
+	uint32_t _ALIGN(64) hash[16];
+	uint8_t _ALIGN(64) data[256];
+	uint32_t nonce = t->first_nonce;
+	const int nonce_oft = cpub_nonce_offset(t->algo);
+
+	cpu_hash_input(data, t->algo->datalen, 0);
+	pthread_barrier_wait(t->barrier);
+	while (!cpub_stop) {
+		le32enc(&data[nonce_oft], nonce++);
+		t->algo->hash(hash, data);
+		t->hashes++;
+	}
+	return NULL;
+}
+
+/* all cores phase, return the total hashrate */
+static double cpub_multi(const struct cpu_hash_algo *algo, int nthreads)
+{
+	struct cpub_thread *thr = (struct cpub_thread*) calloc(nthreads, sizeof(*thr));
+	pthread_barrier_t barrier;
+	uint64_t hashes = 0;
+	int started = 0;
+
+	if (!thr) return 0.;
+	pthread_barrier_init(&barrier, NULL, nthreads + 1);
+	cpub_stop = false;
+	for (int i = 0; i < nthreads; i++) {
+		thr[i].algo = algo;
+		thr[i].barrier = &barrier;
+		thr[i].first_nonce = (uint32_t) i << 24;
+		if (pthread_create(&thr[i].pth, NULL, cpub_thread_fn, &thr[i]))
+			break;
+		started++;
+	}
+	if (started < nthreads) {
+		// unlock the started threads
+		applog(LOG_ERR, "cpu-bench: thread create failed");
+		cpub_stop = true;
+		for (int i = started; i < nthreads; i++)
+			pthread_barrier_wait(&barrier);
+	}
+	pthread_barrier_wait(&barrier);
+	uint64_t start = cpub_now_ns();
+	usleep(CPUB_PHASE_MS * 1000);
+	cpub_stop = true;
+	for (int i = 0; i < started; i++) {
+		pthread_join(thr[i].pth, NULL);
+		hashes += thr[i].hashes;
+	}
+	uint64_t elapsed = cpub_now_ns() - start;
+	pthread_barrier_destroy(&barrier);
+	free(thr);
+	return elapsed ? (double) hashes * 1e9 / (double) elapsed : 0.;
+}
+
+static double cpub_percentile(const uint32_t *sorted, int n, double pct)
+{
+	if (!n) return 0.;
+	int i = (int) (pct * (n - 1) / 100. + 0.5);
+	return sorted[i] / 1000.;
+}
+
+/* blake family, rounds of the midstate nonce scan */
+static int cpub_scan_rounds(const struct cpu_hash_algo *algo)
+{
+	switch (algo->algo) {
+	case ALGO_BLAKE:
+	case ALGO_DECRED:
+		return 14;
+	case ALGO_BLAKECOIN:
+	case ALGO_VANILLA:
+		return 8;
+	}
+	return 0;
+}
+
+/* single thread nonce scan from a midstate, without output buffer */
+static double cpub_scan(const struct cpu_hash_algo *algo, const uint8_t *data)
+{
+	blake256_midstate ms;
+	uint32_t target[8] = { 0 };
+	uint32_t found[4];
+	uint32_t nonce = 0;
+	size_t nonce_off = cpub_nonce_offset(algo);
+
+	if (blake256_mid_init(&ms, data, algo->datalen, nonce_off, cpub_scan_rounds(algo)) < 0)
+		return 0.;
+	uint64_t start = cpub_now_ns(), end = start;
+	uint64_t stop = start + CPUB_PHASE_MS * 1000000ULL;
+	while (end < stop) {
+		blake256_mid_scan(&ms, nonce, 0x10000, target, found, 4);
+		nonce += 0x10000;
+		end = cpub_now_ns();
+	}
+	return (double) nonce * 1e9 / (double) (end - start);
+}
+
+/* keccak-256, batches of 8 nonces on the interleaved permutation */
+static double cpub_scan_keccak(const uint8_t *data)
+{
+	uint32_t _ALIGN(64) hash[8][8];
+	uint32_t nonces[8];
+	uint32_t nonce = 0;
+
+	uint64_t start = cpub_now_ns(), end = start;
+	uint64_t stop = start + CPUB_PHASE_MS * 1000000ULL;
+	while (end < stop) {
+		for (int i = 0; i < 1024; i++) {
+			for (int j = 0; j < 8; j++)
+				nonces[j] = nonce++;
+			keccak256_hash_n(hash, data, 80, 76, nonces, 8);
+		}
+		end = cpub_now_ns();
+	}
+	return (double) nonce * 1e9 / (double) (end - start);
+}
+
+#define CPUB_WK_PAD (64U << 20)
+static double cpub_scan_wildkeccak(const uint8_t *data)
+{
+	uint32_t _ALIGN(64) hash[16][8];
+	uint32_t nonces[16];
+	uint32_t nonce = 0;
+	uint64_t x = 0x9e3779b97f4a7c15ULL;
+
+	uint64_t *pad = wildkeccak_pad_alloc(CPUB_WK_PAD, false);
+	if (!pad) return 0.;
+	for (size_t i = 0; i < CPUB_WK_PAD / 8; i++) {
+		x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+		pad[i] = x;
+	}
+
+	uint64_t start = cpub_now_ns(), end = start;
+	uint64_t stop = start + CPUB_PHASE_MS * 1000000ULL;
+	while (end < stop) {
+		for (int i = 0; i < 16; i++) {
+			for (int j = 0; j < 16; j++)
+				nonces[j] = nonce++;
+			wildkeccak_hash_n(hash, data, nonces, 16, pad, CPUB_WK_PAD / 8);
+		}
+		end = cpub_now_ns();
+	}
+	wildkeccak_pad_free(pad, CPUB_WK_PAD);
+	return (double) nonce * 1e9 / (double) (end - start);
+}
+
+static void cpub_algo(FILE *out, const struct cpu_hash_algo *algo, int nthreads, bool last)
+{
+	uint32_t _ALIGN(64) hash[16];
+	uint8_t _ALIGN(64) data[256];
+	uint32_t *lat = (uint32_t*) calloc(CPUB_MAX_SAMPLES, sizeof(uint32_t));
+	uint64_t allocs = 0, bytes = 0;
+	uint32_t nonce = 0;
+	const int nonce_oft = cpub_nonce_offset(algo);
+	int n = 0;
+	char hex[65];
+
+	cpu_hash_prepare(algo);
+	cpu_hash_input(data, algo->datalen, 0);
+
+	// reference hash of nonce 0, also warms the caches and the static inits
+	memset(hash, 0, sizeof(hash));
+	algo->hash(hash, data);
+	cbin2hex(hex, (const char*) hash, 32);
+
+	// single thread phase
+#ifdef CPUB_ALLOCS
+	tls_allocs = tls_bytes = 0;
+	tls_count = true;
+#endif
+	uint64_t start = cpub_now_ns(), end = start;
+	uint64_t stop = start + CPUB_PHASE_MS * 1000000ULL;
+	while (end < stop) {
+		uint64_t t0 = end;
+		le32enc(&data[nonce_oft], ++nonce);
+		algo->hash(hash, data);
+		end = cpub_now_ns();
+		if (lat && n < CPUB_MAX_SAMPLES)
+			lat[n++] = (uint32_t) min(end - t0, (uint64_t) UINT32_MAX);
+	}
+#ifdef CPUB_ALLOCS
+	tls_count = false;
+	allocs = tls_allocs;
+	bytes = tls_bytes;
+#endif
+	double st_hps = (double) nonce * 1e9 / (double) (end - start);
+	if (lat) std::sort(lat, lat + n);
+
+	double mt_hps = cpub_multi(algo, nthreads);
+
+	char scan[32] = "null";
+	if (cpub_scan_rounds(algo))
+		snprintf(scan, sizeof(scan), "%.1f", cpub_scan(algo, data));
+	else if (algo->algo == ALGO_KECCAK || algo->algo == ALGO_KECCAKC)
+		snprintf(scan, sizeof(scan), "%.1f", cpub_scan_keccak(data));
+	else if (algo->algo == ALGO_WILDKECCAK)
+		snprintf(scan, sizeof(scan), "%.1f", cpub_scan_wildkeccak(data));
+
+	fprintf(out, "    { \"name\": \"%s\", \"datalen\": %d, \"hash\": \"%s\",\n",
+		algo->name, algo->datalen, hex);
+	fprintf(out, "      \"st_hps\": %.1f, \"mt_hps\": %.1f, \"scan_hps\": %s,\n", st_hps, mt_hps, scan);
+	fprintf(out, "      \"lat_us\": { \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f },\n",
+		cpub_percentile(lat, n, 50.), cpub_percentile(lat, n, 90.),
+		cpub_percentile(lat, n, 99.), cpub_percentile(lat, n, 100.));
+#ifdef CPUB_ALLOCS
+	fprintf(out, "      \"allocs_per_hash\": %.3f, \"alloc_bytes_per_hash\": %.1f }%s\n",
+		(double) allocs / nonce, (double) bytes / nonce, last ? "" : ",");
+#else
+	fprintf(out, "      \"allocs_per_hash\": null, \"alloc_bytes_per_hash\": null }%s\n",
+		last ? "" : ",");
+#endif
+	fflush(out);
+
+	if (out != stdout)
+		applog(LOG_INFO, "%s: %.2f kH/s, %.2f kH/s with %d threads", algo->name,
+			st_hps / 1000., mt_hps / 1000., nthreads);
+	free(lat);
+}
+
+/* primitives of the chains, with the algos using them */
+static void cpub_streebog(void *out, const void *in)
+{
+	sph_gost512_context ctx;
+	sph_gost512_init(&ctx);
+	sph_gost512(&ctx, in, 64);
+	sph_gost512_close(&ctx, out);
+}
+
+static void cpub_whirlpool(void *out, const void *in)
+{
+	sph_whirlpool_context ctx;
+	sph_whirlpool_init(&ctx);
+	sph_whirlpool(&ctx, in, 64);
+	sph_whirlpool_close(&ctx, out);
+}
+
+static void cpub_sm3(void *out, const void *in)
+{
+	sm3_ctx_t ctx;
+	sm3_init(&ctx);
+	sm3_update(&ctx, (const unsigned char*) in, 64);
+	sm3_close(&ctx, out);
+}
+
+static const struct {
+	const char *name;
+	void (*hash)(void *out, const void *in);
+	int algos[8];
+} cpub_prims[] = {
+	{ "streebog512", cpub_streebog,  { ALGO_SKUNK, ALGO_SIB, ALGO_VELTOR, ALGO_EXOSIS } },
+	{ "whirlpool",   cpub_whirlpool, { ALGO_WHIRLPOOL, ALGO_WHIRLPOOLX, ALGO_X15, ALGO_X17, ALGO_X16R, ALGO_X16S } },
+	{ "sm3",         cpub_sm3,       { ALGO_HSR } },
+	{ NULL }
+};
+
+static bool cpub_prim_match(int p)
+{
+	if (opt_algo == ALGO_AUTO)
+		return true;
+	for (int i = 0; i < 8 && cpub_prims[p].algos[i]; i++)
+		if (cpub_prims[p].algos[i] == opt_algo) return true;
+	return false;
+}
+
+static double cpub_prim(int p)
+{
+	uint32_t _ALIGN(64) buf[16];
+	uint32_t n = 0;
+
+	cpu_hash_input((uint8_t*) buf, 64, 0);
+	uint64_t start = cpub_now_ns(), end = start;
+	uint64_t stop = start + CPUB_PHASE_MS * 1000000ULL;
+	while (end < stop) {
+		// chained like in the algos
+		for (int i = 0; i < 256; i++, n++)
+			cpub_prims[p].hash(buf, buf);
+		end = cpub_now_ns();
+	}
+	return (double) n * 1e9 / (double) (end - start);
+}
+
+/* replay of a stratum session: notify, difficulty and submit answers */
+#define CPUB_STRATUM_JOBS   64
+#define CPUB_STRATUM_MERKLE 12
+
+static int cpub_stratum_lines(char **lines)
+{
+	uint8_t bin[128];
+	char hex[8][257];
+	int n = 0;
+
+	for (int j = 0; j < CPUB_STRATUM_JOBS; j++) {
+		char *p = lines[n++] = (char*) malloc(4096);
+		static const int sizes[] = { 4, 32, 58, 110 };
+		for (int i = 0; i < 4; i++) {
+			cpu_hash_input(bin, sizes[i], j * 16 + i);
+			cbin2hex(hex[i], (const char*) bin, sizes[i]);
+		}
+		p += sprintf(p, "{\"id\":null,\"method\":\"mining.notify\",\"params\":"
+			"[\"%s\",\"%s\",\"%s\",\"%s\",[", hex[0], hex[1], hex[2], hex[3]);
+		for (int m = 0; m < CPUB_STRATUM_MERKLE; m++) {
+			cpu_hash_input(bin, 32, j * 16 + 4 + m);
+			cbin2hex(hex[4], (const char*) bin, 32);
+			p += sprintf(p, m ? ",\"%s\"" : "\"%s\"", hex[4]);
+		}
+		sprintf(p, "],\"20000000\",\"1a0ffff0\",\"%08x\",%s]}",
+			(uint32_t) time(NULL) + j, (j % 8) ? "false" : "true");
+
+		lines[n] = (char*) malloc(128);
+		sprintf(lines[n++], "{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[%d]}", 8 + j);
+		for (int a = 0; a < 2; a++) {
+			lines[n] = (char*) malloc(128);
+			sprintf(lines[n++], "{\"id\":%d,\"result\":%s,\"error\":%s}", 10 + 2*j + a,
+				a ? "false" : "true", a ? "[21,\"Job not found\",null]" : "null");
+		}
+	}
+	return n;
+}
+
+static double cpub_stratum(char **lines, int count, bool fast, double *allocs_per_msg)
+{
+	struct stratum_ctx sctx;
+	uchar xnonce1[4] = { 0xf0, 0x00, 0x00, 0x01 };
+	uint64_t n = 0;
+
+	memset(&sctx, 0, sizeof(sctx));
+	sctx.xnonce1 = xnonce1;
+	sctx.xnonce1_size = sizeof(xnonce1);
+	sctx.xnonce2_size = 4;
+	sctx.next_diff = 1.;
+
+	stratum_fast_json = fast;
+	for (int i = 0; i < count; i++)
+		stratum_handle_method(&sctx, lines[i]);
+#ifdef CPUB_ALLOCS
+	tls_allocs = tls_bytes = 0;
+	tls_count = true;
+#endif
+	uint64_t start = cpub_now_ns(), end = start;
+	uint64_t stop = start + CPUB_PHASE_MS * 1000000ULL;
+	while (end < stop) {
+		for (int i = 0; i < count; i++, n++)
+			stratum_handle_method(&sctx, lines[i]);
+		end = cpub_now_ns();
+	}
+#ifdef CPUB_ALLOCS
+	tls_count = false;
+	*allocs_per_msg = (double) tls_allocs / n;
+#else
+	*allocs_per_msg = -1.;
+#endif
+	stratum_fast_json = true;
+	stratum_free_job(&sctx);
+	return (double) n * 1e9 / (double) (end - start);
+}
+
+static void cpub_stratum_report(FILE *out)
+{
+	char *lines[CPUB_STRATUM_JOBS * 4];
+	double allocs[2];
+	int count = cpub_stratum_lines(lines);
+
+	double jansson_mps = cpub_stratum(lines, count, false, &allocs[0]);
+	double fast_mps = cpub_stratum(lines, count, true, &allocs[1]);
+	fprintf(out, ",\n  \"stratum\": { \"messages\": %d, \"jansson_mps\": %.1f, \"fast_mps\": %.1f,\n", count, jansson_mps, fast_mps);
+#ifdef CPUB_ALLOCS
+	fprintf(out, "    \"jansson_allocs_per_msg\": %.3f, \"fast_allocs_per_msg\": %.3f }", allocs[0], allocs[1]);
+#else
+	fprintf(out, "    \"jansson_allocs_per_msg\": null, \"fast_allocs_per_msg\": null }");
+#endif
+	fflush(out);
+	for (int i = 0; i < count; i++)
+		free(lines[i]);
+}
+
+/* --cpu-bench[=file], return the process exit code */
+int cpu_bench_run(int nthreads)
+{
+	FILE *out = stdout;
+	int count = 0, done = 0;
+
+	if (opt_cpu_bench && strlen(opt_cpu_bench)) {
+		out = fopen(opt_cpu_bench, "w");
+		if (!out) {
+			applog(LOG_ERR, "cpu-bench: unable to write %s", opt_cpu_bench);
+			return EXIT_CODE_USAGE;
+		}
+	}
+
+	// solver and verify, not a hash function
+	if (opt_algo == ALGO_EQUIHASH) {
+		int rc = equi_cpu_bench(out, opt_equihash_cpu ? opt_equihash_cpu : nthreads);
+		if (out != stdout) fclose(out);
+		return rc;
+	}
+
+	for (int i = 0; cpu_hash_algos[i].name; i++)
+		if (cpu_hash_match(&cpu_hash_algos[i], opt_algo)) count++;
+	if (!count) {
+		applog(LOG_ERR, "cpu-bench: no cpu hash for algo %s", algo_names[opt_algo]);
+		if (out != stdout) fclose(out);
+		return EXIT_CODE_USAGE;
+	}
+
+#ifdef CPUB_ALLOCS
+	cpub_counting = true;
+#endif
+	fprintf(out, "{\n  \"version\": \"%s\",\n  \"threads\": %d,\n  \"phase_ms\": %d,\n  \"algos\": [\n",
+		PACKAGE_VERSION, nthreads, CPUB_PHASE_MS);
+	for (int i = 0; cpu_hash_algos[i].name; i++) {
+		const struct cpu_hash_algo *algo = &cpu_hash_algos[i];
+		if (!cpu_hash_match(algo, opt_algo))
+			continue;
+		done++;
+		cpub_algo(out, algo, nthreads, done == count);
+	}
+	fprintf(out, "  ]");
+	int prims = 0;
+	for (int p = 0; cpub_prims[p].name; p++) {
+		if (!cpub_prim_match(p))
+			continue;
+		fprintf(out, prims++ ? ",\n" : ",\n  \"primitives\": [\n");
+		fprintf(out, "    { \"name\": \"%s\", \"st_hps\": %.1f }", cpub_prims[p].name, cpub_prim(p));
+		fflush(out);
+	}
+	if (prims)
+		fprintf(out, "\n  ]");
+	// the stratum messages decoding, with the full benchmark only
+	if (opt_algo == ALGO_AUTO)
+		cpub_stratum_report(out);
+	fprintf(out, "\n}\n");
+#ifdef CPUB_ALLOCS
+	cpub_counting = false;
+#endif
+
+	if (out != stdout)
+		fclose(out);
+	else
+		fflush(out);
+	return EXIT_CODE_OK;
+}
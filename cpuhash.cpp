@@ -0,0 +1,218 @@
+/**
+ * Table of the cpu hash functions, used by --cpu-bench and --selftest
+ *
+ * Entries use the names of the -a parameter, the variants of an algo
+ * (cryptonight forks, blake rounds) have their own entry.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "miner.h"
+#include "algos.h"
+
+extern int opt_nfactor;
+extern uint64_t* pscratchpad_buff;
+extern uint64_t scratchpad_size;
+
+static void blakecoin_cpu(void *output, const void *input)
+{
+	blake256hash(output, input, 8);
+}
+
+static void blake_cpu(void *output, const void *input)
+{
+	blake256hash(output, input, 14);
+}
+
+static void fugue256_cpu(void *output, const void *input)
+{
+	fugue256_hash((uchar*) output, (const uchar*) input, 80);
+}
+
+#ifdef WITH_HEAVY_ALGO
+static void heavy_cpu(void *output, const void *input)
+{
+	heavycoin_hash((uchar*) output, (const uchar*) input, 84);
+}
+#endif
+
+static void neoscrypt_cpu(void *output, const void *input)
+{
+	neoscrypt((uchar*) output, (const uchar*) input, 0x80000620U);
+}
+
+static void vanilla_cpu(void *output, const void *input)
+{
+	vanillahash(output, input, 8);
+}
+
+/* uses a fixed pseudo random scratchpad, not to be used while mining */
+#define CPUH_WK_SCRATCH (1 << 18)
+static void wildkeccak_cpu(void *output, const void *input)
+{
+	static uint64_t *pad = NULL;
+	static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	pthread_mutex_lock(&lock);
+	if (!pad) {
+		uint64_t x = 0x9e3779b97f4a7c15ULL;
+		pad = (uint64_t*) malloc(CPUH_WK_SCRATCH * sizeof(uint64_t) + 32);
+		for (int i = 0; pad && i < CPUH_WK_SCRATCH + 4; i++) {
+			x ^= x << 13; x ^= x >> 7; x ^= x << 17;
+			pad[i] = x;
+		}
+	}
+	if (!pad) {
+		pthread_mutex_unlock(&lock);
+		memset(output, 0, 32);
+		return;
+	}
+	// the hash uses the scratchpad globals, restore them after
+	uint64_t *prev_buff = pscratchpad_buff;
+	uint64_t prev_size = scratchpad_size;
+	scratchpad_size = CPUH_WK_SCRATCH;
+	wildkeccak_hash(output, input, pad, CPUH_WK_SCRATCH);
+	pscratchpad_buff = prev_buff;
+	scratchpad_size = prev_size;
+	pthread_mutex_unlock(&lock);
+}
+
+/* opt_nfactor is a global, set by the caller from the entry variant */
+static void scrypt_cpu(void *output, const void *input)
+{
+	scrypthash(output, input);
+}
+
+static void scryptjane_cpu(void *output, const void *input)
+{
+	scryptjane_hash(output, input);
+}
+
+const struct cpu_hash_algo cpu_hash_algos[] = {
+	{ "allium",      ALGO_ALLIUM,      0, 80,  allium_hash, 0 },
+	{ "bastion",     ALGO_BASTION,     0, 80,  (cpu_hash_fn) bastionhash, 0 },
+	{ "bitcore",     ALGO_BITCORE,     0, 80,  bitcore_hash, 0 },
+	{ "blake",       ALGO_BLAKE,      14, 80,  blake_cpu, 0 },
+	{ "blakecoin",   ALGO_BLAKECOIN,   8, 80,  blakecoin_cpu, 0 },
+	{ "blake2b",     ALGO_BLAKE2B,     0, 80,  blake2b_hash, 0 },
+	{ "blake2s",     ALGO_BLAKE2S,     0, 80,  blake2s_hash, 0 },
+	{ "bmw",         ALGO_BMW,         0, 80,  bmw_hash, 0 },
+	{ "c11",         ALGO_C11,         0, 80,  c11hash, 0 },
+	{ "cryptolight", ALGO_CRYPTOLIGHT, 1, 76,  cryptolight_hash, 0 },
+	{ "cryptonight", ALGO_CRYPTONIGHT, 0, 76,  cryptonight_hash, CPUH_GLOBAL | CPUH_SERIAL },
+	{ "monero",      ALGO_MONERO,      1, 76,  monero_hash, CPUH_GLOBAL | CPUH_SERIAL },
+	{ "graft",       ALGO_GRAFT,       1, 76,  graft_hash, CPUH_GLOBAL | CPUH_SERIAL },
+	{ "stellite",    ALGO_STELLITE,    2, 76,  stellite_hash, CPUH_GLOBAL | CPUH_SERIAL },
+	{ "decred",      ALGO_DECRED,      0, 180, decred_hash, 0 },
+	{ "deep",        ALGO_DEEP,        0, 80,  deephash, 0 },
+	{ "dmd-gr",      ALGO_DMD_GR,      0, 80,  groestlhash, 0 },
+	{ "exosis",      ALGO_EXOSIS,      0, 80,  exosis_hash, 0 },
+	{ "fresh",       ALGO_FRESH,       0, 80,  fresh_hash, 0 },
+	{ "fugue256",    ALGO_FUGUE256,    0, 80,  fugue256_cpu, 0 },
+	{ "groestl",     ALGO_GROESTL,     0, 80,  groestlhash, 0 },
+#ifdef WITH_HEAVY_ALGO
+	{ "heavy",       ALGO_HEAVY,       0, 84,  heavy_cpu, 0 },
+#endif
+	{ "hmq1725",     ALGO_HMQ1725,     0, 80,  hmq17hash, 0 },
+	{ "hsr",         ALGO_HSR,         0, 80,  hsr_hash, 0 },
+	{ "jackpot",     ALGO_JACKPOT,     0, 80,  jackpothash, 0 },
+	{ "jha",         ALGO_JHA,         0, 80,  jha_hash, 0 },
+	{ "keccak",      ALGO_KECCAK,      0, 80,  keccak256_hash, 0 },
+	{ "keccakc",     ALGO_KECCAKC,     0, 80,  keccak256_hash, 0 },
+	{ "lbry",        ALGO_LBRY,        0, 112, lbry_hash, 0 },
+	{ "luffa",       ALGO_LUFFA,       0, 80,  luffa_hash, 0 },
+	{ "lyra2",       ALGO_LYRA2,       0, 80,  lyra2re_hash, 0 },
+	{ "lyra2v2",     ALGO_LYRA2v2,     0, 80,  lyra2v2_hash, 0 },
+	{ "lyra2v3",     ALGO_LYRA2v3,     0, 80,  lyra2v3_hash, 0 },
+	{ "lyra2z",      ALGO_LYRA2Z,      0, 80,  lyra2Z_hash, 0 },
+	{ "myr-gr",      ALGO_MYR_GR,      0, 80,  myriadhash, 0 },
+	{ "neoscrypt",   ALGO_NEOSCRYPT,   0, 80,  neoscrypt_cpu, 0 },
+	{ "nist5",       ALGO_NIST5,       0, 80,  nist5hash, 0 },
+	{ "penta",       ALGO_PENTABLAKE,  0, 80,  pentablakehash, 0 },
+	{ "phi",         ALGO_PHI,         0, 80,  phi_hash, 0 },
+	{ "phi2",        ALGO_PHI2,        0, 80,  phi2_hash, 0 },
+	{ "polytimos",   ALGO_POLYTIMOS,   0, 80,  polytimos_hash, 0 },
+	{ "quark",       ALGO_QUARK,       0, 80,  quarkhash, 0 },
+	{ "qubit",       ALGO_QUBIT,       0, 80,  qubithash, 0 },
+	{ "scrypt",      ALGO_SCRYPT,      9, 80,  scrypt_cpu, CPUH_GLOBAL | CPUH_SERIAL },
+	{ "scrypt-jane", ALGO_SCRYPT_JANE,14, 80,  scryptjane_cpu, CPUH_GLOBAL | CPUH_SERIAL },
+	{ "sha256d",     ALGO_SHA256D,     0, 80,  sha256d_hash, 0 },
+	{ "sha256t",     ALGO_SHA256T,     0, 80,  sha256t_hash, 0 },
+	{ "sha256q",     ALGO_SHA256Q,     0, 80,  sha256q_hash, 0 },
+	{ "sia",         ALGO_SIA,         0, 80,  sia_blake2b_hash, 0 },
+	{ "sib",         ALGO_SIB,         0, 80,  sibhash, 0 },
+	{ "skein",       ALGO_SKEIN,       0, 80,  skeincoinhash, 0 },
+	{ "skein2",      ALGO_SKEIN2,      0, 80,  skein2hash, 0 },
+	{ "skunk",       ALGO_SKUNK,       0, 80,  skunk_hash, 0 },
+	{ "sonoa",       ALGO_SONOA,       0, 80,  sonoa_hash, 0 },
+	{ "s3",          ALGO_S3,          0, 80,  s3hash, 0 },
+	{ "timetravel",  ALGO_TIMETRAVEL,  0, 80,  timetravel_hash, 0 },
+	{ "tribus",      ALGO_TRIBUS,      0, 80,  tribus_hash, 0 },
+	{ "vanilla",     ALGO_VANILLA,     8, 80,  vanilla_cpu, 0 },
+	{ "veltor",      ALGO_VELTOR,      0, 80,  veltorhash, 0 },
+	{ "whirlcoin",   ALGO_WHIRLCOIN,   0, 80,  wcoinhash, 0 },
+	{ "whirlpool",   ALGO_WHIRLPOOL,   0, 80,  wcoinhash, 0 },
+	{ "whirlpoolx",  ALGO_WHIRLPOOLX,  0, 80,  whirlxHash, 0 },
+	{ "wildkeccak",  ALGO_WILDKECCAK,  0, 88,  wildkeccak_cpu, CPUH_GLOBAL },
+	{ "x11evo",      ALGO_X11EVO,      0, 80,  x11evo_hash, 0 },
+	{ "x11",         ALGO_X11,         0, 80,  x11hash, 0 },
+	{ "x12",         ALGO_X12,         0, 80,  x12hash, 0 },
+	{ "x13",         ALGO_X13,         0, 80,  x13hash, 0 },
+	{ "x14",         ALGO_X14,         0, 80,  x14hash, 0 },
+	{ "x15",         ALGO_X15,         0, 80,  x15hash, 0 },
+	{ "x16r",        ALGO_X16R,        0, 80,  x16r_hash, 0 },
+	{ "x16s",        ALGO_X16S,        0, 80,  x16s_hash, 0 },
+	{ "x17",         ALGO_X17,         0, 80,  x17hash, 0 },
+	{ "zr5",         ALGO_ZR5,         0, 80,  zr5hash, 0 },
+	{ NULL, 0, 0, 0, NULL, 0 }
+};
+
+int cpu_hash_count()
+{
+	return (int) ARRAY_SIZE(cpu_hash_algos) - 1;
+}
+
+const struct cpu_hash_algo* cpu_hash_find(const char *name)
+{
+	for (int i = 0; cpu_hash_algos[i].name; i++) {
+		if (!strcasecmp(name, cpu_hash_algos[i].name))
+			return &cpu_hash_algos[i];
+	}
+	return NULL;
+}
+
+/* entries of the -a algo, all with ALGO_AUTO */
+bool cpu_hash_match(const struct cpu_hash_algo *a, int algo)
+{
+	if (algo == ALGO_AUTO)
+		return true;
+	// -a monero/graft/stellite are parsed as cryptonight with a fork
+	if (algo == ALGO_CRYPTONIGHT) {
+		switch (a->algo) {
+		case ALGO_CRYPTONIGHT:
+		case ALGO_MONERO:
+		case ALGO_GRAFT:
+		case ALGO_STELLITE:
+			return true;
+		}
+	}
+	return a->algo == algo;
+}
+
+/* deterministic header used by the benchmark and the self tests */
+void cpu_hash_input(uint8_t *data, int len, uint32_t seed)
+{
+	for (int i = 0; i < len; i++)
+		data[i] = (uint8_t) ((i * 7 + 1) ^ (seed * 0x5b));
+	le32enc(&data[76], seed);
+}
+
+/* set the globals used by some hashes (scrypt nfactor) */
+void cpu_hash_prepare(const struct cpu_hash_algo *a)
+{
+	switch (a->algo) {
+	case ALGO_SCRYPT:
+	case ALGO_SCRYPT_JANE:
+		opt_nfactor = a->variant;
+		break;
+	}
+}
@@ -12,6 +12,8 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <string.h>
+#include <atomic>
+#include <vector>
 
 #ifdef _MSC_VER
 #include <emmintrin.h>
@@ -24,11 +26,18 @@
 #include "int128_c.h"
 #else
 #include <x86intrin.h>
+#include <sys/mman.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
 #endif
 
 #include <miner.h>
 
 #include "xmr-rpc.h"
+#include "sph/keccak-simd.h"
 
 extern uint64_t* pscratchpad_buff;
 
@@ -124,58 +133,6 @@ static inline uint64_t rotl64_1(uint64_t x, uint64_t y) { return((x << y) | (x >
 static inline uint64_t rotl64_2(uint64_t x, uint64_t y) { return(rotl64_1((x >> 32) | (x << 32), y)); }
 static inline uint64_t bitselect(uint64_t a, uint64_t b, uint64_t c) { return(a ^ (c & (b ^ a))); }
 
-static inline void keccakf_mul(uint64_t *s)
-{
-	uint64_t bc[5], t[5];
-	uint64_t tmp1, tmp2;
-	int i;
-
-	for(i = 0; i < 5; i++)
-		t[i] = s[i + 0] ^ s[i + 5] ^ s[i + 10] * s[i + 15] * s[i + 20];
-
-	bc[0] = t[0] ^ rotl641(t[2]);
-	bc[1] = t[1] ^ rotl641(t[3]);
-	bc[2] = t[2] ^ rotl641(t[4]);
-	bc[3] = t[3] ^ rotl641(t[0]);
-	bc[4] = t[4] ^ rotl641(t[1]);
-
-	tmp1 = s[1] ^ bc[0];
-
-	s[ 0] ^= bc[4];
-	s[ 1] = rotl64_1(s[ 6] ^ bc[0], 44);
-	s[ 6] = rotl64_1(s[ 9] ^ bc[3], 20);
-	s[ 9] = rotl64_1(s[22] ^ bc[1], 61);
-	s[22] = rotl64_1(s[14] ^ bc[3], 39);
-	s[14] = rotl64_1(s[20] ^ bc[4], 18);
-	s[20] = rotl64_1(s[ 2] ^ bc[1], 62);
-	s[ 2] = rotl64_1(s[12] ^ bc[1], 43);
-	s[12] = rotl64_1(s[13] ^ bc[2], 25);
-	s[13] = rotl64_1(s[19] ^ bc[3], 8);
-	s[19] = rotl64_1(s[23] ^ bc[2], 56);
-	s[23] = rotl64_1(s[15] ^ bc[4], 41);
-	s[15] = rotl64_1(s[ 4] ^ bc[3], 27);
-	s[ 4] = rotl64_1(s[24] ^ bc[3], 14);
-	s[24] = rotl64_1(s[21] ^ bc[0], 2);
-	s[21] = rotl64_1(s[ 8] ^ bc[2], 55);
-	s[ 8] = rotl64_1(s[16] ^ bc[0], 45);
-	s[16] = rotl64_1(s[ 5] ^ bc[4], 36);
-	s[ 5] = rotl64_1(s[ 3] ^ bc[2], 28);
-	s[ 3] = rotl64_1(s[18] ^ bc[2], 21);
-	s[18] = rotl64_1(s[17] ^ bc[1], 15);
-	s[17] = rotl64_1(s[11] ^ bc[0], 10);
-	s[11] = rotl64_1(s[ 7] ^ bc[1], 6);
-	s[ 7] = rotl64_1(s[10] ^ bc[4], 3);
-	s[10] = rotl64_1(tmp1, 1);
-
-	tmp1 = s[0]; tmp2 = s[1]; s[0] = bitselect(s[0] ^ s[2], s[0], s[1]); s[1] = bitselect(s[1] ^ s[3], s[1], s[2]); s[2] = bitselect(s[2] ^ s[4], s[2], s[3]); s[3] = bitselect(s[3] ^ tmp1, s[3], s[4]); s[4] = bitselect(s[4] ^ tmp2, s[4], tmp1);
-	tmp1 = s[5]; tmp2 = s[6]; s[5] = bitselect(s[5] ^ s[7], s[5], s[6]); s[6] = bitselect(s[6] ^ s[8], s[6], s[7]); s[7] = bitselect(s[7] ^ s[9], s[7], s[8]); s[8] = bitselect(s[8] ^ tmp1, s[8], s[9]); s[9] = bitselect(s[9] ^ tmp2, s[9], tmp1);
-	tmp1 = s[10]; tmp2 = s[11]; s[10] = bitselect(s[10] ^ s[12], s[10], s[11]); s[11] = bitselect(s[11] ^ s[13], s[11], s[12]); s[12] = bitselect(s[12] ^ s[14], s[12], s[13]); s[13] = bitselect(s[13] ^ tmp1, s[13], s[14]); s[14] = bitselect(s[14] ^ tmp2, s[14], tmp1);
-	tmp1 = s[15]; tmp2 = s[16]; s[15] = bitselect(s[15] ^ s[17], s[15], s[16]); s[16] = bitselect(s[16] ^ s[18], s[16], s[17]); s[17] = bitselect(s[17] ^ s[19], s[17], s[18]); s[18] = bitselect(s[18] ^ tmp1, s[18], s[19]); s[19] = bitselect(s[19] ^ tmp2, s[19], tmp1);
-	tmp1 = s[20]; tmp2 = s[21]; s[20] = bitselect(s[20] ^ s[22], s[20], s[21]); s[21] = bitselect(s[21] ^ s[23], s[21], s[22]); s[22] = bitselect(s[22] ^ s[24], s[22], s[23]); s[23] = bitselect(s[23] ^ tmp1, s[23], s[24]); s[24] = bitselect(s[24] ^ tmp2, s[24], tmp1);
-
-	s[0] ^= 0x0000000000000001ULL;
-}
-
 static inline void keccakf_mul_last(uint64_t *s)
 {
 	uint64_t bc[5], xormul[5];
@@ -201,176 +158,383 @@ static inline void keccakf_mul_last(uint64_t *s)
 	s[0] ^= 0x0000000000000001ULL;
 }
 
-struct reciprocal_value64 cached_recip;
-static uint64_t cached_scr_size = 0;
+#define KK_MIXIN_SIZE 24
+#define WK_LANES 16
+#define WK_CHUNK (WK_LANES * 16)
+#define WK_MAX_NODES 8
 
-static inline void scr_mix(uint64_t *st, uint64_t scr_size, struct reciprocal_value64 recip)
+int opt_wildkeccak_cpu = 0;
+
+struct wk_pad {
+	const uint64_t *buff;
+	uint64_t scr_size; /* 32 bytes entries */
+	struct reciprocal_value64 recip;
+};
+
+static void wk_pad_set(struct wk_pad *p, const uint64_t *buff, uint64_t words)
 {
-#define KK_MIXIN_SIZE 24
-	uint64_t _ALIGN(128) idx[KK_MIXIN_SIZE];
+	p->buff = buff;
+	p->scr_size = words >> 2;
+	p->recip = reciprocal_val64(p->scr_size);
+}
 
-#ifdef _MSC_VER
-	#define pscr pscratchpad_buff
-	int x;
+/* the entries mixed after this round, fetched while the other lanes run */
+static inline void wk_mix_prefetch(const uint64_t *st, uint64_t *idx, const struct wk_pad *p)
+{
+	for (int x = 0; x < KK_MIXIN_SIZE; x++) {
+		idx[x] = reciprocal_remainder64(st[x], p->scr_size, p->recip) << 2;
+		_mm_prefetch((const char*) &p->buff[idx[x]], _MM_HINT_T0);
+	}
+}
+
+static inline void wk_mix(uint64_t *st, const uint64_t *idx, const uint64_t *pscr)
+{
+	for (int x = 0; x < KK_MIXIN_SIZE; x += 4) {
+		for (int k = 0; k < 4; k++)
+			st[x + k] ^= pscr[idx[x] + k] ^ pscr[idx[x + 1] + k] ^ pscr[idx[x + 2] + k] ^ pscr[idx[x + 3] + k];
+	}
+}
 
-	// non-optimized 64bit operations
-	for (x = 0; x < KK_MIXIN_SIZE; x++) {
-		idx[x] = reciprocal_remainder64(st[x], scr_size, recip) << 2;
+/* 23 rounds + scratchpad mix then the last round, the lanes are interleaved */
+static void wk_lanes_pass(uint64_t (*st)[25], uint64_t (*idx)[KK_MIXIN_SIZE], int n, const struct wk_pad *p)
+{
+	int l, r;
+
+	for (l = 0; l < n; l++) {
+		keccakf1600_wild(st[l]);
+		wk_mix_prefetch(st[l], idx[l], p);
 	}
-	if (idx[7] > scr_size*4) {
-		applog(LOG_WARNING, "Wrong remainder64 returned by the cpu hash %016llx > %016llx",
-			(unsigned long long) idx[7], (unsigned long long) scr_size*4);
-		return;
+	for (r = 1; r < 23; r++) {
+		for (l = 0; l < n; l++) {
+			wk_mix(st[l], idx[l], p->buff);
+			keccakf1600_wild(st[l]);
+			wk_mix_prefetch(st[l], idx[l], p);
+		}
 	}
-	for(x = 0; x < KK_MIXIN_SIZE; x += 4) {
-		st[x + 0] ^= pscr[idx[x] + 0] ^ pscr[idx[x + 1] + 0] ^ pscr[idx[x + 2] + 0] ^ pscr[idx[x + 3] + 0];
-		st[x + 1] ^= pscr[idx[x] + 1] ^ pscr[idx[x + 1] + 1] ^ pscr[idx[x + 2] + 1] ^ pscr[idx[x + 3] + 1];
-		st[x + 2] ^= pscr[idx[x] + 2] ^ pscr[idx[x + 1] + 2] ^ pscr[idx[x + 2] + 2] ^ pscr[idx[x + 3] + 2];
-		st[x + 3] ^= pscr[idx[x] + 3] ^ pscr[idx[x + 1] + 3] ^ pscr[idx[x + 2] + 3] ^ pscr[idx[x + 3] + 3];
+	for (l = 0; l < n; l++) {
+		wk_mix(st[l], idx[l], p->buff);
+		keccakf_mul_last(st[l]);
 	}
-	return;
-
-#elif !defined(UNROLL_SCR_MIX)
-
-	#pragma GCC ivdep
-	for(int x = 0; x < 3; ++x)
-	{
-		__m128i *st0, *st1, *st2, *st3;
-
-		idx[0] = reciprocal_remainder64(st[(x << 3) + 0], scr_size, recip) << 2;
-		idx[1] = reciprocal_remainder64(st[(x << 3) + 1], scr_size, recip) << 2;
-		idx[2] = reciprocal_remainder64(st[(x << 3) + 2], scr_size, recip) << 2;
-		idx[3] = reciprocal_remainder64(st[(x << 3) + 3], scr_size, recip) << 2;
-		idx[4] = reciprocal_remainder64(st[(x << 3) + 4], scr_size, recip) << 2;
-		idx[5] = reciprocal_remainder64(st[(x << 3) + 5], scr_size, recip) << 2;
-		idx[6] = reciprocal_remainder64(st[(x << 3) + 6], scr_size, recip) << 2;
-		idx[7] = reciprocal_remainder64(st[(x << 3) + 7], scr_size, recip) << 2;
-
-		for(int y = 0; y < 8; y++) _mm_prefetch((const char*) (&pscratchpad_buff[idx[y]]), _MM_HINT_T1);
-
-		st0 = (__m128i *)&st[(x << 3) + 0];
-		st1 = (__m128i *)&st[(x << 3) + 2];
-		st2 = (__m128i *)&st[(x << 3) + 4];
-		st3 = (__m128i *)&st[(x << 3) + 6];
-
-		*st0 = _mm_xor_si128(*st0, *((__m128i *)&pscratchpad_buff[idx[0]]));
-		*st0 = _mm_xor_si128(*st0, *((__m128i *)&pscratchpad_buff[idx[1]]));
-		*st0 = _mm_xor_si128(*st0, *((__m128i *)&pscratchpad_buff[idx[2]]));
-		*st0 = _mm_xor_si128(*st0, *((__m128i *)&pscratchpad_buff[idx[3]]));
-
-		*st1 = _mm_xor_si128(*st1, *((__m128i *)&pscratchpad_buff[idx[0] + 2]));
-		*st1 = _mm_xor_si128(*st1, *((__m128i *)&pscratchpad_buff[idx[1] + 2]));
-		*st1 = _mm_xor_si128(*st1, *((__m128i *)&pscratchpad_buff[idx[2] + 2]));
-		*st1 = _mm_xor_si128(*st1, *((__m128i *)&pscratchpad_buff[idx[3] + 2]));
-
-		*st2 = _mm_xor_si128(*st2, *((__m128i *)&pscratchpad_buff[idx[4]]));
-		*st2 = _mm_xor_si128(*st2, *((__m128i *)&pscratchpad_buff[idx[5]]));
-		*st2 = _mm_xor_si128(*st2, *((__m128i *)&pscratchpad_buff[idx[6]]));
-		*st2 = _mm_xor_si128(*st2, *((__m128i *)&pscratchpad_buff[idx[7]]));
-
-		*st3 = _mm_xor_si128(*st3, *((__m128i *)&pscratchpad_buff[idx[4] + 2]));
-		*st3 = _mm_xor_si128(*st3, *((__m128i *)&pscratchpad_buff[idx[5] + 2]));
-		*st3 = _mm_xor_si128(*st3, *((__m128i *)&pscratchpad_buff[idx[6] + 2]));
-		*st3 = _mm_xor_si128(*st3, *((__m128i *)&pscratchpad_buff[idx[7] + 2]));
+}
+
+/* up to WK_LANES hashes, the nonces (if set) replace the bytes 1-4 of the input */
+static void wk_hash_lanes(uint8_t *md, const uint8_t *in, const uint32_t *nonces, int n, const struct wk_pad *p)
+{
+	uint64_t _ALIGN(32) st[WK_LANES][25];
+	uint64_t _ALIGN(32) idx[WK_LANES][KK_MIXIN_SIZE];
+	int l;
+
+	// Wild Keccak #1
+	for (l = 0; l < n; l++) {
+		memcpy(st[l], in, 88);
+		if (nonces)
+			st[l][0] = (st[l][0] & ~(0xFFFFFFFFULL << 8)) | ((uint64_t) nonces[l] << 8);
+		st[l][10] = (st[l][10] & 0x00000000000000FFULL) | 0x0000000000000100ULL;
+		memset(&st[l][11], 0, 112);
+		st[l][16] |= 0x8000000000000000ULL;
 	}
+	wk_lanes_pass(st, idx, n, p);
 
+	// Wild Keccak #2
+	for (l = 0; l < n; l++) {
+		memset(&st[l][4], 0x00, 168);
+		st[l][ 4] = 0x0000000000000001ULL;
+		st[l][16] = 0x8000000000000000ULL;
+	}
+	wk_lanes_pass(st, idx, n, p);
+
+	for (l = 0; l < n; l++)
+		memcpy(&md[32 * l], st[l], 32);
+}
+
+void wildkeccak_hash_n(void *output, const void *input, const uint32_t *nonces, int count,
+	const uint64_t *pad, uint64_t pad_words)
+{
+	struct wk_pad p;
+	uint8_t *md = (uint8_t*) output;
+
+	wk_pad_set(&p, pad, pad_words);
+	for (int i = 0; i < count; i += WK_LANES) {
+		wk_hash_lanes(&md[32 * i], (const uint8_t*) input, nonces ? &nonces[i] : NULL,
+			min(count - i, WK_LANES), &p);
+	}
+}
+
+void wildkeccak_hash(void* output, const void* input, uint64_t* scratchpad, uint64_t ssize)
+{
+	if (scratchpad) pscratchpad_buff = scratchpad;
+	if (!scratchpad_size) scratchpad_size = ssize;
+	wildkeccak_hash_n(output, input, NULL, 1, pscratchpad_buff, scratchpad_size);
+}
+
+/* scratchpad memory, 2MB pages when possible */
+
+#define WK_HUGE_SZ (2U << 20)
+
+uint64_t* wildkeccak_pad_alloc(size_t sz, bool populate)
+{
+#ifdef WIN32
+	return (uint64_t*) malloc(sz);
 #else
-	#warning using AVX2 optimizations
-
-	idx[ 0] = reciprocal_remainder64(st[0], scr_size, recip) << 2;
-	idx[ 1] = reciprocal_remainder64(st[1], scr_size, recip) << 2;
-	idx[ 2] = reciprocal_remainder64(st[2], scr_size, recip) << 2;
-	idx[ 3] = reciprocal_remainder64(st[3], scr_size, recip) << 2;
-	idx[ 4] = reciprocal_remainder64(st[4], scr_size, recip) << 2;
-	idx[ 5] = reciprocal_remainder64(st[5], scr_size, recip) << 2;
-	idx[ 6] = reciprocal_remainder64(st[6], scr_size, recip) << 2;
-	idx[ 7] = reciprocal_remainder64(st[7], scr_size, recip) << 2;
-
-	for(int y = 0; y < 8; y++) _mm_prefetch(&pscratchpad_buff[idx[y]], _MM_HINT_T1);
-
-	idx[ 8] = reciprocal_remainder64(st[8], scr_size, recip) << 2;
-	idx[ 9] = reciprocal_remainder64(st[9], scr_size, recip) << 2;
-	idx[10] = reciprocal_remainder64(st[10], scr_size, recip) << 2;
-	idx[11] = reciprocal_remainder64(st[11], scr_size, recip) << 2;
-	idx[12] = reciprocal_remainder64(st[12], scr_size, recip) << 2;
-	idx[13] = reciprocal_remainder64(st[13], scr_size, recip) << 2;
-	idx[14] = reciprocal_remainder64(st[14], scr_size, recip) << 2;
-	idx[15] = reciprocal_remainder64(st[15], scr_size, recip) << 2;
-
-	for(int y = 8; y < 16; ++y) _mm_prefetch(&pscratchpad_buff[idx[y]], _MM_HINT_T1);
-
-	idx[16] = reciprocal_remainder64(st[16], scr_size, recip) << 2;
-	idx[17] = reciprocal_remainder64(st[17], scr_size, recip) << 2;
-	idx[18] = reciprocal_remainder64(st[18], scr_size, recip) << 2;
-	idx[19] = reciprocal_remainder64(st[19], scr_size, recip) << 2;
-	idx[20] = reciprocal_remainder64(st[20], scr_size, recip) << 2;
-	idx[21] = reciprocal_remainder64(st[21], scr_size, recip) << 2;
-	idx[22] = reciprocal_remainder64(st[22], scr_size, recip) << 2;
-	idx[23] = reciprocal_remainder64(st[23], scr_size, recip) << 2;
-
-	for(int y = 16; y < 24; ++y) _mm_prefetch(&pscratchpad_buff[idx[y]], _MM_HINT_T1);
-
-	__m256i *st0 = (__m256i *)&st[0];
-
-	for(int x = 0; x < 6; ++x)
-	{
-		*st0 = _mm256_xor_si256(*st0, *((__m256i *)&pscratchpad_buff[idx[(x << 2) + 0]]));
-		*st0 = _mm256_xor_si256(*st0, *((__m256i *)&pscratchpad_buff[idx[(x << 2) + 1]]));
-		*st0 = _mm256_xor_si256(*st0, *((__m256i *)&pscratchpad_buff[idx[(x << 2) + 2]]));
-		*st0 = _mm256_xor_si256(*st0, *((__m256i *)&pscratchpad_buff[idx[(x << 2) + 3]]));
-		++st0;
+	void *ptr;
+	sz = (sz + WK_HUGE_SZ - 1) & ~((size_t) WK_HUGE_SZ - 1);
+#ifdef MAP_HUGETLB
+	// reserved hugetlb pages
+	ptr = mmap(0, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (populate ? MAP_POPULATE : 0), -1, 0);
+	if (ptr != MAP_FAILED) {
+		if (opt_debug) applog(LOG_DEBUG, "scratchpad: using hugetlb");
+		return (uint64_t*) ptr;
 	}
+#endif
+	// else a 2MB aligned mapping for the transparent huge pages
+	uint8_t *raw = (uint8_t*) mmap(0, sz + WK_HUGE_SZ, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED)
+		return NULL;
+	uint8_t *aligned = (uint8_t*) (((uintptr_t) raw + WK_HUGE_SZ - 1) & ~((uintptr_t) WK_HUGE_SZ - 1));
+	if (aligned > raw)
+		munmap(raw, aligned - raw);
+	munmap(aligned + sz, raw + WK_HUGE_SZ - aligned);
+#ifdef MADV_HUGEPAGE
+	madvise(aligned, sz, MADV_HUGEPAGE);
+#endif
+	madvise(aligned, sz, MADV_RANDOM);
+	if (populate)
+		memset(aligned, 0, sz);
+	return (uint64_t*) aligned;
+#endif
+}
 
+void wildkeccak_pad_free(uint64_t *pad, size_t sz)
+{
+	if (!pad) return;
+#ifdef WIN32
+	free(pad);
+#else
+	sz = (sz + WK_HUGE_SZ - 1) & ~((size_t) WK_HUGE_SZ - 1);
+	munmap(pad, sz);
 #endif
-	return;
 }
 
-static void wild_keccak_hash_dbl(uint8_t * __restrict md, const uint8_t * __restrict in)
+/* replicas of the scratchpad on each numa node, refreshed when it changes */
+
+static struct {
+	uint64_t *buff;
+	uint64_t words;
+	uint32_t gen;
+} wk_replica[WK_MAX_NODES];
+
+static volatile uint32_t wk_pad_gen = 1;
+static pthread_mutex_t wk_replica_lock = PTHREAD_MUTEX_INITIALIZER;
+static int wk_nodes = 0;
+
+void wildkeccak_cpu_pad_changed(void)
 {
-	uint64_t _ALIGN(32) st[25];
-	uint64_t scr_size, i;
-	struct reciprocal_value64 recip;
+	wk_pad_gen++;
+}
 
-	scr_size = scratchpad_size >> 2;
-	if (scr_size == cached_scr_size)
-		recip = cached_recip;
-	else {
-		cached_recip = recip = reciprocal_val64(scr_size);
-		cached_scr_size = scr_size;
-	}
+#ifdef __linux__
+static cpu_set_t wk_node_cpus[WK_MAX_NODES];
 
-	// Wild Keccak #1
-	memcpy(st, in, 88);
-	st[10] = (st[10] & 0x00000000000000FFULL) | 0x0000000000000100ULL;
-	memset(&st[11], 0, 112);
-	st[16] |= 0x8000000000000000ULL;
-
-	for(i = 0; i < 23; i++) {
-		keccakf_mul(st);
-		scr_mix(st, scr_size, recip);
+static void wk_numa_init(void)
+{
+	int n;
+	for (n = 0; n < WK_MAX_NODES; n++) {
+		char path[64];
+		int a, b, c;
+		snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", n);
+		FILE *fp = fopen(path, "r");
+		if (!fp) break;
+		CPU_ZERO(&wk_node_cpus[n]);
+		// "0-7,16-23"
+		while (fscanf(fp, "%d", &a) == 1) {
+			b = a;
+			c = fgetc(fp);
+			if (c == '-') {
+				if (fscanf(fp, "%d", &b) != 1) break;
+				c = fgetc(fp);
+			}
+			for (int i = a; i <= b && i < CPU_SETSIZE; i++)
+				CPU_SET(i, &wk_node_cpus[n]);
+			if (c != ',') break;
+		}
+		fclose(fp);
 	}
+	wk_nodes = max(n, 1);
+}
 
-	keccakf_mul_last(st);
+static int wk_numa_node(void)
+{
+	unsigned cpu = 0, node = 0;
+	if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0)
+		return 0;
+	return (int) node;
+}
 
-	// Wild Keccak #2
-	memset(&st[4], 0x00, 168);
-	st[ 4] = 0x0000000000000001ULL;
-	st[16] = 0x8000000000000000ULL;
+static void wk_numa_bind(int node)
+{
+	sched_setaffinity(0, sizeof(cpu_set_t), &wk_node_cpus[node]);
+}
+#else
+static void wk_numa_init(void) { wk_nodes = 1; }
+static int wk_numa_node(void) { return 0; }
+static void wk_numa_bind(int node) { }
+#endif
 
-	for(i = 0; i < 23; i++) {
-		keccakf_mul(st);
-		scr_mix(st, scr_size, recip);
+/* the scratchpad to use on this node, copied by a thread of the node */
+static const uint64_t* wk_node_pad(int node)
+{
+	const uint64_t *pad = pscratchpad_buff;
+	if (wk_nodes < 2 || node < 0 || node >= WK_MAX_NODES)
+		return pad;
+
+	pthread_mutex_lock(&wk_replica_lock);
+	if (!wk_replica[node].buff)
+		wk_replica[node].buff = wildkeccak_pad_alloc(WILD_KECCAK_SCRATCHPAD_BUFFSIZE, false);
+	if (wk_replica[node].buff) {
+		if (wk_replica[node].gen != wk_pad_gen || wk_replica[node].words != scratchpad_size) {
+			memcpy(wk_replica[node].buff, pscratchpad_buff, (size_t) scratchpad_size * 8);
+			wk_replica[node].words = scratchpad_size;
+			wk_replica[node].gen = wk_pad_gen;
+			if (opt_debug) applog(LOG_DEBUG, "scratchpad: node %d replica refreshed", node);
+		}
+		pad = wk_replica[node].buff;
 	}
+	pthread_mutex_unlock(&wk_replica_lock);
+	return pad;
+}
 
-	keccakf_mul_last(st);
+/* cpu scan (--cpu-wildkeccak=N) */
+
+struct wk_scan {
+	uint8_t data[88];
+	uint32_t target[8];
+	uint64_t words;
+	std::atomic<uint64_t> next;
+	std::atomic<uint64_t> done;
+	uint64_t end;
+	volatile bool found;
+	uint32_t nonce;
+	uint32_t hash[8];
+	int thr_id;
+	pthread_mutex_t lock;
+};
+
+struct wk_scan_arg {
+	pthread_t pth;
+	struct wk_scan *scan;
+	int id;
+};
 
-	memcpy(md, st, 32);
-	return;
+static void* wk_scan_thread(void *userdata)
+{
+	struct wk_scan_arg *arg = (struct wk_scan_arg*) userdata;
+	struct wk_scan *s = arg->scan;
+	uint32_t _ALIGN(64) hash[WK_LANES][8];
+	uint32_t nonces[WK_LANES];
+	struct wk_pad p;
+
+	// the caller keeps its affinity, the others are spread on the nodes
+	if (arg->id && wk_nodes > 1)
+		wk_numa_bind(arg->id % wk_nodes);
+	wk_pad_set(&p, wk_node_pad(wk_numa_node()), s->words);
+
+	while (!s->found && !work_restart[s->thr_id].restart) {
+		uint64_t n = s->next.fetch_add(WK_CHUNK);
+		if (n >= s->end)
+			break;
+		uint64_t end = min(n + WK_CHUNK, s->end);
+		for (; n < end && !s->found; n += WK_LANES) {
+			int count = (int) min((uint64_t) WK_LANES, end - n);
+			for (int l = 0; l < count; l++)
+				nonces[l] = (uint32_t) (n + l);
+			wk_hash_lanes((uint8_t*) hash, s->data, nonces, count, &p);
+			for (int l = 0; l < count; l++) {
+				if (((uint8_t*) hash[l])[31] || hash[l][7] > s->target[7] || !fulltest(hash[l], s->target))
+					continue;
+				pthread_mutex_lock(&s->lock);
+				if (!s->found) {
+					s->nonce = nonces[l];
+					memcpy(s->hash, hash[l], 32);
+					s->found = true;
+				}
+				pthread_mutex_unlock(&s->lock);
+			}
+			s->done += count;
+		}
+	}
+	return NULL;
 }
 
-void wildkeccak_hash(void* output, const void* input, uint64_t* scratchpad, uint64_t ssize)
+int scanhash_wildkeccak_cpu(int thr_id, struct work* work, uint32_t max_nonce, unsigned long *hashes_done)
 {
-	if (scratchpad) pscratchpad_buff = scratchpad;
-	if (!scratchpad_size) scratchpad_size = ssize;
-	wild_keccak_hash_dbl((uint8_t*)output, (uint8_t*)input);
+	uint8_t *pdata = (uint8_t*) work->data;
+	const int nthreads = max(opt_wildkeccak_cpu, 1);
+	std::vector<wk_scan_arg> args(nthreads);
+	struct wk_scan *s;
+	uint32_t first;
+	int started = 1;
+
+	if (!scratchpad_size || !pscratchpad_buff) {
+		work->data[0] = 0; // invalidate
+		sleep(1);
+		return -EBUSY;
+	}
+
+	pthread_mutex_lock(&wk_replica_lock);
+	if (!wk_nodes) {
+		wk_numa_init();
+		if (wk_nodes > 1)
+			gpulog(LOG_INFO, thr_id, "%d numa nodes, one scratchpad replica per node", wk_nodes);
+	}
+	pthread_mutex_unlock(&wk_replica_lock);
+
+	s = new wk_scan;
+	memcpy(&first, &pdata[1], 4);
+	memcpy(s->data, pdata, 88);
+	memcpy(s->target, work->target, 32);
+	s->words = scratchpad_size;
+	s->next = first;
+	s->done = 0;
+	s->end = (uint64_t) max_nonce + 1;
+	s->found = false;
+	s->thr_id = thr_id;
+	pthread_mutex_init(&s->lock, NULL);
+
+	// the caller is the thread 0
+	for (int i = 0; i < nthreads; i++) {
+		args[i].scan = s;
+		args[i].id = i;
+	}
+	for (int i = 1; i < nthreads; i++) {
+		if (pthread_create(&args[i].pth, NULL, wk_scan_thread, &args[i]))
+			break;
+		started++;
+	}
+	wk_scan_thread(&args[0]);
+	for (int i = 1; i < started; i++)
+		pthread_join(args[i].pth, NULL);
+
+	*hashes_done = (unsigned long) s->done;
+	int rc = 0;
+	if (s->found) {
+		uint32_t _ALIGN(64) vhash[8];
+		uint64_t nonce64;
+		memcpy(&pdata[1], &s->nonce, sizeof(uint32_t));
+		memcpy(&nonce64, &pdata[1], 8);
+		// check it against the master scratchpad, a node replica could be stale
+		vstats_hash(thr_id, wildkeccak_hash(vhash, pdata, pscratchpad_buff, scratchpad_size));
+		if (!memcmp(vhash, s->hash, 32)) {
+			memcpy(work->nonces, &nonce64, 8);
+			work_set_target_ratio(work, vhash);
+			work->valid_nonces = 1;
+			rc = 1;
+		} else {
+			gpu_increment_reject(thr_id);
+			if (!opt_quiet)
+				gpulog(LOG_WARNING, thr_id, "result for nonce %08x does not validate!", s->nonce);
+		}
+	}
+	pthread_mutex_destroy(&s->lock);
+	delete s;
+	return rc;
 }
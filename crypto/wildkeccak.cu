@@ -239,6 +239,9 @@ extern "C" int scanhash_wildkeccak(int thr_id, struct work* work, uint32_t max_n
 	memcpy(&first, &pdata[1], 8);
 	n = nonce = first;
 
+	if (opt_wildkeccak_cpu)
+		return scanhash_wildkeccak_cpu(thr_id, work, max_nonce, hashes_done);
+
 	if (!scratchpad_size || !h_scratchpad[thr_id]) {
 		if (h_scratchpad[thr_id])
 			applog(LOG_ERR, "Scratchpad size is not set!");
@@ -316,7 +319,7 @@ extern "C" int scanhash_wildkeccak(int thr_id, struct work* work, uint32_t max_n
 			uint64_t nonce64;
 			memcpy(&pdata[1], &h_retnonce[0], sizeof(uint32_t));
 			memcpy(&nonce64, &pdata[1], 8);
-			wildkeccak_hash(cpuhash, pdata, pscratchpad_buff, scratchpad_size);
+			vstats_hash(thr_id, wildkeccak_hash(cpuhash, pdata, pscratchpad_buff, scratchpad_size));
 			if (!cpuhash[31] && vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 				work_set_target_ratio(work, vhash);
 				//applog_hex(pdata,   84);
@@ -8,3 +8,6 @@ extern uint32_t WK_CUDABlocks, WK_CUDAThreads;
 
 void wildkeccak_scratchpad_need_update(uint64_t* pscratchpad_buff);
 
+// the cpu replicas are refreshed on the next scan
+void wildkeccak_cpu_pad_changed(void);
+
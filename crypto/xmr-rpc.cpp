@@ -83,6 +83,7 @@ static struct addendums_array_entry add_arr[WILD_KECCAK_ADDENDUMS_ARRAY_SIZE];
 static char *rpc2_job_id = NULL;
 static char *rpc2_blob = NULL;
 static uint32_t rpc2_target = 0;
+static double rpc2_diff = 0.;
 static size_t rpc2_bloblen = 0;
 static struct work rpc2_work;
 
@@ -181,6 +182,7 @@ static void reset_scratchpad(void)
 {
 	current_scratchpad_hi.height = 0;
 	scratchpad_size = 0;
+	wildkeccak_cpu_pad_changed();
 	//unlink(scratchpad_file);
 }
 
@@ -210,6 +212,7 @@ static bool apply_addendum(uint64_t* padd_buff, size_t count/*uint64 units*/)
 		pscratchpad_buff[scratchpad_size+k] = padd_buff[k];
 
 	scratchpad_size += count;
+	wildkeccak_cpu_pad_changed();
 
 	return true;
 }
@@ -226,6 +229,7 @@ static bool pop_addendum(struct addendums_array_entry* entry)
 	patch_scratchpad_with_addendum(scratchpad_size - entry->add_size, &pscratchpad_buff[scratchpad_size - entry->add_size], (size_t) entry->add_size);
 	scratchpad_size = scratchpad_size - entry->add_size;
 	memcpy(&current_scratchpad_hi, &entry->prev_hi, sizeof(entry->prev_hi));
+	wildkeccak_cpu_pad_changed();
 
 	memset(entry, 0, sizeof(struct addendums_array_entry));
 	return true;
@@ -446,13 +450,13 @@ bool rpc2_job_decode(const json_t *job, struct work *work)
 		jobj_binary(job, "target", &target, 4);
 		if(rpc2_target != target) {
 			double difficulty = (((double) UINT32_MAX) / target);
-			stratum.job.diff = difficulty;
+			rpc2_diff = difficulty;
 			rpc2_target = target;
 		}
 
 		if (rpc2_job_id) {
 			// reset job share counter
-			if (strcmp(rpc2_job_id, job_id)) stratum.job.shares_count = 0;
+			if (strcmp(rpc2_job_id, job_id)) stratum.shares_count = 0;
 			free(rpc2_job_id);
 		}
 		rpc2_job_id = strdup(job_id);
@@ -501,9 +505,9 @@ bool rpc2_stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 {
 //	pthread_mutex_lock(&rpc2_work_lock);
 	memcpy(work, &rpc2_work, sizeof(struct work));
-	if (stratum_diff != sctx->job.diff) {
+	if (stratum_diff != rpc2_diff) {
 		char sdiff[32] = { 0 };
-		stratum_diff = sctx->job.diff;
+		stratum_diff = rpc2_diff;
 		if (opt_showdiff && work->targetdiff != stratum_diff)
 			snprintf(sdiff, 32, " (%g)", work->targetdiff);
 		if (stratum_diff >= 1e6)
@@ -577,7 +581,7 @@ bool rpc2_stratum_submit(struct pool_infos *pool, struct work *work)
 
 	snprintf(s, sizeof(s), "{\"method\":\"submit\",\"params\":"
 		"{\"id\":\"%s\",\"job_id\":\"%s\",\"nonce\":\"%s\",\"result\":\"%s\"}, \"id\":%u}",
-		rpc2_id, work->job_id, noncestr, hashhex, stratum.job.shares_count + 10);
+		rpc2_id, work->job_id, noncestr, hashhex, stratum.shares_count + 10);
 
 	free(hashhex);
 	free(noncestr);
@@ -737,6 +741,7 @@ bool load_scratchpad_from_file(const char *fname)
 	scratchpad_size = fh.scratchpad_size;
 	current_scratchpad_hi = fh.current_hi;
 	memcpy(&add_arr[0], &fh.add_arr[0], sizeof(fh.add_arr));
+	wildkeccak_cpu_pad_changed();
 	flen = (long)scratchpad_size*8;
 
 	if (!opt_quiet) {
@@ -912,19 +917,12 @@ void GetScratchpad()
 	if (!opt_quiet)
 		applog(LOG_INFO, "Scratchpad file %s", pscratchpad_local_cache);
 
-	pscratchpad_buff = (uint64_t*) mmap(0, sz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, 0, 0);
-	if(pscratchpad_buff == MAP_FAILED)
-	{
-		if(opt_debug) applog(LOG_DEBUG, "hugetlb not available");
-		pscratchpad_buff = (uint64_t*) malloc(sz);
-		if(!pscratchpad_buff) {
-			applog(LOG_ERR, "Scratchpad allocation failed");
-			exit(1);
-		}
-	} else {
-		if(opt_debug) applog(LOG_DEBUG, "using hugetlb");
+	// hugetlb or transparent huge pages (the madvise flags are not a mask)
+	pscratchpad_buff = wildkeccak_pad_alloc(sz, true);
+	if(!pscratchpad_buff) {
+		applog(LOG_ERR, "Scratchpad allocation failed");
+		exit(1);
 	}
-	madvise(pscratchpad_buff, sz, MADV_RANDOM | MADV_WILLNEED | MADV_HUGEPAGE);
 	mlock(pscratchpad_buff, sz);
 
 	if(!load_scratchpad_from_file(pscratchpad_local_cache))
@@ -1080,6 +1078,7 @@ static bool rpc2_getfullscratchpad_decode(const json_t *val)
 
 	applog(LOG_INFO, "Fetched scratchpad size %d bytes", len);
 	scratchpad_size = len/8;
+	wildkeccak_cpu_pad_changed();
 
 	return true;
 
@@ -33,6 +33,8 @@ int cuda_num_devices()
 		applog(LOG_ERR, "Unable to query CUDA driver version! Is an nVidia driver installed?");
 		exit(1);
 	}
+	if (!version) // no driver, the cpu solvers could still be used
+		return 0;
 
 	if (version < CUDART_VERSION) {
 		applog(LOG_ERR, "Your system does not support CUDA %d.%d API!",
@@ -41,6 +43,8 @@ int cuda_num_devices()
 	}
 
 	err = cudaGetDeviceCount(&GPU_N);
+	if (err == cudaErrorNoDevice)
+		return 0;
 	if (err != cudaSuccess) {
 		applog(LOG_ERR, "Unable to query number of CUDA devices! Is an nVidia driver installed?");
 		exit(1);
@@ -58,6 +62,8 @@ void cuda_devicenames()
 	cudaError_t err;
 	int GPU_N;
 	err = cudaGetDeviceCount(&GPU_N);
+	if ((err == cudaSuccess && !GPU_N) || (err != cudaSuccess && !cuda_num_devices()))
+		return; // no device, main() checks if a cpu solver can be used
 	if (err != cudaSuccess)
 	{
 		applog(LOG_ERR, "Unable to query number of CUDA devices! Is an nVidia driver installed?");
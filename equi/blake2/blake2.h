@@ -17,6 +17,8 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "sph/blake2-simd.h"
+
 #if defined(_MSC_VER)
 #define ALIGN(x) __declspec(align(x))
 #else
@@ -69,6 +71,9 @@ extern "C" {
   int eq_blake2b_update( blake2b_state *S, const uint8_t *in, uint64_t inlen );
   int eq_blake2b_final( blake2b_state *S, uint8_t *out, uint8_t outlen );
 
+  // the 4 bytes appended to S (equihash index) become the midstate nonce
+  int eq_blake2b_midstate( const blake2b_state *S, blake2b_midstate *mid, const uint8_t outlen );
+
   // Simple API
   int eq_blake2b( uint8_t *out, const void *in, const void *key, const uint8_t outlen, const uint64_t inlen, uint8_t keylen );
 
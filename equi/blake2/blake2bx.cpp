@@ -19,28 +19,6 @@
 #include "blake2.h"
 #include "blake2-impl.h"
 
-#include "blake2-config.h"
-
-#ifdef WIN32
-#include <intrin.h>
-#endif
-
-#include <emmintrin.h>
-#if defined(HAVE_SSSE3)
-#include <tmmintrin.h>
-#endif
-#if defined(HAVE_SSE41)
-#include <smmintrin.h>
-#endif
-#if defined(HAVE_AVX)
-#include <immintrin.h>
-#endif
-#if defined(HAVE_XOP)
-#include <x86intrin.h>
-#endif
-
-#include "blake2b-round.h"
-
 ALIGN(64) static const uint64_t blake2b_IV[8] = {
 	0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
 	0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
@@ -121,71 +99,7 @@ int eq_blake2b_init_key(blake2b_state *S, const uint8_t outlen, const void *key,
 
 static inline int blake2b_compress(blake2b_state *S, const uint8_t block[BLAKE2B_BLOCKBYTES])
 {
-	__m128i row1l, row1h;
-	__m128i row2l, row2h;
-	__m128i row3l, row3h;
-	__m128i row4l, row4h;
-	__m128i b0, b1;
-	__m128i t0, t1;
-#if defined(HAVE_SSSE3) && !defined(HAVE_XOP)
-	const __m128i r16 = _mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
-	const __m128i r24 = _mm_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
-#endif
-#if defined(HAVE_SSE41)
-	const __m128i m0 = LOADU(block + 00);
-	const __m128i m1 = LOADU(block + 16);
-	const __m128i m2 = LOADU(block + 32);
-	const __m128i m3 = LOADU(block + 48);
-	const __m128i m4 = LOADU(block + 64);
-	const __m128i m5 = LOADU(block + 80);
-	const __m128i m6 = LOADU(block + 96);
-	const __m128i m7 = LOADU(block + 112);
-#else
-	const uint64_t  m0 = ( ( uint64_t * )block )[ 0];
-	const uint64_t  m1 = ( ( uint64_t * )block )[ 1];
-	const uint64_t  m2 = ( ( uint64_t * )block )[ 2];
-	const uint64_t  m3 = ( ( uint64_t * )block )[ 3];
-	const uint64_t  m4 = ( ( uint64_t * )block )[ 4];
-	const uint64_t  m5 = ( ( uint64_t * )block )[ 5];
-	const uint64_t  m6 = ( ( uint64_t * )block )[ 6];
-	const uint64_t  m7 = ( ( uint64_t * )block )[ 7];
-	const uint64_t  m8 = ( ( uint64_t * )block )[ 8];
-	const uint64_t  m9 = ( ( uint64_t * )block )[ 9];
-	const uint64_t m10 = ( ( uint64_t * )block )[10];
-	const uint64_t m11 = ( ( uint64_t * )block )[11];
-	const uint64_t m12 = ( ( uint64_t * )block )[12];
-	const uint64_t m13 = ( ( uint64_t * )block )[13];
-	const uint64_t m14 = ( ( uint64_t * )block )[14];
-	const uint64_t m15 = ( ( uint64_t * )block )[15];
-#endif
-	row1l = LOADU(&S->h[0]);
-	row1h = LOADU(&S->h[2]);
-	row2l = LOADU(&S->h[4]);
-	row2h = LOADU(&S->h[6]);
-	row3l = LOADU(&blake2b_IV[0]);
-	row3h = LOADU(&blake2b_IV[2]);
-	row4l = _mm_xor_si128(LOADU(&blake2b_IV[4]), _mm_set_epi32(0, 0, 0, S->counter));
-	row4h = _mm_xor_si128(LOADU(&blake2b_IV[6]), _mm_set_epi32(0, 0, 0L - S->lastblock, 0L - S->lastblock));
-	ROUND(0);
-	ROUND(1);
-	ROUND(2);
-	ROUND(3);
-	ROUND(4);
-	ROUND(5);
-	ROUND(6);
-	ROUND(7);
-	ROUND(8);
-	ROUND(9);
-	ROUND(10);
-	ROUND(11);
-	row1l = _mm_xor_si128(row3l, row1l);
-	row1h = _mm_xor_si128(row3h, row1h);
-	STOREU(&S->h[0], _mm_xor_si128(LOADU(&S->h[0]), row1l));
-	STOREU(&S->h[2], _mm_xor_si128(LOADU(&S->h[2]), row1h));
-	row2l = _mm_xor_si128(row4l, row2l);
-	row2h = _mm_xor_si128(row4h, row2h);
-	STOREU(&S->h[4], _mm_xor_si128(LOADU(&S->h[4]), row2l));
-	STOREU(&S->h[6], _mm_xor_si128(LOADU(&S->h[6]), row2h));
+	blake2b_compress_x(S->h, block, S->counter, 0, S->lastblock ? ~0ULL : 0);
 	return 0;
 }
 
@@ -239,9 +153,22 @@ int eq_blake2b_final(blake2b_state *S, uint8_t *out, uint8_t outlen)
 	return 0;
 }
 
+int eq_blake2b_midstate(const blake2b_state *S, blake2b_midstate *mid, const uint8_t outlen)
+{
+	uint8_t tail[BLAKE2B_BLOCKBYTES];
+	const size_t len = (size_t) S->buflen + 4;
+
+	if (len > BLAKE2B_BLOCKBYTES)
+		return -1;
+
+	memcpy(tail, S->buf, S->buflen);
+	memset(&tail[S->buflen], 0, 4);
+	return blake2b_mid_set(mid, S->h, S->counter, tail, len, S->buflen, outlen);
+}
+
 int eq_blake2b(uint8_t *out, const void *in, const void *key, const uint8_t outlen, const uint64_t inlen, uint8_t keylen)
 {
-	blake2b_state S[1];
+	blake2b_state S;
 
 	/* Verify parameters */
 	if (!in || !out) return -1;
@@ -249,14 +176,14 @@ int eq_blake2b(uint8_t *out, const void *in, const void *key, const uint8_t outl
 
 	if (keylen)
 	{
-		if (eq_blake2b_init_key(S, outlen, key, keylen) < 0) return -1;
+		if (eq_blake2b_init_key(&S, outlen, key, keylen) < 0) return -1;
 	}
 	else
 	{
-		if (eq_blake2b_init(S, outlen) < 0) return -1;
+		if (eq_blake2b_init(&S, outlen) < 0) return -1;
 	}
 
-	eq_blake2b_update(S, (const uint8_t *)in, inlen);
-	eq_blake2b_final(S, out, outlen);
+	eq_blake2b_update(&S, (const uint8_t *)in, inlen);
+	eq_blake2b_final(&S, out, outlen);
 	return 0;
 }
@@ -111,6 +111,29 @@ public:
 
 // ---------------------------------------------------------------------------------------------------
 
+// cpu solver, same interface (equi-cpu.cpp)
+struct eq_cpu_mem;
+
+class eq_cpu_context : public eq_cuda_context_interface
+{
+	eq_cpu_mem* mem;
+	int nthreads;
+
+	void solve(const char *tequihash_header,
+		unsigned int tequihash_header_len,
+		const char* nonce,
+		unsigned int nonce_len,
+		fn_cancel cancelf,
+		fn_solution solutionf,
+		fn_hashdone hashdonef);
+public:
+	eq_cpu_context(int thr_id, int threads);
+	void freemem();
+	~eq_cpu_context();
+};
+
+// ---------------------------------------------------------------------------------------------------
+
 template <u32 RB, u32 SM, u32 SSM, u32 THREADS, typename PACKER>
 class eq_cuda_context : public eq_cuda_context_interface
 {
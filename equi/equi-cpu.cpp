@@ -0,0 +1,461 @@
+/**
+ * Equihash 200,9 cpu solver (--cpu-equihash=N), Wagner algorithm
+ *
+ * The 2^21 hashes are bucket sorted on the 12 high bits of the digit to
+ * collide, the 8 other bits are matched inside each bucket. A slot keeps
+ * the remaining hash bits, left aligned (the stride decreases with each
+ * round), and a 32 bits tree node: the leaf index or the bucket and the
+ * two slots of the previous round, the indices are only rebuilt for the
+ * solutions. The buckets are shared by N threads, one barrier per round.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <vector>
+
+#include "eqcuda.hpp"
+#include "equihash.h"
+#include "blake2/blake2.h"
+
+#include <miner.h>
+
+#ifdef __APPLE__
+#include "compat/pthreads/pthread_barrier.hpp"
+#endif
+
+#define EQ_HASHOUT   50 /* blake2b output, 2 hashes of 200 bits */
+#define EQ_DIGITBITS (WN / (WK + 1))
+#define EQ_NBLAKES   (1U << EQ_DIGITBITS) /* 2^21 indices, 2 per hash */
+#define EQ_BUCKBITS  12
+#define EQ_NBUCKETS  (1 << EQ_BUCKBITS)
+#define EQ_RESTBITS  (EQ_DIGITBITS - EQ_BUCKBITS)
+#define EQ_NRESTS    (1 << EQ_RESTBITS)
+#define EQ_NSLOTS    640 /* 512 expected per bucket, max 1024 (tree node) */
+#define EQ_BINSLOTS  16  /* same rest in a bucket, 2 expected */
+#define EQ_PROOFSIZE (1 << WK)
+#define EQ_SOLSIZE   1344
+#define EQ_MAXSOLS   MAXREALSOLS
+
+int opt_equihash_cpu = 0;
+
+// u32 words of the hash bits left after each round
+static const int eq_words[WK] = { 7, 6, 5, 5, 4, 4, 3, 2, 2 };
+
+struct eq_cpu_mem {
+	uint32_t *heap[2];
+	uint32_t *tree[WK];
+	std::atomic<uint32_t> count[2][EQ_NBUCKETS];
+	blake2b_state blake;
+	blake2b_midstate mid;
+	bool use_mid;
+	pthread_barrier_t barrier;
+	pthread_mutex_t lock;
+	int nthreads;
+	int thr_id;
+	fn_cancel cancelf;
+	volatile bool cancel;
+	int nsols;
+	uint32_t sols[EQ_MAXSOLS][EQ_PROOFSIZE];
+};
+
+struct eq_cpu_arg {
+	pthread_t pth;
+	eq_cpu_mem *mem;
+	int id;
+};
+
+static inline uint32_t eq_node(uint32_t bucket, uint32_t s0, uint32_t s1)
+{
+	return (bucket << 20) | (s0 << 10) | s1;
+}
+
+static inline void eq_digit_store(eq_cpu_mem *m, uint32_t g, const uint8_t *hash)
+{
+	uint32_t *heap = m->heap[0];
+	for (uint32_t h = 0; h < 2; h++) {
+		const uint8_t *p = &hash[h * EQ_HASHOUT / 2];
+		uint32_t bucket = ((uint32_t) p[0] << 4) | (p[1] >> 4);
+		uint32_t s = m->count[0][bucket].fetch_add(1, std::memory_order_relaxed);
+		if (s >= EQ_NSLOTS)
+			continue;
+		uint32_t slot = bucket * EQ_NSLOTS + s;
+		uint32_t *w = &heap[slot * eq_words[0]];
+		for (int i = 0; i < 6; i++)
+			w[i] = be32dec(&p[i * 4]);
+		w[6] = (uint32_t) p[24] << 24;
+		m->tree[0][slot] = g * 2 + h;
+	}
+}
+
+// first digit: the blake2b hashes of the indices, split between the threads
+static void eq_digit_first(eq_cpu_mem *m, int id)
+{
+	const uint32_t first = (uint32_t) ((uint64_t) EQ_NBLAKES * id / m->nthreads);
+	const uint32_t last = (uint32_t) ((uint64_t) EQ_NBLAKES * (id + 1) / m->nthreads);
+	uint8_t _ALIGN(32) hash[4 * 64];
+	uint32_t g = first;
+
+	// only the index block is compressed, 4 indices at once with AVX2
+	if (m->use_mid) {
+		uint32_t idx[4];
+		for (; g + 4 <= last; g += 4) {
+			for (uint32_t l = 0; l < 4; l++)
+				idx[l] = g + l;
+			blake2b_mid_hash4(&m->mid, hash, idx);
+			for (uint32_t l = 0; l < 4; l++)
+				eq_digit_store(m, g + l, &hash[l * 64]);
+		}
+	}
+	for (; g < last; g++) {
+		blake2b_state ctx = m->blake;
+		uint8_t le[4];
+		le32enc(le, g);
+		eq_blake2b_update(&ctx, le, 4);
+		eq_blake2b_final(&ctx, hash, EQ_HASHOUT);
+		eq_digit_store(m, g, hash);
+	}
+}
+
+// collide the items of round r on their first digit
+static void eq_digit(eq_cpu_mem *m, int r, int id)
+{
+	const int sw = eq_words[r], dw = eq_words[r + 1];
+	const uint32_t *src = m->heap[r & 1];
+	uint32_t *dst = m->heap[(r + 1) & 1];
+	uint32_t *tree = m->tree[r + 1];
+	std::atomic<uint32_t> *dcount = m->count[(r + 1) & 1];
+	uint8_t bincount[EQ_NRESTS];
+	uint16_t bins[EQ_NRESTS][EQ_BINSLOTS];
+
+	for (uint32_t b = id; b < EQ_NBUCKETS; b += m->nthreads) {
+		uint32_t cnt = min(m->count[r & 1][b].load(std::memory_order_relaxed), (uint32_t) EQ_NSLOTS);
+		const uint32_t *base = &src[b * EQ_NSLOTS * sw];
+		m->count[r & 1][b].store(0, std::memory_order_relaxed); // for the round r+2
+		memset(bincount, 0, sizeof(bincount));
+		for (uint32_t s1 = 0; s1 < cnt; s1++) {
+			const uint32_t *h1 = &base[s1 * sw];
+			uint32_t rest = (h1[0] >> (32 - EQ_DIGITBITS)) & (EQ_NRESTS - 1);
+			uint32_t nb = bincount[rest];
+			for (uint32_t k = 0; k < nb; k++) {
+				uint32_t s0 = bins[rest][k];
+				const uint32_t *h0 = &base[s0 * sw];
+				uint32_t x[8], y[8], any = 0;
+				for (int i = 0; i < sw; i++)
+					x[i] = h0[i] ^ h1[i];
+				x[sw] = 0;
+				for (int i = 0; i < dw; i++) {
+					y[i] = (x[i] << EQ_DIGITBITS) | (x[i + 1] >> (32 - EQ_DIGITBITS));
+					any |= y[i];
+				}
+				// same hashes, only duplicated indices to expect
+				if (!any)
+					continue;
+				uint32_t bucket = y[0] >> (32 - EQ_BUCKBITS);
+				uint32_t s = dcount[bucket].fetch_add(1, std::memory_order_relaxed);
+				if (s >= EQ_NSLOTS)
+					continue;
+				uint32_t slot = bucket * EQ_NSLOTS + s;
+				memcpy(&dst[slot * dw], y, dw * sizeof(uint32_t));
+				tree[slot] = eq_node(b, s0, s1);
+			}
+			if (nb < EQ_BINSLOTS) {
+				bins[rest][nb] = (uint16_t) s1;
+				bincount[rest] = (uint8_t) (nb + 1);
+			}
+		}
+	}
+}
+
+// indices of a node of round r, in the order required by the consensus
+static void eq_indices(const eq_cpu_mem *m, int r, uint32_t node, uint32_t *out)
+{
+	if (r == 0) {
+		out[0] = node;
+		return;
+	}
+	const uint32_t size = 1U << (r - 1);
+	const uint32_t *tree = m->tree[r - 1];
+	const uint32_t bucket = node >> 20;
+	eq_indices(m, r - 1, tree[bucket * EQ_NSLOTS + ((node >> 10) & 0x3ff)], out);
+	eq_indices(m, r - 1, tree[bucket * EQ_NSLOTS + (node & 0x3ff)], out + size);
+	if (out[0] > out[size])
+		std::swap_ranges(out, out + size, out + size);
+}
+
+static void eq_candidate(eq_cpu_mem *m, uint32_t node)
+{
+	uint32_t sol[EQ_PROOFSIZE], sorted[EQ_PROOFSIZE];
+
+	eq_indices(m, WK, node, sol);
+	memcpy(sorted, sol, sizeof(sorted));
+	std::sort(sorted, sorted + EQ_PROOFSIZE);
+	for (int i = 1; i < EQ_PROOFSIZE; i++)
+		if (sorted[i] == sorted[i - 1])
+			return;
+
+	pthread_mutex_lock(&m->lock);
+	if (m->nsols < EQ_MAXSOLS)
+		memcpy(m->sols[m->nsols++], sol, sizeof(sol));
+	pthread_mutex_unlock(&m->lock);
+}
+
+// last round, the 2 remaining digits have to collide
+static void eq_digit_last(eq_cpu_mem *m, int id)
+{
+	const int r = WK - 1, sw = eq_words[r];
+	const uint32_t *src = m->heap[r & 1];
+	uint8_t bincount[EQ_NRESTS];
+	uint16_t bins[EQ_NRESTS][EQ_BINSLOTS];
+
+	for (uint32_t b = id; b < EQ_NBUCKETS; b += m->nthreads) {
+		uint32_t cnt = min(m->count[r & 1][b].load(std::memory_order_relaxed), (uint32_t) EQ_NSLOTS);
+		const uint32_t *base = &src[b * EQ_NSLOTS * sw];
+		memset(bincount, 0, sizeof(bincount));
+		for (uint32_t s1 = 0; s1 < cnt; s1++) {
+			const uint32_t *h1 = &base[s1 * sw];
+			uint32_t rest = (h1[0] >> (32 - EQ_DIGITBITS)) & (EQ_NRESTS - 1);
+			uint32_t nb = bincount[rest];
+			for (uint32_t k = 0; k < nb; k++) {
+				uint32_t s0 = bins[rest][k];
+				const uint32_t *h0 = &base[s0 * sw];
+				if (h0[0] == h1[0] && h0[1] == h1[1])
+					eq_candidate(m, eq_node(b, s0, s1));
+			}
+			if (nb < EQ_BINSLOTS) {
+				bins[rest][nb] = (uint16_t) s1;
+				bincount[rest] = (uint8_t) (nb + 1);
+			}
+		}
+	}
+}
+
+static void *eq_cpu_thread(void *userdata)
+{
+	eq_cpu_arg *arg = (eq_cpu_arg*) userdata;
+	eq_cpu_mem *m = arg->mem;
+	const int id = arg->id;
+
+	eq_digit_first(m, id);
+	for (int r = 0; r < WK - 1; r++) {
+		if (id == 0 && m->cancelf && m->cancelf(m->thr_id))
+			m->cancel = true;
+		pthread_barrier_wait(&m->barrier);
+		if (m->cancel)
+			return NULL;
+		eq_digit(m, r, id);
+	}
+	pthread_barrier_wait(&m->barrier);
+	eq_digit_last(m, id);
+	return NULL;
+}
+
+static void eq_cpu_setheader(blake2b_state *ctx, const char *header, const u32 headerLen,
+	const char* nce, const u32 nonceLen)
+{
+	uint32_t le_N = WN;
+	uint32_t le_K = WK;
+	uchar personal[] = "ZcashPoW01230123";
+	memcpy(personal + 8, &le_N, 4);
+	memcpy(personal + 12, &le_K, 4);
+	blake2b_param P[1];
+	P->digest_length = EQ_HASHOUT;
+	P->key_length = 0;
+	P->fanout = 1;
+	P->depth = 1;
+	P->leaf_length = 0;
+	P->node_offset = 0;
+	P->node_depth = 0;
+	P->inner_length = 0;
+	memset(P->reserved, 0, sizeof(P->reserved));
+	memset(P->salt, 0, sizeof(P->salt));
+	memcpy(P->personal, (const uint8_t *)personal, 16);
+	eq_blake2b_init_param(ctx, P);
+	eq_blake2b_update(ctx, (const uchar *)header, headerLen);
+	if (nonceLen) eq_blake2b_update(ctx, (const uchar *)nce, nonceLen);
+}
+
+eq_cpu_context::eq_cpu_context(int thr_id, int threads)
+{
+	thread_id = thr_id;
+	device_id = -1;
+	nthreads = threads > 0 ? threads : 1;
+	throughput = nthreads;
+	totalblocks = threadsperblock = threadsperblock_digits = 0;
+
+	// aligned for the blake2b state
+	void *ptr = aligned_calloc(sizeof(eq_cpu_mem));
+	if (!ptr)
+		throw std::runtime_error("EOM: failed to alloc the cpu solver memory");
+	mem = new (ptr) eq_cpu_mem;
+	memset(mem->heap, 0, sizeof(mem->heap));
+	memset(mem->tree, 0, sizeof(mem->tree));
+	mem->nthreads = nthreads;
+	pthread_barrier_init(&mem->barrier, NULL, nthreads);
+	pthread_mutex_init(&mem->lock, NULL);
+
+	const size_t slots = (size_t) EQ_NBUCKETS * EQ_NSLOTS;
+	bool ok = true;
+	equi_mem_sz = 0;
+	for (int i = 0; i < 2; i++) {
+		mem->heap[i] = (uint32_t*) aligned_calloc((int) (slots * eq_words[i] * sizeof(uint32_t)));
+		equi_mem_sz += slots * eq_words[i] * sizeof(uint32_t);
+		ok = ok && mem->heap[i];
+	}
+	for (int r = 0; r < WK; r++) {
+		mem->tree[r] = (uint32_t*) aligned_calloc((int) (slots * sizeof(uint32_t)));
+		equi_mem_sz += slots * sizeof(uint32_t);
+		ok = ok && mem->tree[r];
+	}
+	if (!ok) {
+		freemem();
+		throw std::runtime_error("EOM: failed to alloc the cpu solver memory");
+	}
+}
+
+void eq_cpu_context::freemem()
+{
+	if (!mem)
+		return;
+	for (int i = 0; i < 2; i++)
+		aligned_free(mem->heap[i]);
+	for (int r = 0; r < WK; r++)
+		aligned_free(mem->tree[r]);
+	pthread_barrier_destroy(&mem->barrier);
+	pthread_mutex_destroy(&mem->lock);
+	mem->~eq_cpu_mem();
+	aligned_free(mem);
+	mem = NULL;
+}
+
+eq_cpu_context::~eq_cpu_context()
+{
+	freemem();
+}
+
+void eq_cpu_context::solve(const char *tequihash_header,
+	unsigned int tequihash_header_len,
+	const char* nonce,
+	unsigned int nonce_len,
+	fn_cancel cancelf,
+	fn_solution solutionf,
+	fn_hashdone hashdonef)
+{
+	std::vector<eq_cpu_arg> args(nthreads);
+	int started = 1;
+
+	eq_cpu_setheader(&mem->blake, tequihash_header, tequihash_header_len, nonce, nonce_len);
+	mem->use_mid = eq_blake2b_midstate(&mem->blake, &mem->mid, EQ_HASHOUT) == 0;
+	for (int i = 0; i < 2; i++)
+		for (int b = 0; b < EQ_NBUCKETS; b++)
+			mem->count[i][b].store(0, std::memory_order_relaxed);
+	mem->thr_id = thread_id;
+	mem->cancelf = cancelf;
+	mem->cancel = false;
+	mem->nsols = 0;
+
+	// the caller is the thread 0
+	for (int i = 0; i < nthreads; i++) {
+		args[i].mem = mem;
+		args[i].id = i;
+	}
+	for (int i = 1; i < nthreads; i++) {
+		if (pthread_create(&args[i].pth, NULL, eq_cpu_thread, &args[i]))
+			break;
+		started++;
+	}
+	if (started < nthreads) {
+		// the barrier expects all the threads
+		for (int i = 1; i < started; i++)
+			pthread_join(args[i].pth, NULL);
+		throw std::runtime_error("cpu solver thread create failed");
+	}
+	eq_cpu_thread(&args[0]);
+	for (int i = 1; i < nthreads; i++)
+		pthread_join(args[i].pth, NULL);
+
+	if (mem->cancel)
+		return;
+
+	for (int s = 0; s < mem->nsols; s++) {
+		std::vector<uint32_t> index_vector(mem->sols[s], mem->sols[s] + EQ_PROOFSIZE);
+		solutionf(thread_id, index_vector, EQ_DIGITBITS, nullptr);
+	}
+	if (!mem->nsols)
+		hashdonef(thread_id);
+}
+
+// offline benchmark (--cpu-bench -a equihash), the solutions are verified
+
+#define EQ_BENCH_NONCES 8
+
+static std::vector<std::vector<uint32_t> > bench_sols;
+
+static void bench_solution(int thr_id, const std::vector<uint32_t>& indices, size_t cbitlen, const unsigned char *compressed)
+{
+	bench_sols.push_back(indices);
+}
+static void bench_hashdone(int thr_id) { }
+static bool bench_cancel(int thr_id) { return false; }
+
+// 512 indices of 21 bits, big endian
+static void eq_compress(const std::vector<uint32_t>& indices, uint8_t *sol)
+{
+	uint64_t acc = 0;
+	int bits = 0, n = 0;
+	for (size_t i = 0; i < indices.size(); i++) {
+		acc = (acc << (EQ_DIGITBITS + 1)) | indices[i];
+		bits += EQ_DIGITBITS + 1;
+		while (bits >= 8) {
+			bits -= 8;
+			sol[n++] = (uint8_t) (acc >> bits);
+		}
+	}
+}
+
+int equi_cpu_bench(FILE *out, int nthreads)
+{
+	uint8_t _ALIGN(64) header[140];
+	uint8_t sol[EQ_SOLSIZE];
+	int found = 0, valid = 0;
+	eq_cpu_context *ctx;
+
+	try {
+		ctx = new eq_cpu_context(0, nthreads);
+	} catch (const std::exception & e) {
+		applog(LOG_ERR, "cpu-bench: %s", e.what());
+		return EXIT_CODE_SW_INIT_ERROR;
+	}
+	eq_cuda_context_interface *solver = ctx;
+
+	cpu_hash_input(header, sizeof(header), 0);
+	struct timeval tv_start, tv_end, diff;
+	gettimeofday(&tv_start, NULL);
+	for (uint32_t n = 0; n < EQ_BENCH_NONCES; n++) {
+		le32enc(&header[EQNONCE_OFFSET * 4], n);
+		bench_sols.clear();
+		solver->solve((const char*) header, 140 - 32, (const char*) &header[108], 32,
+			&bench_cancel, &bench_solution, &bench_hashdone);
+		for (size_t s = 0; s < bench_sols.size(); s++) {
+			eq_compress(bench_sols[s], sol);
+			found++;
+			valid += equi_verify(header, sol) ? 1 : 0;
+		}
+	}
+	gettimeofday(&tv_end, NULL);
+	timeval_subtract(&diff, &tv_end, &tv_start);
+	double secs = (1.0 * diff.tv_sec) + (0.000001 * diff.tv_usec);
+
+	fprintf(out, "{\n  \"version\": \"%s\",\n  \"threads\": %d,\n  \"algos\": [\n",
+		PACKAGE_VERSION, nthreads);
+	fprintf(out, "    { \"name\": \"equihash\", \"nonces\": %d, \"solutions\": %d, \"verified\": %d,\n",
+		EQ_BENCH_NONCES, found, valid);
+	fprintf(out, "      \"ms_per_solve\": %.1f, \"sol_ps\": %.3f, \"mem_mb\": %u }\n  ]\n}\n",
+		secs * 1000. / EQ_BENCH_NONCES, found / secs, (uint32_t) (ctx->equi_mem_sz >> 20));
+	fflush(out);
+
+	delete ctx;
+	return valid == found ? EXIT_CODE_OK : EXIT_CODE_SW_INIT_ERROR;
+}
@@ -101,8 +101,6 @@ bool equi_stratum_set_target(struct stratum_ctx *sctx, json_t *params)
 		target_be[31-i] = target_bin[i];
 		if (target_bin[i]) filled++;
 	}
-	memcpy(sctx->job.extra, target_be, 32);
-
 	pthread_mutex_lock(&stratum_work_lock);
 	sctx->next_diff = target_to_diff_equi((uint32_t*) &target_be);
 	pthread_mutex_unlock(&stratum_work_lock);
@@ -116,9 +114,10 @@ bool equi_stratum_set_target(struct stratum_ctx *sctx, json_t *params)
 bool equi_stratum_notify(struct stratum_ctx *sctx, json_t *params)
 {
 	const char *job_id, *version, *prevhash, *coinb1, *coinb2, *nbits, *stime;
+	struct stratum_job *job;
 	size_t coinb1_size, coinb2_size;
 	bool clean, ret = false;
-	int ntime, i, p=0;
+	int ntime, p=0;
 	job_id = json_string_value(json_array_get(params, p++));
 	version = json_string_value(json_array_get(params, p++));
 	prevhash = json_string_value(json_array_get(params, p++));
@@ -131,7 +130,7 @@ bool equi_stratum_notify(struct stratum_ctx *sctx, json_t *params)
 	if (!job_id || !prevhash || !coinb1 || !coinb2 || !version || !nbits || !stime ||
 	    strlen(prevhash) != 64 || strlen(version) != 8 ||
 	    strlen(coinb1) != 64 || strlen(coinb2) != 64 ||
-	    strlen(nbits) != 8 || strlen(stime) != 8) {
+	    strlen(nbits) != 8 || strlen(stime) != 8 || strlen(job_id) >= STRATUM_MAX_JOBID) {
 		applog(LOG_ERR, "Stratum notify: invalid parameters");
 		goto out;
 	}
@@ -145,39 +144,39 @@ bool equi_stratum_notify(struct stratum_ctx *sctx, json_t *params)
 			applog(LOG_DEBUG, "stratum time is at least %ds in the future", ntime);
 	}
 
-	pthread_mutex_lock(&stratum_work_lock);
-	hex2bin(sctx->job.version, version, 4);
-	hex2bin(sctx->job.prevhash, prevhash, 32);
+	// built off-lock, the readers still use the current job
+	job = stratum_job_new();
+	if (!job)
+		goto out;
+	hex2bin(job->version, version, 4);
+	hex2bin(job->prevhash, prevhash, 32);
 
 	coinb1_size = strlen(coinb1) / 2;
 	coinb2_size = strlen(coinb2) / 2;
-	sctx->job.coinbase_size = coinb1_size + coinb2_size + // merkle + reserved
-		sctx->xnonce1_size + sctx->xnonce2_size; // extranonce and...
-
-	sctx->job.coinbase = (uchar*) realloc(sctx->job.coinbase, sctx->job.coinbase_size);
-	hex2bin(sctx->job.coinbase, coinb1, coinb1_size);
-	hex2bin(sctx->job.coinbase + coinb1_size, coinb2, coinb2_size);
+	if (!stratum_job_coinbase(job, coinb1_size + coinb2_size + // merkle + reserved
+		sctx->xnonce1_size + sctx->xnonce2_size)) { // extranonce and...
+		stratum_job_discard(job);
+		goto out;
+	}
+	hex2bin(job->coinbase, coinb1, coinb1_size);
+	hex2bin(job->coinbase + coinb1_size, coinb2, coinb2_size);
 
-	sctx->job.xnonce2 = sctx->job.coinbase + coinb1_size + coinb2_size + sctx->xnonce1_size;
-	if (!sctx->job.job_id || strcmp(sctx->job.job_id, job_id))
-		memset(sctx->job.xnonce2, 0, sctx->xnonce2_size);
-	memcpy(sctx->job.coinbase + coinb1_size + coinb2_size, sctx->xnonce1, sctx->xnonce1_size);
+	job->xnonce1_size = sctx->xnonce1_size;
+	job->xnonce2_size = sctx->xnonce2_size;
+	job->xnonce2 = job->coinbase + coinb1_size + coinb2_size + sctx->xnonce1_size;
+	memset(job->xnonce2, 0, sctx->xnonce2_size);
+	memcpy(job->coinbase + coinb1_size + coinb2_size, sctx->xnonce1, sctx->xnonce1_size);
 
-	for (i = 0; i < sctx->job.merkle_count; i++)
-		free(sctx->job.merkle[i]);
-	free(sctx->job.merkle);
-	sctx->job.merkle = NULL;
-	sctx->job.merkle_count = 0;
+	job->merkle_count = 0;
 
-	free(sctx->job.job_id);
-	sctx->job.job_id = strdup(job_id);
+	snprintf(job->job_id, sizeof(job->job_id), "%s", job_id);
 
-	hex2bin(sctx->job.nbits, nbits, 4);
-	hex2bin(sctx->job.ntime, stime, 4);
-	sctx->job.clean = clean;
+	hex2bin(job->nbits, nbits, 4);
+	hex2bin(job->ntime, stime, 4);
+	job->clean = clean;
 
-	sctx->job.diff = sctx->next_diff;
-	pthread_mutex_unlock(&stratum_work_lock);
+	job->diff = sctx->next_diff;
+	stratum_job_publish(sctx, job);
 
 	ret = true;
 
@@ -199,7 +198,7 @@ bool equi_stratum_show_message(struct stratum_ctx *sctx, json_t *id, json_t *par
 			char symbol[32] = { 0 };
 			uint32_t height = 0;
 			int ss = sscanf(data, "equihash %s block %u", symbol, &height);
-			if (height && ss > 1) sctx->job.height = height;
+			if (height && ss > 1) sctx->block_height = height;
 			if (opt_debug && ss > 1) applog(LOG_DEBUG, "%s", data);
 		}
 	}
@@ -256,7 +255,7 @@ bool equi_stratum_submit(struct pool_infos *pool, struct work *work)
 	snprintf(s, sizeof(s), "{\"method\":\"mining.submit\",\"params\":"
 		"[\"%s\",\"%s\",\"%s\",\"%s\",\"%s\"], \"id\":%u}",
 		pool->user, jobid, timehex, noncestr, solhex,
-		stratum.job.shares_count + 10);
+		stratum.shares_count + 10);
 
 	free(solhex);
 	free(noncestr);
@@ -269,7 +268,7 @@ bool equi_stratum_submit(struct pool_infos *pool, struct work *work)
 	}
 
 	stratum.sharediff = work->sharediff[idnonce];
-	stratum.job.shares_count++;
+	stratum.shares_count++;
 
 	return true;
 }
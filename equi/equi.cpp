@@ -109,18 +109,22 @@ static void expandArray(const unsigned char *in, const uint32_t in_len,
 	}
 }
 
+#ifdef USE_LIBSODIUM
 static void generateHash(blake2b_state *S, const uint32_t g, uint8_t *hash, const size_t hashLen)
 {
 	const uint32_t le_g = htole32(g);
 	blake2b_state digest = *S; /* copy */
-#ifdef USE_LIBSODIUM
 	crypto_generichash_blake2b_update(&digest, (uint8_t *)&le_g, sizeof(le_g));
 	crypto_generichash_blake2b_final(&digest, hash, hashLen);
+}
 #else
-	eq_blake2b_update(&digest, (const uint8_t*) &le_g, sizeof(le_g));
-	eq_blake2b_final(&digest, hash, (uint8_t) (hashLen & 0xFF));
-#endif
+/* only the block with the index is compressed, the header ones are in mid */
+static void generateHash(const blake2b_midstate *mid, const uint32_t g, uint8_t *hash, const size_t hashLen)
+{
+	assert(hashLen == (size_t) mid->outlen);
+	blake2b_mid_hash(mid, hash, g);
 }
+#endif
 
 static int isZero(const uint8_t *hash, size_t len)
 {
@@ -153,7 +157,9 @@ bool equi_verify(uint8_t* const hdr, uint8_t* const soln)
 #ifdef USE_LIBSODIUM
 	crypto_generichash_blake2b_update(&state, hdr, 140);
 #else
+	blake2b_midstate mid;
 	eq_blake2b_update(&state, hdr, 140);
+	eq_blake2b_midstate(&state, &mid, HASHOUT);
 #endif
 
 	expandArray(soln, equihashSolutionSize, (uint8_t*) &indices, sizeof(indices), collisionBitLength + 1, 1);
@@ -162,7 +168,11 @@ bool equi_verify(uint8_t* const hdr, uint8_t* const soln)
 		uint8_t tmpHash[hashOutput];
 		uint8_t hash[hashLength];
 		uint32_t i = be32toh(indices[j]);
+#ifdef USE_LIBSODIUM
 		generateHash(&state, i / indicesPerHashOutput, tmpHash, hashOutput);
+#else
+		generateHash(&mid, i / indicesPerHashOutput, tmpHash, hashOutput);
+#endif
 		expandArray(tmpHash + (i % indicesPerHashOutput * n / 8), n / 8, hash, hashLength, collisionBitLength, 0);
 		for (uint32_t k = 0; k < hashLength; k++)
 			vHash[k] ^= hash[k];
@@ -161,6 +161,19 @@ extern "C" int scanhash_equihash(int thr_id, struct work *work, uint32_t max_non
 	if (opt_benchmark)
 		ptarget[7] = 0xfffff;
 
+	if (!init[thr_id] && opt_equihash_cpu) {
+		try {
+			solvers[thr_id] = new eq_cpu_context(thr_id, opt_equihash_cpu);
+			size_t memSz = solvers[thr_id]->equi_mem_sz / (1024*1024);
+			api_set_throughput(thr_id, (uint32_t) solvers[thr_id]->throughput);
+			gpulog(LOG_DEBUG, thr_id, "Allocated %u MB for %d cpu solver threads", (u32) memSz, opt_equihash_cpu);
+			init[thr_id] = true;
+		} catch (const std::exception & e) {
+			gpulog(LOG_ERR, thr_id, "init: %s", e.what());
+			proper_exit(EXIT_CODE_SW_INIT_ERROR);
+		}
+	}
+
 	if (!init[thr_id]) {
 		try {
 			int mode = 1;
@@ -231,11 +244,18 @@ extern "C" int scanhash_equihash(int thr_id, struct work *work, uint32_t max_non
 			{
 				memcpy(full_data, endiandata, 140);
 				memcpy(sol_data, &data_sols[thr_id][nsol][140], 1347);
+				uint64_t vstart = vstats_clock();
 				equi_hash(full_data, vhash, 140+3+1344);
 
 				if (vhash[7] <= Htarg && fulltest(vhash, ptarget))
 				{
 					bool valid = equi_verify_sol(endiandata, &sol_data[3]);
+					vstats_verified(thr_id, vstart);
+					if (!valid) {
+						gpu_increment_reject(thr_id);
+						if (!opt_quiet)
+							gpulog(LOG_WARNING, thr_id, "solution %d does not validate on CPU!", nsol);
+					}
 					if (valid && work->valid_nonces < MAX_NONCES) {
 						work->valid_nonces++;
 						memcpy(work->data, endiandata, 140);
@@ -280,6 +300,14 @@ void free_equihash(int thr_id)
 	if (!init[thr_id])
 		return;
 
+	eq_cpu_context* cpu = dynamic_cast<eq_cpu_context*>(solvers[thr_id]);
+	if (cpu) {
+		delete cpu;
+		solvers[thr_id] = NULL;
+		init[thr_id] = false;
+		return;
+	}
+
 	// assume config 1 was used... interface destructor seems bad
 	eq_cuda_context<CONFIG_MODE_1>* ptr = dynamic_cast<eq_cuda_context<CONFIG_MODE_1>*>(solvers[thr_id]);
 	ptr->freemem();
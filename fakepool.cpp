@@ -0,0 +1,926 @@
+/**
+ * Loopback stratum pool (--fake-pool)
+ *
+ * Serve synthetic (or replayed) jobs to the miner at a fixed rate, with
+ * optional clean jobs, reconnect requests, difficulty changes and delayed
+ * submit answers. The shares are checked with the cpu hashes, and the
+ * notify to first hash latency, the submit rtt and the stale rate are
+ * reported to have a reproducible benchmark of the network path.
+ *
+ * The spec is a list of key=value separated by commas, all optional:
+ *   port=3340 job=10000 (ms) clean=4 (jobs) reconnect=0 (jobs)
+ *   vardiff=0 (jobs) diff=1 delay=0 (ms) replay=file seed=1 report=60 (s)
+ *
+ * A replay file contains stratum messages, one per line (a -P log works,
+ * the text before the first '{' is ignored). Only the mining.notify and
+ * mining.set_difficulty methods are used, the file is looped.
+ */
+#ifdef WIN32
+# define  _WINSOCK_DEPRECATED_NO_WARNINGS
+# include <winsock2.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <time.h>
+#include <openssl/sha.h>
+
+#include "miner.h"
+#include "algos.h"
+#include "u256.h"
+
+#ifndef WIN32
+# include <errno.h>
+# include <sys/socket.h>
+# include <netinet/in.h>
+# include <arpa/inet.h>
+# define SOCKETTYPE long
+# define SOCKETFAIL(a) ((a) < 0)
+# define INVSOCK -1 /* INVALID_SOCKET */
+# define CLOSESOCKET close
+#else
+# define SOCKETTYPE SOCKET
+# define SOCKETFAIL(a) ((a) == SOCKET_ERROR)
+# define INVSOCK INVALID_SOCKET
+# define CLOSESOCKET closesocket
+#endif
+
+#define FP_JOBS     16  /* sent jobs kept to check the shares */
+#define FP_MERKLE   16
+#define FP_SHARES   256 /* per job, duplicate check */
+#define FP_PENDING  64  /* delayed answers */
+#define FP_XN2_SIZE 4
+#define FP_RECVBUF  16384
+#define FP_TICK_MS  500
+
+#ifdef MSG_NOSIGNAL
+#define FP_SENDFLAGS MSG_NOSIGNAL
+#else
+#define FP_SENDFLAGS 0
+#endif
+
+struct fp_job {
+	char id[16];
+	uint32_t conn;
+	uint8_t prevhash[32];
+	uint8_t version[4];
+	uint8_t nbits[4];
+	uint32_t ntime;
+	char *coinb1;
+	char *coinb2;
+	int merkle_count;
+	uint8_t merkle[FP_MERKLE][32];
+	double diff;
+	uint64_t sent_us;
+	int started;
+	int nshares;
+	uint64_t shares[FP_SHARES];
+};
+
+struct fp_pending {
+	uint64_t due_us;
+	char *line;
+};
+
+struct fp_conn {
+	SOCKETTYPE sock;
+	uint32_t id;
+	char xnonce1[9];
+	bool authorized;
+	bool closing;
+	double sent_diff;
+	uint64_t next_job_us;
+	uint64_t close_us;
+	int npending;
+	struct fp_pending pending[FP_PENDING];
+	int len;
+	char buf[FP_RECVBUF];
+};
+
+enum {
+	FP_VALID = 0,
+	FP_STALE,
+	FP_DUP,
+	FP_LOW,
+	FP_UNCHECKED,
+};
+
+char *opt_fake_pool = NULL;
+
+static int fp_port = 3340;
+static int fp_job_ms = 10000;
+static int fp_clean = 4;
+static int fp_reconnect = 0;
+static int fp_vardiff = 0;
+static int fp_delay_ms = 0;
+static int fp_report_s = 60;
+static double fp_diff = 1.;
+static uint32_t fp_seed = 1;
+static char *fp_replay_file = NULL;
+
+static const struct cpu_hash_algo *fp_algo = NULL;
+static SOCKETTYPE fp_sock = INVSOCK;
+static pthread_t fp_thr;
+static bool fp_running = false;
+static volatile bool fp_stopping = false;
+static pthread_mutex_t fp_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* job ring and generator state, under fp_lock */
+static struct fp_job fp_jobs[FP_JOBS];
+static uint32_t fp_njobs = 0;
+static uint32_t fp_height = 1000000;
+static uint8_t fp_prevhash[32];
+static double fp_cur_diff = 1.;
+static json_t **fp_replay = NULL;
+static int fp_replay_count = 0;
+static int fp_replay_pos = 0;
+static char fp_thr_job[MAX_GPUS][16];
+
+static struct {
+	uint32_t conns;
+	uint32_t reconnects;
+	uint32_t shares;
+	uint32_t stale;
+	uint32_t dup;
+	uint32_t low;
+	uint32_t unchecked;
+	uint64_t reconnect_start_us;
+	double reconnect_ms_sum;
+	uint32_t reconnect_n;
+	double first_ms_sum, first_ms_max;
+	uint32_t first_n;
+	double all_ms_sum;
+	uint32_t all_n;
+	double rtt_ms_sum;
+	uint32_t rtt_ms_max;
+	uint32_t rtt_n;
+	uint64_t next_report_us;
+} fp_stats;
+
+static uint64_t fp_now_us()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return (uint64_t) tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+/* xorshift, the synthetic jobs only depend on the seed */
+static uint32_t fp_rand()
+{
+	fp_seed ^= fp_seed << 13;
+	fp_seed ^= fp_seed >> 17;
+	fp_seed ^= fp_seed << 5;
+	return fp_seed;
+}
+
+static void fp_rand_bytes(uint8_t *buf, int len)
+{
+	for (int i = 0; i < len; i++)
+		buf[i] = (uint8_t) fp_rand();
+}
+
+static struct fp_job* fp_find_job(const char *id)
+{
+	for (int i = 0; i < FP_JOBS; i++) {
+		if (fp_jobs[i].sent_us && !strcmp(fp_jobs[i].id, id))
+			return &fp_jobs[i];
+	}
+	return NULL;
+}
+
+static bool fp_load_replay(const char *filename)
+{
+	const size_t bufsz = 256 * 1024;
+	FILE *fp = fopen(filename, "r");
+	char *line;
+	int alloc = 0;
+
+	if (!fp) {
+		applog(LOG_ERR, "fake-pool: unable to read %s", filename);
+		return false;
+	}
+	line = (char*) malloc(bufsz);
+	while (line && fgets(line, (int) bufsz, fp)) {
+		json_error_t err;
+		char *js = strchr(line, '{');
+		if (!js) continue;
+		json_t *val = JSON_LOADS(js, &err);
+		if (!val) continue;
+		const char *method = json_string_value(json_object_get(val, "method"));
+		json_t *params = json_object_get(val, "params");
+		bool keep = false;
+		if (method && json_is_array(params)) {
+			if (!strcasecmp(method, "mining.set_difficulty"))
+				keep = json_number_value(json_array_get(params, 0)) > 0.;
+			else if (!strcasecmp(method, "mining.notify"))
+				keep = json_array_size(params) >= 9 &&
+					json_array_size(json_array_get(params, 4)) <= FP_MERKLE;
+		}
+		if (!keep) {
+			json_decref(val);
+			continue;
+		}
+		if (fp_replay_count == alloc) {
+			alloc = alloc ? alloc * 2 : 64;
+			fp_replay = (json_t**) realloc(fp_replay, alloc * sizeof(json_t*));
+		}
+		fp_replay[fp_replay_count++] = val;
+	}
+	free(line);
+	fclose(fp);
+
+	for (int i = 0; i < fp_replay_count; i++) {
+		const char *method = json_string_value(json_object_get(fp_replay[i], "method"));
+		if (!strcasecmp(method, "mining.notify"))
+			return true;
+	}
+	applog(LOG_ERR, "fake-pool: no mining.notify in %s", filename);
+	return false;
+}
+
+static bool fp_hex_param(json_t *params, int n, void *buf, size_t len)
+{
+	const char *hex = json_string_value(json_array_get(params, n));
+	return hex && strlen(hex) == 2 * len && hex2bin(buf, hex, len);
+}
+
+/* next recorded notify, the set_difficulty before are applied */
+static bool fp_replay_job(struct fp_job *job)
+{
+	for (int n = 0; n < fp_replay_count; n++) {
+		json_t *val = fp_replay[fp_replay_pos];
+		json_t *params = json_object_get(val, "params");
+		const char *method = json_string_value(json_object_get(val, "method"));
+		fp_replay_pos = (fp_replay_pos + 1) % fp_replay_count;
+
+		if (!strcasecmp(method, "mining.set_difficulty")) {
+			if (!fp_vardiff)
+				fp_cur_diff = json_number_value(json_array_get(params, 0));
+			continue;
+		}
+		const char *coinb1 = json_string_value(json_array_get(params, 2));
+		const char *coinb2 = json_string_value(json_array_get(params, 3));
+		json_t *merkle = json_array_get(params, 4);
+		const char *stime = json_string_value(json_array_get(params, 7));
+		if (!coinb1 || !coinb2 || !stime || strlen(stime) != 8 ||
+		    !fp_hex_param(params, 1, job->prevhash, 32) ||
+		    !fp_hex_param(params, 5, job->version, 4) ||
+		    !fp_hex_param(params, 6, job->nbits, 4))
+			continue;
+		job->merkle_count = (int) json_array_size(merkle);
+		for (int i = 0; i < job->merkle_count; i++) {
+			if (!fp_hex_param(merkle, i, job->merkle[i], 32))
+				job->merkle_count = -1;
+		}
+		if (job->merkle_count < 0)
+			continue;
+		job->ntime = (uint32_t) strtoul(stime, NULL, 16);
+		job->coinb1 = strdup(coinb1);
+		job->coinb2 = strdup(coinb2);
+		return true;
+	}
+	return false;
+}
+
+/* bip34 like coinbase, for the block height displayed by the miner */
+static void fp_synthetic_job(struct fp_job *job, bool newblock)
+{
+	char tag[] = "/ccfake/";
+	char hex[2 * sizeof(tag)];
+
+	if (newblock || !fp_njobs) {
+		fp_rand_bytes(fp_prevhash, 32);
+		fp_height++;
+	}
+	memcpy(job->prevhash, fp_prevhash, 32);
+	job->version[0] = 0x20;
+	job->nbits[0] = 0x1d; job->nbits[2] = 0xff; job->nbits[3] = 0xff;
+	job->ntime = (uint32_t) time(NULL);
+	job->merkle_count = (int) (fp_rand() % 4);
+	for (int i = 0; i < job->merkle_count; i++)
+		fp_rand_bytes(job->merkle[i], 32);
+
+	cbin2hex(hex, tag, strlen(tag));
+	job->coinb1 = (char*) malloc(128 + strlen(hex));
+	sprintf(job->coinb1, "01000000010000000000000000000000000000000000000000000000000000000000000000"
+		"ffffffff%02x03%02x%02x%02x%s", (int) (4 + strlen(tag) + 4 + FP_XN2_SIZE),
+		fp_height & 0xff, (fp_height >> 8) & 0xff, (fp_height >> 16) & 0xff, hex);
+	job->coinb2 = strdup("ffffffff0100f2052a010000000000000000");
+}
+
+static const double fp_vardiff_steps[] = { 1., 2., 4., 2., 1., 0.5 };
+
+/* caller holds fp_lock */
+static struct fp_job* fp_next_job(uint32_t conn, bool *newblock)
+{
+	struct fp_job *job = &fp_jobs[fp_njobs % FP_JOBS];
+	uint8_t prevhash[32];
+
+	memcpy(prevhash, fp_prevhash, 32);
+
+	free(job->coinb1);
+	free(job->coinb2);
+	memset(job, 0, sizeof(*job));
+
+	if (fp_vardiff > 0 && fp_njobs > 0 && (fp_njobs % fp_vardiff) == 0) {
+		int step = (fp_njobs / fp_vardiff) % ARRAY_SIZE(fp_vardiff_steps);
+		fp_cur_diff = fp_diff * fp_vardiff_steps[step];
+	}
+
+	if (fp_replay_count) {
+		if (!fp_replay_job(job))
+			return NULL;
+		memcpy(fp_prevhash, job->prevhash, 32);
+	} else {
+		fp_synthetic_job(job, fp_clean > 0 && fp_njobs > 0 && (fp_njobs % fp_clean) == 0);
+	}
+	*newblock = !fp_njobs || memcmp(prevhash, fp_prevhash, 32);
+
+	snprintf(job->id, sizeof(job->id), "%x", fp_njobs + 1);
+	job->conn = conn;
+	job->diff = fp_cur_diff;
+	fp_njobs++;
+	return job;
+}
+
+static bool fp_send(struct fp_conn *c, const char *line)
+{
+	size_t len = strlen(line), sent = 0;
+
+	if (opt_protocol)
+		applog(LOG_DEBUG, "fake-pool> %s", line);
+	while (sent < len + 1) {
+		const char *p = (sent < len) ? line + sent : "\n";
+		int n = (int) send(c->sock, p, (int) ((sent < len) ? len - sent : 1), FP_SENDFLAGS);
+		if (n <= 0)
+			return false;
+		sent += n;
+	}
+	return true;
+}
+
+static bool fp_send_job(struct fp_conn *c, struct fp_job *job, bool clean)
+{
+	char prevhash[65], version[9], nbits[9];
+	char *s, *p;
+	bool ret;
+
+	if (c->sent_diff != job->diff) {
+		char sdiff[96];
+		snprintf(sdiff, sizeof(sdiff),
+			"{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[%.17g]}", job->diff);
+		if (!fp_send(c, sdiff))
+			return false;
+		c->sent_diff = job->diff;
+	}
+
+	cbin2hex(prevhash, (const char*) job->prevhash, 32);
+	cbin2hex(version, (const char*) job->version, 4);
+	cbin2hex(nbits, (const char*) job->nbits, 4);
+
+	s = (char*) malloc(256 + strlen(job->coinb1) + strlen(job->coinb2) + 67 * FP_MERKLE);
+	p = s + sprintf(s, "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"%s\",\"%s\",\"%s\",\"%s\",[",
+		job->id, prevhash, job->coinb1, job->coinb2);
+	for (int i = 0; i < job->merkle_count; i++) {
+		char branch[65];
+		cbin2hex(branch, (const char*) job->merkle[i], 32);
+		p += sprintf(p, "%s\"%s\"", i ? "," : "", branch);
+	}
+	sprintf(p, "],\"%s\",\"%s\",\"%08x\",%s]}", version, nbits, job->ntime, clean ? "true" : "false");
+
+	ret = fp_send(c, s);
+	free(s);
+	if (ret) {
+		pthread_mutex_lock(&fp_lock);
+		job->sent_us = fp_now_us();
+		pthread_mutex_unlock(&fp_lock);
+	}
+	return ret;
+}
+
+/* new job, or a reconnect request every n jobs */
+static bool fp_job_tick(struct fp_conn *c, bool clean)
+{
+	struct fp_job *job;
+
+	pthread_mutex_lock(&fp_lock);
+	if (fp_reconnect > 0 && !clean && fp_njobs > 0 && (fp_njobs % fp_reconnect) == 0 &&
+	    fp_stats.reconnect_start_us == 0) {
+		char s[128];
+		fp_stats.reconnect_start_us = fp_now_us();
+		fp_stats.reconnects++;
+		pthread_mutex_unlock(&fp_lock);
+		snprintf(s, sizeof(s), "{\"id\":null,\"method\":\"client.reconnect\",\"params\":[\"127.0.0.1\",%d,0]}", fp_port);
+		c->closing = true;
+		c->close_us = fp_now_us() + 5000000;
+		return fp_send(c, s);
+	}
+	bool newblock = false;
+	job = fp_next_job(c->id, &newblock);
+	pthread_mutex_unlock(&fp_lock);
+
+	if (!job) {
+		applog(LOG_ERR, "fake-pool: no valid job to send");
+		return false;
+	}
+	return fp_send_job(c, job, clean || newblock);
+}
+
+static uint64_t fp_share_key(uint32_t xnonce2, uint32_t ntime, uint32_t nonce)
+{
+	return ((uint64_t) (xnonce2 ^ (ntime * 0x9e3779b9U)) << 32) | nonce;
+}
+
+/* rebuild the header as stratum_gen_work() and check the hash */
+static int fp_check_share(struct fp_conn *c, json_t *params)
+{
+	uint32_t _ALIGN(64) data[32];
+	uint32_t _ALIGN(64) endiandata[32];
+	uint32_t _ALIGN(64) hash[16];
+	uint32_t _ALIGN(64) target[8];
+	uchar merkle_root[64];
+	uint8_t xnonce2[FP_XN2_SIZE], ntime[4], nonce[4];
+	uint32_t xn2 = 0;
+	struct fp_job *job;
+	int rc = FP_VALID;
+
+	const char *job_id = json_string_value(json_array_get(params, 1));
+	if (!job_id || !fp_hex_param(params, 2, xnonce2, FP_XN2_SIZE) ||
+	    !fp_hex_param(params, 3, ntime, 4) || !fp_hex_param(params, 4, nonce, 4))
+		return FP_LOW;
+	memcpy(&xn2, xnonce2, 4);
+
+	pthread_mutex_lock(&fp_lock);
+	job = fp_find_job(job_id);
+	if (!job || job->conn != c->id || memcmp(job->prevhash, fp_prevhash, 32)) {
+		pthread_mutex_unlock(&fp_lock);
+		return FP_STALE;
+	}
+	uint64_t key = fp_share_key(xn2, le32dec(ntime), le32dec(nonce));
+	for (int i = 0; i < job->nshares && i < FP_SHARES; i++) {
+		if (job->shares[i] == key) {
+			pthread_mutex_unlock(&fp_lock);
+			return FP_DUP;
+		}
+	}
+	job->shares[job->nshares++ % FP_SHARES] = key;
+
+	if (!fp_algo) {
+		pthread_mutex_unlock(&fp_lock);
+		return FP_UNCHECKED;
+	}
+
+	size_t coinb1_size = strlen(job->coinb1) / 2;
+	size_t coinb2_size = strlen(job->coinb2) / 2;
+	size_t coinbase_size = coinb1_size + 4 + FP_XN2_SIZE + coinb2_size;
+	uchar *coinbase = (uchar*) malloc(coinbase_size);
+	hex2bin(coinbase, job->coinb1, coinb1_size);
+	hex2bin(coinbase + coinb1_size, c->xnonce1, 4);
+	memcpy(coinbase + coinb1_size + 4, xnonce2, FP_XN2_SIZE);
+	hex2bin(coinbase + coinb1_size + 4 + FP_XN2_SIZE, job->coinb2, coinb2_size);
+
+	switch (opt_algo) {
+		case ALGO_FUGUE256:
+		case ALGO_GROESTL:
+		case ALGO_KECCAK:
+		case ALGO_BLAKECOIN:
+		case ALGO_WHIRLCOIN:
+			SHA256(coinbase, coinbase_size, merkle_root);
+			break;
+		default:
+			sha256d(merkle_root, coinbase, (int) coinbase_size);
+	}
+	free(coinbase);
+	for (int i = 0; i < job->merkle_count; i++) {
+		memcpy(merkle_root + 32, job->merkle[i], 32);
+		sha256d(merkle_root, merkle_root, 64);
+	}
+
+	memset(data, 0, sizeof(data));
+	data[0] = le32dec(job->version);
+	for (int i = 0; i < 8; i++)
+		data[1 + i] = le32dec((uint32_t*) job->prevhash + i);
+	for (int i = 0; i < 8; i++)
+		data[9 + i] = be32dec((uint32_t*) merkle_root + i);
+	data[17] = le32dec(ntime);
+	data[18] = le32dec(job->nbits);
+	data[19] = le32dec(nonce);
+	data[20] = 0x80000000;
+	data[31] = 0x00000280;
+	double diff = job->diff;
+	pthread_mutex_unlock(&fp_lock);
+
+	if (opt_algo == ALGO_SCRYPT)
+		memcpy(endiandata, data, 80);
+	else for (int i = 0; i < 20; i++)
+		be32enc(&endiandata[i], data[i]);
+
+	fp_algo->hash(hash, endiandata);
+	diff_to_target(target, diff / stratum_diff_factor(opt_algo));
+	if (!u256_le32(hash, target))
+		rc = FP_LOW;
+	return rc;
+}
+
+static void fp_answer(struct fp_conn *c, char *line)
+{
+	if (fp_delay_ms <= 0 || c->npending == FP_PENDING) {
+		fp_send(c, line);
+		free(line);
+		return;
+	}
+	c->pending[c->npending].due_us = fp_now_us() + fp_delay_ms * 1000ULL;
+	c->pending[c->npending].line = line;
+	c->npending++;
+}
+
+static void fp_flush_pending(struct fp_conn *c, uint64_t now)
+{
+	int n = 0;
+	while (n < c->npending && c->pending[n].due_us <= now) {
+		fp_send(c, c->pending[n].line);
+		free(c->pending[n].line);
+		n++;
+	}
+	if (n) {
+		c->npending -= n;
+		memmove(c->pending, &c->pending[n], c->npending * sizeof(struct fp_pending));
+	}
+}
+
+static void fp_handle_submit(struct fp_conn *c, int id, json_t *params)
+{
+	static const char *reasons[] = { NULL, "Job not found", "Duplicate share", "Low difficulty share", NULL };
+	static const int codes[] = { 0, 21, 22, 23, 0 };
+	char *s = (char*) malloc(128);
+	int rc = fp_check_share(c, params);
+
+	pthread_mutex_lock(&fp_lock);
+	fp_stats.shares++;
+	switch (rc) {
+		case FP_STALE: fp_stats.stale++; break;
+		case FP_DUP: fp_stats.dup++; break;
+		case FP_LOW: fp_stats.low++; break;
+		case FP_UNCHECKED: fp_stats.unchecked++; break;
+	}
+	pthread_mutex_unlock(&fp_lock);
+
+	if (reasons[rc])
+		snprintf(s, 128, "{\"id\":%d,\"result\":false,\"error\":[%d,\"%s\",null]}", id, codes[rc], reasons[rc]);
+	else
+		snprintf(s, 128, "{\"id\":%d,\"result\":true,\"error\":null}", id);
+	fp_answer(c, s);
+}
+
+static bool fp_handle_line(struct fp_conn *c, const char *line)
+{
+	json_error_t err;
+	char s[256];
+	bool ret = true;
+
+	if (opt_protocol)
+		applog(LOG_DEBUG, "fake-pool< %s", line);
+
+	json_t *val = JSON_LOADS(line, &err);
+	if (!val)
+		return true;
+
+	const char *method = json_string_value(json_object_get(val, "method"));
+	json_t *params = json_object_get(val, "params");
+	int id = (int) json_integer_value(json_object_get(val, "id"));
+
+	if (!method) {
+		// client answer (ignored)
+	} else if (!strcasecmp(method, "mining.subscribe")) {
+		snprintf(s, sizeof(s), "{\"id\":%d,\"result\":[[[\"mining.set_difficulty\",\"%x\"],"
+			"[\"mining.notify\",\"%x\"]],\"%s\",%d],\"error\":null}",
+			id, c->id, c->id, c->xnonce1, FP_XN2_SIZE);
+		ret = fp_send(c, s);
+	} else if (!strcasecmp(method, "mining.extranonce.subscribe")) {
+		snprintf(s, sizeof(s), "{\"id\":%d,\"result\":true,\"error\":null}", id);
+		ret = fp_send(c, s);
+	} else if (!strcasecmp(method, "mining.authorize")) {
+		snprintf(s, sizeof(s), "{\"id\":%d,\"result\":true,\"error\":null}", id);
+		ret = fp_send(c, s);
+		if (ret && !c->authorized) {
+			c->authorized = true;
+			pthread_mutex_lock(&fp_lock);
+			if (fp_stats.reconnect_start_us) {
+				fp_stats.reconnect_ms_sum += (fp_now_us() - fp_stats.reconnect_start_us) / 1000.;
+				fp_stats.reconnect_n++;
+				fp_stats.reconnect_start_us = 0;
+			}
+			pthread_mutex_unlock(&fp_lock);
+			ret = fp_job_tick(c, true);
+			c->next_job_us = fp_now_us() + fp_job_ms * 1000ULL;
+		}
+	} else if (!strcasecmp(method, "mining.submit") && json_is_array(params)) {
+		fp_handle_submit(c, id, params);
+	} else if (json_integer_value(json_object_get(val, "id"))) {
+		snprintf(s, sizeof(s), "{\"id\":%d,\"result\":null,\"error\":[20,\"Not supported\",null]}", id);
+		ret = fp_send(c, s);
+	}
+
+	json_decref(val);
+	return ret;
+}
+
+static void fp_report()
+{
+	pthread_mutex_lock(&fp_lock);
+	uint32_t checked = fp_stats.shares - fp_stats.unchecked;
+	applog(LOG_NOTICE, "fake-pool: %u jobs, %u reconnects, %u shares, %u stale (%.1f%%), "
+		"%u duplicate, %u low diff, %u unchecked", fp_njobs, fp_stats.reconnects,
+		fp_stats.shares, fp_stats.stale, fp_stats.shares ? 100. * fp_stats.stale / fp_stats.shares : 0.,
+		fp_stats.dup, fp_stats.low, fp_stats.unchecked);
+	applog(LOG_NOTICE, "fake-pool: notify to hash %.1f ms (max %.1f, all threads %.1f), "
+		"submit rtt %.1f ms (max %u), reconnect %.1f ms",
+		fp_stats.first_n ? fp_stats.first_ms_sum / fp_stats.first_n : 0., fp_stats.first_ms_max,
+		fp_stats.all_n ? fp_stats.all_ms_sum / fp_stats.all_n : 0.,
+		fp_stats.rtt_n ? fp_stats.rtt_ms_sum / fp_stats.rtt_n : 0., fp_stats.rtt_ms_max,
+		fp_stats.reconnect_n ? fp_stats.reconnect_ms_sum / fp_stats.reconnect_n : 0.);
+	if (checked && opt_debug)
+		applog(LOG_DEBUG, "fake-pool: %u shares checked with the cpu hash", checked);
+	pthread_mutex_unlock(&fp_lock);
+}
+
+static void fp_report_tick(uint64_t now)
+{
+	if (fp_report_s <= 0)
+		return;
+	if (!fp_stats.next_report_us)
+		fp_stats.next_report_us = now + fp_report_s * 1000000ULL;
+	if (now >= fp_stats.next_report_us) {
+		fp_report();
+		fp_stats.next_report_us = now + fp_report_s * 1000000ULL;
+	}
+}
+
+/* one client at a time, until it disconnects */
+static void fp_serve(SOCKETTYPE sock)
+{
+	struct fp_conn *c = (struct fp_conn*) calloc(1, sizeof(struct fp_conn));
+	if (!c) {
+		CLOSESOCKET(sock);
+		return;
+	}
+	c->sock = sock;
+	pthread_mutex_lock(&fp_lock);
+	c->id = ++fp_stats.conns;
+	pthread_mutex_unlock(&fp_lock);
+	snprintf(c->xnonce1, sizeof(c->xnonce1), "%08x", (c->id * 0x01000193U) ^ 0xf0000000U);
+
+	while (!fp_stopping && !abort_flag) {
+		uint64_t now = fp_now_us();
+		fp_flush_pending(c, now);
+		if (c->closing && now >= c->close_us)
+			break;
+		if (c->authorized && !c->closing && now >= c->next_job_us) {
+			if (!fp_job_tick(c, false))
+				break;
+			c->next_job_us = now + fp_job_ms * 1000ULL;
+		}
+		fp_report_tick(now);
+
+		uint64_t wake = now + FP_TICK_MS * 1000ULL;
+		if (c->authorized && !c->closing) wake = min(wake, c->next_job_us);
+		if (c->npending) wake = min(wake, c->pending[0].due_us);
+		if (c->closing) wake = min(wake, c->close_us);
+
+		struct timeval tv;
+		uint64_t wait = wake > now ? wake - now : 0;
+		tv.tv_sec = (long) (wait / 1000000);
+		tv.tv_usec = (long) (wait % 1000000);
+		fd_set rd;
+		FD_ZERO(&rd);
+		FD_SET(sock, &rd);
+		int n = select((int) sock + 1, &rd, NULL, NULL, &tv);
+		if (n < 0)
+			break;
+		if (n == 0 || !FD_ISSET(sock, &rd))
+			continue;
+
+		n = recv(sock, &c->buf[c->len], FP_RECVBUF - 1 - c->len, 0);
+		if (n <= 0)
+			break;
+		c->len += n;
+		c->buf[c->len] = '\0';
+
+		char *line = c->buf, *eol;
+		bool ok = true;
+		while (ok && (eol = strchr(line, '\n')) != NULL) {
+			*eol = '\0';
+			if (eol > line && eol[-1] == '\r') eol[-1] = '\0';
+			if (*line) ok = fp_handle_line(c, line);
+			line = eol + 1;
+		}
+		if (!ok)
+			break;
+		c->len -= (int) (line - c->buf);
+		memmove(c->buf, line, c->len);
+		if (c->len == FP_RECVBUF - 1) {
+			applog(LOG_WARNING, "fake-pool: line too long, closing");
+			break;
+		}
+	}
+
+	for (int i = 0; i < c->npending; i++)
+		free(c->pending[i].line);
+	CLOSESOCKET(sock);
+	free(c);
+}
+
+static void *fp_thread(void *userdata)
+{
+	while (!fp_stopping && !abort_flag) {
+		struct timeval tv = { 0, FP_TICK_MS * 1000 };
+		fd_set rd;
+		FD_ZERO(&rd);
+		FD_SET(fp_sock, &rd);
+		int n = select((int) fp_sock + 1, &rd, NULL, NULL, &tv);
+		fp_report_tick(fp_now_us());
+		if (n <= 0 || !FD_ISSET(fp_sock, &rd))
+			continue;
+
+		SOCKETTYPE c = accept(fp_sock, NULL, NULL);
+		if (SOCKETFAIL(c))
+			continue;
+		fp_serve(c);
+	}
+	return NULL;
+}
+
+static bool fp_parse_spec(const char *spec)
+{
+	char *buf = strdup(spec), *saveptr = NULL;
+	bool ret = true;
+
+	for (char *kv = strtok_r(buf, ",", &saveptr); kv && ret; kv = strtok_r(NULL, ",", &saveptr)) {
+		char *val = strchr(kv, '=');
+		if (!val) {
+			applog(LOG_ERR, "fake-pool: invalid parameter %s", kv);
+			ret = false;
+			break;
+		}
+		*val++ = '\0';
+		if (!strcasecmp(kv, "port")) fp_port = atoi(val);
+		else if (!strcasecmp(kv, "job")) fp_job_ms = atoi(val);
+		else if (!strcasecmp(kv, "clean")) fp_clean = atoi(val);
+		else if (!strcasecmp(kv, "reconnect")) fp_reconnect = atoi(val);
+		else if (!strcasecmp(kv, "vardiff")) fp_vardiff = atoi(val);
+		else if (!strcasecmp(kv, "diff")) fp_diff = atof(val);
+		else if (!strcasecmp(kv, "delay")) fp_delay_ms = atoi(val);
+		else if (!strcasecmp(kv, "report")) fp_report_s = atoi(val);
+		else if (!strcasecmp(kv, "seed")) fp_seed = (uint32_t) strtoul(val, NULL, 0);
+		else if (!strcasecmp(kv, "replay")) {
+			free(fp_replay_file);
+			fp_replay_file = strdup(val);
+		} else {
+			applog(LOG_ERR, "fake-pool: unknown parameter %s", kv);
+			ret = false;
+		}
+	}
+	free(buf);
+
+	if (ret && (fp_port <= 0 || fp_port > 65535 || fp_job_ms <= 0 || fp_diff <= 0.)) {
+		applog(LOG_ERR, "fake-pool: invalid port, job interval or difficulty");
+		ret = false;
+	}
+	if (!fp_seed) fp_seed = 1;
+	return ret;
+}
+
+/* start the server thread, return the listening port or 0 */
+int fakepool_start(const char *spec)
+{
+	struct sockaddr_in serv;
+
+	if (!fp_parse_spec(spec))
+		return 0;
+
+	switch (opt_algo) {
+		case ALGO_CRYPTOLIGHT:
+		case ALGO_CRYPTONIGHT:
+		case ALGO_DECRED:
+		case ALGO_EQUIHASH:
+		case ALGO_LBRY:
+		case ALGO_PHI2:
+		case ALGO_SIA:
+		case ALGO_WILDKECCAK:
+			applog(LOG_ERR, "fake-pool: %s stratum jobs are not supported", algo_names[opt_algo]);
+			return 0;
+		case ALGO_HEAVY:
+		case ALGO_MJOLLNIR:
+		case ALGO_ZR5:
+			fp_algo = NULL;
+			break;
+		default:
+			fp_algo = cpu_hash_find(algo_names[opt_algo]);
+			if (fp_algo && fp_algo->datalen != 80)
+				fp_algo = NULL;
+	}
+	if (!fp_algo)
+		applog(LOG_WARNING, "fake-pool: %s shares will not be checked", algo_names[opt_algo]);
+
+	if (fp_replay_file && !fp_load_replay(fp_replay_file))
+		return 0;
+	fp_cur_diff = fp_diff;
+
+#ifdef WIN32
+	WSADATA wsa;
+	WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+	fp_sock = socket(AF_INET, SOCK_STREAM, 0);
+	if (fp_sock == INVSOCK) {
+		applog(LOG_ERR, "fake-pool: socket failed (%s)", strerror(errno));
+		return 0;
+	}
+#ifndef WIN32
+	int optval = 1;
+	setsockopt(fp_sock, SOL_SOCKET, SO_REUSEADDR, (void *)(&optval), sizeof(optval));
+#endif
+	memset(&serv, 0, sizeof(serv));
+	serv.sin_family = AF_INET;
+	serv.sin_addr.s_addr = inet_addr("127.0.0.1");
+	serv.sin_port = htons((unsigned short) fp_port);
+	if (SOCKETFAIL(bind(fp_sock, (struct sockaddr *)(&serv), sizeof(serv))) ||
+	    SOCKETFAIL(listen(fp_sock, 1))) {
+		applog(LOG_ERR, "fake-pool: bind to port %d failed (%s)", fp_port, strerror(errno));
+		CLOSESOCKET(fp_sock);
+		fp_sock = INVSOCK;
+		return 0;
+	}
+
+	fp_stopping = false;
+	if (pthread_create(&fp_thr, NULL, fp_thread, NULL)) {
+		applog(LOG_ERR, "fake-pool: thread create failed");
+		CLOSESOCKET(fp_sock);
+		fp_sock = INVSOCK;
+		return 0;
+	}
+	fp_running = true;
+	applog(LOG_INFO, "fake-pool: listening on 127.0.0.1:%d, %s jobs every %d ms",
+		fp_port, fp_replay_count ? "replayed" : "synthetic", fp_job_ms);
+	return fp_port;
+}
+
+/* stop the server and log the final report */
+void fakepool_stop()
+{
+	if (!fp_running)
+		return;
+	fp_running = false;
+	fp_stopping = true;
+	pthread_join(fp_thr, NULL);
+	CLOSESOCKET(fp_sock);
+	fp_sock = INVSOCK;
+	fp_report();
+
+	for (int i = 0; i < FP_JOBS; i++) {
+		free(fp_jobs[i].coinb1);
+		free(fp_jobs[i].coinb2);
+	}
+	memset(fp_jobs, 0, sizeof(fp_jobs));
+	for (int i = 0; i < fp_replay_count; i++)
+		json_decref(fp_replay[i]);
+	free(fp_replay);
+	fp_replay = NULL;
+	fp_replay_count = 0;
+}
+
+/* called by the miner threads before a scan, job_id is the pool one */
+void fakepool_job_started(int thr_id, const char *job_id)
+{
+	if (thr_id < 0 || thr_id >= MAX_GPUS || !strncmp(fp_thr_job[thr_id], job_id, sizeof(fp_thr_job[0])))
+		return;
+	snprintf(fp_thr_job[thr_id], sizeof(fp_thr_job[0]), "%s", job_id);
+
+	pthread_mutex_lock(&fp_lock);
+	struct fp_job *job = fp_find_job(job_id);
+	if (job) {
+		double ms = (fp_now_us() - job->sent_us) / 1000.;
+		if (!job->started) {
+			fp_stats.first_ms_sum += ms;
+			fp_stats.first_ms_max = max(fp_stats.first_ms_max, ms);
+			fp_stats.first_n++;
+		}
+		if (++job->started == opt_n_threads) {
+			fp_stats.all_ms_sum += ms;
+			fp_stats.all_n++;
+		}
+	}
+	pthread_mutex_unlock(&fp_lock);
+}
+
+/* time between a share submit and the pool answer */
+void fakepool_submit_rtt(uint32_t msec)
+{
+	pthread_mutex_lock(&fp_lock);
+	fp_stats.rtt_ms_sum += msec;
+	fp_stats.rtt_ms_max = max(fp_stats.rtt_ms_max, msec);
+	fp_stats.rtt_n++;
+	pthread_mutex_unlock(&fp_lock);
+}
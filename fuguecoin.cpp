@@ -71,9 +71,11 @@ int scanhash_fugue256(int thr_id, struct work* work, uint32_t max_nonce, unsigne
 			sph_fugue256_context ctx_fugue;
 			endiandata[19] = SWAP32(foundNounce);
 
+			uint64_t vstart = vstats_clock();
 			sph_fugue256_init(&ctx_fugue);
 			sph_fugue256 (&ctx_fugue, endiandata, 80);
 			sph_fugue256_close(&ctx_fugue, &vhash);
+			vstats_verified(thr_id, vstart);
 
 			if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget))
 			{
@@ -0,0 +1,751 @@
+/**
+ * Solo mining with getblocktemplate (--coinbase-addr)
+ *
+ * The work is assembled locally from the block template: a coinbase paying
+ * the configured address with an 8 bytes extranonce, the merkle root from
+ * the branch of the template transactions (computed once per template) and
+ * the block header. A new work is only a new extranonce and a few hashes,
+ * the daemon is called when the template changes (gbt longpoll) or, when
+ * longpoll is not supported, after the scantime. Blocks are sent with
+ * submitblock.
+ *
+ * Only the algos using the bitcoin 80 bytes header are supported.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/time.h>
+#include <openssl/sha.h>
+
+#include "miner.h"
+#include "algos.h"
+#include "u256.h"
+
+#define GBT_TEMPLATES   4   /* kept to submit the blocks of the previous ones */
+#define GBT_XNONCE_SIZE 8
+#define GBT_MAX_BRANCH  24
+#define GBT_CB_PART     256
+#define GBT_SIG_MAX     64
+
+char *opt_coinbase_addr = NULL;
+char *opt_coinbase_sig = NULL;
+uint32_t opt_coinbase_xnonce = 0;
+
+extern volatile time_t g_work_time;
+extern int opt_scantime;
+
+struct gbt_template {
+	uint32_t id;
+	int pooln;
+	time_t fetched;
+	uint32_t version;
+	uint32_t nbits;
+	uint32_t curtime;
+	uint32_t height;
+	uint32_t target[8];
+	uchar prevhash[32];
+	/* coinbase without witness: coinb1 + extranonce + coinb2 */
+	uchar coinb1[GBT_CB_PART];
+	uchar coinb2[GBT_CB_PART];
+	int coinb1_size;
+	int coinb2_size;
+	bool segwit;
+	int merkle_count;
+	uchar merkle[GBT_MAX_BRANCH][32];
+	int tx_count;
+	char *txs_hex;
+	char *longpollid;
+};
+
+static struct gbt_template tpls[GBT_TEMPLATES];
+static int tpl_cur = -1;
+static uint32_t tpl_next_id = 1;
+static uint32_t xnonce_count = 0;
+static pthread_mutex_t gbt_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uchar payout_script[64];
+static int payout_size = 0;
+
+static volatile bool gbt_lp_running = false;
+
+static const char *gbt_req =
+	"{\"method\": \"getblocktemplate\", \"params\": [{\"rules\": [\"segwit\"]}], \"id\":9}\r\n";
+
+bool gbt_algo_supported(int algo)
+{
+	switch (algo) {
+	case ALGO_CRYPTOLIGHT:
+	case ALGO_CRYPTONIGHT:
+	case ALGO_DECRED:
+	case ALGO_EQUIHASH:
+	case ALGO_HEAVY:
+	case ALGO_LBRY:
+	case ALGO_MJOLLNIR:
+	case ALGO_PHI2:
+	case ALGO_SIA:
+	case ALGO_WILDKECCAK:
+	case ALGO_ZR5:
+		return false;
+	}
+	return true;
+}
+
+static int put_varint(uchar *p, uint64_t n)
+{
+	if (n < 0xfd) {
+		p[0] = (uchar) n;
+		return 1;
+	} else if (n <= 0xffff) {
+		p[0] = 0xfd; p[1] = (uchar) n; p[2] = (uchar) (n >> 8);
+		return 3;
+	}
+	p[0] = 0xfe;
+	le32enc(&p[1], (uint32_t) n);
+	return 5;
+}
+
+/* script number push, as CScript() << height (bip34) */
+static int put_script_num(uchar *p, uint32_t n)
+{
+	int len = 0;
+	if (n == 0) {
+		p[0] = 0x00; /* OP_0 */
+		return 1;
+	}
+	if (n <= 16) {
+		p[0] = 0x50 + n; /* OP_1..OP_16 */
+		return 1;
+	}
+	while (n) {
+		p[1 + len++] = n & 0xff;
+		n >>= 8;
+	}
+	if (p[len] & 0x80)
+		p[1 + len++] = 0;
+	p[0] = len;
+	return len + 1;
+}
+
+/* hex in rpc order (reversed) to internal bytes */
+static bool hex2bin_rev(uchar *out, const char *hex, size_t len)
+{
+	if (!hex || strlen(hex) != len * 2 || !hex2bin(out, hex, len))
+		return false;
+	for (size_t i = 0; i < len / 2; i++) {
+		uchar t = out[i];
+		out[i] = out[len - 1 - i];
+		out[len - 1 - i] = t;
+	}
+	return true;
+}
+
+static const char b58digits[] = "123456789ABCDEFGHJKLMNPQRSTUVWXYZabcdefghijkmnopqrstuvwxyz";
+
+/* legacy base58 address, p2sh when the version is a known one */
+static int b58_address_script(uchar *script, const char *addr)
+{
+	uchar bin[32] = { 0 };
+	uchar hash[32];
+	size_t len = strlen(addr);
+	int size = 0;
+
+	for (size_t i = 0; i < len; i++) {
+		const char *c = strchr(b58digits, addr[i]);
+		if (!c)
+			return 0;
+		uint32_t carry = (uint32_t) (c - b58digits);
+		for (int j = sizeof(bin) - 1; j >= 0; j--) {
+			carry += 58 * bin[j];
+			bin[j] = carry & 0xff;
+			carry >>= 8;
+		}
+		if (carry)
+			return 0;
+	}
+	// the result is 25 bytes, ignore the leading zeros of p2pkh "1..." addresses
+	const uchar *p = &bin[sizeof(bin) - 25];
+	for (size_t i = 0; i < sizeof(bin) - 25; i++)
+		if (bin[i]) return 0;
+	sha256d(hash, p, 21);
+	if (memcmp(hash, &p[21], 4))
+		return 0;
+
+	switch (p[0]) {
+	case 5: case 196: case 50: case 58: // btc, testnet, ltc "M" and "Q"
+		script[size++] = 0xa9; // OP_HASH160
+		script[size++] = 20;
+		memcpy(&script[size], &p[1], 20); size += 20;
+		script[size++] = 0x87; // OP_EQUAL
+		break;
+	default:
+		script[size++] = 0x76; // OP_DUP
+		script[size++] = 0xa9; // OP_HASH160
+		script[size++] = 20;
+		memcpy(&script[size], &p[1], 20); size += 20;
+		script[size++] = 0x88; // OP_EQUALVERIFY
+		script[size++] = 0xac; // OP_CHECKSIG
+	}
+	return size;
+}
+
+/* the daemon knows all the address formats (bech32...), ask it first */
+static bool gbt_payout_script(CURL *curl, struct pool_infos *pool)
+{
+	char req[256];
+	int err = 0;
+
+	snprintf(req, sizeof(req), "{\"method\": \"validateaddress\", \"params\": [\"%s\"], \"id\":11}\r\n",
+		opt_coinbase_addr);
+	json_t *val = json_rpc_call_pool(curl, pool, req, false, false, &err);
+	json_t *res = json_object_get(val, "result");
+	if (res && !json_is_true(json_object_get(res, "isvalid"))) {
+		applog(LOG_ERR, "gbt: invalid coinbase address %s", opt_coinbase_addr);
+		json_decref(val);
+		proper_exit(EXIT_CODE_USAGE);
+		return false;
+	}
+	const char *hex = json_string_value(json_object_get(res, "scriptPubKey"));
+	if (hex && strlen(hex) && strlen(hex) <= 2 * sizeof(payout_script)
+	    && hex2bin(payout_script, hex, strlen(hex) / 2)) {
+		payout_size = (int) strlen(hex) / 2;
+	} else {
+		payout_size = b58_address_script(payout_script, opt_coinbase_addr);
+	}
+	json_decref(val);
+
+	if (!payout_size) {
+		applog(LOG_ERR, "gbt: unable to get the script of address %s", opt_coinbase_addr);
+		proper_exit(EXIT_CODE_USAGE);
+		return false;
+	}
+	return true;
+}
+
+/* coinbase parts around the extranonce, and the merkle branch */
+static bool gbt_template_decode(struct gbt_template *t, const json_t *res)
+{
+	uchar *cb = t->coinb1;
+	uchar *sig;
+	int n = 0, siglen = 0;
+	json_t *key, *txs, *tx;
+	size_t idx;
+
+	key = json_object_get(res, "height");
+	if (!key || !json_is_integer(key)) {
+		applog(LOG_ERR, "gbt: template without height");
+		return false;
+	}
+	t->height = (uint32_t) json_integer_value(key);
+	t->version = (uint32_t) json_integer_value(json_object_get(res, "version"));
+	t->curtime = (uint32_t) json_integer_value(json_object_get(res, "curtime"));
+	const char *bits = json_string_value(json_object_get(res, "bits"));
+	if (!bits || strlen(bits) != 8) {
+		applog(LOG_ERR, "gbt: invalid bits");
+		return false;
+	}
+	t->nbits = (uint32_t) strtoul(bits, NULL, 16);
+	if (!hex2bin_rev(t->prevhash, json_string_value(json_object_get(res, "previousblockhash")), 32)) {
+		applog(LOG_ERR, "gbt: invalid previousblockhash");
+		return false;
+	}
+	uchar tgt[32];
+	if (hex2bin_rev(tgt, json_string_value(json_object_get(res, "target")), 32)) {
+		for (int i = 0; i < 8; i++)
+			t->target[i] = le32dec(&tgt[4 * i]);
+	} else {
+		struct u256 v;
+		u256_from_compact(&v, t->nbits);
+		u256_store(t->target, &v);
+	}
+	uint64_t value = (uint64_t) json_integer_value(json_object_get(res, "coinbasevalue"));
+
+	/* coinbase: version, 1 input with the height, flags, extranonce and sig */
+	le32enc(&cb[n], 1); n += 4;
+	cb[n++] = 1;
+	memset(&cb[n], 0, 32); n += 32;
+	le32enc(&cb[n], 0xffffffff); n += 4;
+	sig = &cb[n++]; // script size, set below
+	siglen = put_script_num(&cb[n], t->height);
+	const char *flags = json_string_value(json_object_get(json_object_get(res, "coinbaseaux"), "flags"));
+	if (flags && strlen(flags) && strlen(flags) <= 32) {
+		cb[n + siglen] = (uchar) (strlen(flags) / 2);
+		if (hex2bin(&cb[n + siglen + 1], flags, strlen(flags) / 2))
+			siglen += 1 + (int) strlen(flags) / 2;
+	}
+	cb[n + siglen++] = GBT_XNONCE_SIZE;
+	n += siglen;
+	t->coinb1_size = n;
+	siglen += GBT_XNONCE_SIZE;
+
+	cb = t->coinb2;
+	n = 0;
+	if (opt_coinbase_sig) {
+		int len = min((int) strlen(opt_coinbase_sig), GBT_SIG_MAX);
+		cb[n++] = (uchar) len;
+		memcpy(&cb[n], opt_coinbase_sig, len); n += len;
+		siglen += len + 1;
+	}
+	*sig = (uchar) siglen;
+	le32enc(&cb[n], 0xffffffff); n += 4;
+
+	/* outputs: the payout and the segwit commitment */
+	const char *commit = json_string_value(json_object_get(res, "default_witness_commitment"));
+	t->segwit = commit && strlen(commit) && strlen(commit) < 2 * 64;
+	cb[n++] = t->segwit ? 2 : 1;
+	le32enc(&cb[n], (uint32_t) value);
+	le32enc(&cb[n + 4], (uint32_t) (value >> 32));
+	n += 8;
+	cb[n++] = (uchar) payout_size;
+	memcpy(&cb[n], payout_script, payout_size); n += payout_size;
+	if (t->segwit) {
+		memset(&cb[n], 0, 8); n += 8;
+		cb[n++] = (uchar) (strlen(commit) / 2);
+		hex2bin(&cb[n], commit, strlen(commit) / 2);
+		n += (int) strlen(commit) / 2;
+	}
+	le32enc(&cb[n], 0); n += 4; // locktime
+	t->coinb2_size = n;
+
+	/* transactions, the branch is the path of the coinbase (index 0) */
+	txs = json_object_get(res, "transactions");
+	t->tx_count = json_is_array(txs) ? (int) json_array_size(txs) : 0;
+	size_t hexlen = 0;
+	json_array_foreach(txs, idx, tx) {
+		const char *data = json_string_value(json_object_get(tx, "data"));
+		if (data) hexlen += strlen(data);
+	}
+	t->txs_hex = (char*) malloc(hexlen + 1);
+	uchar (*level)[32] = (uchar(*)[32]) calloc(t->tx_count + 2, 32);
+	if (!t->txs_hex || !level) {
+		free(level);
+		return false;
+	}
+	char *p = t->txs_hex;
+	*p = '\0';
+	json_array_foreach(txs, idx, tx) {
+		const char *data = json_string_value(json_object_get(tx, "data"));
+		json_t *txid = json_object_get(tx, "txid");
+		if (!txid) txid = json_object_get(tx, "hash");
+		if (!data || !hex2bin_rev(level[idx + 1], json_string_value(txid), 32)) {
+			applog(LOG_ERR, "gbt: invalid transaction %d", (int) idx);
+			free(level);
+			return false;
+		}
+		strcpy(p, data);
+		p += strlen(data);
+	}
+
+	t->merkle_count = 0;
+	for (int count = t->tx_count + 1; count > 1; count /= 2) {
+		if (t->merkle_count == GBT_MAX_BRANCH) {
+			free(level);
+			return false;
+		}
+		memcpy(t->merkle[t->merkle_count++], level[1], 32);
+		if (count & 1) {
+			memcpy(level[count], level[count - 1], 32);
+			count++;
+		}
+		for (int i = 1; i < count / 2; i++)
+			sha256d(level[i], level[2 * i], 64);
+	}
+	free(level);
+
+	free(t->longpollid);
+	t->longpollid = NULL;
+	const char *lpid = json_string_value(json_object_get(res, "longpollid"));
+	if (lpid) t->longpollid = strdup(lpid);
+	return true;
+}
+
+static void gbt_coinbase(const struct gbt_template *t, const uchar *xnonce, uchar *cb, int *size)
+{
+	memcpy(cb, t->coinb1, t->coinb1_size);
+	memcpy(&cb[t->coinb1_size], xnonce, GBT_XNONCE_SIZE);
+	memcpy(&cb[t->coinb1_size + GBT_XNONCE_SIZE], t->coinb2, t->coinb2_size);
+	*size = t->coinb1_size + GBT_XNONCE_SIZE + t->coinb2_size;
+}
+
+/* next extranonce of the template, called with gbt_lock */
+static void gbt_build_work(const struct gbt_template *t, struct work *work)
+{
+	uchar cb[2 * GBT_CB_PART + GBT_XNONCE_SIZE];
+	uchar merkle_root[64];
+	uchar header[80];
+	uchar xnonce[GBT_XNONCE_SIZE];
+	int cbsize;
+
+	le32enc(&xnonce[0], opt_coinbase_xnonce);
+	le32enc(&xnonce[4], ++xnonce_count);
+	gbt_coinbase(t, xnonce, cb, &cbsize);
+
+	// same coinbase hash as stratum_gen_work()
+	switch (opt_algo) {
+	case ALGO_FUGUE256:
+	case ALGO_GROESTL:
+	case ALGO_KECCAK:
+	case ALGO_BLAKECOIN:
+	case ALGO_WHIRLCOIN:
+		SHA256(cb, cbsize, merkle_root);
+		break;
+	default:
+		sha256d(merkle_root, cb, cbsize);
+	}
+	for (int i = 0; i < t->merkle_count; i++) {
+		memcpy(merkle_root + 32, t->merkle[i], 32);
+		sha256d(merkle_root, merkle_root, 64);
+	}
+
+	uint32_t ntime = t->curtime + (uint32_t) (time(NULL) - t->fetched);
+	le32enc(&header[0], t->version);
+	memcpy(&header[4], t->prevhash, 32);
+	memcpy(&header[36], merkle_root, 32);
+	le32enc(&header[68], ntime);
+	le32enc(&header[72], t->nbits);
+	le32enc(&header[76], 0);
+
+	memset(work->data, 0, sizeof(work->data));
+	for (int i = 0; i < 20; i++)
+		work->data[i] = be32dec(&header[4 * i]);
+	work->data[20] = 0x80000000;
+	work->data[31] = 0x00000280;
+
+	memcpy(work->target, t->target, sizeof(work->target));
+	work->targetdiff = target_to_diff(work->target);
+	work->height = t->height;
+	work->pooln = t->pooln;
+	work->xnonce2_len = GBT_XNONCE_SIZE;
+	memcpy(work->xnonce2, xnonce, GBT_XNONCE_SIZE);
+	snprintf(work->job_id, sizeof(work->job_id), "%07x %x", ntime & 0xfffffff, t->id);
+
+	net_diff = u256_nbits_to_diff(t->nbits);
+	stratum_diff = work->targetdiff;
+}
+
+static struct gbt_template* gbt_find(uint32_t id)
+{
+	for (int i = 0; i < GBT_TEMPLATES; i++)
+		if (tpls[i].id == id) return &tpls[i];
+	return NULL;
+}
+
+/* decode a getblocktemplate answer in the next slot, return it when changed */
+static struct gbt_template* gbt_template_update(json_t *val, int pooln)
+{
+	struct gbt_template *t;
+	json_t *res = json_object_get(val, "result");
+	int slot = (tpl_cur + 1) % GBT_TEMPLATES;
+
+	if (!res)
+		return NULL;
+
+	pthread_mutex_lock(&gbt_lock);
+	t = &tpls[slot];
+	free(t->txs_hex);
+	t->txs_hex = NULL;
+	t->id = 0;
+	if (!gbt_template_decode(t, res)) {
+		pthread_mutex_unlock(&gbt_lock);
+		return NULL;
+	}
+	t->pooln = pooln;
+	t->fetched = time(NULL);
+	t->id = tpl_next_id++;
+	struct gbt_template *prev = tpl_cur >= 0 ? &tpls[tpl_cur] : NULL;
+	if (!prev || prev->height != t->height) {
+		if (!opt_quiet)
+			applog(LOG_BLUE, "%s block %u, diff %.2f, %d txs", algo_names[opt_algo],
+				t->height, u256_nbits_to_diff(t->nbits), t->tx_count);
+	}
+	tpl_cur = slot;
+	pthread_mutex_unlock(&gbt_lock);
+	return t;
+}
+
+/* wait for the template changes (blocks and new transactions) */
+static void *gbt_longpoll_thread(void *userdata)
+{
+	int pooln = (int) (size_t) userdata;
+	struct pool_infos *pool = &pools[pooln];
+	CURL *curl = curl_easy_init();
+	char *req = NULL;
+
+	while (curl && !abort_flag && cur_pooln == pooln) {
+		struct timeval tv_start, tv_end, diff;
+		uchar prevhash[32];
+		int err = 0;
+
+		pthread_mutex_lock(&gbt_lock);
+		struct gbt_template *t = &tpls[tpl_cur];
+		if (!t->longpollid) {
+			pthread_mutex_unlock(&gbt_lock);
+			break;
+		}
+		req = (char*) realloc(req, strlen(t->longpollid) + 128);
+		sprintf(req, "{\"method\": \"getblocktemplate\", \"params\": [{\"rules\": [\"segwit\"], "
+			"\"longpollid\": \"%s\"}], \"id\":9}\r\n", t->longpollid);
+		memcpy(prevhash, t->prevhash, 32);
+		uint32_t id = t->id;
+		pthread_mutex_unlock(&gbt_lock);
+
+		gettimeofday(&tv_start, NULL);
+		json_t *val = json_rpc_longpoll(curl, pool->url, pool, req, &err);
+		gettimeofday(&tv_end, NULL);
+		if (abort_flag || cur_pooln != pooln) {
+			if (val) json_decref(val);
+			break;
+		}
+		if (!val) {
+			sleep(1);
+			continue;
+		}
+		t = gbt_template_update(val, pooln);
+		json_decref(val);
+		if (!t)
+			continue;
+
+		timeval_subtract(&diff, &tv_end, &tv_start);
+		if (diff.tv_sec == 0 && !memcmp(prevhash, t->prevhash, 32) && t->id == id + 1) {
+			// immediate answer with the same block, longpollid is ignored
+			if (opt_debug)
+				applog(LOG_DEBUG, "gbt: longpoll not supported by the daemon");
+			break;
+		}
+		if (opt_debug)
+			applog(LOG_DEBUG, "gbt: new template %u (block %u)", t->id, t->height);
+		// the miner threads will take a work of the new template
+		g_work_time = 0;
+		restart_threads();
+	}
+
+	free(req);
+	if (curl) curl_easy_cleanup(curl);
+	gbt_lp_running = false;
+	return NULL;
+}
+
+/* new work of the current template, false if it is missing or too old */
+bool gbt_gen_work(struct work *work, int pooln)
+{
+	bool rc = false;
+	pthread_mutex_lock(&gbt_lock);
+	if (tpl_cur >= 0) {
+		struct gbt_template *t = &tpls[tpl_cur];
+		time_t age = time(NULL) - t->fetched;
+		if (t->pooln == pooln && (gbt_lp_running || age < opt_scantime)) {
+			gbt_build_work(t, work);
+			rc = true;
+		}
+	}
+	pthread_mutex_unlock(&gbt_lock);
+	return rc;
+}
+
+/* workio thread, fetch a template then build the work */
+bool gbt_get_work(CURL *curl, struct pool_infos *pool, struct work *work)
+{
+	int err = 0;
+
+	if (!payout_size && !gbt_payout_script(curl, pool))
+		return false;
+
+	json_t *val = json_rpc_call_pool(curl, pool, gbt_req, false, false, &err);
+	if (!val)
+		return false;
+	struct gbt_template *t = gbt_template_update(val, work->pooln);
+	json_decref(val);
+	if (!t)
+		return false;
+
+	if (t->longpollid && want_longpoll && !gbt_lp_running) {
+		pthread_t pth;
+		gbt_lp_running = true;
+		if (pthread_create(&pth, NULL, gbt_longpoll_thread, (void*) (size_t) work->pooln)) {
+			gbt_lp_running = false;
+		} else {
+			pthread_detach(pth);
+			if (!opt_quiet)
+				applog(LOG_BLUE, "Long-polling on %s (gbt)", pool->short_url);
+		}
+	}
+
+	pthread_mutex_lock(&gbt_lock);
+	gbt_build_work(t, work);
+	pthread_mutex_unlock(&gbt_lock);
+	return true;
+}
+
+/* submitblock, the block is rebuilt from the template and the work extranonce */
+bool gbt_submit(CURL *curl, struct pool_infos *pool, struct work *work)
+{
+	const int idnonce = work->submit_nonce_id;
+	uchar block[80 + 5 + 2 * GBT_CB_PART + GBT_XNONCE_SIZE + 40];
+	uchar cb[2 * GBT_CB_PART + GBT_XNONCE_SIZE];
+	char *req = NULL;
+	int cbsize, n = 0;
+	int err = 0;
+
+	pthread_mutex_lock(&gbt_lock);
+	struct gbt_template *t = gbt_find((uint32_t) strtoul(work->job_id + 8, NULL, 16));
+	if (!t || (tpl_cur >= 0 && memcmp(t->prevhash, tpls[tpl_cur].prevhash, 32))) {
+		pthread_mutex_unlock(&gbt_lock);
+		if (opt_debug)
+			applog(LOG_WARNING, "gbt: stale block %u discarded", work->height);
+		return true;
+	}
+
+	for (int i = 0; i < 19; i++)
+		be32enc(&block[4 * i], work->data[i]);
+	be32enc(&block[76], work->nonces[idnonce]);
+	n = 80 + put_varint(&block[80], t->tx_count + 1);
+
+	gbt_coinbase(t, work->xnonce2, cb, &cbsize);
+	if (t->segwit) {
+		// witness serialization, with the 32 bytes reserved value
+		memcpy(&block[n], cb, 4); n += 4;
+		block[n++] = 0; block[n++] = 1;
+		memcpy(&block[n], &cb[4], cbsize - 8); n += cbsize - 8;
+		block[n++] = 1; block[n++] = 32;
+		memset(&block[n], 0, 32); n += 32;
+		memcpy(&block[n], &cb[cbsize - 4], 4); n += 4;
+	} else {
+		memcpy(&block[n], cb, cbsize); n += cbsize;
+	}
+
+	size_t txlen = strlen(t->txs_hex);
+	req = (char*) malloc(2 * n + txlen + 128);
+	if (req) {
+		char *p = req + sprintf(req, "{\"method\": \"submitblock\", \"params\": [\"");
+		cbin2hex(p, (const char*) block, n);
+		p += 2 * n;
+		memcpy(p, t->txs_hex, txlen);
+		p += txlen;
+		sprintf(p, "\"], \"id\":10}\r\n");
+	}
+	pthread_mutex_unlock(&gbt_lock);
+	if (!req) {
+		applog(LOG_ERR, "gbt: submit OOM");
+		return false;
+	}
+
+	// an accepted block has a null result, else the reject reason
+	json_t *val = json_rpc_submit_pool(curl, pool, req, &err);
+	free(req);
+	if (!val && err > 0)
+		return false; // http error, retry
+
+	const char *reason = NULL;
+	char errbuf[32];
+	bool accepted = false;
+	if (val) {
+		json_t *res = json_object_get(val, "result");
+		accepted = json_is_null(res);
+		reason = json_string_value(res);
+	} else {
+		// rpc error, or an empty or invalid reply
+		if (err)
+			sprintf(errbuf, "rpc error %d", err);
+		else
+			strcpy(errbuf, "invalid reply");
+		reason = errbuf;
+	}
+	share_result(accepted, work->pooln, work->sharediff[idnonce], reason);
+	if (val)
+		json_decref(val);
+
+	if (accepted) {
+		// the daemon will send a new template, don't wait the longpoll
+		pthread_mutex_lock(&gbt_lock);
+		if (tpl_cur >= 0)
+			tpls[tpl_cur].fetched = 0;
+		pthread_mutex_unlock(&gbt_lock);
+	}
+	return true;
+}
+
+/* --selftest, a canned template decoded and its first work */
+
+static const char *gbt_test_tpl = "{\"version\": 536870912, \"height\": 500000, "
+	"\"previousblockhash\": \"00000000000000000024fb37364cbf81fd49cc2d51c09c75c35433c3a1945d04\", "
+	"\"curtime\": 1600000000, \"bits\": \"17034219\", \"coinbasevalue\": 625000000, \"transactions\": ["
+	"{\"data\": \"00\", \"txid\": \"1111111111111111111111111111111111111111111111111111111111111111\"}, "
+	"{\"data\": \"00\", \"txid\": \"2222222222222222222222222222222222222222222222222222222222222222\"}, "
+	"{\"data\": \"00\", \"txid\": \"3333333333333333333333333333333333333333333333333333333333333333\"}, "
+	"{\"data\": \"00\", \"txid\": \"4444444444444444444444444444444444444444444444444444444444444444\"}]}";
+
+/* height 500000, extranonce 0x11223344 and 1, the genesis block address */
+static const char *gbt_test_cb =
+	"01000000" "01" "0000000000000000000000000000000000000000000000000000000000000000" "ffffffff"
+	"0d" "0320a107" "08" "4433221101000000" "ffffffff"
+	"01" "40be402500000000" "19" "76a91462e907b15cbf27d5425399ebf6f0fb50ebb88f1888ac" "00000000";
+
+int gbt_selftest(void)
+{
+	static struct gbt_template t;
+	struct work work;
+	uchar cb[2 * GBT_CB_PART + GBT_XNONCE_SIZE], expected[GBT_CB_PART];
+	uchar tree[8][32], header[80];
+	int cbsize, n, errors = 0;
+
+	const enum sha_algos algo = opt_algo;
+	const uint32_t xnonce = opt_coinbase_xnonce, xcount = xnonce_count;
+	char *sig = opt_coinbase_sig;
+	uchar script[sizeof(payout_script)];
+	int script_size = payout_size;
+	memcpy(script, payout_script, sizeof(script));
+
+	opt_algo = ALGO_SHA256D;
+	opt_coinbase_xnonce = 0x11223344;
+	opt_coinbase_sig = NULL;
+	xnonce_count = 0;
+	payout_size = b58_address_script(payout_script, "1A1zP1eP5QGefi2DMPTfTL5SLmv7DivfNa");
+
+	json_t *res = JSON_LOADS(gbt_test_tpl, NULL);
+	memset(&t, 0, sizeof(t));
+	if (!res || !gbt_template_decode(&t, res)) {
+		errors++;
+	} else {
+		memset(&work, 0, sizeof(work));
+		gbt_build_work(&t, &work);
+
+		// the coinbase of the work extranonce
+		gbt_coinbase(&t, work.xnonce2, cb, &cbsize);
+		n = (int) strlen(gbt_test_cb) / 2;
+		hex2bin(expected, gbt_test_cb, n);
+		if (cbsize != n || memcmp(cb, expected, n))
+			errors++;
+
+		// the merkle root of the full tree, the odd levels repeat their last hash
+		sha256d(tree[0], expected, n);
+		for (n = 1; n <= t.tx_count; n++)
+			memset(tree[n], 0x11 * n, 32);
+		for (n = t.tx_count + 1; n > 1; n = (n + 1) / 2) {
+			if (n & 1)
+				memcpy(tree[n], tree[n - 1], 32);
+			for (int i = 0; i < (n + 1) / 2; i++)
+				sha256d(tree[i], tree[2 * i], 64);
+		}
+		for (int i = 0; i < 20; i++)
+			be32enc(&header[4 * i], work.data[i]);
+		if (memcmp(&header[36], tree[0], 32) || memcmp(&header[4], t.prevhash, 32))
+			errors++;
+	}
+	if (res) json_decref(res);
+	free(t.txs_hex);
+	free(t.longpollid);
+
+	opt_algo = algo;
+	opt_coinbase_xnonce = xnonce;
+	opt_coinbase_sig = sig;
+	xnonce_count = xcount;
+	payout_size = script_size;
+	memcpy(payout_script, script, sizeof(script));
+
+	if (errors) {
+		applog(LOG_ERR, "selftest: gbt coinbase or merkle root mismatch");
+		return 1;
+	}
+	return 0;
+}
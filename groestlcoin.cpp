@@ -72,7 +72,7 @@ int scanhash_groestlcoin(int thr_id, struct work *work, uint32_t max_nonce, unsi
 		{
 			uint32_t _ALIGN(64) vhash[8];
 			endiandata[19] = swab32(work->nonces[0]);
-			groestlhash(vhash, endiandata);
+			vstats_hash(thr_id, groestlhash(vhash, endiandata));
 
 			if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
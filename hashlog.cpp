@@ -88,7 +88,7 @@ void hashlog_remember_submit(struct work* work, uint32_t nonce)
 	data.tm_add = data.tm_upd = data.tm_sent = (uint32_t) time(NULL);
 	data.npool = (uint8_t) cur_pooln;
 	data.pool_type = pools[cur_pooln].type;
-	data.job_nonce_id = (uint8_t) stratum.job.shares_count;
+	data.job_nonce_id = (uint8_t) stratum.shares_count;
 	tlastshares[key] = data;
 }
 
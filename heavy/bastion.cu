@@ -163,7 +163,7 @@ int scanhash_bastion(int thr_id, struct work *work, uint32_t max_nonce, unsigned
 			uint32_t _ALIGN(64) vhash[8];
 			const uint32_t Htarg = ptarget[7];
 			endiandata[19] = work->nonces[0];
-			bastionhash(vhash, (uchar*) endiandata);
+			vstats_hash(thr_id, bastionhash(vhash, (uchar*) endiandata));
 
 			if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
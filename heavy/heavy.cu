@@ -277,7 +277,7 @@ int scanhash_heavy(int thr_id, struct work *work, uint32_t max_nonce, unsigned l
 				if (foundhash[7] <= ptarget[7] && fulltest(foundhash, ptarget)) {
 					uint32_t vhash[8];
 					pdata[19] += nonce - pdata[19];
-					heavycoin_hash((uchar*)vhash, (uchar*)pdata, blocklen);
+					vstats_hash(thr_id, heavycoin_hash((uchar*)vhash, (uchar*)pdata, blocklen));
 					if (memcmp(vhash, foundhash, 32)) {
 						gpu_increment_reject(thr_id);
 						if (!opt_quiet)
@@ -170,7 +170,7 @@ extern "C" int scanhash_lbry(int thr_id, struct work *work, uint32_t max_nonce,
 			resNonces[0] += startNonce;
 
 			endiandata[LBC_NONCE_OFT32] = swab32_if(resNonces[0], !swap);
-			lbry_hash(vhash, endiandata);
+			vstats_hash(thr_id, lbry_hash(vhash, endiandata));
 
 			if (vhash[7] <= Htarg && fulltest(vhash, ptarget))
 			{
@@ -182,7 +182,7 @@ extern "C" int scanhash_lbry(int thr_id, struct work *work, uint32_t max_nonce,
 				{
 					resNonces[1] += startNonce;
 					endiandata[LBC_NONCE_OFT32] = swab32_if(resNonces[1], !swap);
-					lbry_hash(vhash, endiandata);
+					vstats_hash(thr_id, lbry_hash(vhash, endiandata));
 					work->nonces[1] = swab32_if(resNonces[1], swap);
 
 					if (bn_hash_target_ratio(vhash, ptarget) > work->shareratio[0]) {
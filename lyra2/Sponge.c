@@ -24,6 +24,11 @@
 #include "Sponge.h"
 #include "Lyra2.h"
 
+#if defined(__AVX2__) && (BLOCK_LEN_INT64 == 12)
+#define LYRA2_AVX2
+#include <immintrin.h>
+#endif
+
 
 /**
  * Initializes the Sponge State. The first 512 bits are set to zeros and the remainder
@@ -50,6 +55,208 @@ void initState(uint64_t state[/*16*/]) {
 	state[15] = blake2b_IV[7];
 }
 
+#if defined(LYRA2_AVX2)
+
+/* The state rows (v0..v3) (v4..v7) (v8..v11) (v12..v15) are kept in 4 vectors,
+ * a block of 12 words is 3 vectors, one G per 64-bit lane */
+#define ROTR64_32(x) _mm256_shuffle_epi32(x, _MM_SHUFFLE(2,3,0,1))
+#define ROTR64_24(x) _mm256_shuffle_epi8(x, _mm256_setr_epi8( \
+	3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10, \
+	3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10))
+#define ROTR64_16(x) _mm256_shuffle_epi8(x, _mm256_setr_epi8( \
+	2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9, \
+	2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9))
+#define ROTR64_63(x) _mm256_xor_si256(_mm256_srli_epi64(x, 63), _mm256_add_epi64(x, x))
+
+#define G_V(a, b, c, d) \
+	a = _mm256_add_epi64(a, b); d = ROTR64_32(_mm256_xor_si256(d, a)); \
+	c = _mm256_add_epi64(c, d); b = ROTR64_24(_mm256_xor_si256(b, c)); \
+	a = _mm256_add_epi64(a, b); d = ROTR64_16(_mm256_xor_si256(d, a)); \
+	c = _mm256_add_epi64(c, d); b = ROTR64_63(_mm256_xor_si256(b, c));
+
+/* columns, then the diagonals rotated into columns and back */
+#define ROUND_LYRA_V(a, b, c, d) \
+	G_V(a, b, c, d); \
+	b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(0,3,2,1)); \
+	c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1,0,3,2)); \
+	d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(2,1,0,3)); \
+	G_V(a, b, c, d); \
+	b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2,1,0,3)); \
+	c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1,0,3,2)); \
+	d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(0,3,2,1));
+
+#define LOAD_V(p)     _mm256_loadu_si256((const __m256i *) (p))
+#define STORE_V(p, x) _mm256_storeu_si256((__m256i *) (p), x)
+
+#define LOAD_STATE(state) \
+	__m256i s0 = LOAD_V(&state[0]), s1 = LOAD_V(&state[4]); \
+	__m256i s2 = LOAD_V(&state[8]), s3 = LOAD_V(&state[12]);
+#define STORE_STATE(state) \
+	STORE_V(&state[0], s0); STORE_V(&state[4], s1); \
+	STORE_V(&state[8], s2); STORE_V(&state[12], s3);
+
+/* rotW(rand) of the words 0..11: (s11, s0, s1, ..., s10) */
+#define ROTW_V(r0, r1, r2) { \
+	__m256i t0 = _mm256_permute4x64_epi64(s0, _MM_SHUFFLE(2,1,0,3)); \
+	__m256i t1 = _mm256_permute4x64_epi64(s1, _MM_SHUFFLE(2,1,0,3)); \
+	__m256i t2 = _mm256_permute4x64_epi64(s2, _MM_SHUFFLE(2,1,0,3)); \
+	r0 = _mm256_blend_epi32(t0, t2, 0x03); \
+	r1 = _mm256_blend_epi32(t1, t0, 0x03); \
+	r2 = _mm256_blend_epi32(t2, t1, 0x03); }
+
+#define BLAKE2B_LYRA_V() { \
+	int r; \
+	for (r = 0; r < 12; r++) { ROUND_LYRA_V(s0, s1, s2, s3); } }
+
+void squeeze(uint64_t *state, byte *out, unsigned int len)
+{
+	int fullBlocks = len / BLOCK_LEN_BYTES;
+	byte *ptr = out;
+	int i;
+	LOAD_STATE(state);
+
+	//Squeezes full blocks
+	for (i = 0; i < fullBlocks; i++) {
+		STORE_V(ptr, s0); STORE_V(ptr + 32, s1); STORE_V(ptr + 64, s2);
+		BLAKE2B_LYRA_V();
+		ptr += BLOCK_LEN_BYTES;
+	}
+	STORE_STATE(state);
+
+	//Squeezes remaining bytes
+	memcpy(ptr, state, (len % BLOCK_LEN_BYTES));
+}
+
+void absorbBlock(uint64_t *state, const uint64_t *in)
+{
+	LOAD_STATE(state);
+	s0 = _mm256_xor_si256(s0, LOAD_V(&in[0]));
+	s1 = _mm256_xor_si256(s1, LOAD_V(&in[4]));
+	s2 = _mm256_xor_si256(s2, LOAD_V(&in[8]));
+	BLAKE2B_LYRA_V();
+	STORE_STATE(state);
+}
+
+void absorbBlockBlake2Safe(uint64_t *state, const uint64_t *in)
+{
+	LOAD_STATE(state);
+	s0 = _mm256_xor_si256(s0, LOAD_V(&in[0]));
+	s1 = _mm256_xor_si256(s1, LOAD_V(&in[4]));
+	BLAKE2B_LYRA_V();
+	STORE_STATE(state);
+}
+
+/* The row functions keep the state in registers for the whole row */
+void reducedSqueezeRow0(uint64_t* state, uint64_t* rowOut, const uint32_t nCols)
+{
+	uint64_t* ptrWord = rowOut + (nCols-1)*BLOCK_LEN_INT64; //In Lyra2: pointer to M[0][C-1]
+	unsigned int i;
+	LOAD_STATE(state);
+
+	for (i = 0; i < nCols; i++) {
+		STORE_V(&ptrWord[0], s0); STORE_V(&ptrWord[4], s1); STORE_V(&ptrWord[8], s2);
+		ptrWord -= BLOCK_LEN_INT64;
+		ROUND_LYRA_V(s0, s1, s2, s3);
+	}
+	STORE_STATE(state);
+}
+
+void reducedDuplexRow1(uint64_t *state, uint64_t *rowIn, uint64_t *rowOut, const uint32_t nCols)
+{
+	uint64_t* ptrWordIn = rowIn;				//In Lyra2: pointer to prev
+	uint64_t* ptrWordOut = rowOut + (nCols-1)*BLOCK_LEN_INT64; //In Lyra2: pointer to row
+	unsigned int i;
+	LOAD_STATE(state);
+
+	for (i = 0; i < nCols; i++) {
+		__m256i i0 = LOAD_V(&ptrWordIn[0]), i1 = LOAD_V(&ptrWordIn[4]), i2 = LOAD_V(&ptrWordIn[8]);
+
+		s0 = _mm256_xor_si256(s0, i0);
+		s1 = _mm256_xor_si256(s1, i1);
+		s2 = _mm256_xor_si256(s2, i2);
+		ROUND_LYRA_V(s0, s1, s2, s3);
+
+		STORE_V(&ptrWordOut[0], _mm256_xor_si256(i0, s0));
+		STORE_V(&ptrWordOut[4], _mm256_xor_si256(i1, s1));
+		STORE_V(&ptrWordOut[8], _mm256_xor_si256(i2, s2));
+
+		ptrWordIn += BLOCK_LEN_INT64;
+		ptrWordOut -= BLOCK_LEN_INT64;
+	}
+	STORE_STATE(state);
+}
+
+void reducedDuplexRowSetup(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, const uint32_t nCols)
+{
+	uint64_t* ptrWordIn = rowIn;				//In Lyra2: pointer to prev
+	uint64_t* ptrWordInOut = rowInOut;				//In Lyra2: pointer to row*
+	uint64_t* ptrWordOut = rowOut + (nCols-1)*BLOCK_LEN_INT64; //In Lyra2: pointer to row
+	unsigned int i;
+	LOAD_STATE(state);
+
+	for (i = 0; i < nCols; i++) {
+		__m256i i0 = LOAD_V(&ptrWordIn[0]), i1 = LOAD_V(&ptrWordIn[4]), i2 = LOAD_V(&ptrWordIn[8]);
+		__m256i r0, r1, r2;
+
+		s0 = _mm256_xor_si256(s0, _mm256_add_epi64(i0, LOAD_V(&ptrWordInOut[0])));
+		s1 = _mm256_xor_si256(s1, _mm256_add_epi64(i1, LOAD_V(&ptrWordInOut[4])));
+		s2 = _mm256_xor_si256(s2, _mm256_add_epi64(i2, LOAD_V(&ptrWordInOut[8])));
+		ROUND_LYRA_V(s0, s1, s2, s3);
+
+		//M[row][col] = M[prev][col] XOR rand
+		STORE_V(&ptrWordOut[0], _mm256_xor_si256(i0, s0));
+		STORE_V(&ptrWordOut[4], _mm256_xor_si256(i1, s1));
+		STORE_V(&ptrWordOut[8], _mm256_xor_si256(i2, s2));
+
+		//M[row*][col] = M[row*][col] XOR rotW(rand), reloaded as it can be the row
+		ROTW_V(r0, r1, r2);
+		STORE_V(&ptrWordInOut[0], _mm256_xor_si256(LOAD_V(&ptrWordInOut[0]), r0));
+		STORE_V(&ptrWordInOut[4], _mm256_xor_si256(LOAD_V(&ptrWordInOut[4]), r1));
+		STORE_V(&ptrWordInOut[8], _mm256_xor_si256(LOAD_V(&ptrWordInOut[8]), r2));
+
+		ptrWordInOut += BLOCK_LEN_INT64;
+		ptrWordIn += BLOCK_LEN_INT64;
+		ptrWordOut -= BLOCK_LEN_INT64;
+	}
+	STORE_STATE(state);
+}
+
+void reducedDuplexRow(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint64_t *rowOut, const uint32_t nCols)
+{
+	uint64_t* ptrWordInOut = rowInOut; //In Lyra2: pointer to row*
+	uint64_t* ptrWordIn = rowIn; //In Lyra2: pointer to prev
+	uint64_t* ptrWordOut = rowOut; //In Lyra2: pointer to row
+	unsigned int i;
+	LOAD_STATE(state);
+
+	for (i = 0; i < nCols; i++) {
+		__m256i r0, r1, r2;
+
+		s0 = _mm256_xor_si256(s0, _mm256_add_epi64(LOAD_V(&ptrWordIn[0]), LOAD_V(&ptrWordInOut[0])));
+		s1 = _mm256_xor_si256(s1, _mm256_add_epi64(LOAD_V(&ptrWordIn[4]), LOAD_V(&ptrWordInOut[4])));
+		s2 = _mm256_xor_si256(s2, _mm256_add_epi64(LOAD_V(&ptrWordIn[8]), LOAD_V(&ptrWordInOut[8])));
+		ROUND_LYRA_V(s0, s1, s2, s3);
+
+		//M[rowOut][col] = M[rowOut][col] XOR rand
+		STORE_V(&ptrWordOut[0], _mm256_xor_si256(LOAD_V(&ptrWordOut[0]), s0));
+		STORE_V(&ptrWordOut[4], _mm256_xor_si256(LOAD_V(&ptrWordOut[4]), s1));
+		STORE_V(&ptrWordOut[8], _mm256_xor_si256(LOAD_V(&ptrWordOut[8]), s2));
+
+		//M[rowInOut][col] = M[rowInOut][col] XOR rotW(rand), after the rowOut one (same row)
+		ROTW_V(r0, r1, r2);
+		STORE_V(&ptrWordInOut[0], _mm256_xor_si256(LOAD_V(&ptrWordInOut[0]), r0));
+		STORE_V(&ptrWordInOut[4], _mm256_xor_si256(LOAD_V(&ptrWordInOut[4]), r1));
+		STORE_V(&ptrWordInOut[8], _mm256_xor_si256(LOAD_V(&ptrWordInOut[8]), r2));
+
+		ptrWordOut += BLOCK_LEN_INT64;
+		ptrWordInOut += BLOCK_LEN_INT64;
+		ptrWordIn += BLOCK_LEN_INT64;
+	}
+	STORE_STATE(state);
+}
+
+#else /* LYRA2_AVX2 */
+
 /**
  * Execute Blake2b's G function, with all 12 rounds.
  *
@@ -394,6 +601,8 @@ void reducedDuplexRow(uint64_t *state, uint64_t *rowIn, uint64_t *rowInOut, uint
 	}
 }
 
+#endif /* LYRA2_AVX2 */
+
 /**
  * Prints an array of unsigned chars
  */
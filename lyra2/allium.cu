@@ -153,13 +153,21 @@ extern "C" int scanhash_allium(int thr_id, struct work* work, uint32_t max_nonce
 		*hashes_done = pdata[19] - first_nonce + throughput;
 
 		work->nonces[0] = groestl256_cpu_hash_32(thr_id, throughput, pdata[19], d_hash[thr_id], order++);
+		if (work->nonces[0] != UINT32_MAX && validate_async())
+		{
+			// checked by the cpu threads, continue to scan
+			work->nonces[1] = groestl256_getSecNonce(thr_id, 1);
+			if (validate_push_nonces(thr_id, work, endiandata, work->nonces[1] != UINT32_MAX ? 2 : 1, max_nonce, allium_hash))
+				break;
+			continue;
+		}
 		if (work->nonces[0] != UINT32_MAX)
 		{
 			const uint32_t Htarg = ptarget[7];
 			uint32_t _ALIGN(64) vhash[8];
 
 			be32enc(&endiandata[19], work->nonces[0]);
-			allium_hash(vhash, endiandata);
+			vstats_hash(thr_id, allium_hash(vhash, endiandata));
 
 			if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
@@ -167,7 +175,7 @@ extern "C" int scanhash_allium(int thr_id, struct work* work, uint32_t max_nonce
 				work->nonces[1] = groestl256_getSecNonce(thr_id, 1);
 				if (work->nonces[1] != UINT32_MAX) {
 					be32enc(&endiandata[19], work->nonces[1]);
-					allium_hash(vhash, endiandata);
+					vstats_hash(thr_id, allium_hash(vhash, endiandata));
 					bn_set_target_ratio(work, vhash, 1);
 					work->valid_nonces++;
 					pdata[19] = max(work->nonces[0], work->nonces[1]) + 1;
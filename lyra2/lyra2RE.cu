@@ -142,7 +142,7 @@ extern "C" int scanhash_lyra2(int thr_id, struct work* work, uint32_t max_nonce,
 			uint32_t _ALIGN(64) vhash[8];
 
 			be32enc(&endiandata[19], work->nonces[0]);
-			lyra2re_hash(vhash, endiandata);
+			vstats_hash(thr_id, lyra2re_hash(vhash, endiandata));
 
 			if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
@@ -150,7 +150,7 @@ extern "C" int scanhash_lyra2(int thr_id, struct work* work, uint32_t max_nonce,
 				work->nonces[1] = groestl256_getSecNonce(thr_id, 1);
 				if (work->nonces[1] != UINT32_MAX) {
 					be32enc(&endiandata[19], work->nonces[1]);
-					lyra2re_hash(vhash, endiandata);
+					vstats_hash(thr_id, lyra2re_hash(vhash, endiandata));
 					bn_set_target_ratio(work, vhash, 1);
 					work->valid_nonces++;
 					pdata[19] = max(work->nonces[0], work->nonces[1]) + 1;
@@ -103,12 +103,20 @@ extern "C" int scanhash_lyra2Z(int thr_id, struct work* work, uint32_t max_nonce
 
 		work->nonces[0] = lyra2Z_cpu_hash_32(thr_id, throughput, pdata[19], d_hash[thr_id], gtx750ti);
 
+		if (work->nonces[0] != UINT32_MAX && validate_async())
+		{
+			// checked by the cpu threads, continue to scan
+			work->nonces[1] = lyra2Z_getSecNonce(thr_id, 1);
+			if (validate_push_nonces(thr_id, work, endiandata, work->nonces[1] != UINT32_MAX ? 2 : 1, max_nonce, lyra2Z_hash))
+				break;
+			continue;
+		}
 		if (work->nonces[0] != UINT32_MAX)
 		{
 			uint32_t _ALIGN(64) vhash[8];
 
 			be32enc(&endiandata[19], work->nonces[0]);
-			lyra2Z_hash(vhash, endiandata);
+			vstats_hash(thr_id, lyra2Z_hash(vhash, endiandata));
 
 			if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
@@ -118,7 +126,7 @@ extern "C" int scanhash_lyra2Z(int thr_id, struct work* work, uint32_t max_nonce
 				if (work->nonces[1] != UINT32_MAX)
 				{
 					be32enc(&endiandata[19], work->nonces[1]);
-					lyra2Z_hash(vhash, endiandata);
+					vstats_hash(thr_id, lyra2Z_hash(vhash, endiandata));
 					if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 						bn_set_target_ratio(work, vhash, 1);
 						work->valid_nonces++;
@@ -8,6 +8,7 @@ extern "C" {
 #include <ccminer-config.h>
 
 #include <stdbool.h>
+#include <stdarg.h>
 #include <inttypes.h>
 #include <sys/time.h>
 #include <pthread.h>
@@ -642,6 +643,14 @@ extern void format_hashrate_unit(double hashrate, char *output, const char* unit
 extern void applog(int prio, const char *fmt, ...);
 extern void gpulog(int prio, int thr_id, const char *fmt, ...);
 
+/* asynclog.cpp */
+extern bool opt_log_async;
+extern bool opt_log_binary;
+bool applog_async(int prio, const char *fmt, va_list ap);
+bool applog_async_start();
+void applog_async_stop();
+uint64_t applog_dropped();
+
 void get_defconfig_path(char *out, size_t bufsize, char *argv0);
 extern void cbin2hex(char *out, const char *in, size_t len);
 extern char *bin2hex(const unsigned char *in, size_t len);
@@ -651,6 +660,7 @@ extern int timeval_subtract(struct timeval *result, struct timeval *x,
 extern bool fulltest(const uint32_t *hash, const uint32_t *target);
 void diff_to_target(uint32_t* target, double diff);
 void work_set_target(struct work* work, double diff);
+double stratum_diff_factor(int algo);
 double target_to_diff(uint32_t* target);
 extern void get_currentalgo(char* buf, int sz);
 
@@ -668,16 +678,25 @@ void bench_init(int threads);
 void bench_free();
 bool bench_algo_switch_next(int thr_id);
 void bench_set_throughput(int thr_id, uint32_t throughput);
+void bench_set_algo_hashrate(int thr_id, int algo, double hashrate);
+double bench_get_algo_hashrate(int algo);
 void bench_display_results();
 
+#define STRATUM_MAX_JOBID  120 /* work job_id minus the ntime prefix */
+#define STRATUM_MAX_MERKLE 32
+
+/* the buffers are reused by the next notify, only the coinbase grows */
 struct stratum_job {
-	char *job_id;
+	char job_id[STRATUM_MAX_JOBID];
 	unsigned char prevhash[32];
 	size_t coinbase_size;
+	size_t coinbase_alloc;
 	unsigned char *coinbase;
-	unsigned char *xnonce2;
+	unsigned char *xnonce2; /* in the coinbase, after the xnonce1 */
+	size_t xnonce1_size;
+	size_t xnonce2_size;
 	int merkle_count;
-	unsigned char **merkle;
+	unsigned char merkle[STRATUM_MAX_MERKLE][32];
 	unsigned char version[4];
 	unsigned char nbits[4];
 	unsigned char ntime[4];
@@ -685,7 +704,6 @@ struct stratum_job {
 	bool clean;
 	unsigned char nreward[2];
 	uint32_t height;
-	uint32_t shares_count;
 	double diff;
 };
 
@@ -706,7 +724,9 @@ struct stratum_ctx {
 	size_t xnonce1_size;
 	unsigned char *xnonce1;
 	size_t xnonce2_size;
-	struct stratum_job job;
+	struct stratum_job *pub_job; /* see stratum_job_acquire() */
+	uint32_t shares_count;
+	uint32_t block_height; /* equihash show_message */
 
 	struct timeval tv_submit;
 	uint32_t answer_msec;
@@ -829,6 +849,23 @@ json_t * json_rpc_call_pool(CURL *curl, struct pool_infos*,
 	const char *req, bool lp_scan, bool lp, int *err);
 json_t * json_rpc_longpoll(CURL *curl, char *lp_url, struct pool_infos*,
 	const char *req, int *err);
+json_t * json_rpc_submit_pool(CURL *curl, struct pool_infos*,
+	const char *req, int *err);
+
+#define RPC_MULTI_MAX 4
+int json_rpc_call_multi(CURLM *multi, CURL **curls, struct pool_infos*,
+	const char **reqs, json_t **vals, int *errs, int count, bool getwork);
+
+#define RPC_TIMING_MAX 8
+struct rpc_timing {
+	char method[24];
+	uint32_t count;
+	uint32_t fails;
+	double last_ms;
+	double total_ms;
+	double max_ms;
+};
+bool rpc_timing_get(int n, struct rpc_timing *out);
 
 bool stratum_socket_full(struct stratum_ctx *sctx, int timeout);
 bool stratum_send_line(struct stratum_ctx *sctx, char *s);
@@ -839,6 +876,8 @@ bool stratum_subscribe(struct stratum_ctx *sctx);
 bool stratum_authorize(struct stratum_ctx *sctx, const char *user, const char *pass);
 bool stratum_handle_method(struct stratum_ctx *sctx, const char *s);
 void stratum_free_job(struct stratum_ctx *sctx);
+bool stratum_job_coinbase(struct stratum_job *job, size_t size);
+extern bool stratum_fast_json;
 
 bool rpc2_stratum_authorize(struct stratum_ctx *sctx, const char *user, const char *pass);
 
@@ -850,6 +889,8 @@ void equi_work_set_target(struct work* work, double diff);
 void equi_store_work_solution(struct work* work, uint32_t* hash, void* sol_data);
 int equi_verify_sol(void * const hdr, void * const sol);
 double equi_network_diff(struct work *work);
+extern int opt_equihash_cpu;
+int equi_cpu_bench(FILE *out, int nthreads);
 
 void hashlog_remember_submit(struct work* work, uint32_t nonce);
 void hashlog_remember_scan_range(struct work* work);
@@ -893,6 +934,8 @@ extern void tq_thaw(struct thread_q *tq);
 void parse_arg(int key, char *arg);
 void proper_exit(int reason);
 void restart_threads(void);
+bool stratum_roll_work(struct work *work);
+int share_result(int result, int pooln, double sharediff, const char *reason);
 
 size_t time2str(char* buf, time_t timer);
 char* atime2str(time_t timer);
@@ -915,6 +958,7 @@ void cryptolight_hash(void* output, const void* input);
 void cryptonight_hash_variant(void* output, const void* input, size_t len, int variant);
 void cryptonight_hash(void* output, const void* input);
 void monero_hash(void* output, const void* input);
+void graft_hash(void* output, const void* input);
 void stellite_hash(void* output, const void* input);
 void decred_hash(void *state, const void *input);
 void deephash(void *state, const void *input);
@@ -952,11 +996,13 @@ void sibhash(void *output, const void *input);
 void skeincoinhash(void *output, const void *input);
 void skein2hash(void *output, const void *input);
 void skunk_hash(void *state, const void *input);
+void sonoa_hash(void *output, const void *input);
 void s3hash(void *output, const void *input);
 void timetravel_hash(void *output, const void *input);
 void bitcore_hash(void *output, const void *input);
 void exosis_hash(void *output, const void *input);
 void tribus_hash(void *output, const void *input);
+void vanillahash(void *output, const void *input, int8_t blakerounds);
 void veltorhash(void *output, const void *input);
 void wcoinhash(void *state, const void *input);
 void whirlxHash(void *state, const void *input);
@@ -970,9 +1016,168 @@ void x16r_hash(void *output, const void *input);
 void x16s_hash(void *output, const void *input);
 void x17hash(void *output, const void *input);
 void wildkeccak_hash(void *output, const void *input, uint64_t* scratchpad, uint64_t ssize);
+/* 16 hashes interleaved, the nonces replace the input bytes 1-4, outputs 32 bytes apart */
+void wildkeccak_hash_n(void *output, const void *input, const uint32_t *nonces, int count,
+	const uint64_t *pad, uint64_t pad_words);
+uint64_t* wildkeccak_pad_alloc(size_t sz, bool populate);
+void wildkeccak_pad_free(uint64_t *pad, size_t sz);
+int scanhash_wildkeccak_cpu(int thr_id, struct work* work, uint32_t max_nonce, unsigned long *hashes_done);
+extern int opt_wildkeccak_cpu;
 void zr5hash(void *output, const void *input);
 void zr5hash_pok(void *output, uint32_t *pdata);
 
+/* cpuhash.cpp */
+typedef void (*cpu_hash_fn)(void *output, const void *input);
+#define CPUH_GLOBAL 1 /* use or change some global vars */
+#define CPUH_SERIAL 2 /* shared global (cryptonight fork, nfactor), not thread safe */
+struct cpu_hash_algo {
+	const char *name;
+	int algo;    /* enum sha_algos */
+	int variant; /* rounds, nfactor or cryptonight variant */
+	int datalen;
+	cpu_hash_fn hash;
+	int flags;
+};
+extern const struct cpu_hash_algo cpu_hash_algos[];
+int cpu_hash_count();
+const struct cpu_hash_algo* cpu_hash_find(const char *name);
+bool cpu_hash_match(const struct cpu_hash_algo *a, int algo);
+void cpu_hash_input(uint8_t *data, int len, uint32_t seed);
+void cpu_hash_prepare(const struct cpu_hash_algo *a);
+
+/* cpubench.cpp */
+extern char *opt_cpu_bench;
+int cpu_bench_run(int nthreads);
+
+/* selftest.cpp */
+extern bool opt_selftest;
+int selftest_run(int nthreads);
+
+/* fakepool.cpp */
+extern char *opt_fake_pool;
+int fakepool_start(const char *spec);
+void fakepool_stop();
+void fakepool_job_started(int thr_id, const char *job_id);
+void fakepool_submit_rtt(uint32_t msec);
+
+/* gbt.cpp */
+extern char *opt_coinbase_addr;
+extern char *opt_coinbase_sig;
+extern uint32_t opt_coinbase_xnonce;
+bool gbt_algo_supported(int algo);
+bool gbt_get_work(CURL *curl, struct pool_infos *pool, struct work *work);
+bool gbt_gen_work(struct work *work, int pooln);
+bool gbt_submit(CURL *curl, struct pool_infos *pool, struct work *work);
+int gbt_selftest(void);
+
+/* proxy.cpp */
+#define PROXY_SUBMIT_ID 0x40000000 /* stratum ids of the proxied shares */
+extern char *opt_proxy_server;
+bool proxy_start(const char *spec);
+void proxy_stop();
+void proxy_notify(struct stratum_ctx *sctx);
+void proxy_share_result(int id, bool accepted, const char *reason);
+int proxy_xnonce2_reserved(size_t xnonce2_size);
+
+/* validate.cpp */
+extern int opt_validate_threads;
+bool validate_start(int nthreads);
+void validate_stop();
+bool validate_async();
+bool validate_algo_supported(int algo);
+bool validate_push(int thr_id, const struct work *work, const uint32_t *endiandata,
+	uint32_t nonce, cpu_hash_fn hash);
+bool validate_push_nonces(int thr_id, struct work *work, uint32_t *endiandata,
+	int count, uint32_t max_nonce, cpu_hash_fn hash);
+int validate_selftest(void);
+bool submit_gpu_nonce(int thr_id, struct work *work, uint32_t nonce);
+
+/* noncespace.cpp */
+bool nonce_space_update(int thr_id, const struct work *tpl);
+bool nonce_space_can_roll(int thr_id);
+bool nonce_space_exhausted(int thr_id);
+uint32_t* nonce_space_ptr(int thr_id, struct work *work);
+int nonce_space_offset(int algo);
+int nonce_lease(int thr_id, struct work *work, uint64_t size, uint32_t *max_nonce);
+bool nonce_in_lease(int thr_id, uint32_t nonce);
+int nonce_lease_done(int thr_id, struct work *work, int rc);
+int nonce_lease_selftest(void);
+
+/* profit.cpp */
+extern char *opt_profit_feed;
+extern int opt_profit_interval;
+extern int opt_profit_margin;
+bool profit_start();
+
+/* stratum-job.cpp */
+struct stratum_job* stratum_job_acquire(struct stratum_ctx *sctx);
+void stratum_job_release(void);
+struct stratum_job* stratum_job_new(void);
+void stratum_job_discard(struct stratum_job *job);
+void stratum_job_publish(struct stratum_ctx *sctx, struct stratum_job *job);
+bool stratum_job_xnonce2(struct stratum_job *job, uchar *xnonce2, bool next);
+
+/* stratum-json.cpp */
+enum sjson_type {
+	SJSON_INVALID = 0, /* missing */
+	SJSON_NULL,
+	SJSON_FALSE,
+	SJSON_TRUE,
+	SJSON_NUMBER,
+	SJSON_STRING,
+	SJSON_ARRAY,
+	SJSON_OBJECT
+};
+/* a value span in the parsed line, strings without the quotes */
+struct sjson_val {
+	const char *p;
+	int len;
+	int type;
+	int count; /* array items */
+};
+#define STRATUM_MSG_PARAMS 16
+struct stratum_msg {
+	struct sjson_val id;
+	struct sjson_val method;
+	struct sjson_val params;
+	struct sjson_val result;
+	struct sjson_val error;
+	int params_count;
+	struct sjson_val param[STRATUM_MSG_PARAMS];
+};
+bool stratum_msg_parse(const char *s, struct stratum_msg *msg);
+int sjson_array_get(const struct sjson_val *arr, struct sjson_val *items, int max);
+bool sjson_is(const struct sjson_val *v, const char *str);
+double sjson_number(const struct sjson_val *v);
+long long sjson_integer(const struct sjson_val *v);
+const char* sjson_string(const struct sjson_val *v, char *buf, int size);
+
+/* vstats.cpp */
+#define VSTATS_BUCKETS 16
+struct vstats_data {
+	int thr_id;
+	int algo;
+	uint64_t candidates; /* gpu results hashed on the cpu */
+	uint64_t false_pos;  /* which didn't validate */
+	uint64_t duplicates; /* already submitted */
+	uint64_t stales;     /* discarded, job or block changed */
+	uint64_t time_ns;
+	uint32_t hist[VSTATS_BUCKETS]; /* log2(us) of the verification times */
+};
+uint64_t vstats_clock(void);
+void vstats_verified(int thr_id, uint64_t start);
+void vstats_false_pos(int thr_id);
+void vstats_duplicate(int thr_id);
+void vstats_stale(int thr_id);
+int vstats_get(int thr_id, struct vstats_data *data, int max_records);
+
+/* time the cpu hash of a gpu result */
+#define vstats_hash(thr_id, call) do { \
+	uint64_t vstats_start_ = vstats_clock(); \
+	call; \
+	vstats_verified(thr_id, vstats_start_); \
+} while (0)
+
 #ifdef __cplusplus
 }
 #endif
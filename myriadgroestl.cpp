@@ -78,13 +78,13 @@ int scanhash_myriad(int thr_id, struct work *work, uint32_t max_nonce, unsigned
 		{
 			uint32_t _ALIGN(64) vhash[8];
 			endiandata[19] = swab32(work->nonces[0]);
-			myriadhash(vhash, endiandata);
+			vstats_hash(thr_id, myriadhash(vhash, endiandata));
 			if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
 				work_set_target_ratio(work, vhash);
 				if (work->nonces[1] != UINT32_MAX) {
 					endiandata[19] = swab32(work->nonces[1]);
-					myriadhash(vhash, endiandata);
+					vstats_hash(thr_id, myriadhash(vhash, endiandata));
 					bn_set_target_ratio(work, vhash, 1);
 					work->valid_nonces = 2;
 					pdata[19] = max(work->nonces[0], work->nonces[1]) + 1;
@@ -33,6 +33,13 @@
 #include <string.h>
 
 #include "neoscrypt.h"
+#include "sph/blake2-simd.h"
+
+/* vectorised SMix, the ASM path has its own */
+#if !defined(ASM) && (defined(__SSE2__) || defined(_M_X64))
+#define NEOSCRYPT_SIMD
+#include <emmintrin.h>
+#endif
 
 #ifdef WIN32
 /* sizeof(unsigned long) = 4 for MinGW64 */
@@ -309,6 +316,7 @@ extern void neoscrypt_blkxor(void *dstp, const void *srcp, uint len);
 
 #else
 
+#if !defined(NEOSCRYPT_SIMD)
 /* Salsa20, rounds must be a multiple of 2 */
 static void neoscrypt_salsa(uint *X, uint rounds)
 {
@@ -378,6 +386,7 @@ static void neoscrypt_chacha(uint *X, uint rounds)
 
 #undef quarter
 }
+#endif /* !NEOSCRYPT_SIMD */
 
 
 /* Fast 32-bit / 64-bit memcpy();
@@ -396,6 +405,7 @@ static void neoscrypt_blkcpy(void *dstp, const void *srcp, uint len)
 	}
 }
 
+#if !defined(NEOSCRYPT_SIMD)
 /* Fast 32-bit / 64-bit block swapper;
  * len must be a multiple of 32 bytes */
 static void neoscrypt_blkswp(void *blkAp, void *blkBp, uint len)
@@ -420,6 +430,7 @@ static void neoscrypt_blkswp(void *blkAp, void *blkBp, uint len)
 		blkB[i + 3] = t3;
 	}
 }
+#endif /* !NEOSCRYPT_SIMD */
 
 /* Fast 32-bit / 64-bit block XOR engine;
  * len must be a multiple of 32 bytes */
@@ -533,75 +544,9 @@ static const uint blake2s_IV[8] = {
 	0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
 };
 
-static const uint8_t blake2s_sigma[10][16] = {
-	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 } ,
-	{ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 } ,
-	{ 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 } ,
-	{  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 } ,
-	{  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 } ,
-	{  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 } ,
-	{ 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 } ,
-	{ 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 } ,
-	{  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 } ,
-	{ 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13 , 0 } ,
-};
-
 static void blake2s_compress(blake2s_state *S, const uint *buf)
 {
-	uint i;
-	uint m[16];
-	uint v[16];
-
-	neoscrypt_copy(m, buf, 64);
-	neoscrypt_copy(v, S, 32);
-
-	v[ 8] = blake2s_IV[0];
-	v[ 9] = blake2s_IV[1];
-	v[10] = blake2s_IV[2];
-	v[11] = blake2s_IV[3];
-	v[12] = S->t[0] ^ blake2s_IV[4];
-	v[13] = S->t[1] ^ blake2s_IV[5];
-	v[14] = S->f[0] ^ blake2s_IV[6];
-	v[15] = S->f[1] ^ blake2s_IV[7];
-
-#define G(r,i,a,b,c,d) do { \
-	a = a + b + m[blake2s_sigma[r][2*i+0]]; \
-	d = ROTR32(d ^ a, 16); \
-	c = c + d; \
-	b = ROTR32(b ^ c, 12); \
-	a = a + b + m[blake2s_sigma[r][2*i+1]]; \
-	d = ROTR32(d ^ a, 8); \
-	c = c + d; \
-	b = ROTR32(b ^ c, 7); \
-} while(0)
-
-#define ROUND(r) do { \
-	G(r, 0, v[ 0], v[ 4], v[ 8], v[12]); \
-	G(r, 1, v[ 1], v[ 5], v[ 9], v[13]); \
-	G(r, 2, v[ 2], v[ 6], v[10], v[14]); \
-	G(r, 3, v[ 3], v[ 7], v[11], v[15]); \
-	G(r, 4, v[ 0], v[ 5], v[10], v[15]); \
-	G(r, 5, v[ 1], v[ 6], v[11], v[12]); \
-	G(r, 6, v[ 2], v[ 7], v[ 8], v[13]); \
-	G(r, 7, v[ 3], v[ 4], v[ 9], v[14]); \
-} while(0)
-
-	ROUND(0);
-	ROUND(1);
-	ROUND(2);
-	ROUND(3);
-	ROUND(4);
-	ROUND(5);
-	ROUND(6);
-	ROUND(7);
-	ROUND(8);
-	ROUND(9);
-
-	for (i = 0; i < 8; i++)
-		S->h[i] = S->h[i] ^ v[i] ^ v[i + 8];
-
-#undef G
-#undef ROUND
+	blake2s_compress_x(S->h, buf, S->t[0], S->t[1], S->f[0]);
 }
 
 static void blake2s_update(blake2s_state *S, const uchar *input, uint input_size)
@@ -773,10 +718,11 @@ static void neoscrypt_fastkdf(const uchar *password, uint password_len, const uc
 		neoscrypt_copy(&output[0], &B[bufptr], a);
 		neoscrypt_copy(&output[a], &B[0], output_len - a);
 	}
+	free(stack);
 	// for (int i = 0; i<10; i++) { printf("cpu fastkdf %d %08x %08x\n", i, ((unsigned int*)output)[2 * i], ((unsigned int*)output)[2 * i + 1]); }
 }
 
-
+#if !defined(NEOSCRYPT_SIMD)
 /* Configurable optimised block mixer */
 static void neoscrypt_blkmix(uint *X, uint *Y, uint r, uint mixmode)
 {
@@ -847,6 +793,7 @@ static void neoscrypt_blkmix(uint *X, uint *Y, uint r, uint mixmode)
 	for (i = 0; i < r; i++)
 		neoscrypt_blkcpy(&X[16 * (i + r)], &Y[16 * (2 * i + 1)], SCRYPT_BLOCK_SIZE);
 }
+#endif /* !NEOSCRYPT_SIMD */
 
 /* NeoScrypt core engine:
  * p = 1, salt = password;
@@ -878,6 +825,7 @@ static void neoscrypt_blkmix(uint *X, uint *Y, uint r, uint mixmode)
  *     .....
  *     11110 = N of 2147483648;
  *   profile bits 30 to 13 are reserved */
+#if !defined(NEOSCRYPT_SIMD)
 void neoscrypt(unsigned char *output, const unsigned char *input, unsigned int profile)
 {
 	uint N = 128, r = 2, dblmix = 1, mixmode = 0x14, stack_align = 0x40;
@@ -985,5 +933,238 @@ void neoscrypt(unsigned char *output, const unsigned char *input, unsigned int p
 		neoscrypt_pbkdf2_sha256(input, 80, (uchar *) X, r * 2 * SCRYPT_BLOCK_SIZE, 1, output, 32);
 		break;
 	}
+	free(stack);
+}
+#endif /* !NEOSCRYPT_SIMD */
+
+
+#if defined(NEOSCRYPT_SIMD)
+
+/* Vectorised SMix: a 64-byte block is 4 rows of 4 words, one per vector.
+ * ChaCha uses the natural rows, Salsa the diagonal ones (tangled blocks). */
+typedef __m128i nsv;
+#define nsv_zero()        _mm_setzero_si128()
+#define nsv_add(a, b)     _mm_add_epi32(a, b)
+#define nsv_xor(a, b)     _mm_xor_si128(a, b)
+#define nsv_rotl(a, n)    _mm_or_si128(_mm_slli_epi32(a, n), _mm_srli_epi32(a, 32 - (n)))
+#define nsv_shuffle(a, m) _mm_shuffle_epi32(a, m)
+#define nsv_load(W)       _mm_loadu_si128((const __m128i *) (W))
+#define nsv_store(W, a)   _mm_storeu_si128((__m128i *) (W), a)
+#define nsv_word0(a)      (uint) _mm_cvtsi128_si32(a)
+
+/* Salsa rows are (x0,x5,x10,x15) (x12,x1,x6,x11) (x8,x13,x2,x7) (x4,x9,x14,x3),
+ * this permutation is its own inverse */
+static const uchar neoscrypt_tangle_idx[16] = {
+	0, 5, 10, 15, 12, 1, 6, 11, 8, 13, 2, 7, 4, 9, 14, 3
+};
+
+static void neoscrypt_tangle(uint *X, uint count)
+{
+	uint t[16], i, k;
+
+	for (i = 0; i < count; i++, X += 16) {
+		for (k = 0; k < 16; k++)
+			t[k] = X[neoscrypt_tangle_idx[k]];
+		neoscrypt_blkcpy(X, t, SCRYPT_BLOCK_SIZE);
+	}
+}
+
+#define chacha_quarter_v(a, b, c, d) \
+	a = nsv_add(a, b); d = nsv_rotl(nsv_xor(d, a), 16); \
+	c = nsv_add(c, d); b = nsv_rotl(nsv_xor(b, c), 12); \
+	a = nsv_add(a, b); d = nsv_rotl(nsv_xor(d, a),  8); \
+	c = nsv_add(c, d); b = nsv_rotl(nsv_xor(b, c),  7);
+
+#define salsa_quarter_v(a, b, c, d) \
+	b = nsv_xor(b, nsv_rotl(nsv_add(a, d),  7)); \
+	c = nsv_xor(c, nsv_rotl(nsv_add(b, a),  9)); \
+	d = nsv_xor(d, nsv_rotl(nsv_add(c, b), 13)); \
+	a = nsv_xor(a, nsv_rotl(nsv_add(d, c), 18));
+
+/* rotate the rows b, c, d by 1, 2, 3 words (diagonals to columns) and back */
+#define rows_rotate_v(b, c, d) \
+	b = nsv_shuffle(b, 0x39); c = nsv_shuffle(c, 0x4e); d = nsv_shuffle(d, 0x93);
+#define rows_unrotate_v(b, c, d) \
+	b = nsv_shuffle(b, 0x93); c = nsv_shuffle(c, 0x4e); d = nsv_shuffle(d, 0x39);
+
+/* ChaCha20 of the block Z and Salsa20 of the block X, if both are set the
+ * two independent dependency chains are interleaved round by round */
+static void neoscrypt_chacha_salsa_v(nsv *Z, nsv *X, uint rounds)
+{
+	nsv za, zb, zc, zd, xa, xb, xc, xd;
+	uint i;
+
+	/* the rows of a NULL block are never used, only set for the compiler */
+	if (Z) { za = Z[0]; zb = Z[1]; zc = Z[2]; zd = Z[3]; }
+	else za = zb = zc = zd = nsv_zero();
+	if (X) { xa = X[0]; xd = X[1]; xc = X[2]; xb = X[3]; }
+	else xa = xb = xc = xd = nsv_zero();
+
+	for (i = rounds; i; i -= 2) {
+		if (Z) {
+			chacha_quarter_v(za, zb, zc, zd);
+			rows_rotate_v(zb, zc, zd);
+		}
+		if (X) {
+			salsa_quarter_v(xa, xb, xc, xd);
+			rows_rotate_v(xd, xc, xb);
+		}
+		if (Z) {
+			chacha_quarter_v(za, zb, zc, zd);
+			rows_unrotate_v(zb, zc, zd);
+		}
+		if (X) {
+			salsa_quarter_v(xa, xd, xc, xb);
+			rows_unrotate_v(xd, xc, xb);
+		}
+	}
+
+	if (Z) {
+		Z[0] = nsv_add(Z[0], za); Z[1] = nsv_add(Z[1], zb);
+		Z[2] = nsv_add(Z[2], zc); Z[3] = nsv_add(Z[3], zd);
+	}
+	if (X) {
+		X[0] = nsv_add(X[0], xa); X[1] = nsv_add(X[1], xd);
+		X[2] = nsv_add(X[2], xc); X[3] = nsv_add(X[3], xb);
+	}
+}
+
+static inline void neoscrypt_blkxor_v(nsv *dst, const nsv *src)
+{
+	dst[0] = nsv_xor(dst[0], src[0]); dst[1] = nsv_xor(dst[1], src[1]);
+	dst[2] = nsv_xor(dst[2], src[2]); dst[3] = nsv_xor(dst[3], src[3]);
+}
+
+/* neoscrypt_blkmix() of Z with ChaCha and X with Salsa, any of them can be NULL;
+ * Y is a temporal space of 8 * r vectors */
+static void neoscrypt_blkmix_v(nsv *Z, nsv *X, nsv *Y, uint r, uint rounds)
+{
+	uint i, b = 2 * r;
+
+	for (i = 0; i < b; i++) {
+		uint p = 4 * (i ? i - 1 : b - 1);
+		if (Z) neoscrypt_blkxor_v(&Z[4 * i], &Z[p]);
+		if (X) neoscrypt_blkxor_v(&X[4 * i], &X[p]);
+		neoscrypt_chacha_salsa_v(Z ? &Z[4 * i] : NULL, X ? &X[4 * i] : NULL, rounds);
+	}
+	if (r == 1)
+		return;
+
+	/* even blocks first, then the odd ones */
+	if (Z) {
+		memcpy(Y, Z, 8 * r * sizeof(nsv));
+		for (i = 0; i < r; i++) {
+			memcpy(&Z[4 * i], &Y[8 * i], 4 * sizeof(nsv));
+			memcpy(&Z[4 * (i + r)], &Y[8 * i + 4], 4 * sizeof(nsv));
+		}
+	}
+	if (X) {
+		memcpy(Y, X, 8 * r * sizeof(nsv));
+		for (i = 0; i < r; i++) {
+			memcpy(&X[4 * i], &Y[8 * i], 4 * sizeof(nsv));
+			memcpy(&X[4 * (i + r)], &Y[8 * i + 4], 4 * sizeof(nsv));
+		}
+	}
+}
+
+/* The two SMix, ChaCha one (Z) only if dblmix */
+static void neoscrypt_smix_v(nsv *Z, nsv *X, nsv *Y, uint *Vz, uint *Vx,
+	uint N, uint r, uint rounds)
+{
+	const uint words = 32 * r, rows = 8 * r;
+	uint i, k, jz, jx;
+
+	for (i = 0; i < N; i++) {
+		for (k = 0; k < rows; k++) {
+			if (Z) nsv_store(&Vz[i * words + 4 * k], Z[k]);
+			nsv_store(&Vx[i * words + 4 * k], X[k]);
+		}
+		neoscrypt_blkmix_v(Z, X, Y, r, rounds);
+	}
+	for (i = 0; i < N; i++) {
+		/* integerify mod N, x0 is the first word of both layouts */
+		jz = Z ? words * (nsv_word0(Z[rows - 4]) & (N - 1)) : 0;
+		jx = words * (nsv_word0(X[rows - 4]) & (N - 1));
+		for (k = 0; k < rows; k++) {
+			if (Z) Z[k] = nsv_xor(Z[k], nsv_load(&Vz[jz + 4 * k]));
+			X[k] = nsv_xor(X[k], nsv_load(&Vx[jx + 4 * k]));
+		}
+		neoscrypt_blkmix_v(Z, X, Y, r, rounds);
+	}
+}
+
+/* NeoScrypt of an 80-byte input, see the profile bits above */
+void neoscrypt(unsigned char *output, const unsigned char *input, unsigned int profile)
+{
+	uint N = 128, r = 2, dblmix = 1, mixmode = 0x14;
+	const uint stack_align = 0x40;
+	uint kdf, words, rows, k;
+	uint *W, *Wz, *Vx, *Vz;
+	nsv *X, *Z, *Y;
+	uchar *stack;
+
+	if (profile & 0x1) {
+		N = 1024;        /* N = (1 << (Nfactor + 1)); */
+		r = 1;           /* r = (1 << rfactor); */
+		dblmix = 0;      /* Salsa only */
+		mixmode = 0x08;  /* 8 rounds */
+	}
+
+	if (profile >> 31) {
+		N = (1 << (((profile >> 8) & 0x1F) + 1));
+		r = (1 << ((profile >> 5) & 0x7));
+	}
+	words = 32 * r;
+	rows = 8 * r;
+	kdf = (profile >> 1) & 0xF;
+
+	/* X, Z and Y vectors, then the X and Z words, and the two V */
+	stack = (uchar *) malloc(3 * rows * sizeof(nsv)
+		+ (2 + (1 + dblmix) * N) * words * sizeof(uint) + stack_align);
+	if (!stack) {
+		memset(output, 0, 32);
+		return;
+	}
+	X  = (nsv *) (((size_t) stack + stack_align - 1) & ~((size_t) stack_align - 1));
+	Z  = &X[rows];
+	Y  = &Z[rows];
+	W  = (uint *) &Y[rows];
+	Wz = &W[words];
+	Vx = &Wz[words];
+	Vz = &Vx[N * words];
+
+	/* X = KDF(password, salt) */
+	if (kdf == 0x1)
+		neoscrypt_pbkdf2_sha256(input, 80, input, 80, 1, (uchar *) W, r * 2 * SCRYPT_BLOCK_SIZE);
+	else
+		neoscrypt_fastkdf(input, 80, input, 80, 32, (uchar *) W, r * 2 * SCRYPT_BLOCK_SIZE);
+
+	for (k = 0; k < rows; k++)
+		Z[k] = nsv_load(&W[4 * k]);
+	neoscrypt_tangle(W, r * 2);
+	for (k = 0; k < rows; k++)
+		X[k] = nsv_load(&W[4 * k]);
+
+	/* Z = SMix(Z) with ChaCha alongside X = SMix(X) with Salsa */
+	neoscrypt_smix_v(dblmix ? Z : NULL, X, Y, Vz, Vx, N, r, mixmode & 0xFF);
+
+	for (k = 0; k < rows; k++) {
+		nsv_store(&W[4 * k], X[k]);
+		nsv_store(&Wz[4 * k], Z[k]);
+	}
+
+	neoscrypt_tangle(W, r * 2);
+	if (dblmix)
+		/* blkxor(X, Z) */
+		neoscrypt_blkxor(W, Wz, r * 2 * SCRYPT_BLOCK_SIZE);
+
+	/* output = KDF(password, X) */
+	if (kdf == 0x1)
+		neoscrypt_pbkdf2_sha256(input, 80, (uchar *) W, r * 2 * SCRYPT_BLOCK_SIZE, 1, output, 32);
+	else
+		neoscrypt_fastkdf(input, 80, (uchar *) W, r * 2 * SCRYPT_BLOCK_SIZE, 32, output, 32);
+
+	free(stack);
 }
 
+#endif /* NEOSCRYPT_SIMD */
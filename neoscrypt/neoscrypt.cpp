@@ -78,7 +78,7 @@ int scanhash_neoscrypt(int thr_id, struct work* work, uint32_t max_nonce, unsign
 			} else {
 				endiandata[19] = work->nonces[0];
 			}
-			neoscrypt((uchar*)vhash, (uchar*) endiandata, 0x80000620U);
+			vstats_hash(thr_id, neoscrypt((uchar*)vhash, (uchar*) endiandata, 0x80000620U));
 
 			if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
@@ -0,0 +1,445 @@
+/**
+ * Nonce space leases of the mining threads
+ *
+ * The work template (g_work) nonce range is split in leases taken by the
+ * threads from a shared cursor (a single atomic, no lock), each thread
+ * sizes its leases to its own hashrate. Once the shared range is used, a
+ * thread rolls a private space and leases it alone: the next extranonce2
+ * of the stratum job, or a per thread counter in the work data. Leases
+ * and spaces never overlap, so the threads can't find the same results.
+ *
+ * The nonce position, the template bytes to watch and the way to roll
+ * are described per algo in the layouts table.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+
+#include "miner.h"
+#include "algos.h"
+
+enum {
+	NS_ROLL_NONE = 0,
+	NS_ROLL_XNONCE2, /* new stratum extranonce2 (merkle root) */
+	NS_ROLL_WORD     /* counter and thread id in the work data */
+};
+
+struct nonce_layout {
+	int algo;            /* -1 for the default one */
+	int nonce_oft;       /* nonce position in work->data, in bytes */
+	uint32_t nonce_mask; /* nonce bits to lease, 0 if the scan ignores the range */
+	int cmp_oft, cmp_len;   /* template bytes, a change is a new space */
+	int cmp2_oft, cmp2_len;
+	int roll;
+	int ctr_word;        /* NS_ROLL_WORD fields, uint32 index from the nonce */
+	uint32_t ctr_mask;
+	int tid_word;
+	uint32_t tid_mask;
+};
+
+static const struct nonce_layout layouts[] = {
+	/* algo            nonce  mask         cmp       cmp2     roll             counter        thread id */
+	{ ALGO_LBRY,        108, 0xFFFFFFFFU,  0, 108,   0,  0,  NS_ROLL_XNONCE2, 0, 0,          0, 0 },
+	{ ALGO_ZR5,          76, 0xFFFFFFFFU,  4,  72,   0,  0,  NS_ROLL_XNONCE2, 0, 0,          0, 0 }, // no pok
+	{ ALGO_DECRED,      140, 0xFFFFFFFFU,  0, 140,   0,  0,  NS_ROLL_WORD,    1, 0xFFFFFFFFU, 2, 0x000000FFU },
+	{ ALGO_SIA,          32, 0xFFFFFFFFU, 48,  32,   0,  0,  NS_ROLL_WORD,    1, 0x0000FF00U, 1, 0x000000FFU },
+	{ ALGO_EQUIHASH,    120, 0,            0,  68,   0,  0,  NS_ROLL_WORD,    1, 0x00FFFFFFU, 1, 0xFF000000U },
+	{ ALGO_CRYPTOLIGHT,  39, 0xFFFFFFFFU,  0,  39,  43, 33,  NS_ROLL_NONE,    0, 0,          0, 0 },
+	{ ALGO_CRYPTONIGHT,  39, 0xFFFFFFFFU,  0,  39,  43, 33,  NS_ROLL_NONE,    0, 0,          0, 0 },
+	{ ALGO_WILDKECCAK,    1, 0xFFFFFFFFU,  8,  32,   0,  0,  NS_ROLL_NONE,    0, 0,          0, 0 },
+	{ -1,                76, 0xFFFFFFFFU,  0,  76,   0,  0,  NS_ROLL_XNONCE2, 0, 0,          0, 0 },
+};
+
+#define NS_GEN_SHIFT 40
+#define NS_OFT_MASK  ((1ULL << NS_GEN_SHIFT) - 1)
+#define NS_GEN_MASK  0xFFFFFFU
+
+struct ns_thread {
+	struct nonce_layout nl;
+	uint32_t gen;        /* space generation of the thread work */
+	bool priv;           /* rolled, in a private space */
+	bool exhausted;      /* no more lease in this work */
+	uint32_t ctr;        /* NS_ROLL_WORD rolls */
+	uint32_t ctr_base;   /* template counter, the shared space */
+	uint64_t next;       /* private cursor */
+	uint64_t start, end; /* current lease */
+	uint64_t pos;        /* rest of the lease to scan, > end if none */
+};
+
+static struct ns_thread ns_thr[MAX_GPUS];
+
+/* the shared space, generation << 40 | next nonce */
+static std::atomic<uint64_t> ns_shared(0);
+
+/* the template of the shared space, with g_work_lock */
+static struct nonce_layout ns_layout;
+static uint32_t ns_gen = 0;
+static uint32_t ns_tpl[48];
+static char ns_job_id[128];
+
+extern struct stratum_ctx stratum;
+
+static void ns_layout_get(struct nonce_layout *nl)
+{
+	int n = 0;
+	while (layouts[n].algo != -1 && layouts[n].algo != (int) opt_algo)
+		n++;
+	memcpy(nl, &layouts[n], sizeof(*nl));
+
+	if (nl->roll == NS_ROLL_XNONCE2 && (!have_stratum || stratum.rpc2))
+		nl->roll = NS_ROLL_NONE;
+	// nicehash gives the high byte of the nonce
+	if (opt_algo == ALGO_CRYPTONIGHT || opt_algo == ALGO_CRYPTOLIGHT) {
+		if (strstr(pools[cur_pooln].url, "nicehash"))
+			nl->nonce_mask = 0x00FFFFFFU;
+	}
+}
+
+static inline uint32_t* ns_nonceptr(const struct nonce_layout *nl, const struct work *work)
+{
+	return (uint32_t*) (((char*) work->data) + nl->nonce_oft);
+}
+
+static bool ns_tpl_changed(const struct nonce_layout *nl, const struct work *tpl)
+{
+	const char *a = (const char*) ns_tpl, *b = (const char*) tpl->data;
+	if (memcmp(nl, &ns_layout, sizeof(*nl)) || strcmp(tpl->job_id, ns_job_id))
+		return true;
+	if (memcmp(a + nl->cmp_oft, b + nl->cmp_oft, nl->cmp_len))
+		return true;
+	return nl->cmp2_len && memcmp(a + nl->cmp2_oft, b + nl->cmp2_oft, nl->cmp2_len);
+}
+
+/**
+ * check the template, called with g_work_lock before each scan.
+ * return true if the thread work must be replaced by the template
+ */
+bool nonce_space_update(int thr_id, const struct work *tpl)
+{
+	struct ns_thread *t = &ns_thr[thr_id];
+	struct nonce_layout nl;
+	bool changed;
+
+	memset(&nl, 0, sizeof(nl));
+	ns_layout_get(&nl);
+
+	changed = ns_tpl_changed(&nl, tpl);
+	// nothing new to scan, only the benchmark and getwork can restart the range
+	if (!changed && t->exhausted && t->gen == ns_gen && (opt_benchmark || !have_stratum))
+		changed = true;
+
+	if (changed) {
+		memcpy(&ns_layout, &nl, sizeof(nl));
+		memcpy(ns_tpl, tpl->data, sizeof(ns_tpl));
+		snprintf(ns_job_id, sizeof(ns_job_id), "%s", tpl->job_id);
+		ns_gen = (ns_gen + 1) & NS_GEN_MASK;
+		if (!ns_gen) ns_gen = 1; // 0 is a thread without work
+		ns_shared.store((uint64_t) ns_gen << NS_GEN_SHIFT);
+	}
+
+	if (t->gen == ns_gen)
+		return false;
+
+	memcpy(&t->nl, &nl, sizeof(nl));
+	t->gen = ns_gen;
+	t->priv = false;
+	t->exhausted = false;
+	t->ctr = 0;
+	t->ctr_base = ns_nonceptr(&nl, tpl)[nl.ctr_word] & nl.ctr_mask;
+	t->pos = 1; t->end = 0;
+	return true;
+}
+
+/* nonce position of the algo in the header, in bytes */
+int nonce_space_offset(int algo)
+{
+	int n = 0;
+	while (layouts[n].algo != -1 && layouts[n].algo != algo)
+		n++;
+	return layouts[n].nonce_oft;
+}
+
+/* the rolls could give more work after the template range */
+bool nonce_space_can_roll(int thr_id)
+{
+	return ns_thr[thr_id].nl.roll != NS_ROLL_NONE;
+}
+
+bool nonce_space_exhausted(int thr_id)
+{
+	return ns_thr[thr_id].exhausted;
+}
+
+uint32_t* nonce_space_ptr(int thr_id, struct work *work)
+{
+	return ns_nonceptr(&ns_thr[thr_id].nl, work);
+}
+
+/* switch the thread work to a private space */
+static bool ns_roll(struct ns_thread *t, int thr_id, struct work *work)
+{
+	const struct nonce_layout *nl = &t->nl;
+	uint32_t *nonceptr = ns_nonceptr(nl, work);
+
+	switch (nl->roll) {
+	case NS_ROLL_XNONCE2:
+		if (!stratum_roll_work(work))
+			return false;
+		break;
+	case NS_ROLL_WORD:
+	{
+		uint32_t unit = nl->ctr_mask & (0U - nl->ctr_mask);
+		uint32_t *ctr = &nonceptr[nl->ctr_word];
+		uint32_t *tid = &nonceptr[nl->tid_word];
+		if (t->ctr >= nl->ctr_mask / unit)
+			return false;
+		t->ctr++;
+		// the template value is the shared space, never reached again
+		*ctr = (*ctr & ~nl->ctr_mask) | ((t->ctr_base + t->ctr * unit) & nl->ctr_mask);
+		unit = nl->tid_mask & (0U - nl->tid_mask);
+		*tid = (*tid & ~nl->tid_mask) | (((uint32_t) thr_id * unit) & nl->tid_mask);
+		break;
+	}
+	default:
+		return false;
+	}
+	t->priv = true;
+	t->next = 0;
+	return true;
+}
+
+/* take a lease in the shared space: 1 if ok, 0 if all used, -1 if replaced */
+static int ns_shared_lease(struct ns_thread *t, uint64_t size)
+{
+	const uint64_t mask = t->nl.nonce_mask;
+	uint64_t v = ns_shared.load(std::memory_order_relaxed);
+	uint64_t start, end;
+
+	do {
+		if ((v >> NS_GEN_SHIFT) != t->gen)
+			return -1;
+		start = v & NS_OFT_MASK;
+		if (start > mask)
+			return 0;
+		end = min(start + size - 1, mask);
+		// never let small ranges at end
+		if (mask - end < 0x100)
+			end = mask;
+	} while (!ns_shared.compare_exchange_weak(v, (v & ~NS_OFT_MASK) | (end + 1)));
+
+	t->start = start;
+	t->end = end;
+	return 1;
+}
+
+/**
+ * set the next nonce range of the thread work, about size nonces.
+ * return 1 if ok, 0 if the work has no more nonces (new work required)
+ * and -1 if the template was replaced (update again)
+ */
+int nonce_lease(int thr_id, struct work *work, uint64_t size, uint32_t *max_nonce)
+{
+	struct ns_thread *t = &ns_thr[thr_id];
+	const uint64_t mask = t->nl.nonce_mask;
+	uint32_t *nonceptr = ns_nonceptr(&t->nl, work);
+
+	if (t->exhausted)
+		return 0;
+	if (size < 1)
+		size = 1;
+
+	if (!mask) {
+		// the scan doesn't use a range, a new space per scan
+		if (!ns_roll(t, thr_id, work)) {
+			t->exhausted = true;
+			return 0;
+		}
+		*max_nonce = UINT32_MAX;
+		return 1;
+	}
+
+	if (t->pos <= t->end) {
+		// rest of the lease, after results
+		t->start = t->pos;
+	} else for (;;) {
+		if (!t->priv) {
+			int rc = ns_shared_lease(t, size);
+			if (rc < 0)
+				return rc;
+			if (rc > 0)
+				break;
+			if (!ns_roll(t, thr_id, work)) {
+				t->exhausted = true;
+				return 0;
+			}
+		}
+		if (t->next <= mask) {
+			t->start = t->next;
+			t->end = min(t->next + size - 1, mask);
+			if (mask - t->end < 0x100)
+				t->end = mask;
+			t->next = t->end + 1;
+			break;
+		}
+		if (!ns_roll(t, thr_id, work)) {
+			t->exhausted = true;
+			return 0;
+		}
+	}
+
+	// used, unless results are found
+	t->pos = t->end + 1;
+
+	nonceptr[0] = (nonceptr[0] & ~(uint32_t) mask) | (uint32_t) t->start;
+	*max_nonce = (nonceptr[0] & ~(uint32_t) mask) | (uint32_t) t->end;
+	return 1;
+}
+
+static inline bool ns_in_lease(const struct ns_thread *t, uint32_t nonce)
+{
+	uint64_t n = nonce & t->nl.nonce_mask;
+	return n >= t->start && n <= t->end;
+}
+
+/* a result of the thread current lease (or of a scan without range) */
+bool nonce_in_lease(int thr_id, uint32_t nonce)
+{
+	const struct ns_thread *t = &ns_thr[thr_id];
+	return !t->nl.nonce_mask || ns_in_lease(t, nonce);
+}
+
+/**
+ * after a scan with results: drop the ones out of the lease (another
+ * thread lease) and keep the rest of the lease for the next scan.
+ * return the results count
+ */
+int nonce_lease_done(int thr_id, struct work *work, int rc)
+{
+	struct ns_thread *t = &ns_thr[thr_id];
+	const uint64_t mask = t->nl.nonce_mask;
+	uint64_t next;
+	int n, kept = 0;
+
+	if (rc <= 0 || !mask)
+		return rc;
+
+	for (n = 0; n < rc && n < MAX_NONCES; n++) {
+		if (!ns_in_lease(t, work->nonces[n])) {
+			gpulog(LOG_DEBUG, thr_id, "result %08x out of the lease %08x-%08x",
+				work->nonces[n], (uint32_t) t->start, (uint32_t) t->end);
+			continue;
+		}
+		if (kept != n) {
+			work->nonces[kept] = work->nonces[n];
+			work->sharediff[kept] = work->sharediff[n];
+			work->shareratio[kept] = work->shareratio[n];
+		}
+		kept++;
+	}
+	if (kept < rc) {
+		for (n = kept; n < MAX_NONCES; n++)
+			work->nonces[n] = 0;
+		if (work->valid_nonces > kept) work->valid_nonces = (uint8_t) kept;
+		rc = kept;
+	}
+
+	// the scan position, after the results
+	next = ns_nonceptr(&t->nl, work)[0] & mask;
+	for (int i = 0; i < rc; i++)
+		next = max(next, (uint64_t) (work->nonces[i] & mask) + 1);
+	if (next >= t->start && next <= t->end)
+		t->pos = next;
+	return rc;
+}
+
+/* --selftest, threads leasing the shared space at the same time */
+
+#define NS_TEST_THREADS 4
+#define NS_TEST_MASK    0x000FFFFFU
+#define NS_TEST_LEASES  4096
+
+struct ns_test_arg {
+	pthread_t pth;
+	int thr_id;
+	int count;
+	uint64_t start[NS_TEST_LEASES];
+	uint64_t end[NS_TEST_LEASES];
+};
+
+static void* ns_test_thread(void *userdata)
+{
+	struct ns_test_arg *arg = (struct ns_test_arg *) userdata;
+	struct ns_thread *t = &ns_thr[arg->thr_id];
+	struct work work;
+	uint32_t max_nonce;
+
+	memset(&work, 0, sizeof(work));
+	// lease sizes which differ per thread, like the hashrates
+	while (arg->count < NS_TEST_LEASES &&
+	       nonce_lease(arg->thr_id, &work, 0x400 + 0x1A3 * arg->thr_id, &max_nonce) > 0) {
+		arg->start[arg->count] = t->start;
+		arg->end[arg->count] = t->end;
+		arg->count++;
+	}
+	return NULL;
+}
+
+static int ns_test_cmp(const void *a, const void *b)
+{
+	const uint64_t *x = (const uint64_t *) a, *y = (const uint64_t *) b;
+	return (x[0] > y[0]) - (x[0] < y[0]);
+}
+
+int nonce_lease_selftest(void)
+{
+	static struct ns_test_arg args[NS_TEST_THREADS];
+	static uint64_t leases[NS_TEST_THREADS * NS_TEST_LEASES][2];
+	const int nthreads = min(NS_TEST_THREADS, MAX_GPUS);
+	uint64_t next = 0;
+	int started, count = 0, errors = 0;
+
+	ns_shared.store(1ULL << NS_GEN_SHIFT);
+	for (int i = 0; i < nthreads; i++) {
+		struct ns_thread *t = &ns_thr[i];
+		memset(t, 0, sizeof(*t));
+		memcpy(&t->nl, &layouts[ARRAY_SIZE(layouts) - 1], sizeof(t->nl));
+		t->nl.nonce_mask = NS_TEST_MASK;
+		t->nl.roll = NS_ROLL_NONE;
+		t->gen = 1;
+		t->pos = 1; t->end = 0;
+		args[i].thr_id = i;
+		args[i].count = 0;
+	}
+	for (started = 0; started < nthreads; started++) {
+		if (pthread_create(&args[started].pth, NULL, ns_test_thread, &args[started]))
+			break;
+	}
+	for (int i = 0; i < started; i++)
+		pthread_join(args[i].pth, NULL);
+	if (started < nthreads)
+		errors++;
+
+	// sorted, the leases must cover the range without overlap
+	for (int i = 0; i < started; i++) {
+		for (int l = 0; l < args[i].count; l++) {
+			leases[count][0] = args[i].start[l];
+			leases[count][1] = args[i].end[l];
+			count++;
+		}
+	}
+	qsort(leases, count, sizeof(leases[0]), ns_test_cmp);
+	for (int l = 0; l < count; l++) {
+		if (leases[l][0] != next || leases[l][1] < next)
+			errors++;
+		next = leases[l][1] + 1;
+	}
+
+	ns_shared.store(0);
+	memset(ns_thr, 0, sizeof(ns_thr));
+
+	if (errors || next != (uint64_t) NS_TEST_MASK + 1) {
+		applog(LOG_ERR, "selftest: nonce leases overlap, %d leases up to %08x", count, (uint32_t) next);
+		return 1;
+	}
+	return 0;
+}
@@ -162,7 +162,7 @@ extern "C" int scanhash_phi(int thr_id, struct work* work, uint32_t max_nonce, u
 			uint32_t _ALIGN(64) vhash[8];
 			if (!use_compat_kernels[thr_id]) work->nonces[0] += startNonce;
 			be32enc(&endiandata[19], work->nonces[0]);
-			phi_hash(vhash, endiandata);
+			vstats_hash(thr_id, phi_hash(vhash, endiandata));
 
 			if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
@@ -173,7 +173,7 @@ extern "C" int scanhash_phi(int thr_id, struct work* work, uint32_t max_nonce, u
 				if (work->nonces[1] != UINT32_MAX) {
 					work->nonces[1] += startNonce;
 					be32enc(&endiandata[19], work->nonces[1]);
-					phi_hash(vhash, endiandata);
+					vstats_hash(thr_id, phi_hash(vhash, endiandata));
 					bn_set_target_ratio(work, vhash, 1);
 					work->valid_nonces++;
 					pdata[19] = max(work->nonces[0], work->nonces[1]) + 1;
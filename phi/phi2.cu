@@ -203,12 +203,20 @@ extern "C" int scanhash_phi2(int thr_id, struct work* work, uint32_t max_nonce,
 		TRACE("xor  ");
 
 		work->nonces[0] = cuda_check_hash(thr_id, throughput, pdata[19], d_hash_512[thr_id]);
+		if (work->nonces[0] != UINT32_MAX && validate_async())
+		{
+			// checked by the cpu threads, continue to scan
+			work->nonces[1] = cuda_check_hash_suppl(thr_id, throughput, pdata[19], d_hash_512[thr_id], 1);
+			if (validate_push_nonces(thr_id, work, endiandata, work->nonces[1] ? 2 : 1, max_nonce, phi2_hash))
+				break;
+			continue;
+		}
 		if (work->nonces[0] != UINT32_MAX)
 		{
 			const uint32_t Htarg = ptarget[7];
 			uint32_t _ALIGN(64) vhash[8];
 			be32enc(&endiandata[19], work->nonces[0]);
-			phi2_hash(vhash, endiandata);
+			vstats_hash(thr_id, phi2_hash(vhash, endiandata));
 
 			if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
@@ -217,7 +225,7 @@ extern "C" int scanhash_phi2(int thr_id, struct work* work, uint32_t max_nonce,
 				work->nonces[1] = cuda_check_hash_suppl(thr_id, throughput, pdata[19], d_hash_512[thr_id], 1);
 				if (work->nonces[1] != 0) {
 					be32enc(&endiandata[19], work->nonces[1]);
-					phi2_hash(vhash, endiandata);
+					vstats_hash(thr_id, phi2_hash(vhash, endiandata));
 					bn_set_target_ratio(work, vhash, 1);
 					work->valid_nonces++;
 					pdata[19] = max(work->nonces[0], work->nonces[1]) + 1;
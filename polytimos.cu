@@ -155,7 +155,7 @@ extern "C" int scanhash_polytimos(int thr_id, struct work* work, uint32_t max_no
 			uint32_t _ALIGN(64) vhash[8];
 
 			be32enc(&endiandata[19], startNounce + h_resNonce[0]);
-			polytimos_hash(vhash, endiandata);
+			vstats_hash(thr_id, polytimos_hash(vhash, endiandata));
 			if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
 				work->nonces[0] = startNounce + h_resNonce[0];
@@ -163,7 +163,7 @@ extern "C" int scanhash_polytimos(int thr_id, struct work* work, uint32_t max_no
 				if (h_resNonce[1] != UINT32_MAX) {
 					uint32_t secNonce = work->nonces[1] = startNounce + h_resNonce[1];
 					be32enc(&endiandata[19], secNonce);
-					polytimos_hash(vhash, endiandata);
+					vstats_hash(thr_id, polytimos_hash(vhash, endiandata));
 					bn_set_target_ratio(work, vhash, 1);
 					work->valid_nonces++;
 					pdata[19] = max(work->nonces[0], work->nonces[1]) + 1;
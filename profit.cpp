@@ -0,0 +1,266 @@
+/**
+ * Profit switching between the configured pools (--profit-feed)
+ *
+ * The feed is a json object with the profit of each algo for 1 MH/s:
+ *   { "x11": 0.25, "lyra2z": 1.4 }
+ * The yiimp /api/status format is also accepted (estimate_current and
+ * mbtc_mh_factor of each algo entry). It is read from a local file or an
+ * http(s) url, every --profit-interval seconds.
+ *
+ * The profit of a pool is the feed value of its algo * the hashrate
+ * measured on this algo * the pool accept ratio. The algos never mined
+ * are probed once, for PROFIT_PROBE_TIME. A switch costs the warm-up time
+ * of the new algo (measured on each switch), so the best pool has to beat
+ * the current one by --profit-margin over one interval minus this warm-up.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "miner.h"
+#include "algos.h"
+
+#define PROFIT_PROBE_TIME 60  /* seconds to measure an unknown algo */
+#define PROFIT_SETTLE_TIME 15 /* after the warm-up, before to store the rate */
+#define PROFIT_WARMUP 30      /* default warm-up cost of an algo switch */
+#define PROFIT_RECONNECT 5    /* switch cost between pools of the same algo */
+
+char *opt_profit_feed = NULL;
+int opt_profit_interval = 300;
+int opt_profit_margin = 5;
+
+extern double thr_hashrates[MAX_GPUS];
+extern volatile bool pool_is_switching;
+extern volatile bool pool_on_hold;
+
+static double algo_price[ALGO_COUNT] = { 0 };
+static int algo_warmup[ALGO_COUNT] = { 0 };
+static bool algo_probed[ALGO_COUNT] = { 0 };
+
+static pthread_t profit_thr;
+
+static double json_number(json_t *val)
+{
+	if (json_is_number(val))
+		return json_number_value(val);
+	if (json_is_string(val))
+		return atof(json_string_value(val));
+	return 0.;
+}
+
+// parse the feed, returns the number of known algos
+static int profit_parse(json_t *feed, double *price)
+{
+	const char *key;
+	json_t *val;
+	int count = 0;
+
+	if (!json_is_object(feed))
+		return 0;
+
+	json_object_foreach(feed, key, val) {
+		int algo = algo_to_int((char*) key);
+		double p;
+		if (algo < 0 || algo >= ALGO_AUTO)
+			continue;
+		if (json_is_object(val)) {
+			// yiimp api/status
+			double factor = json_number(json_object_get(val, "mbtc_mh_factor"));
+			p = json_number(json_object_get(val, "estimate_current"));
+			if (factor > 0.) p /= factor;
+		} else {
+			p = json_number(val);
+		}
+		if (p < 0.)
+			continue;
+		price[algo] = p;
+		count++;
+	}
+	return count;
+}
+
+static bool profit_load_feed()
+{
+	json_error_t err;
+	json_t *feed;
+	double price[ALGO_COUNT] = { 0 };
+	int count;
+
+	if (strstr(opt_profit_feed, "://"))
+		feed = json_load_url(opt_profit_feed, &err);
+	else
+		feed = JSON_LOADF(opt_profit_feed, &err);
+	if (!feed) {
+		applog(LOG_WARNING, "profit: unable to read %s", opt_profit_feed);
+		return false;
+	}
+	count = profit_parse(feed, price);
+	json_decref(feed);
+	if (!count) {
+		applog(LOG_WARNING, "profit: no known algo in %s", opt_profit_feed);
+		return false;
+	}
+	memcpy(algo_price, price, sizeof(algo_price));
+	if (opt_debug)
+		applog(LOG_DEBUG, "profit: %d algos read from the feed", count);
+	return true;
+}
+
+// expected profit of a pool, 0 if unknown
+static double profit_pool(int pooln)
+{
+	struct pool_infos *p = &pools[pooln];
+	double rate = bench_get_algo_hashrate(p->algo);
+	double ratio = (p->accepted_count + 1.) / (p->accepted_count + p->rejected_count + 1.);
+	return algo_price[p->algo] * (rate / 1e6) * ratio;
+}
+
+static bool profit_pool_usable(int pooln)
+{
+	struct pool_infos *p = &pools[pooln];
+	if (!(p->status & POOL_ST_VALID))
+		return false;
+	if (p->status & (POOL_ST_DISABLED | POOL_ST_REMOVED))
+		return false;
+	return p->algo >= 0 && p->algo < ALGO_AUTO && algo_price[p->algo] > 0.;
+}
+
+// return the pool to mine, cur_pooln to stay
+static int profit_select(bool *probe)
+{
+	int cur = cur_pooln, best = cur;
+	double cur_profit = profit_pool(cur);
+	double best_profit = cur_profit;
+	int warmup;
+
+	*probe = false;
+	for (int n = 0; n < num_pools; n++) {
+		if (n == cur || !profit_pool_usable(n))
+			continue;
+		int algo = pools[n].algo;
+		if (!algo_probed[algo] && bench_get_algo_hashrate(algo) == 0.) {
+			*probe = true;
+			return n;
+		}
+		double profit = profit_pool(n);
+		if (profit > best_profit) {
+			best_profit = profit;
+			best = n;
+		}
+	}
+	if (best == cur)
+		return cur;
+
+	// the switch costs the warm-up time of the next algo
+	if (pools[best].algo == pools[cur].algo)
+		warmup = PROFIT_RECONNECT;
+	else
+		warmup = algo_warmup[pools[best].algo] ? algo_warmup[pools[best].algo] : PROFIT_WARMUP;
+	if (warmup >= opt_profit_interval)
+		return cur;
+
+	if (best_profit * (opt_profit_interval - warmup) >
+	    cur_profit * opt_profit_interval * (1. + opt_profit_margin / 100.))
+		return best;
+
+	return cur;
+}
+
+static double profit_cur_hashrate(bool *warm)
+{
+	double rate = 0.;
+	*warm = true;
+	for (int thr_id = 0; thr_id < opt_n_threads; thr_id++) {
+		double speed = stats_get_speed(thr_id, thr_hashrates[thr_id]);
+		if (speed == 0.) *warm = false;
+		rate += speed;
+	}
+	return rate;
+}
+
+static void *profit_thread(void *userdata)
+{
+	time_t since = time(NULL);
+	time_t next_feed = since + opt_profit_interval;
+	int warmup = -1;
+	bool probing = false;
+	int algo = (int) opt_algo;
+
+	while (!abort_flag) {
+		time_t now = time(NULL);
+		bool warm;
+
+		sleep(1);
+		if (pool_is_switching || pool_on_hold)
+			continue;
+
+		if ((int) opt_algo != algo) {
+			// switched by the api or a pool rotation
+			algo = (int) opt_algo;
+			since = now;
+			warmup = -1;
+		}
+
+		// measure the warm-up, then the algo hashrate
+		profit_cur_hashrate(&warm);
+		if (warmup < 0 && warm) {
+			warmup = (int) (now - since);
+			algo_warmup[algo] = warmup;
+			if (opt_debug)
+				applog(LOG_DEBUG, "profit: %s warm-up time %ds", algo_names[algo], warmup);
+		}
+		if (warmup >= 0 && now - since >= warmup + PROFIT_SETTLE_TIME) {
+			for (int thr_id = 0; thr_id < opt_n_threads; thr_id++)
+				bench_set_algo_hashrate(thr_id, algo, stats_get_speed(thr_id, thr_hashrates[thr_id]));
+			algo_probed[algo] = true;
+		} else if (warmup < 0 && now - since > opt_profit_interval) {
+			// no hashrate, let the other pools be selected
+			algo_probed[algo] = true;
+		}
+
+		if (now >= next_feed) {
+			profit_load_feed();
+			next_feed = now + opt_profit_interval;
+		}
+
+		// probes are shorter, else stay at least one interval on a pool
+		if (!algo_probed[algo] || now - since < (probing ? PROFIT_PROBE_TIME : opt_profit_interval))
+			continue;
+
+		int pooln = profit_select(&probing);
+		if (pooln == cur_pooln) {
+			since = now - opt_profit_interval / 2; // check again later
+			continue;
+		}
+		if (probing)
+			applog(LOG_BLUE, "profit: probing the %s hashrate", algo_names[pools[pooln].algo]);
+		else
+			applog(LOG_BLUE, "profit: %s is now more profitable (%.3g vs %.3g)",
+				algo_names[pools[pooln].algo], profit_pool(pooln), profit_pool(cur_pooln));
+		if (pool_switch(-1, pooln)) {
+			if ((int) opt_algo != algo)
+				warmup = -1;
+			algo = (int) opt_algo;
+			since = time(NULL);
+		}
+	}
+	return NULL;
+}
+
+bool profit_start()
+{
+	if (num_pools < 2) {
+		applog(LOG_WARNING, "profit: at least two pools are required to switch");
+		return true;
+	}
+	if (!profit_load_feed())
+		applog(LOG_WARNING, "profit: will retry in %ds", opt_profit_interval);
+	if (pthread_create(&profit_thr, NULL, profit_thread, NULL)) {
+		applog(LOG_ERR, "profit: thread create failed");
+		return false;
+	}
+	pthread_detach(profit_thr);
+	applog(LOG_INFO, "profit: switching between %d pools every %ds or more", num_pools, opt_profit_interval);
+	return true;
+}
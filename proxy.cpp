@@ -0,0 +1,1090 @@
+/**
+ * Stratum proxy for many rigs (--proxy-server)
+ *
+ * The jobs of the pool stratum connection are served to the downstream
+ * miners. Each client gets a slot, written in the first bytes of the pool
+ * extranonce2 and given as the end of its extranonce1, so the clients share
+ * the pool extranonce2 space without overlap (slot 0 is the local miner).
+ *
+ * The shares are checked with the cpu hash functions by PX_CHECKERS
+ * threads (inline if too many are pending), only the valid ones are sent
+ * to the pool, with the proxy pool user. All the connections are handled
+ * by one thread with non blocking sockets and poll(), it answers the
+ * checked shares and builds the notify line once per job.
+ */
+#ifdef WIN32
+# define  _WINSOCK_DEPRECATED_NO_WARNINGS
+# include <winsock2.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <time.h>
+#include <openssl/sha.h>
+
+#include "miner.h"
+#include "algos.h"
+#include "u256.h"
+
+#ifndef WIN32
+# include <errno.h>
+# include <fcntl.h>
+# include <poll.h>
+# include <sys/resource.h>
+# include <sys/socket.h>
+# include <netinet/in.h>
+# include <arpa/inet.h>
+# define SOCKETTYPE int
+# define SOCKETFAIL(a) ((a) < 0)
+# define INVSOCK -1 /* INVALID_SOCKET */
+# define CLOSESOCKET close
+# define WOULDBLOCK (errno == EAGAIN || errno == EWOULDBLOCK)
+# define PX_POLL_MS 1000
+#else
+# define SOCKETTYPE SOCKET
+# define SOCKETFAIL(a) ((a) == SOCKET_ERROR)
+# define INVSOCK INVALID_SOCKET
+# define CLOSESOCKET closesocket
+# define WOULDBLOCK (WSAGetLastError() == WSAEWOULDBLOCK)
+# define poll WSAPoll
+# define PX_POLL_MS 50 /* no wakeup pipe */
+#endif
+
+#ifdef MSG_NOSIGNAL
+#define PX_SENDFLAGS MSG_NOSIGNAL
+#else
+#define PX_SENDFLAGS 0
+#endif
+
+#define PX_JOBS     8
+#define PX_MAXSLOTS 65536
+#define PX_RECVBUF  4096
+#define PX_SENDMAX  (256 * 1024) /* slow clients are dropped */
+#define PX_REPORT_S 300
+#define PX_CHECKERS 2
+#define PX_MAXPENDING 4096
+
+struct px_job {
+	char *id;
+	uchar prevhash[32];
+	uchar version[4];
+	uchar nbits[4];
+	uchar *cb_head; /* coinb1 and the pool extranonce1 */
+	uchar *cb_tail; /* coinb2 */
+	int cb_head_size;
+	int cb_tail_size;
+	int merkle_count;
+	uchar *merkle;
+	double diff;
+	uint32_t xn_gen;
+	char *notify;
+	/* submitted shares, open addressing */
+	uint64_t *keys;
+	uint32_t nkeys;
+	uint32_t kmask;
+};
+
+struct px_conn {
+	SOCKETTYPE sock;
+	uint32_t slot;
+	uint32_t id;
+	bool subscribed;
+	bool authorized;
+	bool xn_sub;
+	bool closing;
+	uint32_t xn_gen;
+	uint32_t sent_job;
+	double sent_diff;
+	char *out;
+	size_t outlen;
+	size_t outsize;
+	int inlen;
+	char inbuf[PX_RECVBUF];
+};
+
+enum {
+	PX_VALID = 0,
+	PX_STALE,
+	PX_DUP,
+	PX_LOW,
+	PX_INVALID,
+	PX_UNCHECKED,
+	PX_PENDING, /* hash to check */
+};
+
+/* a submitted share, checked by the px_checker threads */
+struct px_share {
+	uint32_t _ALIGN(64) endiandata[32];
+	uint32_t target[8];
+	uint32_t slot;
+	uint32_t conn_id;
+	int rc;
+	char *sid;
+	char *job_id;
+	char ntime[9];
+	char nonce[9];
+	uchar xnonce2[32];
+	int xn2_size;
+	struct px_share *next;
+};
+
+char *opt_proxy_server = NULL;
+
+static const struct cpu_hash_algo *px_algo = NULL;
+static SOCKETTYPE px_sock = INVSOCK;
+static int px_wake[2] = { -1, -1 };
+static pthread_t px_thr;
+static bool px_running = false;
+static volatile bool px_stopping = false;
+static pthread_mutex_t px_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* share checkers, the checked ones wait in the done list (px_lock) */
+static struct thread_q *px_checkq = NULL;
+static pthread_t px_checkers[PX_CHECKERS];
+static int px_ncheckers = 0;
+static int px_pending = 0;
+static struct px_share *px_done = NULL;
+static struct px_share *px_done_tail = NULL;
+
+/* pool job ring and extranonce, under px_lock */
+static struct stratum_ctx *px_sctx = NULL;
+static struct px_job px_jobs[PX_JOBS];
+static uint32_t px_njobs = 0;
+static uchar px_prevhash[32];
+static uchar px_xnonce1[32];
+static int px_xnonce1_size = 0;
+static int px_xnonce2_size = 0;
+static uint32_t px_xn_gen = 0;
+
+/* connections, only used by the proxy thread */
+static struct px_conn **px_conns = NULL;
+static struct px_conn **px_slots = NULL; /* by slot */
+static int px_nconns = 0;
+static struct pollfd *px_fds = NULL;
+static int px_fds_size = 0;
+static uint32_t *px_free_slots = NULL;
+static int px_nfree = 0;
+
+static struct {
+	uint32_t conns;
+	uint32_t peak;
+	uint32_t dropped;
+	uint32_t shares;
+	uint32_t stale;
+	uint32_t dup;
+	uint32_t low;
+	uint32_t unchecked;
+	uint32_t sent;
+	uint32_t accepted;
+	uint32_t rejected;
+	time_t next_report;
+} px_stats;
+
+/* slot bytes in the pool extranonce2, 0 when too small to be shared */
+static int px_prefix_size(int xnonce2_size)
+{
+	if (xnonce2_size >= 4) return 2;
+	if (xnonce2_size == 3) return 1;
+	return 0;
+}
+
+/* bytes of the extranonce2 not incremented by stratum_gen_work() */
+int proxy_xnonce2_reserved(size_t xnonce2_size)
+{
+	if (!opt_proxy_server)
+		return 0;
+	return px_prefix_size((int) xnonce2_size);
+}
+
+static void px_slot_bytes(uchar *buf, uint32_t slot, int size)
+{
+	for (int i = 0; i < size; i++)
+		buf[i] = (uchar) (slot >> (8 * (size - 1 - i)));
+}
+
+static void px_job_free(struct px_job *job)
+{
+	free(job->id);
+	free(job->cb_head);
+	free(job->cb_tail);
+	free(job->merkle);
+	free(job->notify);
+	free(job->keys);
+	memset(job, 0, sizeof(*job));
+}
+
+static struct px_job* px_find_job(const char *id)
+{
+	for (int i = 0; i < PX_JOBS; i++) {
+		if (px_jobs[i].id && !strcmp(px_jobs[i].id, id))
+			return &px_jobs[i];
+	}
+	return NULL;
+}
+
+/* false if the key was already there */
+static bool px_job_add_key(struct px_job *job, uint64_t key)
+{
+	if (!key) key = 1;
+	if (2 * (job->nkeys + 1) > job->kmask) {
+		uint32_t size = job->kmask ? 2 * (job->kmask + 1) : 256;
+		uint64_t *keys = (uint64_t*) calloc(size, sizeof(uint64_t));
+		if (!keys)
+			return true;
+		for (uint32_t i = 0; job->keys && i <= job->kmask; i++) {
+			uint64_t k = job->keys[i];
+			if (!k) continue;
+			uint32_t h = (uint32_t) (k ^ (k >> 32)) & (size - 1);
+			while (keys[h]) h = (h + 1) & (size - 1);
+			keys[h] = k;
+		}
+		free(job->keys);
+		job->keys = keys;
+		job->kmask = size - 1;
+	}
+	uint32_t h = (uint32_t) (key ^ (key >> 32)) & job->kmask;
+	while (job->keys[h]) {
+		if (job->keys[h] == key)
+			return false;
+		h = (h + 1) & job->kmask;
+	}
+	job->keys[h] = key;
+	job->nkeys++;
+	return true;
+}
+
+static uint64_t px_share_key(uint32_t slot, const uchar *xnonce2, int len, uint32_t ntime, uint32_t nonce)
+{
+	uint64_t key = ((uint64_t) slot << 32) ^ ((uint64_t) ntime * 0x9e3779b97f4a7c15ULL) ^ nonce;
+	for (int i = 0; i < len; i++)
+		key = (key ^ xnonce2[i]) * 0x100000001b3ULL;
+	return key;
+}
+
+static void px_wakeup()
+{
+#ifndef WIN32
+	if (px_wake[1] >= 0) {
+		char c = 1;
+		if (write(px_wake[1], &c, 1) < 0) {
+			// pipe already full, the thread will wake up
+		}
+	}
+#endif
+}
+
+/* called by the stratum thread on each new pool job */
+void proxy_notify(struct stratum_ctx *sctx)
+{
+	if (!px_running || sctx->rpc2 || sctx->is_equihash)
+		return;
+
+	struct stratum_job *cur = stratum_job_acquire(sctx);
+	if (!cur || !cur->coinbase) {
+		stratum_job_release();
+		return;
+	}
+	const uchar *xnonce1 = cur->xnonce2 - cur->xnonce1_size;
+	pthread_mutex_lock(&px_lock);
+	px_sctx = sctx;
+	struct px_job *last = px_njobs ? &px_jobs[(px_njobs - 1) % PX_JOBS] : NULL;
+	if (last && last->id && !strcmp(last->id, cur->job_id)) {
+		pthread_mutex_unlock(&px_lock);
+		stratum_job_release();
+		return;
+	}
+
+	if ((int) cur->xnonce1_size != px_xnonce1_size || (int) cur->xnonce2_size != px_xnonce2_size ||
+	    memcmp(px_xnonce1, xnonce1, px_xnonce1_size)) {
+		px_xnonce1_size = (int) min(cur->xnonce1_size, sizeof(px_xnonce1));
+		memcpy(px_xnonce1, xnonce1, px_xnonce1_size);
+		px_xnonce2_size = (int) cur->xnonce2_size;
+		px_xn_gen++;
+		if (!px_prefix_size(px_xnonce2_size))
+			applog(LOG_ERR, "proxy: extranonce2 size %d is too small to be shared", px_xnonce2_size);
+	}
+
+	struct px_job *job = &px_jobs[px_njobs % PX_JOBS];
+	px_job_free(job);
+	int coinb1_size = (int) (cur->xnonce2 - cur->coinbase) - px_xnonce1_size;
+	int tail = (int) (cur->xnonce2 - cur->coinbase) + px_xnonce2_size;
+	job->id = strdup(cur->job_id);
+	memcpy(job->prevhash, cur->prevhash, 32);
+	memcpy(job->version, cur->version, 4);
+	memcpy(job->nbits, cur->nbits, 4);
+	job->cb_head_size = coinb1_size + px_xnonce1_size;
+	job->cb_tail_size = (int) cur->coinbase_size - tail;
+	job->cb_head = (uchar*) malloc(job->cb_head_size);
+	job->cb_tail = (uchar*) malloc(job->cb_tail_size + 1);
+	job->merkle_count = cur->merkle_count;
+	job->merkle = (uchar*) malloc(32 * job->merkle_count + 1);
+	job->diff = cur->diff;
+	job->xn_gen = px_xn_gen;
+	job->notify = (char*) malloc(256 + strlen(job->id) + 2 * cur->coinbase_size + 67 * job->merkle_count);
+	if (!job->id || !job->cb_head || !job->cb_tail || !job->merkle || !job->notify) {
+		applog(LOG_ERR, "proxy: job alloc failed");
+		px_job_free(job);
+		pthread_mutex_unlock(&px_lock);
+		stratum_job_release();
+		return;
+	}
+	memcpy(job->cb_head, cur->coinbase, job->cb_head_size);
+	memcpy(job->cb_tail, cur->coinbase + tail, job->cb_tail_size);
+	for (int i = 0; i < job->merkle_count; i++)
+		memcpy(&job->merkle[32 * i], cur->merkle[i], 32);
+
+	bool clean = cur->clean || memcmp(px_prevhash, job->prevhash, 32);
+	memcpy(px_prevhash, job->prevhash, 32);
+
+	char *p = job->notify;
+	p += sprintf(p, "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"%s\",\"", job->id);
+	cbin2hex(p, (const char*) job->prevhash, 32); p += 64;
+	p += sprintf(p, "\",\"");
+	cbin2hex(p, (const char*) job->cb_head, coinb1_size); p += 2 * coinb1_size;
+	p += sprintf(p, "\",\"");
+	cbin2hex(p, (const char*) job->cb_tail, job->cb_tail_size); p += 2 * job->cb_tail_size;
+	p += sprintf(p, "\",[");
+	for (int i = 0; i < job->merkle_count; i++) {
+		p += sprintf(p, "%s\"", i ? "," : "");
+		cbin2hex(p, (const char*) &job->merkle[32 * i], 32); p += 64;
+		*p++ = '"';
+	}
+	p += sprintf(p, "],\"");
+	cbin2hex(p, (const char*) job->version, 4); p += 8;
+	p += sprintf(p, "\",\"");
+	cbin2hex(p, (const char*) job->nbits, 4); p += 8;
+	p += sprintf(p, "\",\"");
+	cbin2hex(p, (const char*) cur->ntime, 4); p += 8;
+	sprintf(p, "\",%s]}", clean ? "true" : "false");
+
+	px_njobs++;
+	pthread_mutex_unlock(&px_lock);
+	stratum_job_release();
+	px_wakeup();
+}
+
+/* pool answer of a proxied share (stratum thread) */
+void proxy_share_result(int id, bool accepted, const char *reason)
+{
+	pthread_mutex_lock(&px_lock);
+	if (accepted) px_stats.accepted++;
+	else px_stats.rejected++;
+	pthread_mutex_unlock(&px_lock);
+	if (!accepted && opt_debug)
+		applog(LOG_DEBUG, "proxy: share %d rejected by the pool (%s)", id - PROXY_SUBMIT_ID,
+			reason ? reason : "no reason");
+}
+
+static void px_flush(struct px_conn *c)
+{
+	size_t sent = 0;
+	while (sent < c->outlen) {
+		int n = (int) send(c->sock, c->out + sent, (int) (c->outlen - sent), PX_SENDFLAGS);
+		if (n <= 0) {
+			if (n < 0 && WOULDBLOCK)
+				break;
+			c->closing = true;
+			return;
+		}
+		sent += n;
+	}
+	c->outlen -= sent;
+	if (c->outlen && sent)
+		memmove(c->out, c->out + sent, c->outlen);
+}
+
+/* queue a line, sent when the socket is writable */
+static void px_send(struct px_conn *c, const char *line)
+{
+	size_t len = strlen(line);
+
+	if (c->closing)
+		return;
+	if (opt_protocol)
+		applog(LOG_DEBUG, "proxy %u> %s", c->slot, line);
+	if (c->outlen + len + 1 > PX_SENDMAX) {
+		if (opt_debug)
+			applog(LOG_DEBUG, "proxy: client %u is too slow, closing", c->slot);
+		px_stats.dropped++;
+		c->closing = true;
+		return;
+	}
+	if (c->outlen + len + 1 > c->outsize) {
+		size_t size = max(c->outsize * 2, c->outlen + len + 1);
+		char *out = (char*) realloc(c->out, size);
+		if (!out) {
+			c->closing = true;
+			return;
+		}
+		c->out = out;
+		c->outsize = size;
+	}
+	memcpy(c->out + c->outlen, line, len);
+	c->out[c->outlen + len] = '\n';
+	c->outlen += len + 1;
+	// try at once, the poll loop sends the rest
+	px_flush(c);
+}
+
+/* client extranonce1, the pool one and the slot, caller holds px_lock */
+static void px_client_xnonce1(struct px_conn *c, char *hex)
+{
+	uchar xn1[sizeof(px_xnonce1) + 2];
+	int prefix = px_prefix_size(px_xnonce2_size);
+	memcpy(xn1, px_xnonce1, px_xnonce1_size);
+	px_slot_bytes(&xn1[px_xnonce1_size], c->slot, prefix);
+	cbin2hex(hex, (const char*) xn1, px_xnonce1_size + prefix);
+}
+
+/* difficulty and last job, if not already sent */
+static void px_send_job(struct px_conn *c)
+{
+	char *line = NULL;
+	double diff = 0.;
+	bool ready;
+
+	pthread_mutex_lock(&px_lock);
+	ready = px_njobs && px_njobs != c->sent_job;
+	if (ready && c->xn_gen != px_xn_gen) {
+		// the pool extranonce1 changed, the client must be updated or reconnect
+		if (c->xn_sub && px_prefix_size(px_xnonce2_size)) {
+			char s[192], hex[2 * sizeof(px_xnonce1) + 8];
+			px_client_xnonce1(c, hex);
+			snprintf(s, sizeof(s), "{\"id\":null,\"method\":\"mining.set_extranonce\",\"params\":[\"%s\",%d]}",
+				hex, px_xnonce2_size - px_prefix_size(px_xnonce2_size));
+			c->xn_gen = px_xn_gen;
+			pthread_mutex_unlock(&px_lock);
+			px_send(c, s);
+			pthread_mutex_lock(&px_lock);
+		} else {
+			c->closing = true;
+			ready = false;
+		}
+	}
+	if (ready) {
+		struct px_job *job = &px_jobs[(px_njobs - 1) % PX_JOBS];
+		line = strdup(job->notify);
+		diff = job->diff;
+		c->sent_job = px_njobs;
+	}
+	pthread_mutex_unlock(&px_lock);
+
+	if (!line)
+		return;
+	if (diff != c->sent_diff) {
+		char s[96];
+		snprintf(s, sizeof(s), "{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[%.17g]}", diff);
+		px_send(c, s);
+		c->sent_diff = diff;
+	}
+	px_send(c, line);
+	free(line);
+}
+
+static bool px_hex_param(json_t *params, int n, void *buf, size_t len)
+{
+	const char *hex = json_string_value(json_array_get(params, n));
+	return hex && strlen(hex) == 2 * len && hex2bin(buf, hex, len);
+}
+
+/* rebuild the header as stratum_gen_work(), the hash is left to check */
+static int px_check_share(struct px_conn *c, json_t *params, struct px_share *share)
+{
+	uint32_t _ALIGN(64) data[32];
+	uchar *xnonce2 = share->xnonce2;
+	int *xn2_size = &share->xn2_size;
+	uchar merkle_root[64];
+	uchar ntime[4], nonce[4];
+	struct px_job *job;
+
+	const char *job_id = json_string_value(json_array_get(params, 1));
+	pthread_mutex_lock(&px_lock);
+	int prefix = px_prefix_size(px_xnonce2_size);
+	int len = px_xnonce2_size - prefix;
+	if (!job_id || !prefix || !px_hex_param(params, 2, &xnonce2[prefix], len) ||
+	    !px_hex_param(params, 3, ntime, 4) || !px_hex_param(params, 4, nonce, 4)) {
+		pthread_mutex_unlock(&px_lock);
+		return PX_INVALID;
+	}
+	px_slot_bytes(xnonce2, c->slot, prefix);
+	*xn2_size = px_xnonce2_size;
+
+	job = px_find_job(job_id);
+	if (!job || job->xn_gen != c->xn_gen || job->xn_gen != px_xn_gen ||
+	    memcmp(job->prevhash, px_prevhash, 32)) {
+		pthread_mutex_unlock(&px_lock);
+		return PX_STALE;
+	}
+	if (!px_job_add_key(job, px_share_key(c->slot, xnonce2, *xn2_size, le32dec(ntime), le32dec(nonce)))) {
+		pthread_mutex_unlock(&px_lock);
+		return PX_DUP;
+	}
+	if (!px_algo) {
+		pthread_mutex_unlock(&px_lock);
+		return PX_UNCHECKED;
+	}
+
+	size_t coinbase_size = job->cb_head_size + *xn2_size + job->cb_tail_size;
+	uchar *coinbase = (uchar*) malloc(coinbase_size);
+	if (!coinbase) {
+		pthread_mutex_unlock(&px_lock);
+		return PX_UNCHECKED;
+	}
+	memcpy(coinbase, job->cb_head, job->cb_head_size);
+	memcpy(coinbase + job->cb_head_size, xnonce2, *xn2_size);
+	memcpy(coinbase + job->cb_head_size + *xn2_size, job->cb_tail, job->cb_tail_size);
+
+	switch (opt_algo) {
+		case ALGO_FUGUE256:
+		case ALGO_GROESTL:
+		case ALGO_KECCAK:
+		case ALGO_BLAKECOIN:
+		case ALGO_WHIRLCOIN:
+			SHA256(coinbase, coinbase_size, merkle_root);
+			break;
+		default:
+			sha256d(merkle_root, coinbase, (int) coinbase_size);
+	}
+	free(coinbase);
+	for (int i = 0; i < job->merkle_count; i++) {
+		memcpy(merkle_root + 32, &job->merkle[32 * i], 32);
+		sha256d(merkle_root, merkle_root, 64);
+	}
+
+	memset(data, 0, sizeof(data));
+	data[0] = le32dec(job->version);
+	for (int i = 0; i < 8; i++)
+		data[1 + i] = le32dec((uint32_t*) job->prevhash + i);
+	for (int i = 0; i < 8; i++)
+		data[9 + i] = be32dec((uint32_t*) merkle_root + i);
+	data[17] = le32dec(ntime);
+	data[18] = le32dec(job->nbits);
+	data[19] = le32dec(nonce);
+	data[20] = 0x80000000;
+	data[31] = 0x00000280;
+	double diff = job->diff;
+	pthread_mutex_unlock(&px_lock);
+
+	if (opt_algo == ALGO_SCRYPT)
+		memcpy(share->endiandata, data, 80);
+	else for (int i = 0; i < 20; i++)
+		be32enc(&share->endiandata[i], data[i]);
+	diff_to_target(share->target, diff / stratum_diff_factor(opt_algo));
+	return PX_PENDING;
+}
+
+static void px_share_hash(struct px_share *share)
+{
+	uint32_t _ALIGN(64) hash[16];
+	px_algo->hash(hash, share->endiandata);
+	share->rc = u256_le32(hash, share->target) ? PX_VALID : PX_LOW;
+}
+
+static void px_share_free(struct px_share *share)
+{
+	free(share->sid);
+	free(share->job_id);
+	aligned_free(share);
+}
+
+static void *px_checker(void *userdata)
+{
+	while (1) {
+		struct px_share *share = (struct px_share *) tq_pop(px_checkq, NULL);
+		if (!share) {
+			if (px_stopping)
+				break;
+			continue;
+		}
+		px_share_hash(share);
+		pthread_mutex_lock(&px_lock);
+		if (px_done_tail) px_done_tail->next = share;
+		else px_done = share;
+		px_done_tail = share;
+		px_pending--;
+		pthread_mutex_unlock(&px_lock);
+		px_wakeup();
+	}
+	return NULL;
+}
+
+/* answer the client and forward the valid share to the pool */
+static void px_share_done(struct px_conn *c, struct px_share *share)
+{
+	static const char *reasons[] = { NULL, "Job not found", "Duplicate share", "Low difficulty share", "Invalid share", NULL };
+	static const int codes[] = { 0, 21, 22, 23, 20, 0 };
+	const int rc = share->rc;
+	const char *sid = share->sid ? share->sid : "null";
+	char s[256];
+
+	px_stats.shares++;
+	switch (rc) {
+		case PX_STALE: px_stats.stale++; break;
+		case PX_DUP: px_stats.dup++; break;
+		case PX_LOW: case PX_INVALID: px_stats.low++; break;
+		case PX_UNCHECKED: px_stats.unchecked++; break;
+	}
+	if (reasons[rc])
+		snprintf(s, sizeof(s), "{\"id\":%s,\"result\":false,\"error\":[%d,\"%s\",null]}",
+			sid, codes[rc], reasons[rc]);
+	else
+		snprintf(s, sizeof(s), "{\"id\":%s,\"result\":true,\"error\":null}", sid);
+	px_send(c, s);
+	if (reasons[rc])
+		return;
+
+	// forward to the pool
+	char xn2hex[65], *line;
+	cbin2hex(xn2hex, (const char*) share->xnonce2, share->xn2_size);
+
+	pthread_mutex_lock(&px_lock);
+	struct stratum_ctx *sctx = px_sctx;
+	uint32_t num = PROXY_SUBMIT_ID + (px_stats.sent++ & 0xfffffff);
+	pthread_mutex_unlock(&px_lock);
+	if (!sctx)
+		return;
+	const char *user = pools[sctx->pooln].user;
+	line = (char*) malloc(128 + strlen(user) + strlen(share->job_id) + sizeof(xn2hex));
+	if (!line)
+		return;
+	sprintf(line, "{\"method\": \"mining.submit\", \"params\": [\"%s\", \"%s\", \"%s\", \"%s\", \"%s\"], \"id\":%u}",
+		user, share->job_id, xn2hex, share->ntime, share->nonce, num);
+	if (!stratum_send_line(sctx, line) && opt_debug)
+		applog(LOG_DEBUG, "proxy: unable to send the share to the pool");
+	free(line);
+}
+
+static void px_handle_submit(struct px_conn *c, json_t *id, json_t *params)
+{
+	struct px_share *share = (struct px_share *) aligned_calloc(sizeof(*share));
+	if (!share) {
+		c->closing = true;
+		return;
+	}
+	share->slot = c->slot;
+	share->conn_id = c->id;
+	share->sid = json_dumps(id, JSON_ENCODE_ANY);
+	share->rc = c->authorized ? px_check_share(c, params, share) : PX_INVALID;
+	if (share->rc == PX_PENDING || share->rc == PX_UNCHECKED) {
+		const char *job_id = json_string_value(json_array_get(params, 1));
+		share->job_id = strdup(job_id);
+		snprintf(share->ntime, sizeof(share->ntime), "%s", json_string_value(json_array_get(params, 3)));
+		snprintf(share->nonce, sizeof(share->nonce), "%s", json_string_value(json_array_get(params, 4)));
+		if (!share->job_id)
+			share->rc = PX_INVALID;
+	}
+
+	if (share->rc == PX_PENDING) {
+		pthread_mutex_lock(&px_lock);
+		bool queue = px_checkq && px_pending < PX_MAXPENDING;
+		if (queue) px_pending++;
+		pthread_mutex_unlock(&px_lock);
+		if (queue && tq_push(px_checkq, share))
+			return;
+		if (queue) {
+			pthread_mutex_lock(&px_lock);
+			px_pending--;
+			pthread_mutex_unlock(&px_lock);
+		}
+		px_share_hash(share);
+	}
+	px_share_done(c, share);
+	px_share_free(share);
+}
+
+static void px_checkers_stop()
+{
+	for (int i = 0; i < px_ncheckers; i++)
+		tq_push(px_checkq, NULL);
+	for (int i = 0; i < px_ncheckers; i++)
+		pthread_join(px_checkers[i], NULL);
+	px_ncheckers = 0;
+	if (px_checkq)
+		tq_free(px_checkq);
+	px_checkq = NULL;
+}
+
+/* the shares checked by the px_checker threads */
+static void px_answer_checked()
+{
+	pthread_mutex_lock(&px_lock);
+	struct px_share *share = px_done;
+	px_done = px_done_tail = NULL;
+	pthread_mutex_unlock(&px_lock);
+
+	while (share) {
+		struct px_share *next = share->next;
+		struct px_conn *c = px_slots[share->slot];
+		// the client could be gone, and its slot given to another one
+		if (c && c->id == share->conn_id && !c->closing)
+			px_share_done(c, share);
+		px_share_free(share);
+		share = next;
+	}
+}
+
+static void px_handle_line(struct px_conn *c, const char *line)
+{
+	json_error_t err;
+	char s[256];
+
+	if (opt_protocol)
+		applog(LOG_DEBUG, "proxy %u< %s", c->slot, line);
+
+	json_t *val = JSON_LOADS(line, &err);
+	if (!val) {
+		c->closing = true;
+		return;
+	}
+	const char *method = json_string_value(json_object_get(val, "method"));
+	json_t *params = json_object_get(val, "params");
+	json_t *id = json_object_get(val, "id");
+	char *sid = (id && !json_is_null(id)) ? json_dumps(id, JSON_ENCODE_ANY) : NULL;
+
+	if (!method) {
+		// client answer (ignored)
+	} else if (!strcasecmp(method, "mining.subscribe")) {
+		char hex[2 * sizeof(px_xnonce1) + 8];
+		int n2 = 0;
+		pthread_mutex_lock(&px_lock);
+		int prefix = px_prefix_size(px_xnonce2_size);
+		if (px_njobs && prefix && c->slot < (1U << (8 * prefix))) {
+			px_client_xnonce1(c, hex);
+			n2 = px_xnonce2_size - prefix;
+			c->xn_gen = px_xn_gen;
+		}
+		pthread_mutex_unlock(&px_lock);
+		if (n2) {
+			snprintf(s, sizeof(s), "{\"id\":%s,\"result\":[[[\"mining.set_difficulty\",\"%x\"],"
+				"[\"mining.notify\",\"%x\"]],\"%s\",%d],\"error\":null}",
+				sid ? sid : "null", c->slot, c->slot, hex, n2);
+			c->subscribed = true;
+		} else {
+			snprintf(s, sizeof(s), "{\"id\":%s,\"result\":null,\"error\":[20,\"Not ready\",null]}",
+				sid ? sid : "null");
+			c->closing = true;
+		}
+		px_send(c, s);
+	} else if (!strcasecmp(method, "mining.extranonce.subscribe")) {
+		c->xn_sub = true;
+		snprintf(s, sizeof(s), "{\"id\":%s,\"result\":true,\"error\":null}", sid ? sid : "null");
+		px_send(c, s);
+	} else if (!strcasecmp(method, "mining.authorize")) {
+		snprintf(s, sizeof(s), "{\"id\":%s,\"result\":%s,\"error\":null}", sid ? sid : "null",
+			c->subscribed ? "true" : "false");
+		px_send(c, s);
+		if (c->subscribed && !c->authorized) {
+			c->authorized = true;
+			px_send_job(c);
+		}
+	} else if (!strcasecmp(method, "mining.submit") && json_is_array(params)) {
+		px_handle_submit(c, id, params);
+	} else if (sid) {
+		snprintf(s, sizeof(s), "{\"id\":%s,\"result\":null,\"error\":[20,\"Not supported\",null]}", sid);
+		px_send(c, s);
+	}
+
+	free(sid);
+	json_decref(val);
+}
+
+static void px_read(struct px_conn *c)
+{
+	int n = recv(c->sock, &c->inbuf[c->inlen], PX_RECVBUF - 1 - c->inlen, 0);
+	if (n <= 0) {
+		if (n < 0 && WOULDBLOCK)
+			return;
+		c->closing = true;
+		return;
+	}
+	c->inlen += n;
+	c->inbuf[c->inlen] = '\0';
+
+	char *line = c->inbuf, *eol;
+	while (!c->closing && (eol = strchr(line, '\n')) != NULL) {
+		*eol = '\0';
+		if (eol > line && eol[-1] == '\r') eol[-1] = '\0';
+		if (*line) px_handle_line(c, line);
+		line = eol + 1;
+	}
+	c->inlen -= (int) (line - c->inbuf);
+	memmove(c->inbuf, line, c->inlen);
+	if (c->inlen == PX_RECVBUF - 1) {
+		applog(LOG_WARNING, "proxy: line too long, closing client %u", c->slot);
+		c->closing = true;
+	}
+}
+
+static bool px_nonblock(SOCKETTYPE sock)
+{
+#ifndef WIN32
+	int flags = fcntl(sock, F_GETFL, 0);
+	return flags >= 0 && fcntl(sock, F_SETFL, flags | O_NONBLOCK) == 0;
+#else
+	u_long mode = 1;
+	return ioctlsocket(sock, FIONBIO, &mode) == 0;
+#endif
+}
+
+static void px_accept()
+{
+	for (;;) {
+		SOCKETTYPE sock = accept(px_sock, NULL, NULL);
+		if (SOCKETFAIL(sock))
+			return;
+		struct px_conn *c = NULL;
+		if (px_nfree && px_nonblock(sock))
+			c = (struct px_conn*) calloc(1, sizeof(struct px_conn));
+		if (!c || px_nconns + 2 >= PX_MAXSLOTS) {
+			free(c);
+			CLOSESOCKET(sock);
+			continue;
+		}
+		c->sock = sock;
+		c->slot = px_free_slots[--px_nfree];
+		c->id = ++px_stats.conns;
+		c->sent_diff = -1.;
+		px_conns[px_nconns++] = c;
+		px_slots[c->slot] = c;
+		px_stats.peak = max(px_stats.peak, (uint32_t) px_nconns);
+	}
+}
+
+/* free the closed connections, the order of the list is not kept */
+static void px_sweep()
+{
+	for (int i = px_nconns - 1; i >= 0; i--) {
+		struct px_conn *c = px_conns[i];
+		if (!c->closing)
+			continue;
+		CLOSESOCKET(c->sock);
+		px_slots[c->slot] = NULL;
+		px_free_slots[px_nfree++] = c->slot;
+		free(c->out);
+		free(c);
+		px_conns[i] = px_conns[--px_nconns];
+	}
+}
+
+static void px_report()
+{
+	pthread_mutex_lock(&px_lock);
+	applog(LOG_INFO, "proxy: %d clients (peak %u), %u shares, %u stale, %u duplicate, %u low, "
+		"%u accepted and %u rejected by the pool", px_nconns, px_stats.peak, px_stats.shares,
+		px_stats.stale, px_stats.dup, px_stats.low, px_stats.accepted, px_stats.rejected);
+	pthread_mutex_unlock(&px_lock);
+}
+
+static void *px_thread(void *userdata)
+{
+	uint32_t sent_jobs = 0;
+
+	while (!px_stopping && !abort_flag) {
+		int nfds = 0, nconns = px_nconns;
+
+		if (px_fds_size < nconns + 2) {
+			px_fds_size = max(2 * px_fds_size, nconns + 2);
+			px_fds = (struct pollfd*) realloc(px_fds, px_fds_size * sizeof(struct pollfd));
+		}
+		px_fds[nfds].fd = px_sock;
+		px_fds[nfds++].events = POLLIN;
+#ifndef WIN32
+		px_fds[nfds].fd = px_wake[0];
+		px_fds[nfds++].events = POLLIN;
+#endif
+		for (int i = 0; i < nconns; i++) {
+			px_fds[nfds].fd = px_conns[i]->sock;
+			px_fds[nfds++].events = POLLIN | (px_conns[i]->outlen ? POLLOUT : 0);
+		}
+		for (int i = 0; i < nfds; i++)
+			px_fds[i].revents = 0;
+
+		int n = poll(px_fds, nfds, PX_POLL_MS);
+		if (n < 0 && errno != EINTR) {
+			applog(LOG_ERR, "proxy: poll failed (%s)", strerror(errno));
+			break;
+		}
+
+#ifndef WIN32
+		if (px_fds[1].revents & POLLIN) {
+			char buf[64];
+			while (read(px_wake[0], buf, sizeof(buf)) > 0);
+		}
+#endif
+		int first = nfds - nconns;
+		for (int i = 0; n > 0 && i < nconns; i++) {
+			struct px_conn *c = px_conns[i];
+			short ev = px_fds[first + i].revents;
+			if (ev & (POLLERR | POLLNVAL))
+				c->closing = true;
+			if (!c->closing && (ev & POLLOUT))
+				px_flush(c);
+			if (!c->closing && (ev & (POLLIN | POLLHUP)))
+				px_read(c);
+		}
+		px_answer_checked();
+
+		// new pool job, the same line for all the clients
+		pthread_mutex_lock(&px_lock);
+		uint32_t njobs = px_njobs;
+		pthread_mutex_unlock(&px_lock);
+		if (njobs != sent_jobs) {
+			for (int i = 0; i < px_nconns; i++) {
+				if (px_conns[i]->authorized)
+					px_send_job(px_conns[i]);
+			}
+			sent_jobs = njobs;
+		}
+
+		px_sweep();
+		if (px_fds[0].revents & POLLIN)
+			px_accept();
+
+		time_t now = time(NULL);
+		if (now >= px_stats.next_report) {
+			if (px_stats.next_report && !opt_quiet)
+				px_report();
+			px_stats.next_report = now + PX_REPORT_S;
+		}
+	}
+	return NULL;
+}
+
+/* bind and start the proxy thread, spec is [IP:]PORT */
+bool proxy_start(const char *spec)
+{
+	struct sockaddr_in serv;
+	char addr[64] = "0.0.0.0";
+	const char *p = strrchr(spec, ':');
+	int port;
+
+	if (p) {
+		snprintf(addr, sizeof(addr), "%.*s", (int) (p - spec), spec);
+		port = atoi(p + 1);
+	} else {
+		port = atoi(spec);
+	}
+	if (port <= 0 || port > 65535) {
+		applog(LOG_ERR, "proxy: invalid port %s", spec);
+		return false;
+	}
+
+	switch (opt_algo) {
+		case ALGO_CRYPTOLIGHT:
+		case ALGO_CRYPTONIGHT:
+		case ALGO_DECRED:
+		case ALGO_EQUIHASH:
+		case ALGO_HEAVY:
+		case ALGO_LBRY:
+		case ALGO_PHI2:
+		case ALGO_SIA:
+		case ALGO_WILDKECCAK:
+			applog(LOG_ERR, "proxy: %s stratum jobs are not supported", algo_names[opt_algo]);
+			return false;
+		case ALGO_MJOLLNIR:
+		case ALGO_ZR5:
+			px_algo = NULL;
+			break;
+		default:
+			px_algo = cpu_hash_find(algo_names[opt_algo]);
+			if (px_algo && px_algo->datalen != 80)
+				px_algo = NULL;
+	}
+	if (!px_algo)
+		applog(LOG_WARNING, "proxy: %s shares will not be checked", algo_names[opt_algo]);
+
+	px_free_slots = (uint32_t*) malloc(PX_MAXSLOTS * sizeof(uint32_t));
+	px_conns = (struct px_conn**) malloc(PX_MAXSLOTS * sizeof(struct px_conn*));
+	px_slots = (struct px_conn**) calloc(PX_MAXSLOTS, sizeof(struct px_conn*));
+	if (!px_free_slots || !px_conns || !px_slots) {
+		applog(LOG_ERR, "proxy: alloc failed");
+		return false;
+	}
+	// slot 0 is the local miner, lower slots first
+	for (uint32_t s = PX_MAXSLOTS - 1; s > 0; s--)
+		px_free_slots[px_nfree++] = s;
+
+#ifndef WIN32
+	// thousands of clients, use the hard limit of open files
+	struct rlimit rl;
+	if (!getrlimit(RLIMIT_NOFILE, &rl) && rl.rlim_cur < rl.rlim_max) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+	}
+	if (pipe(px_wake) || !px_nonblock(px_wake[0]) || !px_nonblock(px_wake[1])) {
+		applog(LOG_ERR, "proxy: pipe failed (%s)", strerror(errno));
+		return false;
+	}
+#else
+	WSADATA wsa;
+	WSAStartup(MAKEWORD(2, 2), &wsa);
+#endif
+	px_sock = socket(AF_INET, SOCK_STREAM, 0);
+	if (px_sock == INVSOCK) {
+		applog(LOG_ERR, "proxy: socket failed (%s)", strerror(errno));
+		return false;
+	}
+#ifndef WIN32
+	int optval = 1;
+	setsockopt(px_sock, SOL_SOCKET, SO_REUSEADDR, (void *)(&optval), sizeof(optval));
+#endif
+	memset(&serv, 0, sizeof(serv));
+	serv.sin_family = AF_INET;
+	serv.sin_addr.s_addr = inet_addr(addr);
+	serv.sin_port = htons((unsigned short) port);
+	if (SOCKETFAIL(bind(px_sock, (struct sockaddr *)(&serv), sizeof(serv))) ||
+	    SOCKETFAIL(listen(px_sock, 512)) || !px_nonblock(px_sock)) {
+		applog(LOG_ERR, "proxy: bind to %s:%d failed (%s)", addr, port, strerror(errno));
+		CLOSESOCKET(px_sock);
+		px_sock = INVSOCK;
+		return false;
+	}
+
+	px_stopping = false;
+	if (px_algo && (px_checkq = tq_new()) != NULL) {
+		for (; px_ncheckers < PX_CHECKERS; px_ncheckers++) {
+			if (pthread_create(&px_checkers[px_ncheckers], NULL, px_checker, NULL))
+				break;
+		}
+		if (!px_ncheckers)
+			px_checkers_stop();
+	}
+	px_running = true;
+	if (pthread_create(&px_thr, NULL, px_thread, NULL)) {
+		applog(LOG_ERR, "proxy: thread create failed");
+		px_running = false;
+		px_stopping = true;
+		px_checkers_stop();
+		CLOSESOCKET(px_sock);
+		px_sock = INVSOCK;
+		return false;
+	}
+	applog(LOG_INFO, "proxy: listening on %s:%d", addr, port);
+	return true;
+}
+
+void proxy_stop()
+{
+	if (!px_running)
+		return;
+	px_stopping = true;
+	px_wakeup();
+	pthread_join(px_thr, NULL);
+	px_running = false;
+	px_checkers_stop();
+	px_answer_checked();
+	px_report();
+
+	for (int i = 0; i < px_nconns; i++)
+		px_conns[i]->closing = true;
+	px_sweep();
+	CLOSESOCKET(px_sock);
+	px_sock = INVSOCK;
+	pthread_mutex_lock(&px_lock);
+	for (int i = 0; i < PX_JOBS; i++)
+		px_job_free(&px_jobs[i]);
+	pthread_mutex_unlock(&px_lock);
+}
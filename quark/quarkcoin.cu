@@ -272,14 +272,14 @@ extern "C" int scanhash_quark(int thr_id, struct work* work, uint32_t max_nonce,
 		{
 			uint32_t _ALIGN(64) vhash[8];
 			be32enc(&endiandata[19], work->nonces[0]);
-			quarkhash(vhash, endiandata);
+			vstats_hash(thr_id, quarkhash(vhash, endiandata));
 
 			if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
 				work_set_target_ratio(work, vhash);
 				if (work->nonces[1] != 0) {
 					be32enc(&endiandata[19], work->nonces[1]);
-					quarkhash(vhash, endiandata);
+					vstats_hash(thr_id, quarkhash(vhash, endiandata));
 					bn_set_target_ratio(work, vhash, 1);
 					work->valid_nonces++;
 					pdata[19] = max(work->nonces[0], work->nonces[1]) + 1;
@@ -12,6 +12,7 @@
 #include "scrypt/code/scrypt-jane-portable.h"
 #include "scrypt/code/scrypt-jane-chacha.h"
 #include "scrypt/keccak.h"
+#include "sph/keccak-simd.h"
 
 #include "scrypt/salsa_kernel.h"
 
@@ -37,89 +38,16 @@ typedef struct scrypt_hash_state_t {
 	uint8_t buffer[SCRYPT_HASH_BLOCK_SIZE];
 } scrypt_hash_state;
 
-static const uint64_t keccak_round_constants[24] = {
-	0x0000000000000001ull, 0x0000000000008082ull,
-	0x800000000000808aull, 0x8000000080008000ull,
-	0x000000000000808bull, 0x0000000080000001ull,
-	0x8000000080008081ull, 0x8000000000008009ull,
-	0x000000000000008aull, 0x0000000000000088ull,
-	0x0000000080008009ull, 0x000000008000000aull,
-	0x000000008000808bull, 0x800000000000008bull,
-	0x8000000000008089ull, 0x8000000000008003ull,
-	0x8000000000008002ull, 0x8000000000000080ull,
-	0x000000000000800aull, 0x800000008000000aull,
-	0x8000000080008081ull, 0x8000000000008080ull,
-	0x0000000080000001ull, 0x8000000080008008ull
-};
-
 static void keccak_block(scrypt_hash_state *S, const uint8_t *in)
 {
 	size_t i;
-	uint64_t *s = S->state, t[5], u[5], v, w;
+	uint64_t *s = S->state;
 
 	/* absorb input */
 	for (i = 0; i < SCRYPT_HASH_BLOCK_SIZE / 8; i++, in += 8)
 		s[i] ^= U8TO64_LE(in);
 
-	for (i = 0; i < 24; i++) {
-		/* theta: c = a[0,i] ^ a[1,i] ^ .. a[4,i] */
-		t[0] = s[0] ^ s[5] ^ s[10] ^ s[15] ^ s[20];
-		t[1] = s[1] ^ s[6] ^ s[11] ^ s[16] ^ s[21];
-		t[2] = s[2] ^ s[7] ^ s[12] ^ s[17] ^ s[22];
-		t[3] = s[3] ^ s[8] ^ s[13] ^ s[18] ^ s[23];
-		t[4] = s[4] ^ s[9] ^ s[14] ^ s[19] ^ s[24];
-
-		/* theta: d[i] = c[i+4] ^ rotl(c[i+1],1) */
-		u[0] = t[4] ^ ROTL64(t[1], 1);
-		u[1] = t[0] ^ ROTL64(t[2], 1);
-		u[2] = t[1] ^ ROTL64(t[3], 1);
-		u[3] = t[2] ^ ROTL64(t[4], 1);
-		u[4] = t[3] ^ ROTL64(t[0], 1);
-
-		/* theta: a[0,i], a[1,i], .. a[4,i] ^= d[i] */
-		s[0] ^= u[0]; s[5] ^= u[0]; s[10] ^= u[0]; s[15] ^= u[0]; s[20] ^= u[0];
-		s[1] ^= u[1]; s[6] ^= u[1]; s[11] ^= u[1]; s[16] ^= u[1]; s[21] ^= u[1];
-		s[2] ^= u[2]; s[7] ^= u[2]; s[12] ^= u[2]; s[17] ^= u[2]; s[22] ^= u[2];
-		s[3] ^= u[3]; s[8] ^= u[3]; s[13] ^= u[3]; s[18] ^= u[3]; s[23] ^= u[3];
-		s[4] ^= u[4]; s[9] ^= u[4]; s[14] ^= u[4]; s[19] ^= u[4]; s[24] ^= u[4];
-
-		/* rho pi: b[..] = rotl(a[..], ..) */
-		v = s[ 1];
-		s[ 1] = ROTL64(s[ 6], 44);
-		s[ 6] = ROTL64(s[ 9], 20);
-		s[ 9] = ROTL64(s[22], 61);
-		s[22] = ROTL64(s[14], 39);
-		s[14] = ROTL64(s[20], 18);
-		s[20] = ROTL64(s[ 2], 62);
-		s[ 2] = ROTL64(s[12], 43);
-		s[12] = ROTL64(s[13], 25);
-		s[13] = ROTL64(s[19],  8);
-		s[19] = ROTL64(s[23], 56);
-		s[23] = ROTL64(s[15], 41);
-		s[15] = ROTL64(s[ 4], 27);
-		s[ 4] = ROTL64(s[24], 14);
-		s[24] = ROTL64(s[21],  2);
-		s[21] = ROTL64(s[ 8], 55);
-		s[ 8] = ROTL64(s[16], 45);
-		s[16] = ROTL64(s[ 5], 36);
-		s[ 5] = ROTL64(s[ 3], 28);
-		s[ 3] = ROTL64(s[18], 21);
-		s[18] = ROTL64(s[17], 15);
-		s[17] = ROTL64(s[11], 10);
-		s[11] = ROTL64(s[ 7],  6);
-		s[ 7] = ROTL64(s[10],  3);
-		s[10] = ROTL64(    v,  1);
-
-		/* chi: a[i,j] ^= ~b[i,j+1] & b[i,j+2] */
-		v = s[ 0]; w = s[ 1]; s[ 0] ^= (~w) & s[ 2]; s[ 1] ^= (~s[ 2]) & s[ 3]; s[ 2] ^= (~s[ 3]) & s[ 4]; s[ 3] ^= (~s[ 4]) & v; s[ 4] ^= (~v) & w;
-		v = s[ 5]; w = s[ 6]; s[ 5] ^= (~w) & s[ 7]; s[ 6] ^= (~s[ 7]) & s[ 8]; s[ 7] ^= (~s[ 8]) & s[ 9]; s[ 8] ^= (~s[ 9]) & v; s[ 9] ^= (~v) & w;
-		v = s[10]; w = s[11]; s[10] ^= (~w) & s[12]; s[11] ^= (~s[12]) & s[13]; s[12] ^= (~s[13]) & s[14]; s[13] ^= (~s[14]) & v; s[14] ^= (~v) & w;
-		v = s[15]; w = s[16]; s[15] ^= (~w) & s[17]; s[16] ^= (~s[17]) & s[18]; s[17] ^= (~s[18]) & s[19]; s[18] ^= (~s[19]) & v; s[19] ^= (~v) & w;
-		v = s[20]; w = s[21]; s[20] ^= (~w) & s[22]; s[21] ^= (~s[22]) & s[23]; s[22] ^= (~s[23]) & s[24]; s[23] ^= (~s[24]) & v; s[24] ^= (~v) & w;
-
-		/* iota: a[0,0] ^= round constant */
-		s[0] ^= keccak_round_constants[i];
-	}
+	keccakf1600(s, 24);
 }
 
 static void scrypt_hash_init(scrypt_hash_state *S) {
@@ -333,6 +261,34 @@ static void scrypt_free(scrypt_aligned_alloc *aa)
 }
 #endif
 
+/* per thread buffers, kept between the hashes and resized on N-factor changes */
+struct jane_buf {
+	scrypt_aligned_alloc aa;
+	uint64_t size;
+};
+static __thread struct jane_buf jane_V, jane_YX, jane_X[2];
+
+static uint8_t* jane_buffer(struct jane_buf *b, uint64_t size)
+{
+	if (b->size != size) {
+		if (b->size)
+			scrypt_free(&b->aa);
+		b->aa = scrypt_alloc(size);
+		b->size = size;
+	}
+	return b->aa.ptr;
+}
+
+static void jane_free_buffers()
+{
+	struct jane_buf *bufs[] = { &jane_V, &jane_YX, &jane_X[0], &jane_X[1] };
+	for (int i = 0; i < 4; i++) {
+		if (!bufs[i]->size) continue;
+		scrypt_free(&bufs[i]->aa);
+		bufs[i]->size = 0;
+	}
+}
+
 
 // yacoin: increasing Nfactor gradually
 unsigned char GetNfactor(unsigned int nTimestamp)
@@ -436,6 +392,8 @@ void free_scrypt_jane(int thr_id)
 {
 	int dev_id = device_map[thr_id];
 
+	jane_free_buffers();
+
 	if (!init[thr_id])
 		return;
 
@@ -513,17 +471,13 @@ int scanhash_scrypt_jane(int thr_id, struct work *work, uint32_t max_nonce, unsi
 	}
 	if (parallel == 2) prepare_keccak512(thr_id, pdata);
 
-	scrypt_aligned_alloc Xbuf[2] = { scrypt_alloc(128 * throughput), scrypt_alloc(128 * throughput) };
-	scrypt_aligned_alloc Vbuf = scrypt_alloc(N * 128);
-	scrypt_aligned_alloc Ybuf = scrypt_alloc(128);
+	uint8_t *Xbuf[2] = { jane_buffer(&jane_X[0], 128 * throughput), jane_buffer(&jane_X[1], 128 * throughput) };
+	uint8_t *Vbuf = jane_buffer(&jane_V, (uint64_t) N * 128);
+	uint8_t *Ybuf = jane_buffer(&jane_YX, 2 * 128);
 
 	uint32_t nonce[2];
 	uint32_t* cuda_X[2]      = { cuda_transferbuffer(thr_id,0), cuda_transferbuffer(thr_id,1) };
 
-#if !defined(SCRYPT_CHOOSE_COMPILETIME)
-	scrypt_ROMixfn scrypt_ROMix = scrypt_getROMix();
-#endif
-
 	int cur = 0, nxt = 1;
 	int iteration = 0;
 
@@ -540,9 +494,9 @@ int scanhash_scrypt_jane(int thr_id, struct work *work, uint32_t max_nonce, unsi
 			}
 
 			for(int i=0;i<throughput;++i)
-				scrypt_pbkdf2_1((unsigned char *)&data[nxt][20*i], 80, (unsigned char *)&data[nxt][20*i], 80, Xbuf[nxt].ptr + 128 * i, 128);
+				scrypt_pbkdf2_1((unsigned char *)&data[nxt][20*i], 80, (unsigned char *)&data[nxt][20*i], 80, Xbuf[nxt] + 128 * i, 128);
 
-			memcpy(cuda_X[nxt], Xbuf[nxt].ptr, 128 * throughput);
+			memcpy(cuda_X[nxt], Xbuf[nxt], 128 * throughput);
 			cuda_scrypt_serialize(thr_id, nxt);
 			cuda_scrypt_HtoD(thr_id, cuda_X[nxt], nxt);
 			cuda_scrypt_core(thr_id, nxt, N);
@@ -555,20 +509,20 @@ int scanhash_scrypt_jane(int thr_id, struct work *work, uint32_t max_nonce, unsi
 				break;
 			}
 
-			memcpy(Xbuf[cur].ptr, cuda_X[cur], 128 * throughput);
+			memcpy(Xbuf[cur], cuda_X[cur], 128 * throughput);
 			for(int i=0;i<throughput;++i)
-				scrypt_pbkdf2_1((unsigned char *)&data[cur][20*i], 80, Xbuf[cur].ptr + 128 * i, 128, (unsigned char *)(&hash[cur][8*i]), 32);
+				scrypt_pbkdf2_1((unsigned char *)&data[cur][20*i], 80, Xbuf[cur] + 128 * i, 128, (unsigned char *)(&hash[cur][8*i]), 32);
 
 #define VERIFY_ALL 0
 #if VERIFY_ALL
 			{
 				/* 2: X = ROMix(X) */
 				for(int i=0;i<throughput;++i)
-					scrypt_ROMix_1((scrypt_mix_word_t *)(Xbuf[cur].ptr + 128 * i), (scrypt_mix_word_t *)Ybuf.ptr, (scrypt_mix_word_t *)Vbuf.ptr, N);
+					scrypt_ROMix_1((scrypt_mix_word_t *)(Xbuf[cur] + 128 * i), (scrypt_mix_word_t *)Ybuf, (scrypt_mix_word_t *)Vbuf, N);
 
 				unsigned int err = 0;
 				for(int i=0;i<throughput;++i) {
-					unsigned char *ref = (Xbuf[cur].ptr + 128 * i);
+					unsigned char *ref = (Xbuf[cur] + 128 * i);
 					unsigned char *dat = (unsigned char*)(cuda_X[cur] + 32 * i);
 					if (memcmp(ref, dat, 128) != 0)
 					{
@@ -623,22 +577,22 @@ int scanhash_scrypt_jane(int thr_id, struct work *work, uint32_t max_nonce, unsi
 					tdata[z] = bswap_32x4(pdata[z]);
 				tdata[19] = bswap_32x4(tmp_nonce);
 
-				scrypt_pbkdf2_1((unsigned char *)tdata, 80, (unsigned char *)tdata, 80, Xbuf[cur].ptr + 128 * i, 128);
-				scrypt_ROMix_1((scrypt_mix_word_t *)(Xbuf[cur].ptr + 128 * i), (scrypt_mix_word_t *)(Ybuf.ptr), (scrypt_mix_word_t *)(Vbuf.ptr), N);
-				scrypt_pbkdf2_1((unsigned char *)tdata, 80, Xbuf[cur].ptr + 128 * i, 128, (unsigned char *)thash, 32);
+				uint64_t vstart = vstats_clock();
+				scrypt_pbkdf2_1((unsigned char *)tdata, 80, (unsigned char *)tdata, 80, Xbuf[cur] + 128 * i, 128);
+				scrypt_ROMix_1((scrypt_mix_word_t *)(Xbuf[cur] + 128 * i), (scrypt_mix_word_t *)(Ybuf), (scrypt_mix_word_t *)(Vbuf), N);
+				scrypt_pbkdf2_1((unsigned char *)tdata, 80, Xbuf[cur] + 128 * i, 128, (unsigned char *)thash, 32);
+				vstats_verified(thr_id, vstart);
 
 				if (memcmp(thash, &hash[cur][8*i], 32) == 0)
 				{
 					work_set_target_ratio(work, thash);
 					*hashes_done = n - pdata[19];
 					pdata[19] = tmp_nonce;
-					scrypt_free(&Vbuf);
-					scrypt_free(&Ybuf);
-					scrypt_free(&Xbuf[0]); scrypt_free(&Xbuf[1]);
 					delete[] data[0]; delete[] data[1];
 					gettimeofday(tv_end, NULL);
 					return 1;
 				} else {
+					gpu_increment_reject(thr_id);
 					gpulog(LOG_WARNING, thr_id, "result does not validate on CPU! (i=%d, s=%d)", i, cur);
 				}
 			}
@@ -649,9 +603,6 @@ int scanhash_scrypt_jane(int thr_id, struct work *work, uint32_t max_nonce, unsi
 		++iteration;
 	} while (n <= max_nonce && !work_restart[thr_id].restart);
 
-	scrypt_free(&Vbuf);
-	scrypt_free(&Ybuf);
-	scrypt_free(&Xbuf[0]); scrypt_free(&Xbuf[1]);
 	delete[] data[0]; delete[] data[1];
 
 	*hashes_done = n - pdata[19];
@@ -667,10 +618,6 @@ static void scrypt_jane_hash_1_1(const uchar *password, size_t password_len, con
 	uint32_t chunk_bytes, i;
 	const uint32_t p = SCRYPT_P;
 
-#if !defined(SCRYPT_CHOOSE_COMPILETIME)
-	scrypt_ROMixfn scrypt_ROMix = scrypt_getROMix();
-#endif
-
 	chunk_bytes = SCRYPT_BLOCK_BYTES * SCRYPT_R * 2;
 
 	/* 1: X = PBKDF2(password, salt) */
@@ -689,25 +636,17 @@ static void scrypt_jane_hash_1_1(const uchar *password, size_t password_len, con
 #endif
 }
 
-/* for cpu hash test */
+/* for cpu hash test, V is fully written by ROMix before being read */
 void scryptjane_hash(void* output, const void* input)
 {
 	uint32_t Nsize = 1UL << (opt_nfactor + 1);
 	uint64_t chunk_bytes;
-	uint8_t *X, *Y;
-	scrypt_aligned_alloc YX, V;
+	uint8_t *X, *Y, *V;
 
 	chunk_bytes = 2ULL * SCRYPT_BLOCK_BYTES * SCRYPT_R;
-	V  = scrypt_alloc(Nsize * chunk_bytes);
-	YX = scrypt_alloc((SCRYPT_P + 1) * chunk_bytes);
-
-	memset(V.ptr, 0, (size_t) (Nsize * chunk_bytes));
-
-	Y = YX.ptr;
+	V = jane_buffer(&jane_V, Nsize * chunk_bytes);
+	Y = jane_buffer(&jane_YX, (SCRYPT_P + 1) * chunk_bytes);
 	X = Y + chunk_bytes;
 
-	scrypt_jane_hash_1_1((uchar*)input, 80, (uchar*)input, 80, (uint32_t) Nsize, (uchar*)output, 32, X, Y, V.ptr);
-
-	scrypt_free(&V);
-	scrypt_free(&YX);
+	scrypt_jane_hash_1_1((uchar*)input, 80, (uchar*)input, 80, (uint32_t) Nsize, (uchar*)output, 32, X, Y, V);
 }
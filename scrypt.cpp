@@ -43,6 +43,9 @@ using namespace Concurrency;
 #include <string.h>
 
 #include <emmintrin.h>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
 #ifndef __APPLE__
 #include <malloc.h>
 #endif
@@ -91,9 +94,12 @@ public:
 	inline const uint32x4_t operator&(const uint32x4_t &other) const { return _mm_and_si128(val, other); }
 	inline const uint32x4_t operator|(const uint32x4_t &other) const { return _mm_or_si128(val, other); }
 	inline const uint32x4_t operator^(const uint32x4_t &other) const { return _mm_xor_si128(val, other); }
+	inline uint32x4_t& operator^=(const uint32x4_t other) { val = _mm_xor_si128(val, other); return *this; }
 	inline const uint32x4_t operator<<(const int num) const { return _mm_slli_epi32(val, num); }
 	inline const uint32x4_t operator>>(const int num) const { return _mm_srli_epi32(val, num); }
 	inline const uint32_t operator[](const int num) const { return ((uint32_t*)&val)[num]; }
+	static inline uint32x4_t load(const uint32_t *p) { return _mm_loadu_si128((const __m128i*)p); }
+	inline void store(uint32_t *p) const { _mm_storeu_si128((__m128i*)p, val); }
  protected:
 	__m128i val;
 };
@@ -101,6 +107,54 @@ public:
 // non-member overload
 inline const uint32x4_t operator+(const uint32_t left, const uint32x4_t &right) { return _mm_add_epi32(_mm_set1_epi32((int)left), right); }
 
+// Wider lanes for the salsa core, only the operators used by xor_salsa8()
+#if defined(__AVX512F__)
+class uint32x16_t
+{
+public:
+	uint32x16_t() { };
+	uint32x16_t(const __m512i init) { val = init; }
+	inline operator const __m512i() const { return val; }
+	inline const uint32x16_t operator+(const uint32x16_t &other) const { return _mm512_add_epi32(val, other); }
+	inline uint32x16_t& operator+=(const uint32x16_t other) { val = _mm512_add_epi32(val, other); return *this; }
+	inline const uint32x16_t operator|(const uint32x16_t &other) const { return _mm512_or_si512(val, other); }
+	inline const uint32x16_t operator^(const uint32x16_t &other) const { return _mm512_xor_si512(val, other); }
+	inline uint32x16_t& operator^=(const uint32x16_t other) { val = _mm512_xor_si512(val, other); return *this; }
+	inline const uint32x16_t operator<<(const int num) const { return _mm512_slli_epi32(val, num); }
+	inline const uint32x16_t operator>>(const int num) const { return _mm512_srli_epi32(val, num); }
+	static inline uint32x16_t load(const uint32_t *p) { return _mm512_loadu_si512((const void*)p); }
+	inline void store(uint32_t *p) const { _mm512_storeu_si512((void*)p, val); }
+ protected:
+	__m512i val;
+};
+#define SCRYPT_LANES 16
+typedef uint32x16_t scrypt_lanes_t;
+#elif defined(__AVX2__)
+class uint32x8_t
+{
+public:
+	uint32x8_t() { };
+	uint32x8_t(const __m256i init) { val = init; }
+	inline operator const __m256i() const { return val; }
+	inline const uint32x8_t operator+(const uint32x8_t &other) const { return _mm256_add_epi32(val, other); }
+	inline uint32x8_t& operator+=(const uint32x8_t other) { val = _mm256_add_epi32(val, other); return *this; }
+	inline const uint32x8_t operator|(const uint32x8_t &other) const { return _mm256_or_si256(val, other); }
+	inline const uint32x8_t operator^(const uint32x8_t &other) const { return _mm256_xor_si256(val, other); }
+	inline uint32x8_t& operator^=(const uint32x8_t other) { val = _mm256_xor_si256(val, other); return *this; }
+	inline const uint32x8_t operator<<(const int num) const { return _mm256_slli_epi32(val, num); }
+	inline const uint32x8_t operator>>(const int num) const { return _mm256_srli_epi32(val, num); }
+	static inline uint32x8_t load(const uint32_t *p) { return _mm256_loadu_si256((const __m256i*)p); }
+	inline void store(uint32_t *p) const { _mm256_storeu_si256((__m256i*)p, val); }
+ protected:
+	__m256i val;
+};
+#define SCRYPT_LANES 8
+typedef uint32x8_t scrypt_lanes_t;
+#else
+#define SCRYPT_LANES 4
+typedef uint32x4_t scrypt_lanes_t;
+#endif
+
 
 //
 // Code taken from sha2.cpp and vectorized, with minimal changes where required
@@ -700,7 +754,8 @@ static inline void PBKDF2_SHA256_128_32(uint32_t *tstate, uint32_t *ostate,
 
 static int lastFactor = 0;
 
-static void computeGold(uint32_t* const input, uint32_t *reference, uchar *scratchpad);
+static bool scrypt_cpu_batch(const uint32_t *data, const uint32_t *midstate,
+	const uint32_t *nonces, int count, uint32_t *X, uint32_t *hashes);
 
 static bool init[MAX_GPUS] = { 0 };
 
@@ -756,7 +811,6 @@ int scanhash_scrypt(int thr_id, struct work *work, uint32_t max_nonce, unsigned
 	// no default set with --cputest
 	if (opt_nfactor == 0) opt_nfactor = 9;
 	uint32_t N = (1UL<<(opt_nfactor+1));
-	uint32_t *scratch = new uint32_t[N*32]; // scratchbuffer for CPU based validation
 
 	uint32_t nonce[2];
 	uint32_t* hash[2]   = { cuda_hashbuffer(thr_id,0), cuda_hashbuffer(thr_id,1) };
@@ -928,37 +982,50 @@ int scanhash_scrypt(int thr_id, struct work *work, uint32_t max_nonce, unsigned
 
 		if (iteration > 0 || opt_n_threads == 0)
 		{
+			// CPU based validation to rule out GPU errors, SCRYPT_LANES candidates at once
+			uint32_t _ALIGN(64) ref[32 * SCRYPT_LANES], refhash[8 * SCRYPT_LANES];
+			uint32_t cand[SCRYPT_LANES], nonces[SCRYPT_LANES];
+			int count = 0;
+
 			for (int i = 0; i < throughput; i++)
 			{
-				if (hash[cur][i * 8 + 7] <= Htarg && fulltest(hash[cur] + i * 8, ptarget))
-				{
-					// CPU based validation to rule out GPU errors (scalar CPU code)
-					uint32_t _ALIGN(64) inp[32], ref[32], tstate[8], ostate[8], refhash[8], ldata[20];
-
-					memcpy(ldata, pdata, 80); ldata[19] = nonce[cur] + i;
-					memcpy(tstate, midstate, 32);
-					HMAC_SHA256_80_init(ldata, tstate, ostate);
-					PBKDF2_SHA256_80_128(tstate, ostate, ldata, inp);
-					computeGold(inp, ref, (uchar*)scratch);
-					bool good = true;
-
-					if (sha_on_cpu) {
-						if (memcmp(&X[cur][i * 32], ref, 32*sizeof(uint32_t)) != 0) good = false;
-					} else {
-						PBKDF2_SHA256_128_32(tstate, ostate, ref, refhash);
-						if (memcmp(&hash[cur][i * 8], refhash, 32) != 0) good = false;
-					}
+				if (hash[cur][i * 8 + 7] <= Htarg && fulltest(hash[cur] + i * 8, ptarget)) {
+					cand[count] = i;
+					nonces[count++] = nonce[cur] + i;
+				}
+				if (count < SCRYPT_LANES && (count == 0 || i < throughput - 1))
+					continue;
+
+				uint64_t vstart = vstats_clock();
+				if (!scrypt_cpu_batch(pdata, midstate, nonces, count, ref, refhash)) {
+					gpulog(LOG_ERR, thr_id, "unable to allocate the CPU scrypt scratchpad");
+					result = -1;
+					goto byebye;
+				}
+				// one vstats sample per candidate, the batch time shared
+				uint64_t vshare = (vstats_clock() - vstart) / count;
+				for (int c = 0; c < count; c++)
+					vstats_verified(thr_id, vstats_clock() - vshare);
+				for (int c = 0; c < count; c++) {
+					int k = cand[c];
+					bool good;
+					if (sha_on_cpu)
+						good = !memcmp(&X[cur][k * 32], &ref[c * 32], 32*sizeof(uint32_t));
+					else
+						good = !memcmp(&hash[cur][k * 8], &refhash[c * 8], 32);
 
 					if (!good) {
-						gpulog(LOG_WARNING, thr_id, "result does not validate on CPU! (i=%d, s=%d)", i, cur);
+						gpu_increment_reject(thr_id);
+						gpulog(LOG_WARNING, thr_id, "result does not validate on CPU! (i=%d, s=%d)", k, cur);
 					} else {
 						*hashes_done = n - pdata[19];
-						work_set_target_ratio(work, refhash);
-						pdata[19] = nonce[cur] + i;
+						work_set_target_ratio(work, &refhash[c * 8]);
+						pdata[19] = nonces[c];
 						result = 1;
 						goto byebye;
 					}
 				}
+				count = 0;
 			}
 		}
 
@@ -975,19 +1042,20 @@ byebye:
 	delete[] datax4[0]; delete[] datax4[1]; delete[] hashx4[0]; delete[] hashx4[1];
 	delete[] tstatex4[0]; delete[] tstatex4[1]; delete[] ostatex4[0]; delete[] ostatex4[1];
 	delete[] Xx4[0]; delete[] Xx4[1];
-	delete [] scratch;
 	gettimeofday(tv_end, NULL);
 	return result;
 }
 
 #define ROTL(a, b) (((a) << (b)) | ((a) >> (32 - (b))))
 
-static void xor_salsa8(uint32_t * const B, const uint32_t * const C)
+// T is uint32_t, or a vector of words of independent hashes (one lane per nonce)
+template <class T>
+static inline void xor_salsa8(T * const B, const T * const C)
 {
-	uint32_t x0 = (B[ 0] ^= C[ 0]), x1 = (B[ 1] ^= C[ 1]), x2 = (B[ 2] ^= C[ 2]), x3 = (B[ 3] ^= C[ 3]);
-	uint32_t x4 = (B[ 4] ^= C[ 4]), x5 = (B[ 5] ^= C[ 5]), x6 = (B[ 6] ^= C[ 6]), x7 = (B[ 7] ^= C[ 7]);
-	uint32_t x8 = (B[ 8] ^= C[ 8]), x9 = (B[ 9] ^= C[ 9]), xa = (B[10] ^= C[10]), xb = (B[11] ^= C[11]);
-	uint32_t xc = (B[12] ^= C[12]), xd = (B[13] ^= C[13]), xe = (B[14] ^= C[14]), xf = (B[15] ^= C[15]);
+	T x0 = (B[ 0] ^= C[ 0]), x1 = (B[ 1] ^= C[ 1]), x2 = (B[ 2] ^= C[ 2]), x3 = (B[ 3] ^= C[ 3]);
+	T x4 = (B[ 4] ^= C[ 4]), x5 = (B[ 5] ^= C[ 5]), x6 = (B[ 6] ^= C[ 6]), x7 = (B[ 7] ^= C[ 7]);
+	T x8 = (B[ 8] ^= C[ 8]), x9 = (B[ 9] ^= C[ 9]), xa = (B[10] ^= C[10]), xb = (B[11] ^= C[11]);
+	T xc = (B[12] ^= C[12]), xd = (B[13] ^= C[13]), xe = (B[14] ^= C[14]), xf = (B[15] ^= C[15]);
 
 	/* Operate on columns. */
 	x4 ^= ROTL(x0 + xc,  7);  x9 ^= ROTL(x5 + x1,  7); xe ^= ROTL(xa + x6,  7);  x3 ^= ROTL(xf + xb,  7);
@@ -1062,54 +1130,167 @@ static void scrypt_core(uint32_t *X, uint32_t *V, uint32_t N)
 	}
 }
 
+/**
+ * SCRYPT_LANES hashes at once, X[k] holds the word k of each lane
+ * @param X input/ouput
+ * @param V scratch buffer, N*32 words per lane, not interleaved
+ * @param N factor (def. 1024)
+ */
+static void scrypt_core_lanes(scrypt_lanes_t *X, uint32_t *V, uint32_t N)
+{
+	uint32_t _ALIGN(64) t[32 * SCRYPT_LANES];
+	uint32_t j[SCRYPT_LANES];
+
+	for (uint32_t i = 0; i < N; i++) {
+		for (int k = 0; k < 32; k++)
+			X[k].store(&t[k * SCRYPT_LANES]);
+		for (int l = 0; l < SCRYPT_LANES; l++) {
+			uint32_t *v = &V[(l * N + i) * 32];
+			for (int k = 0; k < 32; k++)
+				v[k] = t[k * SCRYPT_LANES + l];
+		}
+		xor_salsa8(&X[0], &X[16]);
+		xor_salsa8(&X[16], &X[0]);
+	}
+	for (uint32_t i = 0; i < N; i++) {
+		// each lane reads its own row, gather them
+		X[16].store(t);
+		for (int l = 0; l < SCRYPT_LANES; l++)
+			j[l] = (l * N + (t[l] & (N - 1))) * 32;
+		for (int l = 0; l < SCRYPT_LANES; l++) {
+			const uint32_t *v = &V[j[l]];
+			for (int k = 0; k < 32; k++)
+				t[k * SCRYPT_LANES + l] = v[k];
+		}
+		for (int k = 0; k < 32; k++)
+			X[k] ^= scrypt_lanes_t::load(&t[k * SCRYPT_LANES]);
+		xor_salsa8(&X[0], &X[16]);
+		xor_salsa8(&X[16], &X[0]);
+	}
+}
+
 /**
  * Compute reference data set on the CPU
- * @param input      input data as provided to device
+ * @param input      input data as provided to device, 32 words per hash
  * @param reference  reference data, computed but preallocated
- * @param scratchpad scrypt scratchpad
+ * @param scratchpad scrypt scratchpad, scrypt_scratch_size() bytes
+ * @param count      number of hashes, done SCRYPT_LANES at once
  **/
-static void computeGold(uint32_t* const input, uint32_t *reference, uchar *scratchpad)
+static void computeGold(uint32_t* const input, uint32_t *reference, uchar *scratchpad, int count)
 {
-	uint32_t X[32] = { 0 };
+	uint32_t _ALIGN(64) X[32 * SCRYPT_LANES];
 	uint32_t *V = (uint32_t*) scratchpad;
 	uint32_t N = (1<<(opt_nfactor+1)); // default 9 = 1024
 
-	for (int k = 0; k < 32; k++)
-		X[k] = input[k];
+	for (int n = 0; n < count; n += SCRYPT_LANES) {
+		int lanes = min(SCRYPT_LANES, count - n);
+		if (lanes == 1) {
+			memcpy(X, &input[n * 32], 128);
+			scrypt_core(X, V, N);
+			memcpy(&reference[n * 32], X, 128);
+			continue;
+		}
+		// unused lanes repeat the first one
+		scrypt_lanes_t Xl[32];
+		for (int k = 0; k < 32; k++) {
+			for (int l = 0; l < SCRYPT_LANES; l++)
+				X[k * SCRYPT_LANES + l] = input[(n + (l < lanes ? l : 0)) * 32 + k];
+			Xl[k] = scrypt_lanes_t::load(&X[k * SCRYPT_LANES]);
+		}
+		scrypt_core_lanes(Xl, V, N);
+		for (int k = 0; k < 32; k++) {
+			Xl[k].store(&X[k * SCRYPT_LANES]);
+			for (int l = 0; l < lanes; l++)
+				reference[(n + l) * 32 + k] = X[k * SCRYPT_LANES + l];
+		}
+	}
+}
+
+static size_t scrypt_scratch_size(uint32_t N)
+{
+	return (size_t) N * 128 * SCRYPT_LANES;
+}
+
+// per thread, the size only changes with the nfactor
+static __thread uchar *cpu_scratch = NULL;
+static __thread size_t cpu_scratch_size = 0;
 
-	scrypt_core(X, V, N);
+static uchar* scrypt_cpu_scratch(uint32_t N)
+{
+	size_t size = scrypt_scratch_size(N);
+	if (size != cpu_scratch_size) {
+		free(cpu_scratch);
+		cpu_scratch = (uchar*) malloc(size);
+		cpu_scratch_size = cpu_scratch ? size : 0;
+	}
+	return cpu_scratch;
+}
+
+/**
+ * Full scrypt of up to SCRYPT_LANES nonces of the same header,
+ * with the 4-way sha256 and the multi-lane salsa core
+ * @param data     header, 20 words
+ * @param midstate sha256 midstate of the header first block
+ * @param X        optional, the core outputs (32 words per nonce)
+ * @param hashes   the hashes (8 words per nonce)
+ **/
+static bool scrypt_cpu_batch(const uint32_t *data, const uint32_t *midstate,
+	const uint32_t *nonces, int count, uint32_t *X, uint32_t *hashes)
+{
+	uint32_t _ALIGN(64) Xb[32 * SCRYPT_LANES];
+	uint32x4_t datax4[20], Xx4[32], hashx4[8];
+	uint32x4_t tstatex4[SCRYPT_LANES/4][8], ostatex4[SCRYPT_LANES/4][8];
+	uint32_t N = (1<<(opt_nfactor+1));
+	uchar *scratch = scrypt_cpu_scratch(N);
+
+	if (!scratch)
+		return false;
+	if (!X) X = Xb;
+
+	for (int j = 0; j < 19; j++)
+		datax4[j] = uint32x4_t(data[j]);
+
+	for (int g = 0; g*4 < count; g++) {
+		int n = g*4, last = count - 1;
+		datax4[19] = uint32x4_t(nonces[n], nonces[min(n+1, last)],
+			nonces[min(n+2, last)], nonces[min(n+3, last)]);
+		for (int l = 0; l < 8; l++)
+			tstatex4[g][l] = uint32x4_t(midstate[l]);
+		HMAC_SHA256_80_initx4(datax4, tstatex4[g], ostatex4[g]);
+		PBKDF2_SHA256_80_128x4(tstatex4[g], ostatex4[g], datax4, Xx4);
+		for (int l = 0; l < 4 && n + l < count; l++)
+			for (int k = 0; k < 32; k++)
+				X[(n + l) * 32 + k] = Xx4[k][l];
+	}
 
-	for (int k = 0; k < 32; k++)
-		reference[k] = X[k];
+	computeGold(X, X, scratch, count);
+
+	for (int g = 0; g*4 < count; g++) {
+		int n = g*4, last = count - 1;
+		for (int k = 0; k < 32; k++)
+			Xx4[k] = uint32x4_t(X[n*32 + k], X[min(n+1, last)*32 + k],
+				X[min(n+2, last)*32 + k], X[min(n+3, last)*32 + k]);
+		PBKDF2_SHA256_128_32x4(tstatex4[g], ostatex4[g], Xx4, hashx4);
+		for (int l = 0; l < 4 && n + l < count; l++)
+			for (int k = 0; k < 8; k++)
+				hashes[(n + l) * 8 + k] = hashx4[k][l];
+	}
+	return true;
 }
 
-/* cputest */
+/* cputest, one lane of the batched core used to validate the gpu nonces */
 void scrypthash(void* output, const void* input)
 {
-	uint32_t _ALIGN(64) X[32], ref[32] = { 0 }, tstate[8], ostate[8], midstate[8];
-	uint32_t _ALIGN(64) data[20];
-	uchar *scratchbuf;
+	uint32_t _ALIGN(64) data[20], midstate[8];
 
 	// no default set with --cputest
 	if (opt_nfactor == 0) opt_nfactor = 9;
 
-	scratchbuf = (uchar*) calloc(4 * 128 + 63, 1UL << (opt_nfactor+1));
-
 	memcpy(data, input, 80);
 
 	sha256_init(midstate);
 	sha256_transform(midstate, data, 0); /* ok */
 
-	memcpy(tstate, midstate, 32);
-	HMAC_SHA256_80_init(data, tstate, ostate);
-	PBKDF2_SHA256_80_128(tstate, ostate, data, X); /* ok */
-
-	if (scratchbuf) {
-		computeGold(X, ref, scratchbuf);
-		PBKDF2_SHA256_128_32(tstate, ostate, ref, (uint32_t*) output);
-	} else {
+	if (!scrypt_cpu_batch(data, midstate, &data[19], 1, NULL, (uint32_t*) output))
 		memset(output, 0, 32);
-	}
-
-	free(scratchbuf);
 }
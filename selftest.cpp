@@ -0,0 +1,404 @@
+/**
+ * Known answer tests of the cpu hash functions (--selftest)
+ *
+ * The expected hashes are those of the headers made by cpu_hash_input(),
+ * several seeds are used for the algos with an header based order (x16r,
+ * timetravel...). The vectors are checked in parallel, by all the cores.
+ *
+ * They were recorded with hashes which only depend on their input (the
+ * timetravel family takes its order from the hashed ntime), one vector
+ * per process, and give the same results in any order.
+ *
+ * The u256.h helpers are also checked against the plain (old) code with
+ * random values, the --cpu-validate queue with a synthetic producer, the
+ * nonce leases of concurrent threads and the gbt coinbase of a canned
+ * template.
+ *
+ * Not covered: equihash (a solver, its solutions are not a header hash),
+ * heavy (only built WITH_HEAVY_ALGO) and mjollnir (no cpu hash).
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+
+#include "miner.h"
+#include "algos.h"
+#include "u256.h"
+
+extern int opt_nfactor;
+
+bool opt_selftest = false;
+
+struct selftest_vector {
+	const char *algo;
+	uint32_t seed;
+	const char *hash;
+};
+
+static const struct selftest_vector selftest_vectors[] = {
+	{ "allium",      0, "89904979acffe4b3817f94a62fcec41aa5ee9b374b09dcf7dbe544dc1c279212" },
+	{ "allium",      1, "d194ae5aeaa6e5b4c40e0c5e21ee36ecb0bedc2d93b3bb3509a46955a81da818" },
+	{ "bastion",     0, "993fff65d8a317934f50a5d950c071ca54f8daf4b89c19f6d0ab6954a3f8b67f" },
+	{ "bastion",     1, "55d27c5d51cb7c29fcf0e2ebbefcddfd2345ba3ac6206b12cbd692b155612ff7" },
+	{ "bitcore",     0, "800f4ae316ad3b2eaf961fa38129971f3ccaf0a127cd22b673990f7ce3364640" },
+	{ "bitcore",     1, "07ff357aa63d61388acedfca1456c0accdfac3d0567af33316726a56145f5895" },
+	{ "bitcore",     2, "ee371607353d722f95aa8c4b54ad70ddfff8e6da2caaed9cef70916021e747f0" },
+	{ "bitcore",     3, "0ed3e1df197426620b11423a3ce40bf53a0d04745bf37c5f83d1d68b0eec6d1f" },
+	{ "blake",       0, "ee4973231b05773d3013ad5740210fd0dc6a75e04a4b293330d2a871ccd14a1d" },
+	{ "blake",       1, "925070977e84ccea650f31b21469849a21390d17caf5838daf1983f8eaec3e23" },
+	{ "blakecoin",   0, "2901d1af70bcd67e72e7a32e8835a4690713fdd222db25efd8dad20c7252aae4" },
+	{ "blakecoin",   1, "2aa86b8727fb21321d2e567335c81df88e07dba6c2e269beedcc143c096b43f7" },
+	{ "blake2b",     0, "37e1f7706c046aea5df7d74b25cd2bc2a62a03e1c301f24d453ecb5900d600e3" },
+	{ "blake2b",     1, "1d28b285f9cb73d2ab66eaeafe9fcd6f76f367a550dca26734227bf835d86678" },
+	{ "blake2s",     0, "42c6772d07ff8dca94db45350bc8748f3ed2353240841c9cee064324e7c36ec5" },
+	{ "blake2s",     1, "b568df2e516a891a2b17193accf6ff9e2ffb1dafb855b7edc2812eea04238dca" },
+	{ "bmw",         0, "5e5cb39d5733ba7b7ece8bd6950ba8153332cb6b191e89d177833de93c269c05" },
+	{ "bmw",         1, "3305a4ab62d9936eab0a8476f34df5822aa844948ee18dccc1fd011f75014813" },
+	{ "c11",         0, "3ad66878b56183463415242cca84edc210cd920102ecac6e5037c0b62ea6ae4e" },
+	{ "c11",         1, "8d14893029bd2da0755844c356c26d10f60e557fc83adf92d006fcefdb23e5f4" },
+	{ "cryptolight", 0, "28d6002a6e4957e12e79856db6084a0c926f2fc43e54d934c2b3ff9f4aee60ed" },
+	{ "cryptonight", 0, "2ed1d5a2fdbb0492620af8a0f1b2206f5d96b29986f4ceef55f5fe9068890000" },
+	{ "monero",      0, "3667b62b2a4eccb6c9649b44fa583829a206885008127eef54f0390b6b8e8d5b" },
+	{ "graft",       0, "3667b62b2a4eccb6c9649b44fa583829a206885008127eef54f0390b6b8e8d5b" },
+	{ "stellite",    0, "ce91da5c82f8f73ec5cb13bfd65b3db2c4822ef7f31f1a558cbae52ec880c2c7" },
+	{ "decred",      0, "b274a5874f410290051b4227f465af255941ba6f181178f0aa29606f82334f0c" },
+	{ "decred",      1, "69a6716ae5e57fc095a51fea092feae1b854df61768605e72974269191051550" },
+	{ "deep",        0, "c4e5db28fb1037ab0cad71be5642f2a3451ca8f0e99e9a1784fe5946dba031c3" },
+	{ "deep",        1, "d3463b4e17493cf6563d0bf79b702924dbf274064f2b86a73c04e2573980eab1" },
+	{ "dmd-gr",      0, "427d828652c2db8e8e69036dd7991ee28b5fde22e816d6abbcfe56f0e6deefff" },
+	{ "dmd-gr",      1, "a6b409c99c6da9e07d13e3934e2849e697ca7fa8ce2c7b94c92087b917d98c9d" },
+	{ "exosis",      0, "b5c2cc9c4c16ca7da1ce9d6ead919e0cc552dc4cc445b2d6df00db6cca398b11" },
+	{ "exosis",      1, "0c30fe18fe39c6f2d36a22e9a10ba11ab0e6414247b451b7e4a39ae4a93974b8" },
+	{ "exosis",      2, "f0ac38d203c84b2a60c374d9c1f41a4b47abd44bf9d4200483150bacb101e54a" },
+	{ "exosis",      3, "8e546e39edc1116d3769cda116f6391430d7f5bada3fdf17d276ad30c2a0fb4d" },
+	{ "fresh",       0, "89a20f649e1edd60b76e7d9c4937f533d2b1921c668361417ba8c4e6c42f8195" },
+	{ "fresh",       1, "0ce0c3e5c86c98646e0115a041df68bf2b6efcce8260a8dddb08fd744568a8fb" },
+	{ "fugue256",    0, "6d4186e0ca27c2d045743173b967f0263f21ada1a60797cd29feb87f6901c158" },
+	{ "fugue256",    1, "d56d27c82dd548db341a4e808bb0656ea0af8fcd9e36f96d63502dbec00977fe" },
+	{ "groestl",     0, "427d828652c2db8e8e69036dd7991ee28b5fde22e816d6abbcfe56f0e6deefff" },
+	{ "groestl",     1, "a6b409c99c6da9e07d13e3934e2849e697ca7fa8ce2c7b94c92087b917d98c9d" },
+	{ "hmq1725",     0, "be07398401780ed7bd8338296694037060583126a132c0beccbd823e9ea4afa5" },
+	{ "hmq1725",     1, "1f3ce1da48afc0b47c5ca85ea18090b736d379118cc904080c2fecf9127b1cd4" },
+	{ "hsr",         0, "7ca343c256ff625b6a628d340e65d26ab4af947e9aba10864f3ed8d29eb48f24" },
+	{ "hsr",         1, "f5734a01a9bf83ebba7e9f3fe37fba36925c29ba1635b697777a5a82048ffcf8" },
+	{ "jackpot",     0, "4c2826b068277d0eba52cf81e4a39fac3dc04812e70f2dde9059554d996f474a" },
+	{ "jackpot",     1, "0488106f87e4746561f5ce418073076990156d0ba12d9d89bfb4f3aa5a39b19e" },
+	{ "jha",         0, "4c2826b068277d0eba52cf81e4a39fac3dc04812e70f2dde9059554d996f474a" },
+	{ "jha",         1, "0488106f87e4746561f5ce418073076990156d0ba12d9d89bfb4f3aa5a39b19e" },
+	{ "keccak",      0, "e4e8a13a4125289c68227fa0e0be2662d3ad5f6a2c2f27d08d3b9a305a3c829a" },
+	{ "keccak",      1, "ce3720df552515bae38ad9696f81c5cf419ec73baa9e225e976245bee842caac" },
+	{ "keccakc",     0, "e4e8a13a4125289c68227fa0e0be2662d3ad5f6a2c2f27d08d3b9a305a3c829a" },
+	{ "keccakc",     1, "ce3720df552515bae38ad9696f81c5cf419ec73baa9e225e976245bee842caac" },
+	{ "lbry",        0, "d7cabf973b81b2dbb24dab8f4a58fddc3d786c571c4024b52ab49d666a634ca8" },
+	{ "lbry",        1, "63adf201572c3524c343aa88c7b221802c047cfccf5005e9ca44f0d6aeb95239" },
+	{ "luffa",       0, "ab8f755c56562c06d87308408bc86ed4b6853237065ac1cddad96a50487fbf9d" },
+	{ "luffa",       1, "48a1039b079b586994e89f45e2d7b8fdfde66005859b2823a3d859f451060763" },
+	{ "lyra2",       0, "42be213df0f1fa7bec989a3bd5e023177442b4d695a1c6fa92ecd722788d12d0" },
+	{ "lyra2",       1, "0769ec596fe7a4979ac62ec929387d0e2eea90949a6ff7aea65ebcb8dd4aa922" },
+	{ "lyra2v2",     0, "e61ad6fe25ea79f0a9b72ebbf92fbc706e7c33f74abbf78d1e42592dc4ab1aad" },
+	{ "lyra2v2",     1, "5ff9bb05734ff34891503cc1ca8a06fb881c043953d6afcd6b782e821c0a47ac" },
+	{ "lyra2v3",     0, "4b43eec0313d8913c3473d2edc953887487b572fcaea286a70896505288e1db4" },
+	{ "lyra2v3",     1, "7426d37f0199c7158a5e1a642d2f6247b95e7927df5e00d173a2e4bb49f63506" },
+	{ "lyra2z",      0, "83570f9ba10c6bbd3d7d8ce3c6293e89725e2a198335c7f728ffec60f41d7380" },
+	{ "lyra2z",      1, "bfb8e4eb9d6bfa504ad7f82865b767909e69c53eadd094525199c4a5fa3d2ac5" },
+	{ "myr-gr",      0, "e8a225fe587508eeefa28f96b83bfe0a3fd7804c363f3529598f3b159fd0efca" },
+	{ "myr-gr",      1, "0072752e5edab25ccbdc123464cc33d64fdf7c7d711319c610e28f6029449db4" },
+	{ "neoscrypt",   0, "849c8c904f486d1ca84069a80f63be65a046bd69a4fe513d172612490445b0cd" },
+	{ "neoscrypt",   1, "75555d7169c16ab0ac232f7e58cc2c59d6c2da9b04008ed1840bad76b7216cbd" },
+	{ "nist5",       0, "aec828b3a24ba2b74e1ad43a9c8e2a2bf97621ad7d14ae056ff4180e3a536afe" },
+	{ "nist5",       1, "c9108b52ce71c8759b9b5a1536a59601e9a3517ac936a663c3d3175e5301ddc5" },
+	{ "penta",       0, "e5adc83f559f8b1f9d226bf9586a3aa4c8a075dc829792bea5133e81a923186a" },
+	{ "penta",       1, "d30d2800501eb0117a784539b18744a4807f6cbd9f942ed205663fb16dfc5889" },
+	{ "phi",         0, "78bf7060423b75051cb93fc535671f759770e64cce57f0e1ff85fe1faf797d69" },
+	{ "phi",         1, "a9f7150c465b73586576317d5a617aa07b14ce19a161e34cfc033591f1200786" },
+	{ "phi2",        0, "df07ac6fdaa6d0d16e9a8c16173969b5c35083b1a11b3a0cd866dee145437292" },
+	{ "phi2",        1, "2f22484610bdc764fe0f033a009dff15c4512aec46206bd4acf3af118008dbbf" },
+	{ "polytimos",   0, "995578666e766de52c90377408b4988cf7f447a4d46559e82fb449f0fb10f9fe" },
+	{ "polytimos",   1, "44e8e9f1dc8535da2911a16e30c979f7f1329350dc57eaaa61ac33da3d6ac5a0" },
+	{ "quark",       0, "b4ad55bcd7e74b1a1be4b938dbec0ba08c9c8b9abaf160debf0bccf5442c96bc" },
+	{ "quark",       1, "f91de7d26cd64b8ba47ed852d64491857f0cbb9728d966dbf56500ac1993ec9c" },
+	{ "qubit",       0, "3aabe14707d279af672f2aada918543d2b1222152cc83eb0a44f28120f0cf134" },
+	{ "qubit",       1, "50d9428a577f5ae4758bab1ec15fa7b562f00d8815a14375eaa3d1c83591021a" },
+	{ "scrypt",      0, "ad4c7a6a1a82b588226aaaef6d7c9f27ce79bcee308dd991191224bc2c7d535e" },
+	{ "scrypt",      1, "64fdc185a7ffbf9358a9fba0554dc109d4b389bf908c38d01b475350e462ae70" },
+	{ "scrypt-jane", 0, "0d83ff2e941b732d95c74f2c693c5e1453e852910c88176b5f60d0c2f8ccba3c" },
+	{ "sha256d",     0, "188243992536bd2bc3105436632c8d2566450a51aff2152143530badfd4e2a29" },
+	{ "sha256d",     1, "277ea550c835a47fc4022bd518f1d3faee354689d49d841033660e2738abeba8" },
+	{ "sha256t",     0, "552838aee9683a031dfc96951c6dfe4530c10b63fa00e7ba697e54b82370dcd0" },
+	{ "sha256t",     1, "4a5e8e2f86cfc833f6bef27365b865d95caa20347ad4718d672743614f267047" },
+	{ "sha256q",     0, "f0858ffc6a5b75af65711a53345204c6f3b9c1f5f453396453dc654169938e5e" },
+	{ "sha256q",     1, "ef2b0c682b1ec70c49ff9a855920d8607cf3639f748be4d2338946fdf5c22481" },
+	{ "sia",         0, "37e1f7706c046aea5df7d74b25cd2bc2a62a03e1c301f24d453ecb5900d600e3" },
+	{ "sia",         1, "1d28b285f9cb73d2ab66eaeafe9fcd6f76f367a550dca26734227bf835d86678" },
+	{ "sib",         0, "48cb9ee501480d0188e090c0e4acc48fb12d9a4b75d9bf006aafa39f26e3b05f" },
+	{ "sib",         1, "53bb8f70743e9983c9ee0615345ffc18a54852e77e8ab9ece3a6f237cc60e7f9" },
+	{ "skein",       0, "e862865b2608af23b6f0ed7d1c6d46d194bd8b8a74cda7527116046957711a4e" },
+	{ "skein",       1, "95e7f23669d42ea77cb016b19bc21b6a51db2338aa0c86864c870e531d3cf1ad" },
+	{ "skein2",      0, "f7f7c3c804868c3eb0fc85285969849165c6f85604ee561d1ed80ba0e42f21b7" },
+	{ "skein2",      1, "98ae0789a4d1b4787565cdcf12dc0df5ab844738d951ac703cc504fa7da2147a" },
+	{ "skunk",       0, "3bbcdeb3e76967519f7722fcc963be7d3760052af6e934a0fea60adec7e72f28" },
+	{ "skunk",       1, "c6bd0ec0b2b34ee8bb3aa4fc537db93a4c905e26c133dd78b49ffcb8cfd4a268" },
+	{ "sonoa",       0, "fa1bd7a7435f2814e00baf34a372e80378957c5c16a0e51249203b07cb60d4c0" },
+	{ "sonoa",       1, "1c8a8531122c18deb661518f3e0ea96a9d513c673237441ab599f1b93446d4df" },
+	{ "s3",          0, "9ce741f6607a0ef8d13cecf105639be36a186d3638b836b6f925b0ad6312a34d" },
+	{ "s3",          1, "a7b42272fbf31b6f8bf5b80b49ebf5595f80eda5e4321616e12eb0a3e98d62b9" },
+	{ "timetravel",  0, "b6eace0167f4e9fd0acee92076f03b031ae75eb579ee6747fa29fec89dfab4d6" },
+	{ "timetravel",  1, "da84069a2372bdde0504cff97e6474021ba7e8746a78b0ea36f70f4add6ca138" },
+	{ "timetravel",  2, "c71cb2f22e5c5e149c565b59eed0bfbe05823ccaf9b0941ac055eadaa392d8bc" },
+	{ "timetravel",  3, "98aff7de15e0b1bab1eee18145ffbcc3c3d904d230d06a39e7ef630b1dfb5e10" },
+	{ "tribus",      0, "8b4df88b0d2a845dbd32359e9c45cdcda11f961ff75419d5e8f65a90e38de19c" },
+	{ "tribus",      1, "62fac00df1e851a4bb95cc57e740d8f4ee1fc52791468c8381c478cdaa619198" },
+	{ "vanilla",     0, "2901d1af70bcd67e72e7a32e8835a4690713fdd222db25efd8dad20c7252aae4" },
+	{ "vanilla",     1, "2aa86b8727fb21321d2e567335c81df88e07dba6c2e269beedcc143c096b43f7" },
+	{ "veltor",      0, "e87264c112d8ce99c6179453e72c9c3b26fcb47fb03f1dacf056a60edd1a4799" },
+	{ "veltor",      1, "7b3e09484c41ab179a06b7c16b60bbb01d6250ba32d9e2e51416aae4fe85d9a1" },
+	{ "whirlcoin",   0, "6e79a5e61a9567a7110a3514577488b0f71f483eabed0fe673cea571131134e8" },
+	{ "whirlcoin",   1, "267b41d733f8074bfbec704da557799615fe24b5875db5b518bfebbadb8a45e7" },
+	{ "whirlpool",   0, "6e79a5e61a9567a7110a3514577488b0f71f483eabed0fe673cea571131134e8" },
+	{ "whirlpool",   1, "267b41d733f8074bfbec704da557799615fe24b5875db5b518bfebbadb8a45e7" },
+	{ "whirlpoolx",  0, "e95fecaeb6c847341f1fcb4530344f076bf4306170aa5cf60327a161742faba3" },
+	{ "whirlpoolx",  1, "4af2ea2037dac72532364e944bb7cd4e54d2cfeecb7756164043578c89cbaf54" },
+	{ "wildkeccak",  0, "b1fb4f1be9eb33250336b383753603fb7a8b909741b881a09099bf5bc8ae1f86" },
+	{ "wildkeccak",  1, "370ac78d9718489967cf4b55946638519469d87addad5c6abb34c23cea6cb2f4" },
+	{ "x11evo",      0, "ef388cf6a618bfe219a5e7443422e8f9f7f959a483dd9566e767dc1fc5034efb" },
+	{ "x11evo",      1, "63f537cbfce430cad5439ac59d50e58bea5086b6b6ff49d67bab290a82d8b9ac" },
+	{ "x11evo",      2, "a1d41db01a01c38e22cee6dc31b63f9fd73f16910166a1cfa8af88d574b092a3" },
+	{ "x11evo",      3, "d914b9ba8354eaae855c94e9ad58496c7c4f563900089984f9b33842ae3077ae" },
+	{ "x11",         0, "ef388cf6a618bfe219a5e7443422e8f9f7f959a483dd9566e767dc1fc5034efb" },
+	{ "x11",         1, "d9e9513dd13790c362db909dfb3a0f8236088da407beb83bc2464500d3896a3b" },
+	{ "x12",         0, "ec9561ea8fe379919e05308d63189e42223324813d9b7461e3645fa8611054f1" },
+	{ "x12",         1, "124e619c753f3a96ce09f85144ae1fd72f499d2470463ddf3eaa5946790ff292" },
+	{ "x13",         0, "d6ecd83e937735b0c1b2321fe3526bd94da928e219353a14123f9d1b831ade01" },
+	{ "x13",         1, "5de3759d8c9800a252aacf6f634e340ed9e91ec62b5f923d842b46e836672701" },
+	{ "x14",         0, "20bc98176d7a1de9266bb46584acd40b257d0fa69290250ece397db257d1b37b" },
+	{ "x14",         1, "554e7979defe8e4ecb685a7a50b52d9b26699c16e55303b4b370182ac8b944a8" },
+	{ "x15",         0, "fd2bad7a4cc3c4736f0abfd914e27211bbf30474ec45351e7e63912872809c51" },
+	{ "x15",         1, "bf758c8c24e8d51874612afa4fa3237b5fa468f64bba0ac8cf046191ccbac140" },
+	{ "x16r",        0, "ec291f46491f48c27242596f94e2c88558862f85bba28a6e9166c212cb8f13b1" },
+	{ "x16r",        1, "4bdd7de560394f71cefe901387a1b0381258ce0e069a4a2fdf60888e55798b6f" },
+	{ "x16r",        2, "6d0e38abe555e8482e214e23bcc5ebcf30baf60f12d7017b52de433db0bdbc5b" },
+	{ "x16r",        3, "631f0f1920a51525287e9250fb7cf1bbf1a812bfb450222738c5e81aa70727ea" },
+	{ "x16s",        0, "13c6c932a88b11c9834c9f481cf705359b99f1efb6a437770372149c41a5533e" },
+	{ "x16s",        1, "6c4926fa25f76c1458a4e7c6a234b1b2e976eafec3d42f90889c7e211e13a2b3" },
+	{ "x16s",        2, "971c6dafbbd50be4504beb27121a4ebdb75d2f51b06bae9fa5f6ca4d689675f8" },
+	{ "x16s",        3, "c790153dbd46272ce76e1325f9398a0b35afda5aae10e0f1a3f700566c3832e8" },
+	{ "x17",         0, "48dc2a4fcfba4060113515ea69a6f74857b1d8568e42b19958d14a9015cca6b5" },
+	{ "x17",         1, "6010b940e6c6f1188a3d7137305dcbe8d7bfa07fd406fe6ff6dcbab1efcfcf13" },
+	{ "zr5",         0, "5ea911e4c3f478a2e4d9780d902544b58dc03f6bf0abe2088febd18d261cbbc1" },
+	{ "zr5",         1, "bb05e85ac0a9b045ad1874ab919800593b69e7552a27b11190b5df2456d124aa" },
+	{ NULL, 0, NULL }
+};
+
+struct selftest_job {
+	const struct cpu_hash_algo *algo;
+	const struct selftest_vector *vec;
+	char result[65];
+	bool ok;
+};
+
+struct selftest_ctx {
+	struct selftest_job *jobs;
+	int count;
+	std::atomic<int> next;
+};
+
+static void selftest_check(struct selftest_job *job)
+{
+	uint32_t _ALIGN(64) hash[16];
+	uint8_t _ALIGN(64) data[256];
+
+	memset(hash, 0, sizeof(hash));
+	memset(data, 0, sizeof(data));
+	cpu_hash_input(data, job->algo->datalen, job->vec->seed);
+	job->algo->hash(hash, data);
+	cbin2hex(job->result, (const char*) hash, 32);
+	job->ok = !strcmp(job->result, job->vec->hash);
+}
+
+static void *selftest_thread(void *userdata)
+{
+	struct selftest_ctx *ctx = (struct selftest_ctx*) userdata;
+	int n;
+	while ((n = ctx->next.fetch_add(1)) < ctx->count) {
+		struct selftest_job *job = &ctx->jobs[n];
+		if (!(job->algo->flags & CPUH_SERIAL))
+			selftest_check(job);
+	}
+	return NULL;
+}
+
+/* u256.h checks, the references are the word loops of the old code */
+static uint32_t u256_rand(uint64_t *x)
+{
+	*x ^= *x << 13; *x ^= *x >> 7; *x ^= *x << 17;
+	return (uint32_t) (*x >> 32);
+}
+
+static bool u256_ref_le32(const uint32_t *a, const uint32_t *b)
+{
+	for (int i = 7; i >= 0; i--) {
+		if (a[i] != b[i])
+			return a[i] < b[i];
+	}
+	return true;
+}
+
+/* CBigNum::SetCompact() */
+static void u256_ref_compact(uint8_t *le, uint32_t nbits)
+{
+	int size = (int) (nbits >> 24);
+	uint32_t m = nbits & 0x007fffff;
+	memset(le, 0, 32);
+	if (size <= 3) {
+		m >>= 8 * (3 - size);
+		for (int i = 0; i < 3; i++)
+			le[i] = (uint8_t) (m >> (8 * i));
+		return;
+	}
+	for (int i = 0; i < 3; i++) {
+		int n = size - 3 + i;
+		if (n < 32)
+			le[n] = (uint8_t) (m >> (8 * i));
+	}
+}
+
+/* uint256::getdouble() */
+static double u256_ref_getdouble(const uint32_t *w)
+{
+	double ret = 0.0, fact = 1.0;
+	for (int i = 0; i < 8; i++) {
+		ret += fact * w[i];
+		fact *= 4294967296.0;
+	}
+	return ret;
+}
+
+static int selftest_u256(void)
+{
+	uint64_t x = 0x9e3779b97f4a7c15ULL;
+	int errors = 0;
+
+	for (int n = 0; n < 100000; n++) {
+		uint32_t a[8], b[8];
+		struct u256 ua, ub;
+		for (int i = 0; i < 8; i++)
+			a[i] = b[i] = u256_rand(&x);
+		// differ from a random word, or equal
+		int k = (int) (u256_rand(&x) % 9);
+		for (int i = 0; i < k; i++)
+			b[i] = (u256_rand(&x) & 1) ? u256_rand(&x) : a[i] + 1 - 2 * (u256_rand(&x) & 1);
+		if (n & 1) a[k ? k - 1 : 0] ^= 0x80000000U; // sign bit, signed compares
+		u256_load(&ua, a);
+		u256_load(&ub, b);
+		bool ref = u256_ref_le32(a, b);
+		if (u256_le32(a, b) != ref || u256_le(ua, ub) != ref || u256_le32(b, a) != u256_ref_le32(b, a)) {
+			if (!errors++) applog(LOG_ERR, "selftest: u256 compare failed, loop %d", n);
+		}
+		if (u256_getdouble(ua) != u256_ref_getdouble(a)) {
+			if (!errors++) applog(LOG_ERR, "selftest: u256 getdouble failed, loop %d", n);
+		}
+
+		uint32_t nbits = ((u256_rand(&x) % 0x22) << 24) | (u256_rand(&x) & 0x007fffff);
+		uint8_t ref_le[32];
+		uint32_t w[8];
+		u256_ref_compact(ref_le, nbits);
+		u256_from_compact(&ua, nbits);
+		u256_store(w, &ua);
+		if (memcmp(w, ref_le, 32)) {
+			if (!errors++) applog(LOG_ERR, "selftest: u256 compact %08x failed", nbits);
+		}
+		if (nbits & 0xffffff) {
+			double d = (double) 0x0000ffff / (double) (nbits & 0xffffff) * ldexp(1.0, 8 * (29 - (int) (nbits >> 24)));
+			if (u256_nbits_to_diff(nbits) != d) {
+				if (!errors++) applog(LOG_ERR, "selftest: u256 diff of %08x failed", nbits);
+			}
+		}
+	}
+	return errors;
+}
+
+/* --selftest, return the process exit code */
+int selftest_run(int nthreads)
+{
+	struct selftest_ctx ctx;
+	int nvec = (int) ARRAY_SIZE(selftest_vectors) - 1;
+	int failed = 0, started = 0;
+
+	ctx.jobs = (struct selftest_job*) calloc(nvec, sizeof(struct selftest_job));
+	ctx.count = 0;
+	ctx.next = 0;
+	if (!ctx.jobs)
+		return EXIT_CODE_SW_INIT_ERROR;
+
+	if (selftest_u256() || validate_selftest() || nonce_lease_selftest() || gbt_selftest()) {
+		free(ctx.jobs);
+		return EXIT_CODE_SW_INIT_ERROR;
+	}
+
+	for (int i = 0; i < nvec; i++) {
+		const struct cpu_hash_algo *algo = cpu_hash_find(selftest_vectors[i].algo);
+		if (!algo || !cpu_hash_match(algo, opt_algo))
+			continue;
+		ctx.jobs[ctx.count].algo = algo;
+		ctx.jobs[ctx.count].vec = &selftest_vectors[i];
+		ctx.count++;
+	}
+	if (!ctx.count) {
+		applog(LOG_ERR, "selftest: no test vector for algo %s", algo_names[opt_algo]);
+		free(ctx.jobs);
+		return EXIT_CODE_USAGE;
+	}
+
+	// the cryptonight and scrypt hashes change these globals
+	int prev_fork = cryptonight_fork;
+	int prev_nfactor = opt_nfactor;
+	struct timeval tv_start, tv_end, diff;
+	gettimeofday(&tv_start, NULL);
+
+	nthreads = max(1, min(nthreads, ctx.count));
+	pthread_t *thr = (pthread_t*) calloc(nthreads, sizeof(pthread_t));
+	for (int i = 0; thr && i < nthreads; i++) {
+		if (pthread_create(&thr[i], NULL, selftest_thread, &ctx))
+			break;
+		started++;
+	}
+	if (!started)
+		selftest_thread(&ctx);
+	for (int i = 0; i < started; i++)
+		pthread_join(thr[i], NULL);
+	free(thr);
+
+	// the hashes using a shared global (fork, nfactor) are checked alone
+	for (int i = 0; i < ctx.count; i++) {
+		struct selftest_job *job = &ctx.jobs[i];
+		if (job->algo->flags & CPUH_SERIAL) {
+			cpu_hash_prepare(job->algo);
+			selftest_check(job);
+		}
+	}
+
+	gettimeofday(&tv_end, NULL);
+	timeval_subtract(&diff, &tv_end, &tv_start);
+	cryptonight_fork = prev_fork;
+	opt_nfactor = prev_nfactor;
+
+	for (int i = 0; i < ctx.count; i++) {
+		struct selftest_job *job = &ctx.jobs[i];
+		if (job->ok) {
+			if (opt_debug)
+				applog(LOG_DEBUG, "selftest: %s #%u %s", job->algo->name, job->vec->seed, job->result);
+			continue;
+		}
+		applog(LOG_ERR, "selftest: %s #%u failed, got %s", job->algo->name, job->vec->seed, job->result);
+		applog(LOG_ERR, "selftest: %s #%u expected %s", job->algo->name, job->vec->seed, job->vec->hash);
+		failed++;
+	}
+	applog(failed ? LOG_ERR : LOG_INFO, "selftest: %d/%d vectors passed in %u ms (%d threads)",
+		ctx.count - failed, ctx.count, (uint32_t) (diff.tv_sec * 1000 + diff.tv_usec / 1000),
+		max(started, 1));
+
+	free(ctx.jobs);
+	return failed ? EXIT_CODE_SW_INIT_ERROR : EXIT_CODE_OK;
+}
@@ -80,13 +80,13 @@ extern "C" int scanhash_sha256q(int thr_id, struct work* work, uint32_t max_nonc
 			uint32_t _ALIGN(64) vhash[8];
 
 			endiandata[19] = swab32(work->nonces[0]);
-			sha256q_hash(vhash, endiandata);
+			vstats_hash(thr_id, sha256q_hash(vhash, endiandata));
 			if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
 				work_set_target_ratio(work, vhash);
 				if (work->nonces[1] != UINT32_MAX) {
 					endiandata[19] = swab32(work->nonces[1]);
-					sha256q_hash(vhash, endiandata);
+					vstats_hash(thr_id, sha256q_hash(vhash, endiandata));
 					if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 						work->valid_nonces++;
 						bn_set_target_ratio(work, vhash, 1);
@@ -10,7 +10,7 @@
 #include <string.h>
 #include <stdint.h>
 
-#include <sph/blake2b.h>
+#include <sph/blake2-simd.h>
 
 #include <cuda_helper.h>
 #include <cuda_vector_uint2x4.h>
@@ -42,14 +42,7 @@ static __constant__ const int8_t blake2b_sigma[12][16] = {
 
 extern "C" void sia_blake2b_hash(void *output, const void *input)
 {
-	uint8_t _ALIGN(A) hash[32];
-	blake2b_ctx ctx;
-
-	blake2b_init(&ctx, 32, NULL, 0);
-	blake2b_update(&ctx, input, 80);
-	blake2b_final(&ctx, hash);
-
-	memcpy(output, hash, 32);
+	blake2b_simd(output, 32, input, 80);
 }
 
 // ----------------------------------------------------------------
@@ -190,6 +183,7 @@ int scanhash_sia(int thr_id, struct work *work, uint32_t max_nonce, unsigned lon
 	uint32_t _ALIGN(A) hash[8];
 	uint32_t _ALIGN(A) vhashcpu[8];
 	uint32_t _ALIGN(A) inputdata[20];
+	blake2b_midstate mid;
 	uint32_t *pdata = work->data;
 	uint32_t *ptarget = work->target;
 
@@ -225,6 +219,8 @@ int scanhash_sia(int thr_id, struct work *work, uint32_t max_nonce, unsigned lon
 	const uint2 target = make_uint2(ptarget[6], ptarget[7]);
 
 	sia_blake2b_setBlock(inputdata);
+	// the cpu checks only hash the nonce block
+	blake2b_mid_init(&mid, inputdata, 80, 32, 32);
 
 	do {
 		work->nonces[0] = sia_blake2b_hash_cuda(thr_id, throughput, pdata[8], target, work->nonces[1]);
@@ -234,8 +230,7 @@ int scanhash_sia(int thr_id, struct work *work, uint32_t max_nonce, unsigned lon
 		if (work->nonces[0] != UINT32_MAX)
 		{
 			work->valid_nonces = 0;
-			inputdata[8] = work->nonces[0];
-			sia_blake2b_hash(hash, inputdata);
+			vstats_hash(thr_id, blake2b_mid_hash(&mid, hash, work->nonces[0]));
 			if (swab32(hash[0]) <= Htarg) {
 				// sia hash target is reversed (start of hash)
 				swab256(vhashcpu, hash);
@@ -249,8 +244,7 @@ int scanhash_sia(int thr_id, struct work *work, uint32_t max_nonce, unsigned lon
 			}
 
 			if (work->nonces[1] != UINT32_MAX) {
-				inputdata[8] = work->nonces[1];
-				sia_blake2b_hash(hash, inputdata);
+				vstats_hash(thr_id, blake2b_mid_hash(&mid, hash, work->nonces[1]));
 				if (swab32(hash[0]) <= Htarg) {
 					swab256(vhashcpu, hash);
 					if (fulltest(vhashcpu, ptarget)) {
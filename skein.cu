@@ -418,7 +418,7 @@ extern "C" int scanhash_skeincoin(int thr_id, struct work* work, uint32_t max_no
 			uint32_t _ALIGN(64) vhash[8];
 
 			endiandata[19] = swab32(work->nonces[0]);
-			skeincoinhash(vhash, endiandata);
+			vstats_hash(thr_id, skeincoinhash(vhash, endiandata));
 			if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
 				work_set_target_ratio(work, vhash);
@@ -426,7 +426,7 @@ extern "C" int scanhash_skeincoin(int thr_id, struct work* work, uint32_t max_no
 					work->nonces[1] = cuda_check_hash_suppl(thr_id, throughput, pdata[19], d_hash[thr_id], work->valid_nonces);
 					if (work->nonces[1] != 0) {
 						endiandata[19] = swab32(work->nonces[1]);
-						skeincoinhash(vhash, endiandata);
+						vstats_hash(thr_id, skeincoinhash(vhash, endiandata));
 						if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 							work->valid_nonces++;
 							bn_set_target_ratio(work, vhash, 1);
@@ -91,7 +91,7 @@ int scanhash_skein2(int thr_id, struct work* work, uint32_t max_nonce, unsigned
 			uint32_t _ALIGN(64) vhash[8];
 
 			endiandata[19] = swab32(work->nonces[0]);
-			skein2hash(vhash, endiandata);
+			vstats_hash(thr_id, skein2hash(vhash, endiandata));
 
 			if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
@@ -99,7 +99,7 @@ int scanhash_skein2(int thr_id, struct work* work, uint32_t max_nonce, unsigned
 				work_set_target_ratio(work, vhash);
 				if (work->nonces[1] != 0) {
 					endiandata[19] = swab32(work->nonces[1]);
-					skein2hash(vhash, endiandata);
+					vstats_hash(thr_id, skein2hash(vhash, endiandata));
 					work->valid_nonces++;
 					bn_set_target_ratio(work, vhash, 1);
 					gpulog(LOG_DEBUG, thr_id, "found second nonce %08x!", endiandata[19]);
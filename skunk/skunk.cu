@@ -145,7 +145,7 @@ extern "C" int scanhash_skunk(int thr_id, struct work* work, uint32_t max_nonce,
 			const uint32_t startNounce = pdata[19];
 
 			be32enc(&endiandata[19], startNounce + h_resNonce[0]);
-			skunk_hash(vhash, endiandata);
+			vstats_hash(thr_id, skunk_hash(vhash, endiandata));
 			if (vhash[7] <= Htarg && fulltest(vhash, ptarget))
 			{
 				work->nonces[0] = startNounce + h_resNonce[0];
@@ -155,7 +155,7 @@ extern "C" int scanhash_skunk(int thr_id, struct work* work, uint32_t max_nonce,
 				{
 					uint32_t secNonce = work->nonces[1] = startNounce + h_resNonce[1];
 					be32enc(&endiandata[19], secNonce);
-					skunk_hash(vhash, endiandata);
+					vstats_hash(thr_id, skunk_hash(vhash, endiandata));
 					if (bn_hash_target_ratio(vhash, ptarget) > work->shareratio[0]) {
 						work_set_target_ratio(work, vhash);
 						xchg(work->nonces[1], work->nonces[0]);
@@ -0,0 +1,670 @@
+/**
+ * Blake2b and blake2s with the compression function selected at runtime
+ * (scalar, SSE4.1 or AVX2), shared by sia, blake2b, blake2s, neoscrypt and
+ * equihash.
+ *
+ * The single block functions keep one state row per vector. The midstate
+ * lane functions put one input per lane instead, only the nonce word then
+ * differs between the lanes.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "blake2-simd.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define BLAKE2_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define B2_TARGET(x) __attribute__((target(x)))
+#else
+#define B2_TARGET(x)
+#endif
+
+static const uint64_t blake2b_iv[8] = {
+	0x6A09E667F3BCC908ULL, 0xBB67AE8584CAA73BULL,
+	0x3C6EF372FE94F82BULL, 0xA54FF53A5F1D36F1ULL,
+	0x510E527FADE682D1ULL, 0x9B05688C2B3E6C1FULL,
+	0x1F83D9ABFB41BD6BULL, 0x5BE0CD19137E2179ULL
+};
+
+static const uint32_t blake2s_iv[8] = {
+	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+	0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+static const uint8_t blake2_sigma[12][16] = {
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+	{ 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+	{  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+	{  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+	{  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+	{ 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+	{ 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+	{  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+	{ 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 }
+};
+
+#define ROTR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static inline uint64_t le64_get(const uint8_t *p)
+{
+	return (uint64_t) p[0] | ((uint64_t) p[1] << 8) | ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24) |
+		((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40) | ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+}
+
+static inline uint32_t le32_get(const uint8_t *p)
+{
+	return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/* the sigma indexes are constants once unrolled */
+#define B2_ROUND(G, r) { \
+	G(0, 4,  8, 12, blake2_sigma[r][ 0], blake2_sigma[r][ 1]); \
+	G(1, 5,  9, 13, blake2_sigma[r][ 2], blake2_sigma[r][ 3]); \
+	G(2, 6, 10, 14, blake2_sigma[r][ 4], blake2_sigma[r][ 5]); \
+	G(3, 7, 11, 15, blake2_sigma[r][ 6], blake2_sigma[r][ 7]); \
+	G(0, 5, 10, 15, blake2_sigma[r][ 8], blake2_sigma[r][ 9]); \
+	G(1, 6, 11, 12, blake2_sigma[r][10], blake2_sigma[r][11]); \
+	G(2, 7,  8, 13, blake2_sigma[r][12], blake2_sigma[r][13]); \
+	G(3, 4,  9, 14, blake2_sigma[r][14], blake2_sigma[r][15]); \
+}
+
+#define B2S_ROUNDS(R) { \
+	R(0); R(1); R(2); R(3); R(4); R(5); R(6); R(7); R(8); R(9); \
+}
+
+#define B2B_ROUNDS(R) { \
+	B2S_ROUNDS(R); R(10); R(11); \
+}
+
+typedef void (*b2b_compress_fn)(uint64_t *h, const uint64_t *m, uint64_t t0, uint64_t t1, uint64_t f0);
+typedef void (*b2s_compress_fn)(uint32_t *h, const uint32_t *m, uint32_t t0, uint32_t t1, uint32_t f0);
+
+/* scalar */
+
+#define B2B_G(a,b,c,d,x,y) { \
+	v[a] += v[b] + m[x]; v[d] = ROTR64(v[d] ^ v[a], 32); \
+	v[c] += v[d];        v[b] = ROTR64(v[b] ^ v[c], 24); \
+	v[a] += v[b] + m[y]; v[d] = ROTR64(v[d] ^ v[a], 16); \
+	v[c] += v[d];        v[b] = ROTR64(v[b] ^ v[c], 63); \
+}
+#define B2B_R(r) B2_ROUND(B2B_G, r)
+
+static void b2b_compress_ref(uint64_t *h, const uint64_t *m, uint64_t t0, uint64_t t1, uint64_t f0)
+{
+	uint64_t v[16];
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		v[i] = h[i];
+		v[i + 8] = blake2b_iv[i];
+	}
+	v[12] ^= t0;
+	v[13] ^= t1;
+	v[14] ^= f0;
+
+	B2B_ROUNDS(B2B_R);
+
+	for (i = 0; i < 8; i++)
+		h[i] ^= v[i] ^ v[i + 8];
+}
+
+#define B2S_G(a,b,c,d,x,y) { \
+	v[a] += v[b] + m[x]; v[d] = ROTR32(v[d] ^ v[a], 16); \
+	v[c] += v[d];        v[b] = ROTR32(v[b] ^ v[c], 12); \
+	v[a] += v[b] + m[y]; v[d] = ROTR32(v[d] ^ v[a], 8); \
+	v[c] += v[d];        v[b] = ROTR32(v[b] ^ v[c], 7); \
+}
+#define B2S_R(r) B2_ROUND(B2S_G, r)
+
+static void b2s_compress_ref(uint32_t *h, const uint32_t *m, uint32_t t0, uint32_t t1, uint32_t f0)
+{
+	uint32_t v[16];
+	int i;
+
+	for (i = 0; i < 8; i++) {
+		v[i] = h[i];
+		v[i + 8] = blake2s_iv[i];
+	}
+	v[12] ^= t0;
+	v[13] ^= t1;
+	v[14] ^= f0;
+
+	B2S_ROUNDS(B2S_R);
+
+	for (i = 0; i < 8; i++)
+		h[i] ^= v[i] ^ v[i + 8];
+}
+
+#ifdef BLAKE2_X86
+
+/* SSE4.1, blake2s rows in one vector, blake2b rows in two halves */
+
+#define ROR32_X(x, n) _mm_or_si128(_mm_srli_epi32(x, n), _mm_slli_epi32(x, 32 - (n)))
+
+#define B2S_HALF_X(x, rot, r1, r2) { \
+	a = _mm_add_epi32(_mm_add_epi32(a, b), x); \
+	d = _mm_shuffle_epi8(_mm_xor_si128(d, a), rot); \
+	c = _mm_add_epi32(c, d); \
+	b = ROR32_X(_mm_xor_si128(b, c), r1); \
+	(void) r2; \
+}
+
+#define B2S_R_X(r) { \
+	const uint8_t *s = blake2_sigma[r]; \
+	B2S_HALF_X(_mm_setr_epi32(m[s[0]], m[s[2]], m[s[4]], m[s[6]]), r16, 12, 0); \
+	B2S_HALF_X(_mm_setr_epi32(m[s[1]], m[s[3]], m[s[5]], m[s[7]]), r8, 7, 0); \
+	b = _mm_shuffle_epi32(b, _MM_SHUFFLE(0,3,2,1)); \
+	c = _mm_shuffle_epi32(c, _MM_SHUFFLE(1,0,3,2)); \
+	d = _mm_shuffle_epi32(d, _MM_SHUFFLE(2,1,0,3)); \
+	B2S_HALF_X(_mm_setr_epi32(m[s[8]], m[s[10]], m[s[12]], m[s[14]]), r16, 12, 0); \
+	B2S_HALF_X(_mm_setr_epi32(m[s[9]], m[s[11]], m[s[13]], m[s[15]]), r8, 7, 0); \
+	b = _mm_shuffle_epi32(b, _MM_SHUFFLE(2,1,0,3)); \
+	c = _mm_shuffle_epi32(c, _MM_SHUFFLE(1,0,3,2)); \
+	d = _mm_shuffle_epi32(d, _MM_SHUFFLE(0,3,2,1)); \
+}
+
+B2_TARGET("sse4.1")
+static void b2s_compress_sse41(uint32_t *h, const uint32_t *m, uint32_t t0, uint32_t t1, uint32_t f0)
+{
+	const __m128i r16 = _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+	const __m128i r8 = _mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+	const __m128i h0 = _mm_loadu_si128((const __m128i*) &h[0]);
+	const __m128i h1 = _mm_loadu_si128((const __m128i*) &h[4]);
+	__m128i a = h0, b = h1;
+	__m128i c = _mm_loadu_si128((const __m128i*) &blake2s_iv[0]);
+	__m128i d = _mm_xor_si128(_mm_loadu_si128((const __m128i*) &blake2s_iv[4]),
+		_mm_setr_epi32((int) t0, (int) t1, (int) f0, 0));
+
+	B2S_ROUNDS(B2S_R_X);
+
+	_mm_storeu_si128((__m128i*) &h[0], _mm_xor_si128(h0, _mm_xor_si128(a, c)));
+	_mm_storeu_si128((__m128i*) &h[4], _mm_xor_si128(h1, _mm_xor_si128(b, d)));
+}
+
+#define ROR64_63_X(x) _mm_xor_si128(_mm_srli_epi64(x, 63), _mm_add_epi64(x, x))
+
+#define B2B_HALF_X(x0, x1, rd, rb) { \
+	al = _mm_add_epi64(_mm_add_epi64(al, bl), x0); \
+	ah = _mm_add_epi64(_mm_add_epi64(ah, bh), x1); \
+	dl = rd(_mm_xor_si128(dl, al)); \
+	dh = rd(_mm_xor_si128(dh, ah)); \
+	cl = _mm_add_epi64(cl, dl); \
+	ch = _mm_add_epi64(ch, dh); \
+	bl = rb(_mm_xor_si128(bl, cl)); \
+	bh = rb(_mm_xor_si128(bh, ch)); \
+}
+
+#define ROR64_32_X(x) _mm_shuffle_epi32(x, _MM_SHUFFLE(2,3,0,1))
+#define ROR64_24_X(x) _mm_shuffle_epi8(x, r24)
+#define ROR64_16_X(x) _mm_shuffle_epi8(x, r16)
+
+#define M2(i, j) _mm_set_epi64x((long long) m[j], (long long) m[i])
+
+#define B2B_R_X(r) { \
+	const uint8_t *s = blake2_sigma[r]; \
+	__m128i t0, t1; \
+	B2B_HALF_X(M2(s[0], s[2]), M2(s[4], s[6]), ROR64_32_X, ROR64_24_X); \
+	B2B_HALF_X(M2(s[1], s[3]), M2(s[5], s[7]), ROR64_16_X, ROR64_63_X); \
+	t0 = _mm_alignr_epi8(bh, bl, 8); t1 = _mm_alignr_epi8(bl, bh, 8); bl = t0; bh = t1; \
+	t0 = cl; cl = ch; ch = t0; \
+	t0 = _mm_alignr_epi8(dh, dl, 8); t1 = _mm_alignr_epi8(dl, dh, 8); dl = t1; dh = t0; \
+	B2B_HALF_X(M2(s[8], s[10]), M2(s[12], s[14]), ROR64_32_X, ROR64_24_X); \
+	B2B_HALF_X(M2(s[9], s[11]), M2(s[13], s[15]), ROR64_16_X, ROR64_63_X); \
+	t0 = _mm_alignr_epi8(bl, bh, 8); t1 = _mm_alignr_epi8(bh, bl, 8); bl = t0; bh = t1; \
+	t0 = cl; cl = ch; ch = t0; \
+	t0 = _mm_alignr_epi8(dl, dh, 8); t1 = _mm_alignr_epi8(dh, dl, 8); dl = t1; dh = t0; \
+}
+
+B2_TARGET("sse4.1")
+static void b2b_compress_sse41(uint64_t *h, const uint64_t *m, uint64_t t0, uint64_t t1, uint64_t f0)
+{
+	const __m128i r16 = _mm_setr_epi8(2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+	const __m128i r24 = _mm_setr_epi8(3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+	__m128i al = _mm_loadu_si128((const __m128i*) &h[0]);
+	__m128i ah = _mm_loadu_si128((const __m128i*) &h[2]);
+	__m128i bl = _mm_loadu_si128((const __m128i*) &h[4]);
+	__m128i bh = _mm_loadu_si128((const __m128i*) &h[6]);
+	__m128i cl = _mm_loadu_si128((const __m128i*) &blake2b_iv[0]);
+	__m128i ch = _mm_loadu_si128((const __m128i*) &blake2b_iv[2]);
+	__m128i dl = _mm_xor_si128(_mm_loadu_si128((const __m128i*) &blake2b_iv[4]),
+		_mm_set_epi64x((long long) t1, (long long) t0));
+	__m128i dh = _mm_xor_si128(_mm_loadu_si128((const __m128i*) &blake2b_iv[6]),
+		_mm_set_epi64x(0, (long long) f0));
+
+	B2B_ROUNDS(B2B_R_X);
+
+	al = _mm_xor_si128(al, cl); ah = _mm_xor_si128(ah, ch);
+	bl = _mm_xor_si128(bl, dl); bh = _mm_xor_si128(bh, dh);
+	_mm_storeu_si128((__m128i*) &h[0], _mm_xor_si128(_mm_loadu_si128((const __m128i*) &h[0]), al));
+	_mm_storeu_si128((__m128i*) &h[2], _mm_xor_si128(_mm_loadu_si128((const __m128i*) &h[2]), ah));
+	_mm_storeu_si128((__m128i*) &h[4], _mm_xor_si128(_mm_loadu_si128((const __m128i*) &h[4]), bl));
+	_mm_storeu_si128((__m128i*) &h[6], _mm_xor_si128(_mm_loadu_si128((const __m128i*) &h[6]), bh));
+}
+
+/* AVX2, blake2b rows in one vector */
+
+#define ROR64_32_Y(x) _mm256_shuffle_epi32(x, _MM_SHUFFLE(2,3,0,1))
+#define ROR64_24_Y(x) _mm256_shuffle_epi8(x, r24)
+#define ROR64_16_Y(x) _mm256_shuffle_epi8(x, r16)
+#define ROR64_63_Y(x) _mm256_xor_si256(_mm256_srli_epi64(x, 63), _mm256_add_epi64(x, x))
+
+#define B2B_HALF_Y(x, rd, rb) { \
+	a = _mm256_add_epi64(_mm256_add_epi64(a, b), x); \
+	d = rd(_mm256_xor_si256(d, a)); \
+	c = _mm256_add_epi64(c, d); \
+	b = rb(_mm256_xor_si256(b, c)); \
+}
+
+#define M4(i, j, k, l) _mm256_set_epi64x((long long) m[l], (long long) m[k], (long long) m[j], (long long) m[i])
+
+#define B2B_R_Y(r) { \
+	const uint8_t *s = blake2_sigma[r]; \
+	B2B_HALF_Y(M4(s[0], s[2], s[4], s[6]), ROR64_32_Y, ROR64_24_Y); \
+	B2B_HALF_Y(M4(s[1], s[3], s[5], s[7]), ROR64_16_Y, ROR64_63_Y); \
+	b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(0,3,2,1)); \
+	c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1,0,3,2)); \
+	d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(2,1,0,3)); \
+	B2B_HALF_Y(M4(s[8], s[10], s[12], s[14]), ROR64_32_Y, ROR64_24_Y); \
+	B2B_HALF_Y(M4(s[9], s[11], s[13], s[15]), ROR64_16_Y, ROR64_63_Y); \
+	b = _mm256_permute4x64_epi64(b, _MM_SHUFFLE(2,1,0,3)); \
+	c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(1,0,3,2)); \
+	d = _mm256_permute4x64_epi64(d, _MM_SHUFFLE(0,3,2,1)); \
+}
+
+B2_TARGET("avx2")
+static void b2b_compress_avx2(uint64_t *h, const uint64_t *m, uint64_t t0, uint64_t t1, uint64_t f0)
+{
+	const __m256i r16 = _mm256_setr_epi8(
+		2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+		2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+	const __m256i r24 = _mm256_setr_epi8(
+		3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+		3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+	const __m256i h0 = _mm256_loadu_si256((const __m256i*) &h[0]);
+	const __m256i h1 = _mm256_loadu_si256((const __m256i*) &h[4]);
+	__m256i a = h0, b = h1;
+	__m256i c = _mm256_loadu_si256((const __m256i*) &blake2b_iv[0]);
+	__m256i d = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) &blake2b_iv[4]),
+		_mm256_set_epi64x(0, (long long) f0, (long long) t1, (long long) t0));
+
+	B2B_ROUNDS(B2B_R_Y);
+
+	_mm256_storeu_si256((__m256i*) &h[0], _mm256_xor_si256(h0, _mm256_xor_si256(a, c)));
+	_mm256_storeu_si256((__m256i*) &h[4], _mm256_xor_si256(h1, _mm256_xor_si256(b, d)));
+}
+
+/* AVX2 lanes, v[] holds the same state word of 4 or 8 inputs */
+
+#define B2B_G_L(a,b,c,d,x,y) { \
+	v[a] = _mm256_add_epi64(_mm256_add_epi64(v[a], v[b]), vm[x]); \
+	v[d] = ROR64_32_Y(_mm256_xor_si256(v[d], v[a])); \
+	v[c] = _mm256_add_epi64(v[c], v[d]); \
+	v[b] = ROR64_24_Y(_mm256_xor_si256(v[b], v[c])); \
+	v[a] = _mm256_add_epi64(_mm256_add_epi64(v[a], v[b]), vm[y]); \
+	v[d] = ROR64_16_Y(_mm256_xor_si256(v[d], v[a])); \
+	v[c] = _mm256_add_epi64(v[c], v[d]); \
+	v[b] = ROR64_63_Y(_mm256_xor_si256(v[b], v[c])); \
+}
+#define B2B_R_L(r) B2_ROUND(B2B_G_L, r)
+
+B2_TARGET("avx2")
+static void b2b_lanes4_avx2(const blake2b_midstate *ms, uint64_t out[8][4], const uint32_t *nonces)
+{
+	const __m256i r16 = _mm256_setr_epi8(
+		2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9,
+		2, 3, 4, 5, 6, 7, 0, 1, 10, 11, 12, 13, 14, 15, 8, 9);
+	const __m256i r24 = _mm256_setr_epi8(
+		3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10,
+		3, 4, 5, 6, 7, 0, 1, 2, 11, 12, 13, 14, 15, 8, 9, 10);
+	__m256i v[16], vm[16];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		vm[i] = _mm256_set1_epi64x((long long) ms->m[i]);
+	__m256i n = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*) nonces));
+	n = _mm256_sll_epi64(n, _mm_cvtsi32_si128(ms->nonce_shift));
+	vm[ms->nonce_word] = _mm256_or_si256(vm[ms->nonce_word], n);
+
+	for (i = 0; i < 8; i++) {
+		v[i] = _mm256_set1_epi64x((long long) ms->h[i]);
+		v[i + 8] = _mm256_set1_epi64x((long long) blake2b_iv[i]);
+	}
+	v[12] = _mm256_set1_epi64x((long long) (blake2b_iv[4] ^ ms->t0));
+	v[13] = _mm256_set1_epi64x((long long) (blake2b_iv[5] ^ ms->t1));
+	v[14] = _mm256_set1_epi64x((long long) ~blake2b_iv[6]);
+
+	B2B_ROUNDS(B2B_R_L);
+
+	for (i = 0; i < 8; i++) {
+		__m256i x = _mm256_xor_si256(_mm256_set1_epi64x((long long) ms->h[i]), _mm256_xor_si256(v[i], v[i + 8]));
+		_mm256_storeu_si256((__m256i*) out[i], x);
+	}
+}
+
+#define ROR32_Y(x, n) _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - (n)))
+
+#define B2S_G_L(a,b,c,d,x,y) { \
+	v[a] = _mm256_add_epi32(_mm256_add_epi32(v[a], v[b]), vm[x]); \
+	v[d] = _mm256_shuffle_epi8(_mm256_xor_si256(v[d], v[a]), r16); \
+	v[c] = _mm256_add_epi32(v[c], v[d]); \
+	v[b] = ROR32_Y(_mm256_xor_si256(v[b], v[c]), 12); \
+	v[a] = _mm256_add_epi32(_mm256_add_epi32(v[a], v[b]), vm[y]); \
+	v[d] = _mm256_shuffle_epi8(_mm256_xor_si256(v[d], v[a]), r8); \
+	v[c] = _mm256_add_epi32(v[c], v[d]); \
+	v[b] = ROR32_Y(_mm256_xor_si256(v[b], v[c]), 7); \
+}
+#define B2S_R_L(r) B2_ROUND(B2S_G_L, r)
+
+B2_TARGET("avx2")
+static void b2s_lanes8_avx2(const blake2s_midstate *ms, uint32_t out[8][8], const uint32_t *nonces)
+{
+	const __m256i r16 = _mm256_setr_epi8(
+		2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+		2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+	const __m256i r8 = _mm256_setr_epi8(
+		1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12,
+		1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+	__m256i v[16], vm[16];
+	int i;
+
+	for (i = 0; i < 16; i++)
+		vm[i] = _mm256_set1_epi32((int) ms->m[i]);
+	vm[ms->nonce_word] = _mm256_loadu_si256((const __m256i*) nonces);
+
+	for (i = 0; i < 8; i++) {
+		v[i] = _mm256_set1_epi32((int) ms->h[i]);
+		v[i + 8] = _mm256_set1_epi32((int) blake2s_iv[i]);
+	}
+	v[12] = _mm256_set1_epi32((int) (blake2s_iv[4] ^ ms->t0));
+	v[13] = _mm256_set1_epi32((int) (blake2s_iv[5] ^ ms->t1));
+	v[14] = _mm256_set1_epi32((int) ~blake2s_iv[6]);
+
+	B2S_ROUNDS(B2S_R_L);
+
+	for (i = 0; i < 8; i++) {
+		__m256i x = _mm256_xor_si256(_mm256_set1_epi32((int) ms->h[i]), _mm256_xor_si256(v[i], v[i + 8]));
+		_mm256_storeu_si256((__m256i*) out[i], x);
+	}
+}
+
+#endif /* BLAKE2_X86 */
+
+/* runtime selection */
+
+static b2b_compress_fn b2b_compress = b2b_compress_ref;
+static b2s_compress_fn b2s_compress = b2s_compress_ref;
+static volatile int b2_level = -1;
+
+static int blake2_cpu_level(void)
+{
+#if defined(BLAKE2_X86) && (defined(__GNUC__) || defined(__clang__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return 2;
+	if (__builtin_cpu_supports("sse4.1"))
+		return 1;
+#elif defined(BLAKE2_X86) && defined(_MSC_VER)
+	int r[4];
+	int level = 0;
+	__cpuid(r, 1);
+	if (r[2] & (1 << 19)) {
+		level = 1;
+		// avx with the ymm registers saved by the os
+		if ((r[2] & (1 << 27)) && (r[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6) {
+			__cpuidex(r, 7, 0);
+			if (r[1] & (1 << 5))
+				level = 2;
+		}
+	}
+	return level;
+#endif
+	return 0;
+}
+
+int blake2_simd_level(void)
+{
+	if (b2_level < 0) {
+		int level = blake2_cpu_level();
+#ifdef BLAKE2_X86
+		if (level >= 1) {
+			b2b_compress = b2b_compress_sse41;
+			b2s_compress = b2s_compress_sse41;
+		}
+		if (level >= 2)
+			b2b_compress = b2b_compress_avx2;
+#endif
+		b2_level = level;
+	}
+	return b2_level;
+}
+
+/* block helpers */
+
+static void b2b_compress_bytes(uint64_t *h, const uint8_t *block, uint64_t t0, uint64_t t1, uint64_t f0)
+{
+	uint64_t m[16];
+	for (int i = 0; i < 16; i++)
+		m[i] = le64_get(&block[8 * i]);
+	b2b_compress(h, m, t0, t1, f0);
+}
+
+static void b2s_compress_bytes(uint32_t *h, const uint8_t *block, uint32_t t0, uint32_t t1, uint32_t f0)
+{
+	uint32_t m[16];
+	for (int i = 0; i < 16; i++)
+		m[i] = le32_get(&block[4 * i]);
+	b2s_compress(h, m, t0, t1, f0);
+}
+
+void blake2b_compress_x(uint64_t *h, const void *block, uint64_t t0, uint64_t t1, uint64_t f0)
+{
+	blake2_simd_level();
+	b2b_compress_bytes(h, (const uint8_t*) block, t0, t1, f0);
+}
+
+void blake2s_compress_x(uint32_t *h, const void *block, uint32_t t0, uint32_t t1, uint32_t f0)
+{
+	blake2_simd_level();
+	b2s_compress_bytes(h, (const uint8_t*) block, t0, t1, f0);
+}
+
+static void b2b_output(const uint64_t *h, uint8_t *out, size_t outlen)
+{
+	for (size_t i = 0; i < outlen; i++)
+		out[i] = (uint8_t) (h[i >> 3] >> (8 * (i & 7)));
+}
+
+static void b2s_output(const uint32_t *h, uint8_t *out, size_t outlen)
+{
+	for (size_t i = 0; i < outlen; i++)
+		out[i] = (uint8_t) (h[i >> 2] >> (8 * (i & 3)));
+}
+
+void blake2b_simd(void *out, size_t outlen, const void *in, size_t inlen)
+{
+	const uint8_t *p = (const uint8_t*) in;
+	uint8_t last[BLAKE2B_BLOCK];
+	uint64_t h[8];
+	uint64_t t = 0;
+
+	blake2_simd_level();
+	memcpy(h, blake2b_iv, sizeof(h));
+	h[0] ^= 0x01010000ULL ^ (uint64_t) outlen;
+
+	// the last block, even full, is compressed with the final flag
+	while (inlen > BLAKE2B_BLOCK) {
+		t += BLAKE2B_BLOCK;
+		b2b_compress_bytes(h, p, t, 0, 0);
+		p += BLAKE2B_BLOCK;
+		inlen -= BLAKE2B_BLOCK;
+	}
+	memset(last, 0, sizeof(last));
+	memcpy(last, p, inlen);
+	t += inlen;
+	b2b_compress_bytes(h, last, t, 0, ~0ULL);
+	b2b_output(h, (uint8_t*) out, outlen);
+}
+
+void blake2s_simd(void *out, size_t outlen, const void *in, size_t inlen)
+{
+	const uint8_t *p = (const uint8_t*) in;
+	uint8_t last[BLAKE2S_BLOCK];
+	uint32_t h[8];
+	uint32_t t = 0;
+
+	blake2_simd_level();
+	memcpy(h, blake2s_iv, sizeof(h));
+	h[0] ^= 0x01010000U ^ (uint32_t) outlen;
+
+	while (inlen > BLAKE2S_BLOCK) {
+		t += BLAKE2S_BLOCK;
+		b2s_compress_bytes(h, p, t, 0, 0);
+		p += BLAKE2S_BLOCK;
+		inlen -= BLAKE2S_BLOCK;
+	}
+	memset(last, 0, sizeof(last));
+	memcpy(last, p, inlen);
+	t += (uint32_t) inlen;
+	b2s_compress_bytes(h, last, t, 0, ~0U);
+	b2s_output(h, (uint8_t*) out, outlen);
+}
+
+/* midstates */
+
+int blake2b_mid_set(blake2b_midstate *ms, const uint64_t *h, uint64_t counter,
+	const void *tail, size_t taillen, size_t nonce_off, size_t outlen)
+{
+	uint8_t last[BLAKE2B_BLOCK];
+
+	if (!taillen || taillen > BLAKE2B_BLOCK || (nonce_off & 3) || nonce_off + 4 > taillen || outlen > 64)
+		return -1;
+
+	blake2_simd_level();
+	memset(last, 0, sizeof(last));
+	memcpy(last, tail, taillen);
+	memset(&last[nonce_off], 0, 4);
+	for (int i = 0; i < 16; i++)
+		ms->m[i] = le64_get(&last[8 * i]);
+	memcpy(ms->h, h, sizeof(ms->h));
+	ms->t0 = counter + taillen;
+	ms->t1 = ms->t0 < counter;
+	ms->nonce_word = (int) (nonce_off >> 3);
+	ms->nonce_shift = (int) (nonce_off & 7) * 8;
+	ms->outlen = (int) outlen;
+	return 0;
+}
+
+int blake2b_mid_init(blake2b_midstate *ms, const void *data, size_t len, size_t nonce_off, size_t outlen)
+{
+	const uint8_t *p = (const uint8_t*) data;
+	size_t head = len ? (len - 1) & ~(size_t) (BLAKE2B_BLOCK - 1) : 0;
+	uint64_t h[8];
+
+	if (!len || nonce_off < head || outlen > 64)
+		return -1;
+
+	blake2_simd_level();
+	memcpy(h, blake2b_iv, sizeof(h));
+	h[0] ^= 0x01010000ULL ^ (uint64_t) outlen;
+	for (size_t off = 0; off < head; off += BLAKE2B_BLOCK)
+		b2b_compress_bytes(h, &p[off], off + BLAKE2B_BLOCK, 0, 0);
+
+	return blake2b_mid_set(ms, h, head, &p[head], len - head, nonce_off - head, outlen);
+}
+
+void blake2b_mid_hash(const blake2b_midstate *ms, void *out, uint32_t nonce)
+{
+	uint64_t h[8], m[16];
+
+	memcpy(h, ms->h, sizeof(h));
+	memcpy(m, ms->m, sizeof(m));
+	m[ms->nonce_word] |= (uint64_t) nonce << ms->nonce_shift;
+	b2b_compress(h, m, ms->t0, ms->t1, ~0ULL);
+	b2b_output(h, (uint8_t*) out, ms->outlen);
+}
+
+void blake2b_mid_hash4(const blake2b_midstate *ms, void *out, const uint32_t *nonces)
+{
+	uint8_t *dst = (uint8_t*) out;
+#ifdef BLAKE2_X86
+	if (b2_level >= 2) {
+		uint64_t w[8][4], h[8];
+		b2b_lanes4_avx2(ms, w, nonces);
+		for (int lane = 0; lane < 4; lane++) {
+			for (int i = 0; i < 8; i++)
+				h[i] = w[i][lane];
+			b2b_output(h, &dst[64 * lane], ms->outlen);
+		}
+		return;
+	}
+#endif
+	for (int lane = 0; lane < 4; lane++)
+		blake2b_mid_hash(ms, &dst[64 * lane], nonces[lane]);
+}
+
+int blake2s_mid_init(blake2s_midstate *ms, const void *data, size_t len, size_t nonce_off, size_t outlen)
+{
+	const uint8_t *p = (const uint8_t*) data;
+	size_t head = len ? (len - 1) & ~(size_t) (BLAKE2S_BLOCK - 1) : 0;
+	uint8_t last[BLAKE2S_BLOCK];
+
+	if (!len || nonce_off < head || (nonce_off & 3) || nonce_off + 4 > len || outlen > 32)
+		return -1;
+
+	blake2_simd_level();
+	memcpy(ms->h, blake2s_iv, sizeof(ms->h));
+	ms->h[0] ^= 0x01010000U ^ (uint32_t) outlen;
+	for (size_t off = 0; off < head; off += BLAKE2S_BLOCK)
+		b2s_compress_bytes(ms->h, &p[off], (uint32_t) (off + BLAKE2S_BLOCK), 0, 0);
+
+	memset(last, 0, sizeof(last));
+	memcpy(last, &p[head], len - head);
+	for (int i = 0; i < 16; i++)
+		ms->m[i] = le32_get(&last[4 * i]);
+	ms->t0 = (uint32_t) len;
+	ms->t1 = (uint32_t) ((uint64_t) len >> 32);
+	ms->nonce_word = (int) ((nonce_off - head) >> 2);
+	ms->outlen = (int) outlen;
+	return 0;
+}
+
+void blake2s_mid_hash(const blake2s_midstate *ms, void *out, uint32_t nonce)
+{
+	uint32_t h[8], m[16];
+
+	memcpy(h, ms->h, sizeof(h));
+	memcpy(m, ms->m, sizeof(m));
+	m[ms->nonce_word] = nonce;
+	b2s_compress(h, m, ms->t0, ms->t1, ~0U);
+	b2s_output(h, (uint8_t*) out, ms->outlen);
+}
+
+void blake2s_mid_hash8(const blake2s_midstate *ms, void *out, const uint32_t *nonces)
+{
+	uint8_t *dst = (uint8_t*) out;
+#ifdef BLAKE2_X86
+	if (b2_level >= 2) {
+		uint32_t w[8][8], h[8];
+		b2s_lanes8_avx2(ms, w, nonces);
+		for (int lane = 0; lane < 8; lane++) {
+			for (int i = 0; i < 8; i++)
+				h[i] = w[i][lane];
+			b2s_output(h, &dst[32 * lane], ms->outlen);
+		}
+		return;
+	}
+#endif
+	for (int lane = 0; lane < 8; lane++)
+		blake2s_mid_hash(ms, &dst[32 * lane], nonces[lane]);
+}
@@ -0,0 +1,65 @@
+#ifndef BLAKE2_SIMD_H
+#define BLAKE2_SIMD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if (__cplusplus)
+extern "C" {
+#endif
+
+#define BLAKE2B_BLOCK 128
+#define BLAKE2S_BLOCK 64
+
+/* 0: scalar, 1: SSE4.1, 2: AVX2, selected on the first call */
+int blake2_simd_level(void);
+
+/* compress one block, f0 is ~0 for the last one */
+void blake2b_compress_x(uint64_t *h, const void *block, uint64_t t0, uint64_t t1, uint64_t f0);
+void blake2s_compress_x(uint32_t *h, const void *block, uint32_t t0, uint32_t t1, uint32_t f0);
+
+/* unkeyed hashes, outlen up to 64 (blake2b) or 32 (blake2s) bytes */
+void blake2b_simd(void *out, size_t outlen, const void *in, size_t inlen);
+void blake2s_simd(void *out, size_t outlen, const void *in, size_t inlen);
+
+/**
+ * Midstates, for the inputs which only differ by a 32-bit little endian
+ * nonce in their last block. The lane functions hash 4 (blake2b) or 8
+ * (blake2s) nonces at once with AVX2, their outputs are 64 or 32 bytes
+ * apart.
+ */
+typedef struct {
+	uint64_t h[8];
+	uint64_t m[16];    /* last block, nonce bits cleared */
+	uint64_t t0, t1;
+	int nonce_word;
+	int nonce_shift;
+	int outlen;
+} blake2b_midstate;
+
+typedef struct {
+	uint32_t h[8];
+	uint32_t m[16];
+	uint32_t t0, t1;
+	int nonce_word;
+	int outlen;
+} blake2s_midstate;
+
+/* the nonce must be in the last block of data, returns -1 if not */
+int blake2b_mid_init(blake2b_midstate *ms, const void *data, size_t len, size_t nonce_off, size_t outlen);
+int blake2s_mid_init(blake2s_midstate *ms, const void *data, size_t len, size_t nonce_off, size_t outlen);
+
+/* from a chain value and the bytes counted before the tail (the last block) */
+int blake2b_mid_set(blake2b_midstate *ms, const uint64_t *h, uint64_t counter,
+	const void *tail, size_t taillen, size_t nonce_off, size_t outlen);
+
+void blake2b_mid_hash(const blake2b_midstate *ms, void *out, uint32_t nonce);
+void blake2b_mid_hash4(const blake2b_midstate *ms, void *out, const uint32_t *nonces);
+void blake2s_mid_hash(const blake2s_midstate *ms, void *out, uint32_t nonce);
+void blake2s_mid_hash8(const blake2s_midstate *ms, void *out, const uint32_t *nonces);
+
+#if (__cplusplus)
+}
+#endif
+
+#endif
@@ -0,0 +1,391 @@
+/**
+ * Keccak-f[1600] shared by keccak, sph_keccak, cryptonight, wildkeccak and
+ * scrypt-jane: a scalar round, a lane complemented one (5 NOT per round
+ * instead of 25, the sph_keccak state layout) and 4 or 8 interleaved
+ * states with AVX2 or AVX-512F, selected at runtime.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "keccak-simd.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define KECCAK_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define K_TARGET(x) __attribute__((target(x)))
+#else
+#define K_TARGET(x)
+#endif
+
+static const uint64_t keccak_rc[24] = {
+	0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808aULL,
+	0x8000000080008000ULL, 0x000000000000808bULL, 0x0000000080000001ULL,
+	0x8000000080008081ULL, 0x8000000000008009ULL, 0x000000000000008aULL,
+	0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000aULL,
+	0x000000008000808bULL, 0x800000000000008bULL, 0x8000000000008089ULL,
+	0x8000000000008003ULL, 0x8000000000008002ULL, 0x8000000000000080ULL,
+	0x000000000000800aULL, 0x800000008000000aULL, 0x8000000080008081ULL,
+	0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+#define ROL64(x, n) (((x) << (n)) | ((x) >> (64 - (n))))
+
+static inline uint64_t le64_get(const uint8_t *p)
+{
+	return (uint64_t) p[0] | ((uint64_t) p[1] << 8) | ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24) |
+		((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40) | ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+}
+
+static inline void le64_put(uint8_t *p, uint64_t v)
+{
+	for (int i = 0; i < 8; i++)
+		p[i] = (uint8_t) (v >> (8 * i));
+}
+
+/**
+ * Lane aXY is the word x + 5 * y. One round reads A and writes E, with the
+ * operations of the lane type KT given by KPAR (column parity), KXOR, KROL,
+ * KCHI (a ^ (~b & c)) and KIOTA.
+ */
+#define KF_ROUND(A, E, rc) { \
+	KT c0 = KPAR(A##00, A##01, A##02, A##03, A##04); \
+	KT c1 = KPAR(A##10, A##11, A##12, A##13, A##14); \
+	KT c2 = KPAR(A##20, A##21, A##22, A##23, A##24); \
+	KT c3 = KPAR(A##30, A##31, A##32, A##33, A##34); \
+	KT c4 = KPAR(A##40, A##41, A##42, A##43, A##44); \
+	KT d0 = KXOR(c4, KROL(c1, 1)); \
+	KT d1 = KXOR(c0, KROL(c2, 1)); \
+	KT d2 = KXOR(c1, KROL(c3, 1)); \
+	KT d3 = KXOR(c2, KROL(c4, 1)); \
+	KT d4 = KXOR(c3, KROL(c0, 1)); \
+	KT b0, b1, b2, b3, b4; \
+	b0 = KXOR(A##00, d0); b1 = KROL(KXOR(A##11, d1), 44); b2 = KROL(KXOR(A##22, d2), 43); \
+	b3 = KROL(KXOR(A##33, d3), 21); b4 = KROL(KXOR(A##44, d4), 14); \
+	E##00 = KIOTA(KCHI(b0, b1, b2), rc); E##10 = KCHI(b1, b2, b3); E##20 = KCHI(b2, b3, b4); \
+	E##30 = KCHI(b3, b4, b0); E##40 = KCHI(b4, b0, b1); \
+	b0 = KROL(KXOR(A##30, d3), 28); b1 = KROL(KXOR(A##41, d4), 20); b2 = KROL(KXOR(A##02, d0), 3); \
+	b3 = KROL(KXOR(A##13, d1), 45); b4 = KROL(KXOR(A##24, d2), 61); \
+	E##01 = KCHI(b0, b1, b2); E##11 = KCHI(b1, b2, b3); E##21 = KCHI(b2, b3, b4); \
+	E##31 = KCHI(b3, b4, b0); E##41 = KCHI(b4, b0, b1); \
+	b0 = KROL(KXOR(A##10, d1), 1); b1 = KROL(KXOR(A##21, d2), 6); b2 = KROL(KXOR(A##32, d3), 25); \
+	b3 = KROL(KXOR(A##43, d4), 8); b4 = KROL(KXOR(A##04, d0), 18); \
+	E##02 = KCHI(b0, b1, b2); E##12 = KCHI(b1, b2, b3); E##22 = KCHI(b2, b3, b4); \
+	E##32 = KCHI(b3, b4, b0); E##42 = KCHI(b4, b0, b1); \
+	b0 = KROL(KXOR(A##40, d4), 27); b1 = KROL(KXOR(A##01, d0), 36); b2 = KROL(KXOR(A##12, d1), 10); \
+	b3 = KROL(KXOR(A##23, d2), 15); b4 = KROL(KXOR(A##34, d3), 56); \
+	E##03 = KCHI(b0, b1, b2); E##13 = KCHI(b1, b2, b3); E##23 = KCHI(b2, b3, b4); \
+	E##33 = KCHI(b3, b4, b0); E##43 = KCHI(b4, b0, b1); \
+	b0 = KROL(KXOR(A##20, d2), 62); b1 = KROL(KXOR(A##31, d3), 55); b2 = KROL(KXOR(A##42, d4), 39); \
+	b3 = KROL(KXOR(A##03, d0), 41); b4 = KROL(KXOR(A##14, d1), 2); \
+	E##04 = KCHI(b0, b1, b2); E##14 = KCHI(b1, b2, b3); E##24 = KCHI(b2, b3, b4); \
+	E##34 = KCHI(b3, b4, b0); E##44 = KCHI(b4, b0, b1); \
+}
+
+#define KF_ROUND_LC(A, E, rc) { \
+	uint64_t c0 = A##00 ^ A##01 ^ A##02 ^ A##03 ^ A##04; \
+	uint64_t c1 = A##10 ^ A##11 ^ A##12 ^ A##13 ^ A##14; \
+	uint64_t c2 = A##20 ^ A##21 ^ A##22 ^ A##23 ^ A##24; \
+	uint64_t c3 = A##30 ^ A##31 ^ A##32 ^ A##33 ^ A##34; \
+	uint64_t c4 = A##40 ^ A##41 ^ A##42 ^ A##43 ^ A##44; \
+	uint64_t d0 = c4 ^ ROL64(c1, 1); \
+	uint64_t d1 = c0 ^ ROL64(c2, 1); \
+	uint64_t d2 = c1 ^ ROL64(c3, 1); \
+	uint64_t d3 = c2 ^ ROL64(c4, 1); \
+	uint64_t d4 = c3 ^ ROL64(c0, 1); \
+	uint64_t b0, b1, b2, b3, b4, t; \
+	b0 = A##00 ^ d0; b1 = ROL64(A##11 ^ d1, 44); b2 = ROL64(A##22 ^ d2, 43); \
+	b3 = ROL64(A##33 ^ d3, 21); b4 = ROL64(A##44 ^ d4, 14); \
+	t = ~b2; E##00 = b0 ^ (b1 | b2) ^ rc; E##10 = b1 ^ (t | b3); \
+	E##20 = b2 ^ (b3 & b4); E##30 = b3 ^ (b4 | b0); E##40 = b4 ^ (b0 & b1); \
+	b0 = ROL64(A##30 ^ d3, 28); b1 = ROL64(A##41 ^ d4, 20); b2 = ROL64(A##02 ^ d0, 3); \
+	b3 = ROL64(A##13 ^ d1, 45); b4 = ROL64(A##24 ^ d2, 61); \
+	t = ~b4; E##01 = b0 ^ (b1 | b2); E##11 = b1 ^ (b2 & b3); \
+	E##21 = b2 ^ (b3 | t); E##31 = b3 ^ (b4 | b0); E##41 = b4 ^ (b0 & b1); \
+	b0 = ROL64(A##10 ^ d1, 1); b1 = ROL64(A##21 ^ d2, 6); b2 = ROL64(A##32 ^ d3, 25); \
+	b3 = ROL64(A##43 ^ d4, 8); b4 = ROL64(A##04 ^ d0, 18); \
+	t = ~b3; E##02 = b0 ^ (b1 | b2); E##12 = b1 ^ (b2 & b3); \
+	E##22 = b2 ^ (t & b4); E##32 = t ^ (b4 | b0); E##42 = b4 ^ (b0 & b1); \
+	b0 = ROL64(A##40 ^ d4, 27); b1 = ROL64(A##01 ^ d0, 36); b2 = ROL64(A##12 ^ d1, 10); \
+	b3 = ROL64(A##23 ^ d2, 15); b4 = ROL64(A##34 ^ d3, 56); \
+	t = ~b3; E##03 = b0 ^ (b1 & b2); E##13 = b1 ^ (b2 | b3); \
+	E##23 = b2 ^ (t | b4); E##33 = t ^ (b4 & b0); E##43 = b4 ^ (b0 | b1); \
+	b0 = ROL64(A##20 ^ d2, 62); b1 = ROL64(A##31 ^ d3, 55); b2 = ROL64(A##42 ^ d4, 39); \
+	b3 = ROL64(A##03 ^ d0, 41); b4 = ROL64(A##14 ^ d1, 2); \
+	t = ~b1; E##04 = b0 ^ (t & b2); E##14 = t ^ (b2 | b3); \
+	E##24 = b2 ^ (b3 & b4); E##34 = b3 ^ (b4 | b0); E##44 = b4 ^ (b0 & b1); \
+}
+
+#define KF_FOR(M, A) \
+	M(A##00, 0) M(A##10, 1) M(A##20, 2) M(A##30, 3) M(A##40, 4) \
+	M(A##01, 5) M(A##11, 6) M(A##21, 7) M(A##31, 8) M(A##41, 9) \
+	M(A##02, 10) M(A##12, 11) M(A##22, 12) M(A##32, 13) M(A##42, 14) \
+	M(A##03, 15) M(A##13, 16) M(A##23, 17) M(A##33, 18) M(A##43, 19) \
+	M(A##04, 20) M(A##14, 21) M(A##24, 22) M(A##34, 23) M(A##44, 24)
+
+#define KF_DECLV(v, i)  KT v;
+#define KF_LOADV(v, i)  v = KLOAD(i);
+#define KF_STOREV(v, i) KSTORE(i, v);
+
+#define KF_PERMUTE(ROUND, nr) { \
+	KF_FOR(KF_DECLV, a) \
+	KF_FOR(KF_DECLV, e) \
+	int r; \
+	KF_FOR(KF_LOADV, a) \
+	for (r = 0; r + 2 <= (nr); r += 2) { \
+		ROUND(a, e, keccak_rc[r]); \
+		ROUND(e, a, keccak_rc[r + 1]); \
+	} \
+	if (r < (nr)) { \
+		ROUND(a, e, keccak_rc[r]); \
+		KF_FOR(KF_STOREV, e) \
+	} else { \
+		KF_FOR(KF_STOREV, a) \
+	} \
+}
+
+/* scalar */
+
+#define KT uint64_t
+#define KPAR(a, b, c, d, e) ((a) ^ (b) ^ (c) ^ (d) ^ (e))
+#define KXOR(a, b)   ((a) ^ (b))
+#define KROL(a, n)   ROL64(a, n)
+#define KCHI(a, b, c) ((a) ^ (~(b) & (c)))
+#define KIOTA(a, rc) ((a) ^ (rc))
+#define KLOAD(i)     st[i]
+#define KSTORE(i, v) st[i] = v
+
+void keccakf1600(uint64_t *st, int rounds)
+{
+	KF_PERMUTE(KF_ROUND, rounds);
+}
+
+void keccakf1600_lc(uint64_t *st)
+{
+	KF_PERMUTE(KF_ROUND_LC, 24);
+}
+
+/* wild keccak, the parity of the column is a0 ^ a1 ^ (a2 * a3 * a4) */
+#undef KPAR
+#define KPAR(a, b, c, d, e) ((a) ^ (b) ^ ((c) * (d) * (e)))
+
+void keccakf1600_wild(uint64_t *st)
+{
+	KF_FOR(KF_DECLV, a)
+	KF_FOR(KF_DECLV, e)
+	KF_FOR(KF_LOADV, a)
+	KF_ROUND(a, e, keccak_rc[0]);
+	KF_FOR(KF_STOREV, e)
+}
+
+#undef KT
+#undef KPAR
+#undef KXOR
+#undef KROL
+#undef KCHI
+#undef KIOTA
+#undef KLOAD
+#undef KSTORE
+
+#ifdef KECCAK_X86
+
+/* 4 states, word i of the state j in st[4 * i + j] */
+
+#define KT __m256i
+#define KPAR(a, b, c, d, e) _mm256_xor_si256(_mm256_xor_si256(_mm256_xor_si256(a, b), _mm256_xor_si256(c, d)), e)
+#define KXOR(a, b)   _mm256_xor_si256(a, b)
+#define KROL(a, n)   _mm256_or_si256(_mm256_slli_epi64(a, n), _mm256_srli_epi64(a, 64 - (n)))
+#define KCHI(a, b, c) _mm256_xor_si256(a, _mm256_andnot_si256(b, c))
+#define KIOTA(a, rc) _mm256_xor_si256(a, _mm256_set1_epi64x((long long) (rc)))
+#define KLOAD(i)     _mm256_loadu_si256((const __m256i*) &st[4 * (i)])
+#define KSTORE(i, v) _mm256_storeu_si256((__m256i*) &st[4 * (i)], v)
+
+K_TARGET("avx2")
+static void kf_x4_avx2(uint64_t *st)
+{
+	KF_PERMUTE(KF_ROUND, 24);
+}
+
+#undef KT
+#undef KPAR
+#undef KXOR
+#undef KROL
+#undef KCHI
+#undef KIOTA
+#undef KLOAD
+#undef KSTORE
+
+/* 8 states, the column parity and chi are single ternary logic ops */
+
+#define KT __m512i
+#define KPAR(a, b, c, d, e) _mm512_ternarylogic_epi64(_mm512_ternarylogic_epi64(a, b, c, 0x96), d, e, 0x96)
+#define KXOR(a, b)   _mm512_xor_si512(a, b)
+#define KROL(a, n)   _mm512_rol_epi64(a, n)
+#define KCHI(a, b, c) _mm512_ternarylogic_epi64(a, b, c, 0xD2)
+#define KIOTA(a, rc) _mm512_xor_si512(a, _mm512_set1_epi64((long long) (rc)))
+#define KLOAD(i)     _mm512_loadu_si512((const void*) &st[8 * (i)])
+#define KSTORE(i, v) _mm512_storeu_si512((void*) &st[8 * (i)], v)
+
+K_TARGET("avx512f")
+static void kf_x8_avx512(uint64_t *st)
+{
+	KF_PERMUTE(KF_ROUND, 24);
+}
+
+#undef KT
+#undef KPAR
+#undef KXOR
+#undef KROL
+#undef KCHI
+#undef KIOTA
+#undef KLOAD
+#undef KSTORE
+
+#endif /* KECCAK_X86 */
+
+/* runtime selection */
+
+static volatile int k_level = -1;
+
+static int keccak_cpu_level(void)
+{
+#if defined(KECCAK_X86) && (defined(__GNUC__) || defined(__clang__))
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return 2;
+	if (__builtin_cpu_supports("avx2"))
+		return 1;
+#elif defined(KECCAK_X86) && defined(_MSC_VER)
+	int r[4];
+	int level = 0;
+	__cpuid(r, 1);
+	// avx with the ymm (and zmm) registers saved by the os
+	if ((r[2] & (1 << 27)) && (r[2] & (1 << 28))) {
+		uint64_t xcr0 = _xgetbv(0);
+		__cpuidex(r, 7, 0);
+		if ((xcr0 & 6) == 6 && (r[1] & (1 << 5)))
+			level = 1;
+		if ((xcr0 & 0xe6) == 0xe6 && (r[1] & (1 << 16)))
+			level = 2;
+	}
+	return level;
+#endif
+	return 0;
+}
+
+int keccak_simd_level(void)
+{
+	if (k_level < 0)
+		k_level = keccak_cpu_level();
+	return k_level;
+}
+
+/* the lanes one by one, for the cpus without the wide vectors */
+static void kf_lanes_ref(uint64_t *st, int n)
+{
+	uint64_t s[25];
+	for (int j = 0; j < n; j++) {
+		for (int i = 0; i < 25; i++)
+			s[i] = st[n * i + j];
+		keccakf1600(s, 24);
+		for (int i = 0; i < 25; i++)
+			st[n * i + j] = s[i];
+	}
+}
+
+void keccakf1600_x4(uint64_t *st)
+{
+#ifdef KECCAK_X86
+	if (keccak_simd_level() >= 1) {
+		kf_x4_avx2(st);
+		return;
+	}
+#endif
+	kf_lanes_ref(st, 4);
+}
+
+void keccakf1600_x8(uint64_t *st)
+{
+#ifdef KECCAK_X86
+	if (keccak_simd_level() >= 2) {
+		kf_x8_avx512(st);
+		return;
+	}
+#endif
+	kf_lanes_ref(st, 8);
+}
+
+/* sponge, the rate (200 - 2 * outlen) must be whole words: keccak-224,
+ * 256, 384 and 512 */
+
+void keccak_simd(void *out, size_t outlen, const void *in, size_t inlen)
+{
+	const uint8_t *p = (const uint8_t*) in;
+	const size_t rate = 200 - 2 * outlen;
+	uint64_t st[25] = { 0 };
+	uint8_t block[200];
+
+	for (; inlen >= rate; inlen -= rate, p += rate) {
+		for (size_t i = 0; i < rate / 8; i++)
+			st[i] ^= le64_get(&p[8 * i]);
+		keccakf1600(st, 24);
+	}
+	memset(block, 0, rate);
+	memcpy(block, p, inlen);
+	block[inlen] = 0x01;
+	block[rate - 1] |= 0x80;
+	for (size_t i = 0; i < rate / 8; i++)
+		st[i] ^= le64_get(&block[8 * i]);
+	keccakf1600(st, 24);
+
+	// the last word can be partial (keccak-224)
+	for (size_t i = 0; i < (outlen + 7) / 8; i++)
+		le64_put(&block[8 * i], st[i]);
+	memcpy(out, block, outlen);
+}
+
+int keccak256_hash_n(void *out, const void *data, size_t len, size_t nonce_off,
+	const uint32_t *nonces, int count)
+{
+	const size_t rate = 136;
+	uint8_t *o = (uint8_t*) out;
+	uint8_t block[136];
+	uint64_t m[17];
+	uint64_t st[25 * 8];
+	int w = (int) (nonce_off / 8), shift = (int) (nonce_off % 8) * 8;
+
+	if (len >= rate || nonce_off % 4 || nonce_off + 4 > len)
+		return -1;
+
+	memset(block, 0, rate);
+	memcpy(block, data, len);
+	block[len] = 0x01;
+	block[rate - 1] |= 0x80;
+	memset(&block[nonce_off], 0, 4);
+	for (int i = 0; i < 17; i++)
+		m[i] = le64_get(&block[8 * i]);
+
+	while (count > 0) {
+		// widest batch available, the last lanes of a partial one are unused
+		int n = keccak_simd_level() >= 2 && count > 4 ? 8 : keccak_simd_level() >= 1 && count > 1 ? 4 : 1;
+		for (int i = 0; i < 25; i++)
+			for (int j = 0; j < n; j++)
+				st[n * i + j] = i < 17 ? m[i] : 0;
+		for (int j = 0; j < n && j < count; j++)
+			st[n * w + j] |= (uint64_t) nonces[j] << shift;
+		if (n == 8) keccakf1600_x8(st);
+		else if (n == 4) keccakf1600_x4(st);
+		else keccakf1600(st, 24);
+		for (int j = 0; j < n && j < count; j++, o += 32)
+			for (int i = 0; i < 4; i++)
+				le64_put(&o[8 * i], st[n * i + j]);
+		nonces += n;
+		count -= n;
+	}
+	return 0;
+}
@@ -0,0 +1,43 @@
+#ifndef KECCAK_SIMD_H
+#define KECCAK_SIMD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if (__cplusplus)
+extern "C" {
+#endif
+
+/* 0: scalar, 1: AVX2, 2: AVX-512F, selected on the first call */
+int keccak_simd_level(void);
+
+/* keccak-f[1600], only the first rounds if less than 24 */
+void keccakf1600(uint64_t *st, int rounds);
+
+/* same, on a state with the lanes 1, 2, 8, 12, 17 and 20 complemented (sph_keccak) */
+void keccakf1600_lc(uint64_t *st);
+
+/* 4 or 8 interleaved states, word i of the state j is st[4 * i + j] (st[8 * i + j]) */
+void keccakf1600_x4(uint64_t *st);
+void keccakf1600_x8(uint64_t *st);
+
+/* one round of wild keccak, the column parity multiplies its last three words */
+void keccakf1600_wild(uint64_t *st);
+
+/* keccak (0x01 padding) with a rate of 200 - 2 * outlen, outlen up to 64 */
+void keccak_simd(void *out, size_t outlen, const void *in, size_t inlen);
+
+/**
+ * Keccak-256 of single block inputs (len < 136) which only differ by the
+ * 32-bit little endian nonce at nonce_off, 8 or 4 nonces at once with the
+ * wide vectors. The outputs are 32 bytes apart, returns -1 if the input
+ * does not fit.
+ */
+int keccak256_hash_n(void *out, const void *data, size_t len, size_t nonce_off,
+	const uint32_t *nonces, int count);
+
+#if (__cplusplus)
+}
+#endif
+
+#endif
@@ -34,6 +34,7 @@
 #include <string.h>
 
 #include "sph_keccak.h"
+#include "keccak-simd.h"
 
 #ifdef __cplusplus
 extern "C"{
@@ -133,6 +134,8 @@ extern "C"{
 
 #if SPH_KECCAK_64
 
+#if !SPH_KECCAK_NOCOPY
+/* the NOCOPY permutation is keccakf1600_lc(), with its own constants */
 static const sph_u64 RC[] = {
 	SPH_C64(0x0000000000000001), SPH_C64(0x0000000000008082),
 	SPH_C64(0x800000000000808A), SPH_C64(0x8000000080008000),
@@ -147,6 +150,7 @@ static const sph_u64 RC[] = {
 	SPH_C64(0x8000000080008081), SPH_C64(0x8000000000008080),
 	SPH_C64(0x0000000080000001), SPH_C64(0x8000000080008008)
 };
+#endif
 
 #if SPH_KECCAK_NOCOPY
 
@@ -1522,6 +1526,12 @@ static const struct {
 
 #endif
 
+#if SPH_KECCAK_64 && SPH_KECCAK_NOCOPY
+/* the shared lane complemented permutation, same state layout */
+#undef KECCAK_F_1600
+#define KECCAK_F_1600   keccakf1600_lc((uint64_t*) kc->u.wide)
+#endif
+
 static void
 keccak_init(sph_keccak_context *kc, unsigned out_size)
 {
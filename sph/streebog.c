@@ -546,441 +546,265 @@ static const sph_u64 TG[8][256] = {{
 	0x717E7067AF4F499A,0x938290A9ECD1DBB3,0x88E3B293344DD172,0x2734158C250FA3D6
 }};
 
-// Constant values for KeySchedule function
-const unsigned char C[12][64] = {{
-	0xB1,0x08,0x5B,0xDA,0x1E,0xCA,0xDA,0xE9,0xEB,0xCB,0x2F,0x81,0xC0,0x65,0x7C,0x1F,
-	0x2F,0x6A,0x76,0x43,0x2E,0x45,0xD0,0x16,0x71,0x4E,0xB8,0x8D,0x75,0x85,0xC4,0xFC,
-	0x4B,0x7C,0xE0,0x91,0x92,0x67,0x69,0x01,0xA2,0x42,0x2A,0x08,0xA4,0x60,0xD3,0x15,
-	0x05,0x76,0x74,0x36,0xCC,0x74,0x4D,0x23,0xDD,0x80,0x65,0x59,0xF2,0xA6,0x45,0x07
+// Constant values for KeySchedule function, as little endian words
+static const sph_u64 CC[12][8] = {{
+	0xE9DACA1EDA5B08B1, 0x1F7C65C0812FCBEB, 0x16D0452E43766A2F, 0xFCC485758DB84E71,
+	0x0169679291E07C4B, 0x15D360A4082A42A2, 0x234D74CC36747605, 0x0745A6F2596580DD
 },{
-	0x6F,0xA3,0xB5,0x8A,0xA9,0x9D,0x2F,0x1A,0x4F,0xE3,0x9D,0x46,0x0F,0x70,0xB5,0xD7,
-	0xF3,0xFE,0xEA,0x72,0x0A,0x23,0x2B,0x98,0x61,0xD5,0x5E,0x0F,0x16,0xB5,0x01,0x31,
-	0x9A,0xB5,0x17,0x6B,0x12,0xD6,0x99,0x58,0x5C,0xB5,0x61,0xC2,0xDB,0x0A,0xA7,0xCA,
-	0x55,0xDD,0xA2,0x1B,0xD7,0xCB,0xCD,0x56,0xE6,0x79,0x04,0x70,0x21,0xB1,0x9B,0xB7
+	0x1A2F9DA98AB5A36F, 0xD7B5700F469DE34F, 0x982B230A72EAFEF3, 0x3101B5160F5ED561,
+	0x5899D6126B17B59A, 0xCAA70ADBC261B55C, 0x56CDCBD71BA2DD55, 0xB79BB121700479E6
 },{
-	0xF5,0x74,0xDC,0xAC,0x2B,0xCE,0x2F,0xC7,0x0A,0x39,0xFC,0x28,0x6A,0x3D,0x84,0x35,
-	0x06,0xF1,0x5E,0x5F,0x52,0x9C,0x1F,0x8B,0xF2,0xEA,0x75,0x14,0xB1,0x29,0x7B,0x7B,
-	0xD3,0xE2,0x0F,0xE4,0x90,0x35,0x9E,0xB1,0xC1,0xC9,0x3A,0x37,0x60,0x62,0xDB,0x09,
-	0xC2,0xB6,0xF4,0x43,0x86,0x7A,0xDB,0x31,0x99,0x1E,0x96,0xF5,0x0A,0xBA,0x0A,0xB2
+	0xC72FCE2BACDC74F5, 0x35843D6A28FC390A, 0x8B1F9C525F5EF106, 0x7B7B29B11475EAF2,
+	0xB19E3590E40FE2D3, 0x09DB6260373AC9C1, 0x31DB7A8643F4B6C2, 0xB20ABA0AF5961E99
 },{
-	0xEF,0x1F,0xDF,0xB3,0xE8,0x15,0x66,0xD2,0xF9,0x48,0xE1,0xA0,0x5D,0x71,0xE4,0xDD,
-	0x48,0x8E,0x85,0x7E,0x33,0x5C,0x3C,0x7D,0x9D,0x72,0x1C,0xAD,0x68,0x5E,0x35,0x3F,
-	0xA9,0xD7,0x2C,0x82,0xED,0x03,0xD6,0x75,0xD8,0xB7,0x13,0x33,0x93,0x52,0x03,0xBE,
-	0x34,0x53,0xEA,0xA1,0x93,0xE8,0x37,0xF1,0x22,0x0C,0xBE,0xBC,0x84,0xE3,0xD1,0x2E
+	0xD26615E8B3DF1FEF, 0xDDE4715DA0E148F9, 0x7D3C5C337E858E48, 0x3F355E68AD1C729D,
+	0x75D603ED822CD7A9, 0xBE0352933313B7D8, 0xF137E893A1EA5334, 0x2ED1E384BCBE0C22
 },{
-	0x4B,0xEA,0x6B,0xAC,0xAD,0x47,0x47,0x99,0x9A,0x3F,0x41,0x0C,0x6C,0xA9,0x23,0x63,
-	0x7F,0x15,0x1C,0x1F,0x16,0x86,0x10,0x4A,0x35,0x9E,0x35,0xD7,0x80,0x0F,0xFF,0xBD,
-	0xBF,0xCD,0x17,0x47,0x25,0x3A,0xF5,0xA3,0xDF,0xFF,0x00,0xB7,0x23,0x27,0x1A,0x16,
-	0x7A,0x56,0xA2,0x7E,0xA9,0xEA,0x63,0xF5,0x60,0x17,0x58,0xFD,0x7C,0x6C,0xFE,0x57
+	0x994747ADAC6BEA4B, 0x6323A96C0C413F9A, 0x4A1086161F1C157F, 0xBDFF0F80D7359E35,
+	0xA3F53A254717CDBF, 0x161A2723B700FFDF, 0xF563EAA97EA2567A, 0x57FE6C7CFD581760
 },{
-	0xAE,0x4F,0xAE,0xAE,0x1D,0x3A,0xD3,0xD9,0x6F,0xA4,0xC3,0x3B,0x7A,0x30,0x39,0xC0,
-	0x2D,0x66,0xC4,0xF9,0x51,0x42,0xA4,0x6C,0x18,0x7F,0x9A,0xB4,0x9A,0xF0,0x8E,0xC6,
-	0xCF,0xFA,0xA6,0xB7,0x1C,0x9A,0xB7,0xB4,0x0A,0xF2,0x1F,0x66,0xC2,0xBE,0xC6,0xB6,
-	0xBF,0x71,0xC5,0x72,0x36,0x90,0x4F,0x35,0xFA,0x68,0x40,0x7A,0x46,0x64,0x7D,0x6E
+	0xD9D33A1DAEAE4FAE, 0xC039307A3BC3A46F, 0x6CA44251F9C4662D, 0xC68EF09AB49A7F18,
+	0xB4B79A1CB7A6FACF, 0xB6C6BEC2661FF20A, 0x354F903672C571BF, 0x6E7D64467A4068FA
 },{
-	0xF4,0xC7,0x0E,0x16,0xEE,0xAA,0xC5,0xEC,0x51,0xAC,0x86,0xFE,0xBF,0x24,0x09,0x54,
-	0x39,0x9E,0xC6,0xC7,0xE6,0xBF,0x87,0xC9,0xD3,0x47,0x3E,0x33,0x19,0x7A,0x93,0xC9,
-	0x09,0x92,0xAB,0xC5,0x2D,0x82,0x2C,0x37,0x06,0x47,0x69,0x83,0x28,0x4A,0x05,0x04,
-	0x35,0x17,0x45,0x4C,0xA2,0x3C,0x4A,0xF3,0x88,0x86,0x56,0x4D,0x3A,0x14,0xD4,0x93
+	0xECC5AAEE160EC7F4, 0x540924BFFE86AC51, 0xC987BFE6C7C69E39, 0xC9937A19333E47D3,
+	0x372C822DC5AB9209, 0x04054A2883694706, 0xF34A3CA24C451735, 0x93D4143A4D568688
 },{
-	0x9B,0x1F,0x5B,0x42,0x4D,0x93,0xC9,0xA7,0x03,0xE7,0xAA,0x02,0x0C,0x6E,0x41,0x41,
-	0x4E,0xB7,0xF8,0x71,0x9C,0x36,0xDE,0x1E,0x89,0xB4,0x44,0x3B,0x4D,0xDB,0xC4,0x9A,
-	0xF4,0x89,0x2B,0xCB,0x92,0x9B,0x06,0x90,0x69,0xD1,0x8D,0x2B,0xD1,0xA5,0xC4,0x2F,
-	0x36,0xAC,0xC2,0x35,0x59,0x51,0xA8,0xD9,0xA4,0x7F,0x0D,0xD4,0xBF,0x02,0xE7,0x1E
+	0xA7C9934D425B1F9B, 0x41416E0C02AAE703, 0x1EDE369C71F8B74E, 0x9AC4DB4D3B44B489,
+	0x90069B92CB2B89F4, 0x2FC4A5D12B8DD169, 0xD9A8515935C2AC36, 0x1EE702BFD40D7FA4
 },{
-	0x37,0x8F,0x5A,0x54,0x16,0x31,0x22,0x9B,0x94,0x4C,0x9A,0xD8,0xEC,0x16,0x5F,0xDE,
-	0x3A,0x7D,0x3A,0x1B,0x25,0x89,0x42,0x24,0x3C,0xD9,0x55,0xB7,0xE0,0x0D,0x09,0x84,
-	0x80,0x0A,0x44,0x0B,0xDB,0xB2,0xCE,0xB1,0x7B,0x2B,0x8A,0x9A,0xA6,0x07,0x9C,0x54,
-	0x0E,0x38,0xDC,0x92,0xCB,0x1F,0x2A,0x60,0x72,0x61,0x44,0x51,0x83,0x23,0x5A,0xDB
+	0x9B223116545A8F37, 0xDE5F16ECD89A4C94, 0x244289251B3A7D3A, 0x84090DE0B755D93C,
+	0xB1CEB2DB0B440A80, 0x549C07A69A8A2B7B, 0x602A1FCB92DC380E, 0xDB5A238351446172
 },{
-	0xAB,0xBE,0xDE,0xA6,0x80,0x05,0x6F,0x52,0x38,0x2A,0xE5,0x48,0xB2,0xE4,0xF3,0xF3,
-	0x89,0x41,0xE7,0x1C,0xFF,0x8A,0x78,0xDB,0x1F,0xFF,0xE1,0x8A,0x1B,0x33,0x61,0x03,
-	0x9F,0xE7,0x67,0x02,0xAF,0x69,0x33,0x4B,0x7A,0x1E,0x6C,0x30,0x3B,0x76,0x52,0xF4,
-	0x36,0x98,0xFA,0xD1,0x15,0x3B,0xB6,0xC3,0x74,0xB4,0xC7,0xFB,0x98,0x45,0x9C,0xED
+	0x526F0580A6DEBEAB, 0xF3F3E4B248E52A38, 0xDB788AFF1CE74189, 0x0361331B8AE1FF1F,
+	0x4B3369AF0267E79F, 0xF452763B306C1E7A, 0xC3B63B15D1FA9836, 0xED9C4598FBC7B474
 },{
-	0x7B,0xCD,0x9E,0xD0,0xEF,0xC8,0x89,0xFB,0x30,0x02,0xC6,0xCD,0x63,0x5A,0xFE,0x94,
-	0xD8,0xFA,0x6B,0xBB,0xEB,0xAB,0x07,0x61,0x20,0x01,0x80,0x21,0x14,0x84,0x66,0x79,
-	0x8A,0x1D,0x71,0xEF,0xEA,0x48,0xB9,0xCA,0xEF,0xBA,0xCD,0x1D,0x7D,0x47,0x6E,0x98,
-	0xDE,0xA2,0x59,0x4A,0xC0,0x6F,0xD8,0x5D,0x6B,0xCA,0xA4,0xCD,0x81,0xF3,0x2D,0x1B
+	0xFB89C8EFD09ECD7B, 0x94FE5A63CDC60230, 0x6107ABEBBB6BFAD8, 0x7966841421800120,
+	0xCAB948EAEF711D8A, 0x986E477D1DCDBAEF, 0x5DD86FC04A59A2DE, 0x1B2DF381CDA4CA6B
 },{
-	0x37,0x8E,0xE7,0x67,0xF1,0x16,0x31,0xBA,0xD2,0x13,0x80,0xB0,0x04,0x49,0xB1,0x7A,
-	0xCD,0xA4,0x3C,0x32,0xBC,0xDF,0x1D,0x77,0xF8,0x20,0x12,0xD4,0x30,0x21,0x9F,0x9B,
-	0x5D,0x80,0xEF,0x9D,0x18,0x91,0xCC,0x86,0xE7,0x1D,0xA4,0xAA,0x88,0xE1,0x28,0x52,
-	0xFA,0xF4,0x17,0xD5,0xD9,0xB2,0x1B,0x99,0x48,0xBC,0x92,0x4A,0xF1,0x1B,0xD7,0x20
+	0xBA3116F167E78E37, 0x7AB14904B08013D2, 0x771DDFBC323CA4CD, 0x9B9F2130D41220F8,
+	0x86CC91189DEF805D, 0x5228E188AAA41DE7, 0x991BB2D9D517F4FA, 0x20D71BF14A92BC48
 }};
 
+// Key schedules of the first block, from the zero N and the 512 or 256 bits IV
+static const sph_u64 KZ512[13][8] = {{
+	0x74A5D4CE2EFC83B3, 0x74A5D4CE2EFC83B3, 0x74A5D4CE2EFC83B3, 0x74A5D4CE2EFC83B3,
+	0x74A5D4CE2EFC83B3, 0x74A5D4CE2EFC83B3, 0x74A5D4CE2EFC83B3, 0x74A5D4CE2EFC83B3
+},{
+	0x8FD72F640708B0D0, 0x0DE874C7EBC3F213, 0xE92EEF3AD202E9E0, 0xC1E9DA0708013DA7,
+	0x9727DAB2F014BE88, 0x103051A02BCD6935, 0x33EC7E1DBD28F736, 0x1ECF460CF78AD1F4
+},{
+	0x0B2D9F89C775449D, 0x6B6EEFC6DAB7E8B0, 0xF1A0D31667F6EC44, 0x2A71132D5E108166,
+	0x0E9357C2EC87931A, 0xC99F5C1B4A01612D, 0x7E60B16E637D4EE2, 0xA9FCB827F9BA6D81
+},{
+	0x231FECA5AB3D285C, 0x70C6E1483C838C3B, 0x9C21C3C40CE4E2DA, 0x2FA796BD5688E573,
+	0x04C0E3FF55809FDF, 0x5FF978BFB8E3CDC8, 0xC54A19D6A3D07033, 0x0FCA83FDDE872478
+},{
+	0xBDF9312726339F10, 0x51A5BA1793BC9C56, 0xC4428DA14F96D2D4, 0xEC925222374EAB1F,
+	0x79477893747DD92F, 0xC495E19A46886304, 0x9C23F893BA7CFA36, 0x0C47268881FC5FEB
+},{
+	0xCF117966029B2CB3, 0x07179ABE77088A8F, 0x671EF4CC2650E257, 0x7474B8B170DAB5C6,
+	0x4224FEBECF35113E, 0x993D156C675C5537, 0x2DEE3A5782C39B45, 0xE7C586F2990DD385
+},{
+	0x8608FD95B1C1138A, 0x8BB0847D9E9849AC, 0x5E76623F4F0EB0C7, 0x34C2BDBAFC5060CE,
+	0xE9E814475907826C, 0x22C9ED94D6AAC7C9, 0xE6B75E28171EB0D6, 0xF1329E5534E60215
+},{
+	0x86BB4814B1C3CE52, 0xE8F226C9FBDDD017, 0xCEDED67991CB3087, 0x76C33E32FDBFACA5,
+	0xDBB13BE1A9F7474C, 0x3D0273470342C356, 0x8E7246C51CF07F61, 0xAC8C125DDEF8DF71
+},{
+	0x6D73E747795B8CF3, 0x4E4AA65EA0072050, 0xA14A1582CB43C2B9, 0x748EF2B7BB63B938,
+	0x126789534410D7D4, 0xD4D48FF40301D791, 0xC67DFBE315C41FC0, 0x35E7A1A1AF88601C
+},{
+	0x9BD33EA0FAB34007, 0xF51B7CDBE3D67D25, 0xD3ABDA0CE4186E6B, 0x8E61DDADCBCE1706,
+	0x58994565B41BE6A5, 0x7A87ABC1240CD31D, 0xFAFE6C28487968D0, 0x15B368609FF9EEA7
+},{
+	0xAE33263CCF115818, 0x93B2DBE9CADFCFC8, 0x0A91952BF91B0147, 0x458E67CA5F1ED73A,
+	0x94C2E5F288F074E3, 0x377895E85C69E996, 0xF11A4456AAB37B10, 0x163131934816821A
+},{
+	0xD07E4A2366BF469D, 0x5EF1A3D220213B6C, 0x3C5BB78971D8ED0F, 0x0DE05E6B9006F2D2,
+	0xC58CFB00B8EAA1C9, 0xEFCDB54D1F250B76, 0xFD135634FA527042, 0x4CEE791290516407
+},{
+	0xD800B9264010790F, 0x974C4823E2B668D7, 0xA605A4B385C5E361, 0x3F6C92DA5A56D8D2,
+	0x82B9D67C12EF8277, 0x0AB6B4582561BF90, 0x46954FD98FC2CBA3, 0x70BE45CB21B6760D
+}};
 
-static void AddModulo512(const void *a,const void *b,void *c)
-{
-	const unsigned char *A=a, *B=b;
-	unsigned char *C=c;
-	int t = 0;
-#ifdef FULL_UNROLL
-#define ADDBYTE_8(i) t = A[i] + B[i] + (t >> 8); C[i] = t & 0xFF;
-
-	ADDBYTE_8(63)
-	ADDBYTE_8(62)
-	ADDBYTE_8(61)
-	ADDBYTE_8(60)
-	ADDBYTE_8(59)
-	ADDBYTE_8(58)
-	ADDBYTE_8(57)
-	ADDBYTE_8(56)
-	ADDBYTE_8(55)
-	ADDBYTE_8(54)
-	ADDBYTE_8(53)
-	ADDBYTE_8(52)
-	ADDBYTE_8(51)
-	ADDBYTE_8(50)
-	ADDBYTE_8(49)
-	ADDBYTE_8(48)
-	ADDBYTE_8(47)
-	ADDBYTE_8(46)
-	ADDBYTE_8(45)
-	ADDBYTE_8(44)
-	ADDBYTE_8(43)
-	ADDBYTE_8(42)
-	ADDBYTE_8(41)
-	ADDBYTE_8(40)
-	ADDBYTE_8(39)
-	ADDBYTE_8(38)
-	ADDBYTE_8(37)
-	ADDBYTE_8(36)
-	ADDBYTE_8(35)
-	ADDBYTE_8(34)
-	ADDBYTE_8(33)
-	ADDBYTE_8(32)
-	ADDBYTE_8(31)
-	ADDBYTE_8(30)
-	ADDBYTE_8(29)
-	ADDBYTE_8(28)
-	ADDBYTE_8(27)
-	ADDBYTE_8(26)
-	ADDBYTE_8(25)
-	ADDBYTE_8(24)
-	ADDBYTE_8(23)
-	ADDBYTE_8(22)
-	ADDBYTE_8(21)
-	ADDBYTE_8(20)
-	ADDBYTE_8(19)
-	ADDBYTE_8(18)
-	ADDBYTE_8(17)
-	ADDBYTE_8(16)
-	ADDBYTE_8(15)
-	ADDBYTE_8(14)
-	ADDBYTE_8(13)
-	ADDBYTE_8(12)
-	ADDBYTE_8(11)
-	ADDBYTE_8(10)
-	ADDBYTE_8(9)
-	ADDBYTE_8(8)
-	ADDBYTE_8(7)
-	ADDBYTE_8(6)
-	ADDBYTE_8(5)
-	ADDBYTE_8(4)
-	ADDBYTE_8(3)
-	ADDBYTE_8(2)
-	ADDBYTE_8(1)
-	ADDBYTE_8(0)
-
-#else
-	int i = 0;
+static const sph_u64 KZ256[13][8] = {{
+	0x155F7BB040EEC523, 0x155F7BB040EEC523, 0x155F7BB040EEC523, 0x155F7BB040EEC523,
+	0x155F7BB040EEC523, 0x155F7BB040EEC523, 0x155F7BB040EEC523, 0x155F7BB040EEC523
+},{
+	0xEAEBB276318FEE18, 0xEA4C693382CBD63B, 0xBF26BE88DF699734, 0x49A504A9B6FA1C45,
+	0xB1666AA693DE22DA, 0x113563EA5E6B7E9C, 0xCDBF01848CD611E6, 0xB95E4A9DC30C7D0C
+},{
+	0x919565A231CFA4AA, 0x46FDE791CEC8AE57, 0xE3C56411E2DE27BF, 0x1F9D9E511ABA0B94,
+	0x57773E25F11309CE, 0x2CE14B67CD005091, 0x00FB26BA738EF6C7, 0x2D5F800141AF74FD
+},{
+	0xF57A17CC650AFE61, 0x26D3DEADAFE23502, 0xF87B7436229A32A5, 0x85459CCAAE2842A5,
+	0x0D3A74DDA91E80CD, 0x330E2B60F01ED098, 0x56C16ADD5DFB6720, 0x8692832019310082
+},{
+	0x6F63D34F5F688399, 0xA826BF5FB7ABD51F, 0x3ECB2EAA144393E2, 0x4E7D6CC0863C69E4,
+	0x61E175AF40D59B16, 0xBA60D963CD6A540A, 0x69BF99C14C3995D5, 0x5A3DE79F30D5A599
+},{
+	0x25F0E72CAE7257F0, 0xFDB8C6BC7F9A6C15, 0x326E9413D635E7F1, 0xEAFF2028E5942992,
+	0x1A55B07E905D6162, 0x882060860A9970D1, 0xE2B0CD223CC898AF, 0x56A1F7C0137C29BE
+},{
+	0x4E6E5462C344D15A, 0xB7FB298868E7B346, 0x33741921C3E95374, 0xACB5E26B0E8D2B0B,
+	0x59F16751B3B69EC8, 0xA659593EA405B0B7, 0x98408EFC8CB1A951, 0x8DBBCF819B3DF0FC
+},{
+	0x8D0AA21B9AEC6C6A, 0x2B3534B940A84FB6, 0x2A1230D58E638C51, 0xC9DAEFB8E02F3383,
+	0xC709F5A9E5878201, 0x6F42D5DC6A746C8D, 0x3FB7DF9057ADA0B0, 0xAA6D0139A591F1C1
+},{
+	0xB3A97A7336702199, 0x51BD05F743668D8A, 0xC50F8F941F5351F3, 0xBDD89DEE5FA35FE3,
+	0x9C4E220A589D4CBB, 0xED49FC69200E2ED8, 0x38354437945F7D36, 0x0904DDF5A8B68F2B
+},{
+	0x1AFA89FCC0636790, 0xDA9D9EECD88892E6, 0xFEC3D6BFE830769A, 0xAFAE622E5DC303D7,
+	0x7F7A31A7805DB3F0, 0x916752F22230F876, 0x7B33CB8F67DF8FCA, 0xD205CB3C39E54FD7
+},{
+	0x648E61636C99CE88, 0x8533E43EE0C8A504, 0xBB9189E6EEE32A4E, 0x6EDBDA389DC2F3BF,
+	0xDF6DDCA6E9DAA1D6, 0xD3962F27AF34CE52, 0xE1E63F4C628C9C15, 0xD5AD89FC0B5C693D
+},{
+	0x0646BDA91E280A3E, 0x3A6F57000155EC3E, 0x579182CF68A16A50, 0x382FA3CAFC78B976,
+	0x45CA8299C7305FB5, 0x778479D865838E62, 0x2A119981C6495AE7, 0xDBF255760F5A7B1D
+},{
+	0xEB1AB39E4073B2F0, 0x22216718AEFB32E4, 0xF9926A2B4248C862, 0x838BD14EB5BA6C3F,
+	0xA33F1EC5FF1CB214, 0xDB6AEF763E43FF19, 0xA17F903CE0F5F90E, 0x03BF0065A0ECF9FC
+}};
 
-	for(i=63;i>=0;i--)
-	{
-		t = A[i] + B[i] + (t >> 8);
-		C[i] = t & 0xFF;
-	}
-#endif
+#define LPS_COL(T, w) do { \
+	sph_u64 t = (w); \
+	r0 ^= TG[T][t & 0xFF]; t >>= 8; \
+	r1 ^= TG[T][t & 0xFF]; t >>= 8; \
+	r2 ^= TG[T][t & 0xFF]; t >>= 8; \
+	r3 ^= TG[T][t & 0xFF]; t >>= 8; \
+	r4 ^= TG[T][t & 0xFF]; t >>= 8; \
+	r5 ^= TG[T][t & 0xFF]; t >>= 8; \
+	r6 ^= TG[T][t & 0xFF]; t >>= 8; \
+	r7 ^= TG[T][t]; \
+} while (0)
+
+// LPS transform of (a ^ b), the byte j of the words gives the word j
+static SPH_INLINE void F(sph_u64 *out, const sph_u64 *a, const sph_u64 *b)
+{
+	sph_u64 r0 = 0, r1 = 0, r2 = 0, r3 = 0, r4 = 0, r5 = 0, r6 = 0, r7 = 0;
+	LPS_COL(7, a[0] ^ b[0]);
+	LPS_COL(6, a[1] ^ b[1]);
+	LPS_COL(5, a[2] ^ b[2]);
+	LPS_COL(4, a[3] ^ b[3]);
+	LPS_COL(3, a[4] ^ b[4]);
+	LPS_COL(2, a[5] ^ b[5]);
+	LPS_COL(1, a[6] ^ b[6]);
+	LPS_COL(0, a[7] ^ b[7]);
+	out[0] = r0; out[1] = r1; out[2] = r2; out[3] = r3;
+	out[4] = r4; out[5] = r5; out[6] = r6; out[7] = r7;
 }
 
-static void AddXor512(const void *a,const void *b,void *c)
+// the 512-bit numbers are big endian, the byte 63 is the lowest one
+static void AddModulo512(sph_u64 *a, const sph_u64 *b)
 {
-	const unsigned long long *A=a, *B=b;
-	unsigned long long *C=c;
-#ifdef FULL_UNROLL
-	C[0] = A[0] ^ B[0];
-	C[1] = A[1] ^ B[1];
-	C[2] = A[2] ^ B[2];
-	C[3] = A[3] ^ B[3];
-	C[4] = A[4] ^ B[4];
-	C[5] = A[5] ^ B[5];
-	C[6] = A[6] ^ B[6];
-	C[7] = A[7] ^ B[7];
-#else
-	int i = 0;
-
-	for(i=0; i<8; i++) {
-		C[i] = A[i] ^ B[i];
+	sph_u64 carry = 0;
+	int i;
+	for (i = 7; i >= 0; i--) {
+		sph_u64 x = sph_bswap64(a[i]), y = sph_bswap64(b[i]);
+		sph_u64 t = SPH_T64(x + y);
+		sph_u64 c = t < x;
+		t = SPH_T64(t + carry);
+		carry = c | (t < carry);
+		a[i] = sph_bswap64(t);
 	}
-#endif
 }
 
-static void F(unsigned char *state)
+static void AddModulo512_64(sph_u64 *a, sph_u64 v)
 {
-	unsigned long long return_state[8];
-	register unsigned long long r = 0;
-	r ^= TG[0][state[56]];
-	r ^= TG[1][state[48]];
-	r ^= TG[2][state[40]];
-	r ^= TG[3][state[32]];
-	r ^= TG[4][state[24]];
-	r ^= TG[5][state[16]];
-	r ^= TG[6][state[8]];
-	r ^= TG[7][state[0]];
-	return_state[0] = r;
-	r = 0;
-
-	r ^= TG[0][state[57]];
-	r ^= TG[1][state[49]];
-	r ^= TG[2][state[41]];
-	r ^= TG[3][state[33]];
-	r ^= TG[4][state[25]];
-	r ^= TG[5][state[17]];
-	r ^= TG[6][state[9]];
-	r ^= TG[7][state[1]];
-	return_state[1] = r;
-	r = 0;
-
-	r ^= TG[0][state[58]];
-	r ^= TG[1][state[50]];
-	r ^= TG[2][state[42]];
-	r ^= TG[3][state[34]];
-	r ^= TG[4][state[26]];
-	r ^= TG[5][state[18]];
-	r ^= TG[6][state[10]];
-	r ^= TG[7][state[2]];
-	return_state[2] = r;
-	r = 0;
-
-	r ^= TG[0][state[59]];
-	r ^= TG[1][state[51]];
-	r ^= TG[2][state[43]];
-	r ^= TG[3][state[35]];
-	r ^= TG[4][state[27]];
-	r ^= TG[5][state[19]];
-	r ^= TG[6][state[11]];
-	r ^= TG[7][state[3]];
-	return_state[3] = r;
-	r = 0;
-
-	r ^= TG[0][state[60]];
-	r ^= TG[1][state[52]];
-	r ^= TG[2][state[44]];
-	r ^= TG[3][state[36]];
-	r ^= TG[4][state[28]];
-	r ^= TG[5][state[20]];
-	r ^= TG[6][state[12]];
-	r ^= TG[7][state[4]];
-	return_state[4] = r;
-	r = 0;
-
-	r ^= TG[0][state[61]];
-	r ^= TG[1][state[53]];
-	r ^= TG[2][state[45]];
-	r ^= TG[3][state[37]];
-	r ^= TG[4][state[29]];
-	r ^= TG[5][state[21]];
-	r ^= TG[6][state[13]];
-	r ^= TG[7][state[5]];
-	return_state[5] = r;
-	r = 0;
-
-	r ^= TG[0][state[62]];
-	r ^= TG[1][state[54]];
-	r ^= TG[2][state[46]];
-	r ^= TG[3][state[38]];
-	r ^= TG[4][state[30]];
-	r ^= TG[5][state[22]];
-	r ^= TG[6][state[14]];
-	r ^= TG[7][state[6]];
-	return_state[6] = r;
-	r = 0;
-
-	r ^= TG[0][state[63]];
-	r ^= TG[1][state[55]];
-	r ^= TG[2][state[47]];
-	r ^= TG[3][state[39]];
-	r ^= TG[4][state[31]];
-	r ^= TG[5][state[23]];
-	r ^= TG[6][state[15]];
-	r ^= TG[7][state[7]];
-	return_state[7] = r;
-
-	memcpy(state,(unsigned char*)return_state,64);
+	int i;
+	for (i = 7; i >= 0 && v; i--) {
+		sph_u64 x = sph_bswap64(a[i]);
+		sph_u64 t = SPH_T64(x + v);
+		v = t < x;
+		a[i] = sph_bswap64(t);
+	}
 }
 
-#define KeySchedule(K,i) AddXor512(K,C[i],K); F(K);
+static const sph_u64 zero512[8] = { 0 };
 
-static void E(unsigned char *K,const unsigned char *m, unsigned char *state)
+static void g_N(const sph_u64 *N, sph_u64 *h, const sph_u64 *m)
 {
-#ifdef FULL_UNROLL
-	AddXor512(m,K,state);
-
-	F(state);
-	KeySchedule(K,0);
-	AddXor512(state,K,state);
-
-	F(state);
-	KeySchedule(K,1);
-	AddXor512(state,K,state);
-
-	F(state);
-	KeySchedule(K,2);
-	AddXor512(state,K,state);
-
-	F(state);
-	KeySchedule(K,3);
-	AddXor512(state,K,state);
-
-	F(state);
-	KeySchedule(K,4);
-	AddXor512(state,K,state);
-
-	F(state);
-	KeySchedule(K,5);
-	AddXor512(state,K,state);
-
-	F(state);
-	KeySchedule(K,6);
-	AddXor512(state,K,state);
-
-	F(state);
-	KeySchedule(K,7);
-	AddXor512(state,K,state);
-
-	F(state);
-	KeySchedule(K,8);
-	AddXor512(state,K,state);
-
-	F(state);
-	KeySchedule(K,9);
-	AddXor512(state,K,state);
-
-	F(state);
-	KeySchedule(K,10);
-	AddXor512(state,K,state);
-
-	F(state);
-	KeySchedule(K,11);
-	AddXor512(state,K,state);
-#else
-	int i = 0;
-
-	AddXor512(m,K,state);
-
-	for(i=0;i<12;i++) {
-		F(state);
-		KeySchedule(K,i);
-		AddXor512(state,K,state);
+	sph_u64 K[8], t[8];
+	int i;
+
+	F(K, N, h);
+	F(t, m, K);
+	for (i = 0; i < 11; i++) {
+		F(K, K, CC[i]);
+		F(t, t, K);
 	}
-#endif
+	F(K, K, CC[11]);
+
+	for (i = 0; i < 8; i++)
+		h[i] ^= t[i] ^ K[i] ^ m[i];
 }
 
-static void g_N(const unsigned char *N,unsigned char *h,const unsigned char *m)
+// g_N of the first block, with its precomputed keys
+static void g_0(const sph_u64 (*K)[8], sph_u64 *h, const sph_u64 *m)
 {
-	unsigned char t[64], K[64];
+	sph_u64 t[8];
+	int i;
 
-	AddXor512(N,h,K);
+	F(t, m, K[0]);
+	for (i = 1; i < 12; i++)
+		F(t, t, K[i]);
 
-	F(K);
-
-	E(K,m,t);
-
-	AddXor512(t,h,t);
-	AddXor512(t,m,h);
+	for (i = 0; i < 8; i++)
+		h[i] ^= t[i] ^ K[12][i] ^ m[i];
 }
 
-static void hash_X(unsigned char *IV,const unsigned char *message,unsigned long long length,unsigned char *out)
+static void hash_X(sph_u64 *hash, const sph_u64 (*KZ)[8], const unsigned char *message, size_t len, unsigned char *out, size_t outlen)
 {
-	unsigned char v512[64] = {
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x02,0x00
-	};
-	unsigned char v0[64] = {
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00
-	};
-	unsigned char Sigma[64] = {
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00
-	};
-	unsigned char N[64] = {
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00
-	};
-	unsigned char m[64], *hash = IV;
-	unsigned long long len = length;
-
-	// Stage 2
-	while (len >= 512)
-	{
-		memcpy(m, message + len/8 - 63 - ( (len & 0x7) == 0 ), 64);
-
-		g_N(N,hash,m);
-		AddModulo512(N,v512,N);
-		AddModulo512(Sigma,m,Sigma);
-		len -= 512;
+	sph_u64 N[8] = { 0 }, Sigma[8] = { 0 }, m[8];
+	int first = 1;
+
+	// Stage 2, the blocks are taken from the end of the message
+	while (len >= 64) {
+		memcpy(m, message + len - 64, 64);
+		if (first)
+			g_0(KZ, hash, m);
+		else
+			g_N(N, hash, m);
+		first = 0;
+		AddModulo512_64(N, 512);
+		AddModulo512(Sigma, m);
+		len -= 64;
 	}
 
-	memset(m,0,64);
-	memcpy(m + 63 - len/8 + ( (len & 0x7) == 0 ), message, len/8 + 1 - ( (len & 0x7) == 0 ));
+	memset(m, 0, 64);
+	memcpy((unsigned char*) m + 64 - len, message, len);
 
 	// Stage 3
-	m[ 63 - len/8 ] |= (1 << (len & 0x7));
+	((unsigned char*) m)[63 - len] |= 1;
 
-	g_N(N,hash,m);
-	v512[63] = len & 0xFF;
-	v512[62] = (unsigned char) (len >> 8);
-	AddModulo512(N,v512,N);
+	if (first)
+		g_0(KZ, hash, m);
+	else
+		g_N(N, hash, m);
+	AddModulo512_64(N, (sph_u64) len * 8);
+	AddModulo512(Sigma, m);
 
-	AddModulo512(Sigma,m,Sigma);
+	g_N(zero512, hash, N);
+	g_N(zero512, hash, Sigma);
 
-	g_N(v0,hash,N);
-	g_N(v0,hash,Sigma);
-
-	memcpy(out, hash, 64);
+	memcpy(out, hash, outlen);
 }
 
-static void hash_512(const unsigned char *message, unsigned long long length, unsigned char *out)
+static void hash_512(const unsigned char *message, size_t len, unsigned char *out)
 {
-	unsigned char IV[64] = {
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,
-		0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00
-	};
-
-	hash_X(IV,message,length,out);
+	sph_u64 IV[8] = { 0 };
+	hash_X(IV, KZ512, message, len, out, 64);
 }
 
-static void hash_256(const unsigned char *message, unsigned long long length, unsigned char *out)
+static void hash_256(const unsigned char *message, size_t len, unsigned char *out)
 {
-	unsigned char IV[64] = {
-		0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,
-		0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,
-		0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,
-		0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01,0x01
-	};
-	unsigned char hash[64];
-
-	hash_X(IV,message,length,hash);
-
-	memcpy(out,hash,32);
+	sph_u64 IV[8];
+	memset(IV, 0x01, sizeof(IV));
+	hash_X(IV, KZ256, message, len, out, 32);
 }
 
-
-
-
-
 /* see sph_gost.h */
 void
 sph_gost256_init(void *cc)
@@ -992,7 +816,7 @@ sph_gost256_init(void *cc)
 void
 sph_gost256(void *cc, const void *data, size_t len)
 {
-	hash_256(data, 8*len, cc);
+	hash_256(data, len, cc);
 }
 
 /* see sph_gost.h */
@@ -1021,7 +845,7 @@ sph_gost512_init(void *cc)
 void
 sph_gost512(void *cc, const void *data, size_t len)
 {
-	hash_512(data, 8*len, cc);
+	hash_512(data, len, cc);
 }
 
 /* see sph_gost.h */
@@ -3272,6 +3272,79 @@ static const sph_u64 old1_RC[10] = {
 	SPH_C64(0x33835AAD07BF2DCA)
 };
 
+/*
+ * Round keys of the zero chaining value, used for the first block of
+ * each message (half of the table lookups of that block).
+ */
+static const sph_u64 plain_KZ[10][8] = {
+	{ SPH_C64(0x672990AFC0EE0B30), SPH_C64(0x2828282828282828), SPH_C64(0x2828282828282828), SPH_C64(0x2828282828282828),
+	  SPH_C64(0x2828282828282828), SPH_C64(0x2828282828282828), SPH_C64(0x2828282828282828), SPH_C64(0x2828282828282828) },
+	{ SPH_C64(0x24AED1EAF889AB3B), SPH_C64(0xAFCBE94566454544), SPH_C64(0x89B2A4C5A4A4FE70), SPH_C64(0xA0E1CCE1E1A9FAC5),
+	  SPH_C64(0xFCB8FCFC5CC0AC48), SPH_C64(0x698F8F90260EF78F), SPH_C64(0x797985D707147996), SPH_C64(0xF878C8B868F8A8F8) },
+	{ SPH_C64(0x58704630DBBF19D3), SPH_C64(0xDB37CFAFD1235B29), SPH_C64(0x98AC958BC28A2C01), SPH_C64(0xA706B2C0B19E6381),
+	  SPH_C64(0xDB09B2B07A605E44), SPH_C64(0x71BC8CBCCF2C5B73), SPH_C64(0xD3DDEDEF240967DC), SPH_C64(0x197D3BD7F03B8D7B) },
+	{ SPH_C64(0x866511DEC1AABE38), SPH_C64(0x7F33874AD0F37C68), SPH_C64(0x57F0AD98DBFA37F3), SPH_C64(0xBC8D35EE5842E2C5),
+	  SPH_C64(0x7E246E99E8F00911), SPH_C64(0x0134B010EDD6C501), SPH_C64(0xD3EC287BF152C9FB), SPH_C64(0x4027F1C70CDC5632) },
+	{ SPH_C64(0x14CF9B9420A525AF), SPH_C64(0x4D53C4E3A92636C1), SPH_C64(0xE1F94077867D0FE6), SPH_C64(0x29066AE2BBE65D91),
+	  SPH_C64(0x8D5EFE4CCC545A96), SPH_C64(0xA63A3262CB31E9BE), SPH_C64(0x476A849618597BB1), SPH_C64(0x31AF592736C9F0D4) },
+	{ SPH_C64(0xB00B3725C0B5F9E2), SPH_C64(0xA5948416A2CB2B39), SPH_C64(0x148C34FACEF88A60), SPH_C64(0x19928C416437A57A),
+	  SPH_C64(0x893F83FAA146F3B3), SPH_C64(0x7CCF0278483F4997), SPH_C64(0x238F001EBAE8ADDC), SPH_C64(0x3D32B0ED494F7792) },
+	{ SPH_C64(0x2FFF4D7782634175), SPH_C64(0x00460355D038FAFF), SPH_C64(0x61F3983E49027DBF), SPH_C64(0x0BCEE59AC260A8F4),
+	  SPH_C64(0x279D5DEE445ADFC8), SPH_C64(0xA4007504555AF423), SPH_C64(0x8CE2F902121016B0), SPH_C64(0x1D33336829CD30AC) },
+	{ SPH_C64(0x89AD846882F16B03), SPH_C64(0x637146D862C64099), SPH_C64(0x10C2194B173E434C), SPH_C64(0xC586FF4CD3CF9CE2),
+	  SPH_C64(0x5326DF42A011FF21), SPH_C64(0x134BE46CCB008E1B), SPH_C64(0xCEB747A3F73B12A6), SPH_C64(0xCA33283B0E9018D9) },
+	{ SPH_C64(0xF92C9A0A7A671CD0), SPH_C64(0xB2B6634A532F942A), SPH_C64(0xB4A8ACFE46224288), SPH_C64(0x5935583DC75C4A47),
+	  SPH_C64(0xA16F5CA55D92A674), SPH_C64(0x395C73C48CE61777), SPH_C64(0xC61AEC530B3B2A08), SPH_C64(0x62E74D81EB58F62A) },
+	{ SPH_C64(0x3ABCEE01B6489548), SPH_C64(0x818EED6BC66B0DA5), SPH_C64(0x755A2688CF3DCEE0), SPH_C64(0xE99CF6C0DB4A8CC2),
+	  SPH_C64(0x1385717FD59CB754), SPH_C64(0x7B0B7D978A4B4143), SPH_C64(0x7A15F6DBBB351963), SPH_C64(0x27820137F64E7A6A) }
+};
+
+static const sph_u64 old0_KZ[10][8] = {
+	{ SPH_C64(0x5CD225F0935368D0), SPH_C64(0xB8B8B8B8B8B8B8B8), SPH_C64(0xB8B8B8B8B8B8B8B8), SPH_C64(0xB8B8B8B8B8B8B8B8),
+	  SPH_C64(0xB8B8B8B8B8B8B8B8), SPH_C64(0xB8B8B8B8B8B8B8B8), SPH_C64(0xB8B8B8B8B8B8B8B8), SPH_C64(0xB8B8B8B8B8B8B8B8) },
+	{ SPH_C64(0x3F3C4ADC28FB0A4A), SPH_C64(0x7721B8FD51FDFDB8), SPH_C64(0x68B659A05959B69A), SPH_C64(0x3172DD727231F42D),
+	  SPH_C64(0x2A352A2A1456D714), SPH_C64(0x97BFBFEF1F0BEFBF), SPH_C64(0xB1B1D9617BD9B185), SPH_C64(0x88048DAE0488CE88) },
+	{ SPH_C64(0xDDE702DC3098BA4F), SPH_C64(0x4581E371EA1EC9A3), SPH_C64(0x80E28F0BF31DB925), SPH_C64(0x74DE983F4ED577FC),
+	  SPH_C64(0x3EA9B2E1293EA2DE), SPH_C64(0x59A130433E0FCEF4), SPH_C64(0xB14BE2DD00B8C608), SPH_C64(0x1DCDA9132C38EDB2) },
+	{ SPH_C64(0x0C9EE90DC1333598), SPH_C64(0x1C09812EF033255D), SPH_C64(0x21C807AA5DA76350), SPH_C64(0x4BE201CB121BC694),
+	  SPH_C64(0xC6CEA499F126F322), SPH_C64(0xEA5E657ADEACDD95), SPH_C64(0x5181FF2C57B8028E), SPH_C64(0x036592D974D3BEA3) },
+	{ SPH_C64(0x1E8412327494C13F), SPH_C64(0x1E10FCFBD75B1281), SPH_C64(0x08F92FAD5D5B3386), SPH_C64(0x8928F396BE334678),
+	  SPH_C64(0x4D5A1E355AABE517), SPH_C64(0x7C9EF7CBA80D3FDF), SPH_C64(0x0B9A61E32AF14B03), SPH_C64(0xB9ECFFBDBC7AA9A6) },
+	{ SPH_C64(0x7A1120E299811275), SPH_C64(0x53232A4A8F6D81FE), SPH_C64(0x36946412B70E8443), SPH_C64(0x6BDFD3AAA5BB99BA),
+	  SPH_C64(0x183418AB81AD4C51), SPH_C64(0x305F96EBB34752A6), SPH_C64(0xEDD904205DC64D20), SPH_C64(0x1BE87C54A9CA42D5) },
+	{ SPH_C64(0x21F1CDBEAA16720A), SPH_C64(0x70420642117B8AEE), SPH_C64(0x56CBF3BAFFBD4042), SPH_C64(0xA81FA3F7274D3C39),
+	  SPH_C64(0x9A3E80F48D8C23E7), SPH_C64(0x1EC97D317DA9D142), SPH_C64(0xE81A98741DB29B27), SPH_C64(0x1A14EBA23B7EE547) },
+	{ SPH_C64(0xDA64FBD70BB30F45), SPH_C64(0x1CB81C5D85102B1A), SPH_C64(0xA1C05DD789B2EECF), SPH_C64(0x3BEACB52008B8C47),
+	  SPH_C64(0xC0EAC2B96430AE80), SPH_C64(0x4C27D698CF166CC2), SPH_C64(0x5D8DEAB443F349D7), SPH_C64(0xFEB344CAB8A73BCC) },
+	{ SPH_C64(0xE6AA77E0F0AD60CF), SPH_C64(0xA3DD15B27F173359), SPH_C64(0x48CEFDB3ED67A54E), SPH_C64(0xD7E1C5FB145884BD),
+	  SPH_C64(0xCFF18A2609A27979), SPH_C64(0xE375FAC7F6FD5624), SPH_C64(0x0B58660C0314C9AB), SPH_C64(0xEA8F8D8C383F2B51) },
+	{ SPH_C64(0x23B877B9F6D0DB7C), SPH_C64(0xDC3A62DFADB65BC6), SPH_C64(0x13843BCF08F8BB73), SPH_C64(0x76C01543412B1F40),
+	  SPH_C64(0xE8F0762A8F2FC88B), SPH_C64(0xE7D93F10B1452F65), SPH_C64(0xE8EFF50437C4D7F6), SPH_C64(0xDA22AAC39569A21B) }
+};
+
+static const sph_u64 old1_KZ[10][8] = {
+	{ SPH_C64(0x672990AFC0EE0B30), SPH_C64(0x2828282828282828), SPH_C64(0x2828282828282828), SPH_C64(0x2828282828282828),
+	  SPH_C64(0x2828282828282828), SPH_C64(0x2828282828282828), SPH_C64(0x2828282828282828), SPH_C64(0x2828282828282828) },
+	{ SPH_C64(0xECE7FCC7F808AB3B), SPH_C64(0x44E9CB45024545CB), SPH_C64(0xB289A43CA4A489FE), SPH_C64(0xC5E1F3E1E1C5A9A0),
+	  SPH_C64(0xFCD4FCFCAC5C48AC), SPH_C64(0x418F8F0E90F70E8F), SPH_C64(0x7979078514077946), SPH_C64(0xF8B87868B8F8D8F8) },
+	{ SPH_C64(0xE4B6012A17B9C1EF), SPH_C64(0xAFF6AD2866D6C68D), SPH_C64(0xB0C745991504968F), SPH_C64(0x74E93F120FE2E675),
+	  SPH_C64(0xC1D216198D2A495B), SPH_C64(0x35B6A53DF6716FD7), SPH_C64(0xD6983228CCDC354F), SPH_C64(0xC3B8BFCB242AB159) },
+	{ SPH_C64(0x4AC0340260B548D4), SPH_C64(0x3B3582BB4F9BB769), SPH_C64(0xD8683C4AF17C46F8), SPH_C64(0x9EE05220D8214E61),
+	  SPH_C64(0xFED2431F5098E0E5), SPH_C64(0x387AF50F0776E24F), SPH_C64(0x7FFD300A74DE5AE1), SPH_C64(0xB753981921AEB24B) },
+	{ SPH_C64(0x296F5919978BA0BD), SPH_C64(0x52CC9DD7031E59AC), SPH_C64(0xE5E646C9A5165AE3), SPH_C64(0x4F848BDF70532817),
+	  SPH_C64(0xA01ADD556B693C51), SPH_C64(0xC7268B83DDB75E97), SPH_C64(0xCB908F9316E2C076), SPH_C64(0x8FC39EE0D946E9C5) },
+	{ SPH_C64(0x5B256B0FE7937D86), SPH_C64(0xF77C51751A22932C), SPH_C64(0x2582A83CD34108C4), SPH_C64(0xE218CDE28A9C790D),
+	  SPH_C64(0xC93A572E592E3594), SPH_C64(0xEA70CF71BC4E55AC), SPH_C64(0xC135C8214155BC85), SPH_C64(0x50989643A6B8456E) },
+	{ SPH_C64(0x60E970DFD74C71E6), SPH_C64(0xC0B5A520AB7C88D8), SPH_C64(0x3A66AA761D5B1400), SPH_C64(0x0502AB3087300DE6),
+	  SPH_C64(0xC06203EDED483DEA), SPH_C64(0xC2620EDF55C1CB74), SPH_C64(0xF36A22CF9AA452F1), SPH_C64(0xB3502DC83BA2660F) },
+	{ SPH_C64(0xCF249B6DB82273C3), SPH_C64(0xC74DADAB026388F2), SPH_C64(0xB8B77B3275AFCDE8), SPH_C64(0xC9947382C6D6A3C0),
+	  SPH_C64(0x84938F2258A6BC21), SPH_C64(0x1E51E15A3B99CDF7), SPH_C64(0xC812F9AC41F5CC05), SPH_C64(0x21BFEC61E9B9393E) },
+	{ SPH_C64(0xF576066160243540), SPH_C64(0x3A62D1CB6404180D), SPH_C64(0x8807A55C2AC7AFE2), SPH_C64(0x804237B54859503E),
+	  SPH_C64(0x1619B3612106744B), SPH_C64(0xC1ECB5643D81C76F), SPH_C64(0xBA7CBB8C13214C6C), SPH_C64(0xD241AEAD7622701E) },
+	{ SPH_C64(0xDD900A1B66BF748C), SPH_C64(0xCACCF665EC2391FE), SPH_C64(0xF9BED90100B89447), SPH_C64(0x4CF5D284E56B7A0F),
+	  SPH_C64(0x003EB289B6993F96), SPH_C64(0xE9DB01146199245D), SPH_C64(0x97701270F3F41CCB), SPH_C64(0x9C8CA117E01E4B49) }
+};
+
 /* ====================================================================== */
 
 #define DECL8(z)   sph_u64 z ## 0, z ## 1, z ## 2, z ## 3, \
@@ -3372,6 +3445,10 @@ table_skew(sph_u64 val, int num)
 	ROUND(table, in, out, key ## 0, key ## 1, key ## 2, \
 		key ## 3, key ## 4, key ## 5, key ## 6, key ## 7)
 
+#define ROUND_WKEY(table, in, key, out) \
+	ROUND(table, in, out, key[0], key[1], key[2], \
+		key[3], key[4], key[5], key[6], key[7])
+
 #define TRANSFER(dst, src)   do { \
 		dst ## 0 = src ## 0; \
 		dst ## 1 = src ## 1; \
@@ -3412,6 +3489,16 @@ name ## _round(const void *src, sph_u64 *state) \
  \
 	READ_DATA; \
 	READ_STATE; \
+	if (!(h0 | h1 | h2 | h3 | h4 | h5 | h6 | h7)) { \
+		for (r = 0; r < 10; r ++) { \
+			DECL8(tmp); \
+ \
+			ROUND_WKEY(type ## _T, n, type ## _KZ[r], tmp); \
+			TRANSFER(n, tmp); \
+		} \
+		UPDATE_STATE; \
+		return; \
+	} \
 	ROUND0; \
 	for (r = 0; r < 10; r ++) { \
 		DECL8(tmp); \
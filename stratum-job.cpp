@@ -0,0 +1,215 @@
+/**
+ * Published stratum jobs
+ *
+ * The stratum thread builds each job off-lock in a private object and
+ * publishes it with an atomic pointer swap, the readers (miner threads,
+ * api, proxy) never take a lock. The replaced jobs are reclaimed once no
+ * reader can still use them (epoch based reclamation): a reader announces
+ * the global epoch in its slot before loading the job pointer, a job
+ * retired at epoch E is recycled when all the active slots are above E.
+ *
+ * The only mutable part of a job is its extranonce2 counter, closed when
+ * the job is replaced (and carried over if the job id doesn't change).
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <atomic>
+
+#include "miner.h"
+
+#define SJ_SLOTS    128
+#define SJ_FREE_MAX 4
+#define SJ_CLOSED   (1ULL << 63)
+
+struct sj_node {
+	struct stratum_job job; /* first, the public part */
+	std::atomic<uint64_t> xnonce2_seq;
+	uint64_t retired;
+	struct sj_node *next;
+};
+
+struct _ALIGN(64) sj_slot {
+	std::atomic<uint64_t> epoch; /* 0 if not reading */
+};
+
+static struct sj_slot sj_slots[SJ_SLOTS];
+static std::atomic<int> sj_nslots(0);
+static std::atomic<int> sj_overflow(0); /* readers without slot */
+static std::atomic<uint64_t> sj_epoch(1);
+static __thread int tls_slot = -1;
+static __thread int tls_depth = 0;
+static __thread bool tls_overflow = false;
+
+/* publisher side */
+static pthread_mutex_t sj_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct sj_node *sj_retired = NULL;
+static struct sj_node *sj_free = NULL;
+static int sj_nfree = 0;
+
+static inline struct sj_node* sj_node_of(struct stratum_job *job)
+{
+	return reinterpret_cast<struct sj_node*>(job);
+}
+
+/* the stratum_ctx pointer, only accessed atomically */
+static inline std::atomic<struct stratum_job*>& sj_current(struct stratum_ctx *sctx)
+{
+	static_assert(sizeof(std::atomic<struct stratum_job*>) == sizeof(struct stratum_job*),
+		"atomic pointer size");
+	return *reinterpret_cast<std::atomic<struct stratum_job*>*>(&sctx->pub_job);
+}
+
+static int sj_get_slot()
+{
+	if (tls_slot >= 0 || tls_overflow)
+		return tls_slot;
+	int idx = sj_nslots.fetch_add(1);
+	if (idx >= SJ_SLOTS) {
+		applog(LOG_WARNING, "stratum: too many job readers, reclaim will be delayed");
+		tls_overflow = true;
+		return -1;
+	}
+	tls_slot = idx;
+	return idx;
+}
+
+/* the current job or NULL, valid until stratum_job_release() */
+struct stratum_job* stratum_job_acquire(struct stratum_ctx *sctx)
+{
+	if (!tls_depth++) {
+		int slot = sj_get_slot();
+		if (slot >= 0)
+			sj_slots[slot].epoch.store(sj_epoch.load());
+		else
+			sj_overflow.fetch_add(1);
+	}
+	return sj_current(sctx).load();
+}
+
+void stratum_job_release(void)
+{
+	if (tls_depth <= 0 || --tls_depth)
+		return;
+	if (tls_slot >= 0)
+		sj_slots[tls_slot].epoch.store(0, std::memory_order_release);
+	else
+		sj_overflow.fetch_sub(1, std::memory_order_release);
+}
+
+static void sj_recycle(struct sj_node *n)
+{
+	if (sj_nfree < SJ_FREE_MAX) {
+		n->next = sj_free;
+		sj_free = n;
+		sj_nfree++;
+		return;
+	}
+	free(n->job.coinbase);
+	delete n;
+}
+
+/* recycle the retired jobs not visible anymore, with sj_lock */
+static void sj_reclaim()
+{
+	uint64_t min_epoch = UINT64_MAX;
+	if (sj_overflow.load())
+		return;
+	int nslots = min(sj_nslots.load(), SJ_SLOTS);
+	for (int i = 0; i < nslots; i++) {
+		uint64_t e = sj_slots[i].epoch.load();
+		if (e && e < min_epoch)
+			min_epoch = e;
+	}
+	struct sj_node **pn = &sj_retired;
+	while (*pn) {
+		struct sj_node *n = *pn;
+		if (n->retired < min_epoch) {
+			*pn = n->next;
+			sj_recycle(n);
+		} else {
+			pn = &n->next;
+		}
+	}
+}
+
+/* a private job to fill before stratum_job_publish(), the coinbase buffer is reused */
+struct stratum_job* stratum_job_new(void)
+{
+	struct sj_node *n;
+
+	pthread_mutex_lock(&sj_lock);
+	n = sj_free;
+	if (n) {
+		sj_free = n->next;
+		sj_nfree--;
+	}
+	pthread_mutex_unlock(&sj_lock);
+
+	if (!n) {
+		n = new (std::nothrow) sj_node;
+		if (!n) {
+			applog(LOG_ERR, "Stratum notify: job alloc failed");
+			return NULL;
+		}
+		n->job.coinbase = NULL;
+		n->job.coinbase_alloc = 0;
+	}
+	uchar *coinbase = n->job.coinbase;
+	size_t alloc = n->job.coinbase_alloc;
+	memset(&n->job, 0, sizeof(n->job));
+	n->job.coinbase = coinbase;
+	n->job.coinbase_alloc = alloc;
+	n->xnonce2_seq.store(0, std::memory_order_relaxed);
+	n->retired = 0;
+	n->next = NULL;
+	return &n->job;
+}
+
+/* drop a job not published */
+void stratum_job_discard(struct stratum_job *job)
+{
+	if (!job) return;
+	pthread_mutex_lock(&sj_lock);
+	sj_recycle(sj_node_of(job));
+	pthread_mutex_unlock(&sj_lock);
+}
+
+/* replace the current job (NULL to clear it), the job must not be changed after */
+void stratum_job_publish(struct stratum_ctx *sctx, struct stratum_job *job)
+{
+	pthread_mutex_lock(&sj_lock);
+	struct stratum_job *cur = sj_current(sctx).load();
+	if (cur) {
+		// no extranonce2 can be taken from the old job after this point
+		uint64_t seq = sj_node_of(cur)->xnonce2_seq.fetch_or(SJ_CLOSED) & ~SJ_CLOSED;
+		if (job && !strcmp(job->job_id, cur->job_id) && job->xnonce2_size == cur->xnonce2_size)
+			sj_node_of(job)->xnonce2_seq.store(seq, std::memory_order_relaxed);
+	}
+	sj_current(sctx).exchange(job);
+	if (cur) {
+		struct sj_node *n = sj_node_of(cur);
+		n->retired = sj_epoch.fetch_add(1);
+		n->next = sj_retired;
+		sj_retired = n;
+	}
+	sj_reclaim();
+	pthread_mutex_unlock(&sj_lock);
+}
+
+/* the extranonce2 to use (next=false to peek it), false if the job was replaced */
+bool stratum_job_xnonce2(struct stratum_job *job, uchar *xnonce2, bool next)
+{
+	std::atomic<uint64_t> &seq = sj_node_of(job)->xnonce2_seq;
+	uint64_t n = next ? seq.fetch_add(1, std::memory_order_relaxed) : seq.load(std::memory_order_relaxed);
+	if (n & SJ_CLOSED)
+		return false;
+
+	// the first bytes are the proxy clients slot
+	memcpy(xnonce2, job->xnonce2, job->xnonce2_size);
+	for (int i = proxy_xnonce2_reserved(job->xnonce2_size); i < (int) job->xnonce2_size; i++) {
+		xnonce2[i] = (uchar) n;
+		n >>= 8;
+	}
+	return true;
+}
@@ -0,0 +1,211 @@
+/**
+ * Allocation free decoder of the common stratum messages
+ *
+ * The line is parsed in place: the values are spans of the input buffer,
+ * the strings are not copied (nor nul terminated). Only the top level id,
+ * method, params, result and error keys and the params array items are
+ * kept, the other keys are skipped. Strings with escapes, too many params
+ * or a malformed line make the parse fail, the caller then falls back to
+ * jansson which also reports the errors.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "miner.h"
+
+#define SJSON_MAX_DEPTH 32
+
+static inline const char* sj_ws(const char *s)
+{
+	while (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n')
+		s++;
+	return s;
+}
+
+static const char* sj_value(const char *s, struct sjson_val *v, int depth);
+
+/* parse an array or an object at s, store up to max array items */
+static const char* sj_container(const char *s, struct sjson_val *v,
+	struct sjson_val *items, int max, int depth)
+{
+	const char close = (*s == '{') ? '}' : ']';
+	struct sjson_val skip;
+	const char *e;
+
+	if (depth >= SJSON_MAX_DEPTH)
+		return NULL;
+	v->p = s;
+	v->type = (*s == '{') ? SJSON_OBJECT : SJSON_ARRAY;
+	v->count = 0;
+	e = sj_ws(s + 1);
+	if (*e != close) for (;;) {
+		struct sjson_val *item = (v->count < max) ? &items[v->count] : &skip;
+		if (close == '}') {
+			if (*e != '"' || !(e = sj_value(e, &skip, depth + 1)))
+				return NULL;
+			e = sj_ws(e);
+			if (*e++ != ':')
+				return NULL;
+		}
+		if (!(e = sj_value(e, item, depth + 1)))
+			return NULL;
+		v->count++;
+		e = sj_ws(e);
+		if (*e == close)
+			break;
+		if (*e++ != ',')
+			return NULL;
+		e = sj_ws(e);
+	}
+	v->len = (int) (e + 1 - s);
+	return e + 1;
+}
+
+/* parse the value at s, return the end of the value or NULL */
+static const char* sj_value(const char *s, struct sjson_val *v, int depth)
+{
+	const char *e;
+
+	s = sj_ws(s);
+	v->p = s;
+	v->count = 0;
+	switch (*s) {
+	case '"':
+		for (e = s + 1; *e != '"'; e++) {
+			if ((uchar) *e < 0x20 || *e == '\\')
+				return NULL;
+		}
+		v->p = s + 1;
+		v->len = (int) (e - s - 1);
+		v->type = SJSON_STRING;
+		return e + 1;
+	case '{':
+	case '[':
+		return sj_container(s, v, NULL, 0, depth);
+	case 't':
+		if (strncmp(s, "true", 4)) return NULL;
+		v->type = SJSON_TRUE; v->len = 4;
+		return s + 4;
+	case 'f':
+		if (strncmp(s, "false", 5)) return NULL;
+		v->type = SJSON_FALSE; v->len = 5;
+		return s + 5;
+	case 'n':
+		if (strncmp(s, "null", 4)) return NULL;
+		v->type = SJSON_NULL; v->len = 4;
+		return s + 4;
+	default:
+		e = s;
+		if (*e == '-') e++;
+		if (*e < '0' || *e > '9')
+			return NULL;
+		while ((*e >= '0' && *e <= '9') || *e == '.' || *e == 'e' || *e == 'E' || *e == '+' || *e == '-')
+			e++;
+		v->type = SJSON_NUMBER;
+		v->len = (int) (e - s);
+		return e;
+	}
+}
+
+static inline bool sj_key(const struct sjson_val *k, const char *name, int len)
+{
+	return k->len == len && !memcmp(k->p, name, len);
+}
+
+bool stratum_msg_parse(const char *s, struct stratum_msg *msg)
+{
+	struct sjson_val key, val;
+	const char *e;
+
+	msg->id.type = msg->method.type = SJSON_INVALID;
+	msg->params.type = msg->result.type = msg->error.type = SJSON_INVALID;
+	msg->params_count = 0;
+
+	e = sj_ws(s);
+	if (*e++ != '{')
+		return false;
+	e = sj_ws(e);
+	if (*e == '}')
+		return *sj_ws(e + 1) == '\0';
+
+	for (;;) {
+		if (*e != '"' || !(e = sj_value(e, &key, 1)))
+			return false;
+		e = sj_ws(e);
+		if (*e++ != ':')
+			return false;
+		e = sj_ws(e);
+		if (sj_key(&key, "params", 6) && *e == '[') {
+			// the items are kept while parsing
+			e = sj_container(e, &val, msg->param, STRATUM_MSG_PARAMS, 1);
+			if (!e || val.count > STRATUM_MSG_PARAMS)
+				return false;
+		} else if (!(e = sj_value(e, &val, 1)))
+			return false;
+
+		if (sj_key(&key, "id", 2)) msg->id = val;
+		else if (sj_key(&key, "method", 6)) msg->method = val;
+		else if (sj_key(&key, "result", 6)) msg->result = val;
+		else if (sj_key(&key, "error", 5)) msg->error = val;
+		else if (sj_key(&key, "params", 6)) {
+			msg->params = val;
+			msg->params_count = (val.type == SJSON_ARRAY) ? val.count : 0;
+		}
+
+		e = sj_ws(e);
+		if (*e == '}')
+			break;
+		if (*e++ != ',')
+			return false;
+		e = sj_ws(e);
+	}
+	return *sj_ws(e + 1) == '\0';
+}
+
+/* store up to max items of an array, return the items count (or -1) */
+int sjson_array_get(const struct sjson_val *arr, struct sjson_val *items, int max)
+{
+	struct sjson_val v;
+
+	if (arr->type != SJSON_ARRAY || !sj_container(arr->p, &v, items, max, 1))
+		return -1;
+	return v.count;
+}
+
+/* case insensitive compare of a string value */
+bool sjson_is(const struct sjson_val *v, const char *str)
+{
+	int len = (int) strlen(str);
+	return v->type == SJSON_STRING && v->len == len && !strncasecmp(v->p, str, len);
+}
+
+/* like json_number_value(), 0 if not a number */
+double sjson_number(const struct sjson_val *v)
+{
+	if (v->type != SJSON_NUMBER)
+		return 0.;
+	return strtod(v->p, NULL);
+}
+
+/* like json_integer_value(), 0 if not an integer */
+long long sjson_integer(const struct sjson_val *v)
+{
+	if (v->type != SJSON_NUMBER)
+		return 0;
+	for (int i = 0; i < v->len; i++) {
+		if (v->p[i] == '.' || v->p[i] == 'e' || v->p[i] == 'E')
+			return 0;
+	}
+	return strtoll(v->p, NULL, 10);
+}
+
+/* copy a string value as a c string, truncated to the buffer size */
+const char* sjson_string(const struct sjson_val *v, char *buf, int size)
+{
+	if (v->type != SJSON_STRING || size < 1)
+		return NULL;
+	int len = v->len < size - 1 ? v->len : size - 1;
+	memcpy(buf, v->p, len);
+	buf[len] = '\0';
+	return buf;
+}
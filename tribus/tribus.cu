@@ -125,7 +125,7 @@ extern "C" int scanhash_tribus(int thr_id, struct work *work, uint32_t max_nonce
 			const uint32_t startNounce = pdata[19];
 			if (!use_compat_kernels[thr_id]) work->nonces[0] += startNounce;
 			be32enc(&endiandata[19], work->nonces[0]);
-			tribus_hash(vhash, endiandata);
+			vstats_hash(thr_id, tribus_hash(vhash, endiandata));
 
 			if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
@@ -133,7 +133,7 @@ extern "C" int scanhash_tribus(int thr_id, struct work *work, uint32_t max_nonce
 				if (work->nonces[1] != UINT32_MAX) {
 					work->nonces[1] += startNounce;
 					be32enc(&endiandata[19], work->nonces[1]);
-					tribus_hash(vhash, endiandata);
+					vstats_hash(thr_id, tribus_hash(vhash, endiandata));
 					bn_set_target_ratio(work, vhash, 1);
 					work->valid_nonces++;
 					pdata[19] = max(work->nonces[0], work->nonces[1]) + 1;
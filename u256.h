@@ -0,0 +1,148 @@
+#ifndef U256_H
+#define U256_H
+
+/**
+ * Light 256-bit unsigned integer used for the hash/target checks
+ *
+ * Words are little endian (w[0] is the lowest), like the uint32_t[8]
+ * hash and target arrays, so both can be loaded with a memcpy.
+ * The compare is branch free (SSE2 when available) and the helpers
+ * are constexpr with compilers supporting it (not VS2013).
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define U256_SSE2 1
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define U256_CONSTEXPR inline
+#else
+#define U256_CONSTEXPR constexpr
+#define U256_HAVE_CONSTEXPR 1
+#endif
+
+struct u256 {
+	uint64_t w[4];
+};
+
+static inline void u256_load(struct u256 *v, const uint32_t *words)
+{
+	memcpy(v->w, words, 32);
+}
+
+static inline void u256_store(uint32_t *words, const struct u256 *v)
+{
+	memcpy(words, v->w, 32);
+}
+
+/* big endian byte array, as the old bignum ToString() + hex2bin() */
+static inline void u256_to_be(uint8_t *out, const struct u256 *v)
+{
+	for (int i = 0; i < 32; i++)
+		out[i] = (uint8_t) (v->w[3 - (i >> 3)] >> (56 - 8 * (i & 7)));
+}
+
+/* bit i set when a.w[i] > b.w[i], the highest differing word decides */
+U256_CONSTEXPR uint32_t u256_gtmask(const uint64_t *a, const uint64_t *b)
+{
+	return ((uint32_t) (a[3] > b[3]) << 3) | ((uint32_t) (a[2] > b[2]) << 2)
+		| ((uint32_t) (a[1] > b[1]) << 1) | (uint32_t) (a[0] > b[0]);
+}
+
+U256_CONSTEXPR bool u256_le(const struct u256 &a, const struct u256 &b)
+{
+	return u256_gtmask(a.w, b.w) <= u256_gtmask(b.w, a.w);
+}
+
+/* same as u256_le() for 8x32-bit little endian arrays (hash <= target) */
+static inline bool u256_le32(const uint32_t *a, const uint32_t *b)
+{
+#ifdef U256_SSE2
+	const __m128i bias = _mm_set1_epi32((int) 0x80000000);
+	__m128i a0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*) &a[0]), bias);
+	__m128i a1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*) &a[4]), bias);
+	__m128i b0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*) &b[0]), bias);
+	__m128i b1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*) &b[4]), bias);
+	int gt = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a0, b0)))
+	       | _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a1, b1))) << 4;
+	int lt = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(a0, b0)))
+	       | _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(a1, b1))) << 4;
+	return gt <= lt;
+#else
+	uint32_t gt = 0, lt = 0;
+	for (int i = 0; i < 8; i++) {
+		gt |= (uint32_t) (a[i] > b[i]) << i;
+		lt |= (uint32_t) (a[i] < b[i]) << i;
+	}
+	return gt <= lt;
+#endif
+}
+
+/* word i of (m << s), s in bits, can be negative */
+U256_CONSTEXPR uint64_t u256_shl_word(uint64_t m, int s, int i)
+{
+	return s < 0 ? (i == 0 ? (s > -64 ? m >> -s : 0) : 0)
+		: (s / 64 == i ? m << (s % 64)
+		: ((s / 64 + 1 == i && (s % 64)) ? m >> (64 - s % 64) : 0));
+}
+
+/* compact nbits to target word i, same result as CBigNum::SetCompact() */
+U256_CONSTEXPR uint64_t u256_compact_word(uint32_t nbits, int i)
+{
+	return u256_shl_word(nbits & 0x007fffff, 8 * ((int) (nbits >> 24) - 3), i);
+}
+
+static inline void u256_from_compact(struct u256 *v, uint32_t nbits)
+{
+	for (int i = 0; i < 4; i++)
+		v->w[i] = u256_compact_word(nbits, i);
+}
+
+/* same rounding as uint256::getdouble(), powers of 2 are exact */
+U256_CONSTEXPR double u256_getdouble(const struct u256 &v)
+{
+	return (double) (uint32_t) v.w[0]
+		+ 4294967296.0 * (uint32_t) (v.w[0] >> 32)
+		+ 18446744073709551616.0 * (uint32_t) v.w[1]
+		+ 79228162514264337593543950336.0 * (uint32_t) (v.w[1] >> 32)
+		+ 340282366920938463463374607431768211456.0 * (uint32_t) v.w[2]
+		+ 1461501637330902918203684832716283019655932542976.0 * (uint32_t) (v.w[2] >> 32)
+		+ 6277101735386680763835789423207666416102355444464034512896.0 * (uint32_t) v.w[3]
+		+ 26959946667150639794667015087019630673637144422540572481103610249216.0 * (uint32_t) (v.w[3] >> 32);
+}
+
+/* target/hash ratio, the found share diff is work diff * ratio */
+static inline double u256_target_ratio(const uint32_t *hash, const uint32_t *target)
+{
+	struct u256 h, t;
+	u256_load(&h, hash);
+	u256_load(&t, target);
+	double dhash = u256_getdouble(h);
+	return dhash > 0. ? u256_getdouble(t) / dhash : dhash;
+}
+
+U256_CONSTEXPR double u256_pow256(int n)
+{
+	return n == 0 ? 1.0 : n > 0 ? 256.0 * u256_pow256(n - 1) : u256_pow256(n + 1) / 256.0;
+}
+
+/* network difficulty of compact bits (diff 1 = 0x1d00ffff) */
+U256_CONSTEXPR double u256_nbits_to_diff(uint32_t nbits)
+{
+	return (double) 0x0000ffff / (double) (nbits & 0xffffff) * u256_pow256(29 - (int) (nbits >> 24));
+}
+
+#ifdef U256_HAVE_CONSTEXPR
+static_assert(u256_compact_word(0x1d00ffff, 3) == 0x00000000ffff0000ULL, "compact");
+static_assert(u256_compact_word(0x1d00ffff, 2) == 0, "compact");
+static_assert(u256_compact_word(0x1a05ea29, 3) == 0x00000000000005eaULL, "compact");
+static_assert(u256_compact_word(0x1a05ea29, 2) == 0x2900000000000000ULL, "compact");
+static_assert(u256_compact_word(0x02123456, 0) == 0x1234, "compact");
+static_assert(u256_nbits_to_diff(0x1d00ffff) == 1.0, "diff");
+#endif
+
+#endif /* U256_H */
@@ -34,12 +34,14 @@
 #include <netinet/tcp.h>
 #endif
 #include "miner.h"
+#include "u256.h"
 #include "elist.h"
 
 #include "crypto/xmr-rpc.h"
 
 extern pthread_mutex_t stratum_sock_lock;
 extern pthread_mutex_t stratum_work_lock;
+extern pthread_mutex_t stats_lock;
 extern bool opt_debug_diff;
 
 bool opt_tracegpu = false;
@@ -81,6 +83,11 @@ void applog(int prio, const char *fmt, ...)
 
 	va_start(ap, fmt);
 
+	if (opt_log_async && applog_async(prio, fmt, ap)) {
+		va_end(ap);
+		return;
+	}
+
 #ifdef HAVE_SYSLOG_H
 	if (use_syslog) {
 		va_list ap2;
@@ -419,25 +426,78 @@ static int sockopt_keepalive_cb(void *userdata, curl_socket_t fd,
 }
 #endif
 
-/* For getwork (longpoll or wallet) - not stratum pools!
- * DO NOT USE DIRECTLY
- */
-static json_t *json_rpc_call(CURL *curl, const char *url,
-		      const char *userpass, const char *rpc_req,
-		      bool longpoll_scan, bool longpoll, bool keepalive, int *curl_err)
+/* per method timings of the getwork/gbt requests, see the api "rpc" command */
+static struct rpc_timing rpc_timings[RPC_TIMING_MAX];
+static pthread_mutex_t rpc_timing_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void rpc_timing_add(const char *rpc_req, bool longpoll, double ms, bool ok)
+{
+	char method[sizeof(rpc_timings[0].method)] = { 0 };
+	const char *p = strstr(rpc_req, "\"method\"");
+	if (longpoll)
+		strcpy(method, "longpoll");
+	else if (p && (p = strchr(p + 8, '"'))) {
+		size_t len = strcspn(p + 1, "\"");
+		memcpy(method, p + 1, min(len, sizeof(method) - 1));
+	} else
+		strcpy(method, "unknown");
+
+	pthread_mutex_lock(&rpc_timing_lock);
+	for (int i = 0; i < RPC_TIMING_MAX; i++) {
+		struct rpc_timing *t = &rpc_timings[i];
+		if (t->method[0] && strcmp(t->method, method))
+			continue;
+		if (!t->method[0])
+			strcpy(t->method, method);
+		t->count++;
+		if (!ok) t->fails++;
+		t->last_ms = ms;
+		t->total_ms += ms;
+		t->max_ms = max(t->max_ms, ms);
+		break;
+	}
+	pthread_mutex_unlock(&rpc_timing_lock);
+}
+
+bool rpc_timing_get(int n, struct rpc_timing *out)
 {
-	json_t *val, *err_val, *res_val;
-	int rc;
-	struct data_buffer all_data = { 0 };
+	bool rc = false;
+	if (n < 0 || n >= RPC_TIMING_MAX)
+		return false;
+	pthread_mutex_lock(&rpc_timing_lock);
+	if (rpc_timings[n].method[0]) {
+		memcpy(out, &rpc_timings[n], sizeof(*out));
+		rc = true;
+	}
+	pthread_mutex_unlock(&rpc_timing_lock);
+	return rc;
+}
+
+/* state of one getwork/gbt request, kept until its transfer is done */
+struct rpc_call {
+	struct data_buffer all_data;
 	struct upload_buffer upload_data;
-	json_error_t err;
-	struct curl_slist *headers = NULL;
-	char *httpdata;
+	struct curl_slist *headers;
+	struct header_info hi;
+	char curl_err_str[CURL_ERROR_SIZE];
 	char len_hdr[64], hashrate_hdr[64];
-	char curl_err_str[CURL_ERROR_SIZE] = { 0 };
+	const char *rpc_req;
+	bool longpoll_scan;
+	bool longpoll;
+	bool null_result; /* submitblock, null is the accepted answer */
+	struct timeval tv_start;
+};
+
+static void rpc_call_setup(CURL *curl, struct rpc_call *rc, const char *url,
+		      const char *userpass, const char *rpc_req,
+		      bool longpoll_scan, bool longpoll, bool keepalive)
+{
 	long timeout = longpoll ? opt_timeout : opt_timeout/2;
-	struct header_info hi = { 0 };
-	bool lp_scanning = longpoll_scan && !have_longpoll;
+
+	memset(rc, 0, sizeof(*rc));
+	rc->rpc_req = rpc_req;
+	rc->longpoll_scan = longpoll_scan;
+	rc->longpoll = longpoll;
 
 	/* it is assumed that 'curl' is freshly [re]initialized at this pt */
 
@@ -454,18 +514,18 @@ static json_t *json_rpc_call(CURL *curl, const char *url,
 	curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
 	curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1);
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, all_data_cb);
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &all_data);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &rc->all_data);
 	curl_easy_setopt(curl, CURLOPT_READFUNCTION, upload_data_cb);
-	curl_easy_setopt(curl, CURLOPT_READDATA, &upload_data);
+	curl_easy_setopt(curl, CURLOPT_READDATA, &rc->upload_data);
 #if LIBCURL_VERSION_NUM >= 0x071200
 	curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, &seek_data_cb);
-	curl_easy_setopt(curl, CURLOPT_SEEKDATA, &upload_data);
+	curl_easy_setopt(curl, CURLOPT_SEEKDATA, &rc->upload_data);
 #endif
-	curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, curl_err_str);
+	curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, rc->curl_err_str);
 	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
 	curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
 	curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, resp_hdr_cb);
-	curl_easy_setopt(curl, CURLOPT_HEADERDATA, &hi);
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, &rc->hi);
 	if (opt_proxy) {
 		curl_easy_setopt(curl, CURLOPT_PROXY, opt_proxy);
 		curl_easy_setopt(curl, CURLOPT_PROXYTYPE, opt_proxy_type);
@@ -483,55 +543,72 @@ static json_t *json_rpc_call(CURL *curl, const char *url,
 	if (opt_protocol)
 		applog(LOG_DEBUG, "JSON protocol request:\n%s", rpc_req);
 
-	upload_data.buf = rpc_req;
-	upload_data.len = strlen(rpc_req);
-	upload_data.pos = 0;
-	sprintf(len_hdr, "Content-Length: %lu", (unsigned long) upload_data.len);
-	sprintf(hashrate_hdr, "X-Mining-Hashrate: %llu", (unsigned long long) global_hashrate);
+	rc->upload_data.buf = rpc_req;
+	rc->upload_data.len = strlen(rpc_req);
+	rc->upload_data.pos = 0;
+	curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long) rc->upload_data.len);
+	sprintf(rc->len_hdr, "Content-Length: %lu", (unsigned long) rc->upload_data.len);
+	sprintf(rc->hashrate_hdr, "X-Mining-Hashrate: %llu", (unsigned long long) global_hashrate);
 
-	headers = curl_slist_append(headers, "Content-Type: application/json");
-	headers = curl_slist_append(headers, len_hdr);
-	headers = curl_slist_append(headers, "User-Agent: " USER_AGENT);
-	headers = curl_slist_append(headers, "X-Mining-Extensions: longpoll noncerange reject-reason");
-	headers = curl_slist_append(headers, hashrate_hdr);
-	headers = curl_slist_append(headers, "Accept:"); /* disable Accept hdr*/
-	headers = curl_slist_append(headers, "Expect:"); /* disable Expect hdr*/
+	rc->headers = curl_slist_append(rc->headers, "Content-Type: application/json");
+	rc->headers = curl_slist_append(rc->headers, rc->len_hdr);
+	rc->headers = curl_slist_append(rc->headers, "User-Agent: " USER_AGENT);
+	rc->headers = curl_slist_append(rc->headers, "X-Mining-Extensions: longpoll noncerange reject-reason");
+	rc->headers = curl_slist_append(rc->headers, rc->hashrate_hdr);
+	rc->headers = curl_slist_append(rc->headers, "Accept:"); /* disable Accept hdr*/
+	rc->headers = curl_slist_append(rc->headers, "Expect:"); /* disable Expect hdr*/
 
-	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, rc->headers);
+
+	gettimeofday(&rc->tv_start, NULL);
+}
+
+/* parse the answer of a done transfer, res is the curl result code */
+static json_t *rpc_call_finish(CURL *curl, struct rpc_call *rc, int res, int *curl_err)
+{
+	json_t *val, *err_val, *res_val;
+	json_error_t err;
+	char *httpdata;
+	struct header_info *hi = &rc->hi;
+	bool lp_scanning = rc->longpoll_scan && !have_longpoll;
+	struct timeval tv_end, diff;
+
+	gettimeofday(&tv_end, NULL);
+	timeval_subtract(&diff, &tv_end, &rc->tv_start);
+	double ms = (1000.0 * diff.tv_sec) + (0.001 * diff.tv_usec);
 
-	rc = curl_easy_perform(curl);
 	if (curl_err != NULL)
-		*curl_err = rc;
-	if (rc) {
-		if (!(longpoll && rc == CURLE_OPERATION_TIMEDOUT)) {
-			applog(LOG_ERR, "HTTP request failed: %s", curl_err_str);
+		*curl_err = res;
+	if (res) {
+		if (!(rc->longpoll && res == CURLE_OPERATION_TIMEDOUT)) {
+			applog(LOG_ERR, "HTTP request failed: %s", rc->curl_err_str);
 			goto err_out;
 		}
 	}
 
 	/* If X-Stratum was found, activate Stratum */
-	if (want_stratum && hi.stratum_url &&
-	    !strncasecmp(hi.stratum_url, "stratum+tcp://", 14) &&
+	if (want_stratum && hi->stratum_url &&
+	    !strncasecmp(hi->stratum_url, "stratum+tcp://", 14) &&
 	    !(opt_proxy && opt_proxy_type == CURLPROXY_HTTP)) {
 		have_stratum = true;
-		tq_push(thr_info[stratum_thr_id].q, hi.stratum_url);
-		hi.stratum_url = NULL;
+		tq_push(thr_info[stratum_thr_id].q, hi->stratum_url);
+		hi->stratum_url = NULL;
 	}
 
 	/* If X-Long-Polling was found, activate long polling */
-	if (lp_scanning && hi.lp_path && !have_stratum) {
+	if (lp_scanning && hi->lp_path && !have_stratum) {
 		have_longpoll = true;
-		tq_push(thr_info[longpoll_thr_id].q, hi.lp_path);
-		hi.lp_path = NULL;
+		tq_push(thr_info[longpoll_thr_id].q, hi->lp_path);
+		hi->lp_path = NULL;
 	}
 
-	if (!all_data.buf || !all_data.len) {
+	if (!rc->all_data.buf || !rc->all_data.len) {
 		if (!have_longpoll) // seems normal on longpoll timeout
 			applog(LOG_ERR, "Empty data received in json_rpc_call.");
 		goto err_out;
 	}
 
-	httpdata = (char*) all_data.buf;
+	httpdata = (char*) rc->all_data.buf;
 
 	if (*httpdata != '{' && *httpdata != '[') {
 		long errcode = 0;
@@ -561,7 +638,7 @@ static json_t *json_rpc_call(CURL *curl, const char *url,
 	res_val = json_object_get(val, "result");
 	err_val = json_object_get(val, "error");
 
-	if (!res_val || json_is_null(res_val) ||
+	if (!res_val || (json_is_null(res_val) && !rc->null_result) ||
 	    (err_val && !json_is_null(err_val))) {
 		char *s = NULL;
 
@@ -594,24 +671,41 @@ static json_t *json_rpc_call(CURL *curl, const char *url,
 		goto err_out;
 	}
 
-	if (hi.reason)
-		json_object_set_new(val, "reject-reason", json_string(hi.reason));
+	if (hi->reason)
+		json_object_set_new(val, "reject-reason", json_string(hi->reason));
 
-	databuf_free(&all_data);
-	curl_slist_free_all(headers);
+	rpc_timing_add(rc->rpc_req, rc->longpoll, ms, true);
+	databuf_free(&rc->all_data);
+	curl_slist_free_all(rc->headers);
 	curl_easy_reset(curl);
 	return val;
 
 err_out:
-	free(hi.lp_path);
-	free(hi.reason);
-	free(hi.stratum_url);
-	databuf_free(&all_data);
-	curl_slist_free_all(headers);
+	rpc_timing_add(rc->rpc_req, rc->longpoll, ms, false);
+	free(hi->lp_path);
+	free(hi->reason);
+	free(hi->stratum_url);
+	databuf_free(&rc->all_data);
+	curl_slist_free_all(rc->headers);
 	curl_easy_reset(curl);
 	return NULL;
 }
 
+/* For getwork (longpoll or wallet) - not stratum pools!
+ * DO NOT USE DIRECTLY
+ */
+static json_t *json_rpc_call(CURL *curl, const char *url,
+		      const char *userpass, const char *rpc_req,
+		      bool longpoll_scan, bool longpoll, bool keepalive, int *curl_err)
+{
+	struct rpc_call rc;
+	int res;
+
+	rpc_call_setup(curl, &rc, url, userpass, rpc_req, longpoll_scan, longpoll, keepalive);
+	res = curl_easy_perform(curl);
+	return rpc_call_finish(curl, &rc, res, curl_err);
+}
+
 /* getwork calls with pool pointer (wallet/longpoll pools) */
 json_t *json_rpc_call_pool(CURL *curl, struct pool_infos *pool, const char *req,
 	bool longpoll_scan, bool longpoll, int *curl_err)
@@ -637,6 +731,87 @@ json_t *json_rpc_longpoll(CURL *curl, char *lp_url, struct pool_infos *pool, con
 	return json_rpc_call(curl, lp_url, userpass, req, false, true, keepalive, curl_err);
 }
 
+/* submitblock, the reply is also returned with a null result (accepted) */
+json_t *json_rpc_submit_pool(CURL *curl, struct pool_infos *pool, const char *req, int *curl_err)
+{
+	struct rpc_call rc;
+	char userpass[768];
+	int res;
+
+	snprintf(userpass, sizeof(userpass), "%s%c%s", pool->user,
+		strlen(pool->pass)?':':'\0', pool->pass);
+
+	rpc_call_setup(curl, &rc, pool->url, userpass, req, false, false, false);
+	rc.null_result = true;
+	res = curl_easy_perform(curl);
+	return rpc_call_finish(curl, &rc, res, curl_err);
+}
+
+/* run count getwork/gbt requests together on the pool, the connections of
+ * the multi handle are kept alive between the calls. with getwork, the
+ * first request is the getwork one (which can enable the longpoll) */
+int json_rpc_call_multi(CURLM *multi, CURL **curls, struct pool_infos *pool,
+	const char **reqs, json_t **vals, int *curl_errs, int count, bool getwork)
+{
+	struct rpc_call rc[RPC_MULTI_MAX];
+	char userpass[768];
+	int done = 0;
+
+	if (count > RPC_MULTI_MAX)
+		count = RPC_MULTI_MAX;
+	snprintf(userpass, sizeof(userpass), "%s%c%s", pool->user,
+		strlen(pool->pass)?':':'\0', pool->pass);
+
+#if LIBCURL_VERSION_NUM >= 0x071c00
+	int running = 0;
+	int res[RPC_MULTI_MAX];
+	for (int i = 0; i < count; i++) {
+		// the first request can enable the longpoll, like getwork. As in
+		// json_rpc_call_pool(), these are never the longpoll request itself
+		// (short timeout, timed under their method name)
+		rpc_call_setup(curls[i], &rc[i], pool->url, userpass, reqs[i],
+			i == 0 && getwork && want_longpoll, false, false);
+		res[i] = CURLE_FAILED_INIT;
+		curl_multi_add_handle(multi, curls[i]);
+	}
+
+	do {
+		CURLMcode mc = curl_multi_perform(multi, &running);
+		if (mc == CURLM_OK && running)
+			mc = curl_multi_wait(multi, NULL, 0, 1000, NULL);
+		if (mc != CURLM_OK) {
+			applog(LOG_ERR, "HTTP multi request failed: %s", curl_multi_strerror(mc));
+			break;
+		}
+	} while (running && !abort_flag);
+
+	CURLMsg *msg;
+	int left = 0;
+	while ((msg = curl_multi_info_read(multi, &left))) {
+		if (msg->msg != CURLMSG_DONE)
+			continue;
+		for (int i = 0; i < count; i++) {
+			if (msg->easy_handle == curls[i])
+				res[i] = msg->data.result;
+		}
+	}
+
+	for (int i = 0; i < count; i++) {
+		curl_multi_remove_handle(multi, curls[i]);
+		vals[i] = rpc_call_finish(curls[i], &rc[i], res[i], &curl_errs[i]);
+		if (vals[i]) done++;
+	}
+#else
+	/* no curl_multi_wait(), one after the other */
+	for (int i = 0; i < count; i++) {
+		vals[i] = json_rpc_call(curls[i], pool->url, userpass, reqs[i],
+			i == 0 && getwork && want_longpoll, false, false, &curl_errs[i]);
+		if (vals[i]) done++;
+	}
+#endif
+	return done;
+}
+
 json_t *json_load_url(char* cfg_url, json_error_t *err)
 {
 	char err_str[CURL_ERROR_SIZE] = { 0 };
@@ -709,12 +884,16 @@ void aligned_free(void *ptr)
 #endif
 }
 
+static const char hexdigits[] = "0123456789abcdef";
+
 void cbin2hex(char *out, const char *in, size_t len)
 {
-	if (out) {
-		unsigned int i;
-		for (i = 0; i < len; i++)
-			sprintf(out + (i * 2), "%02x", (uint8_t)in[i]);
+	if (out && len) {
+		for (size_t i = 0; i < len; i++) {
+			out[2*i]   = hexdigits[(uint8_t)in[i] >> 4];
+			out[2*i+1] = hexdigits[(uint8_t)in[i] & 0xf];
+		}
+		out[2*len] = '\0';
 	}
 }
 
@@ -729,26 +908,42 @@ char *bin2hex(const uchar *in, size_t len)
 	return s;
 }
 
-bool hex2bin(void *output, const char *hexstr, size_t len)
+static inline int hexval(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+/* decode len bytes of a string which is not nul terminated */
+static bool hex2bin_n(void *output, const char *hexstr, size_t len)
 {
 	uchar *p = (uchar *) output;
-	char hex_byte[4];
-	char *ep;
+	for (size_t i = 0; i < len; i++) {
+		int h = hexval(hexstr[2*i]), l = hexval(hexstr[2*i+1]);
+		if ((h | l) < 0)
+			return false;
+		p[i] = (uchar) ((h << 4) | l);
+	}
+	return true;
+}
 
-	hex_byte[2] = '\0';
+bool hex2bin(void *output, const char *hexstr, size_t len)
+{
+	uchar *p = (uchar *) output;
 
 	while (*hexstr && len) {
 		if (!hexstr[1]) {
 			applog(LOG_ERR, "hex2bin str truncated");
 			return false;
 		}
-		hex_byte[0] = hexstr[0];
-		hex_byte[1] = hexstr[1];
-		*p = (uchar) strtol(hex_byte, &ep, 16);
-		if (*ep) {
-			applog(LOG_ERR, "hex2bin failed on '%s'", hex_byte);
+		int h = hexval(hexstr[0]), l = hexval(hexstr[1]);
+		if ((h | l) < 0) {
+			applog(LOG_ERR, "hex2bin failed on '%c%c'", hexstr[0], hexstr[1]);
 			return false;
 		}
+		*p = (uchar) ((h << 4) | l);
 		p++;
 		hexstr += 2;
 		len--;
@@ -787,21 +982,7 @@ int timeval_subtract(struct timeval *result, struct timeval *x,
 bool fulltest(const uint32_t *hash, const uint32_t *target)
 {
 	int i;
-	bool rc = true;
-	
-	for (i = 7; i >= 0; i--) {
-		if (hash[i] > target[i]) {
-			rc = false;
-			break;
-		}
-		if (hash[i] < target[i]) {
-			rc = true;
-			break;
-		}
-		if (hash[1] == target[1]) {
-			applog(LOG_NOTICE, "We found a close match!");
-		}
-	}
+	bool rc = u256_le32(hash, target);
 
 	if ((!rc && opt_debug) || opt_debug_diff) {
 		uint32_t hash_be[8], target_be[8];
@@ -1105,21 +1286,25 @@ bool stratum_connect(struct stratum_ctx *sctx, const char *url)
 
 void stratum_free_job(struct stratum_ctx *sctx)
 {
-	pthread_mutex_lock(&stratum_work_lock);
-	if (sctx->job.job_id) {
-		free(sctx->job.job_id);
-	}
-	if (sctx->job.merkle_count) {
-		for (int i = 0; i < sctx->job.merkle_count; i++) {
-			free(sctx->job.merkle[i]);
-			sctx->job.merkle[i] = NULL;
+	stratum_job_publish(sctx, NULL);
+	sctx->shares_count = 0;
+	sctx->block_height = 0;
+}
+
+/* resize the job coinbase, only grows, before the job is published */
+bool stratum_job_coinbase(struct stratum_job *job, size_t size)
+{
+	if (size > job->coinbase_alloc) {
+		uchar *cb = (uchar*) realloc(job->coinbase, size);
+		if (!cb) {
+			applog(LOG_ERR, "Stratum notify: coinbase alloc failed");
+			return false;
 		}
-		free(sctx->job.merkle);
+		job->coinbase = cb;
+		job->coinbase_alloc = size;
 	}
-	free(sctx->job.coinbase);
-	// note: xnonce2 is not allocated
-	memset(&(sctx->job.job_id), 0, sizeof(struct stratum_job));
-	pthread_mutex_unlock(&stratum_work_lock);
+	job->coinbase_size = size;
+	return true;
 }
 
 void stratum_disconnect(struct stratum_ctx *sctx)
@@ -1134,7 +1319,7 @@ void stratum_disconnect(struct stratum_ctx *sctx)
 		// free(sctx->sockbuf);
 		// sctx->sockbuf = NULL;
 	}
-	if (sctx->job.job_id) {
+	if (sctx->pub_job) {
 		stratum_free_job(sctx);
 	}
 	pthread_mutex_unlock(&stratum_sock_lock);
@@ -1413,13 +1598,13 @@ out:
  * Extract bloc height     L H... here len=3, height=0x1333e8
  * "...0000000000ffffffff2703e83313062f503253482f043d61105408"
  */
-static uint32_t getblocheight(struct stratum_ctx *sctx)
+static uint32_t getblocheight(struct stratum_job *job)
 {
 	uint32_t height = 0;
 	uint8_t hlen = 0, *p, *m;
 
 	// find 0xffff tag
-	p = (uint8_t*) sctx->job.coinbase + 32;
+	p = (uint8_t*) job->coinbase + 32;
 	m = p + 128;
 	while (*p != 0xff && p < m) p++;
 	while (*p == 0xff && p < m) p++;
@@ -1439,62 +1624,63 @@ static uint32_t getblocheight(struct stratum_ctx *sctx)
 	return height;
 }
 
-static bool stratum_notify(struct stratum_ctx *sctx, json_t *params)
+/* the string params are spans of the line, or of the jansson values */
+static bool stratum_notify_job(struct stratum_ctx *sctx, const struct sjson_val *param, int count,
+	const struct sjson_val *merkle_items)
 {
-	const char *job_id, *prevhash, *coinb1, *coinb2, *version, *nbits, *stime;
-	const char *extradata = NULL, *nreward = NULL;
+	static const struct sjson_val none = { 0 };
+	const struct sjson_val *job_id, *prevhash, *coinb1, *coinb2, *merkle_arr;
+	const struct sjson_val *version, *nbits, *stime, *nreward, *extradata = NULL;
+	struct sjson_val items[STRATUM_MAX_MERKLE];
+	uchar merkle[STRATUM_MAX_MERKLE][32];
 	size_t coinb1_size, coinb2_size;
-	bool clean, ret = false;
-	int merkle_count, i, p=0;
-	json_t *merkle_arr;
-	uchar **merkle = NULL;
-	// uchar(*merkle_tree)[32] = { 0 };
+	bool clean;
+	int merkle_count, i, p = 0;
 	int ntime;
 	char algo[64] = { 0 };
 	get_currentalgo(algo, sizeof(algo));
 	bool has_claim = !strcmp(algo, "lbry");
-	bool has_roots = !strcmp(algo, "phi2") && json_array_size(params) == 10;
-
-	if (sctx->is_equihash) {
-		return equi_stratum_notify(sctx, params);
-	}
+	bool has_roots = !strcmp(algo, "phi2") && count == 10;
 
-	job_id = json_string_value(json_array_get(params, p++));
-	prevhash = json_string_value(json_array_get(params, p++));
+#define NEXT_PARAM (p < count ? &param[p++] : (p++, &none))
+	job_id = NEXT_PARAM;
+	prevhash = NEXT_PARAM;
 	if (has_claim) {
-		extradata = json_string_value(json_array_get(params, p++));
-		if (!extradata || strlen(extradata) != 64) {
+		extradata = NEXT_PARAM;
+		if (extradata->type != SJSON_STRING || extradata->len != 64) {
 			applog(LOG_ERR, "Stratum notify: invalid claim parameter");
-			goto out;
+			return false;
 		}
 	} else if (has_roots) {
-		extradata = json_string_value(json_array_get(params, p++));
-		if (!extradata || strlen(extradata) != 128) {
+		extradata = NEXT_PARAM;
+		if (extradata->type != SJSON_STRING || extradata->len != 128) {
 			applog(LOG_ERR, "Stratum notify: invalid UTXO root parameter");
-			goto out;
+			return false;
 		}
 	}
-	coinb1 = json_string_value(json_array_get(params, p++));
-	coinb2 = json_string_value(json_array_get(params, p++));
-	merkle_arr = json_array_get(params, p++);
-	if (!merkle_arr || !json_is_array(merkle_arr))
-		goto out;
-	merkle_count = (int) json_array_size(merkle_arr);
-	version = json_string_value(json_array_get(params, p++));
-	nbits = json_string_value(json_array_get(params, p++));
-	stime = json_string_value(json_array_get(params, p++));
-	clean = json_is_true(json_array_get(params, p)); p++;
-	nreward = json_string_value(json_array_get(params, p++));
-
-	if (!job_id || !prevhash || !coinb1 || !coinb2 || !version || !nbits || !stime ||
-	    strlen(prevhash) != 64 || strlen(version) != 8 ||
-	    strlen(nbits) != 8 || strlen(stime) != 8) {
+	coinb1 = NEXT_PARAM;
+	coinb2 = NEXT_PARAM;
+	merkle_arr = NEXT_PARAM;
+	if (merkle_arr->type != SJSON_ARRAY)
+		return false;
+	version = NEXT_PARAM;
+	nbits = NEXT_PARAM;
+	stime = NEXT_PARAM;
+	clean = (NEXT_PARAM)->type == SJSON_TRUE;
+	nreward = NEXT_PARAM;
+#undef NEXT_PARAM
+
+	if (job_id->type != SJSON_STRING || prevhash->type != SJSON_STRING ||
+	    coinb1->type != SJSON_STRING || coinb2->type != SJSON_STRING ||
+	    version->type != SJSON_STRING || nbits->type != SJSON_STRING || stime->type != SJSON_STRING ||
+	    prevhash->len != 64 || version->len != 8 ||
+	    nbits->len != 8 || stime->len != 8) {
 		applog(LOG_ERR, "Stratum notify: invalid parameters");
-		goto out;
+		return false;
 	}
 
 	/* store stratum server time diff */
-	hex2bin((uchar *)&ntime, stime, 4);
+	hex2bin_n((uchar *)&ntime, stime->p, 4);
 	ntime = swab32(ntime) - (uint32_t) time(0);
 	if (ntime > sctx->srvtime_diff) {
 		sctx->srvtime_diff = ntime;
@@ -1502,69 +1688,113 @@ static bool stratum_notify(struct stratum_ctx *sctx, json_t *params)
 			applog(LOG_DEBUG, "stratum time is at least %ds in the future", ntime);
 	}
 
-	if (merkle_count)
-		merkle = (uchar**) malloc(merkle_count * sizeof(char *));
+	merkle_count = merkle_arr->count;
+	if (merkle_count > STRATUM_MAX_MERKLE) {
+		applog(LOG_ERR, "Stratum notify: too many Merkle branches (%d)", merkle_count);
+		return false;
+	}
+	if (!merkle_items) {
+		sjson_array_get(merkle_arr, items, STRATUM_MAX_MERKLE);
+		merkle_items = items;
+	}
 	for (i = 0; i < merkle_count; i++) {
-		const char *s = json_string_value(json_array_get(merkle_arr, i));
-		if (!s || strlen(s) != 64) {
-			while (i--)
-				free(merkle[i]);
-			free(merkle);
+		if (merkle_items[i].type != SJSON_STRING || merkle_items[i].len != 64 ||
+		    !hex2bin_n(merkle[i], merkle_items[i].p, 32)) {
 			applog(LOG_ERR, "Stratum notify: invalid Merkle branch");
-			goto out;
+			return false;
 		}
-		merkle[i] = (uchar*) malloc(32);
-		hex2bin(merkle[i], s, 32);
 	}
 
-	pthread_mutex_lock(&stratum_work_lock);
+	// built off-lock, the readers still use the current job
+	struct stratum_job *job = stratum_job_new();
+	if (!job)
+		return false;
+
+	coinb1_size = coinb1->len / 2;
+	coinb2_size = coinb2->len / 2;
+	if (!stratum_job_coinbase(job, coinb1_size + sctx->xnonce1_size +
+	                          sctx->xnonce2_size + coinb2_size)) {
+		stratum_job_discard(job);
+		return false;
+	}
 
-	coinb1_size = strlen(coinb1) / 2;
-	coinb2_size = strlen(coinb2) / 2;
-	sctx->job.coinbase_size = coinb1_size + sctx->xnonce1_size +
-	                          sctx->xnonce2_size + coinb2_size;
+	job->xnonce1_size = sctx->xnonce1_size;
+	job->xnonce2_size = sctx->xnonce2_size;
+	job->xnonce2 = job->coinbase + coinb1_size + sctx->xnonce1_size;
+	hex2bin_n(job->coinbase, coinb1->p, coinb1_size);
+	memcpy(job->coinbase + coinb1_size, sctx->xnonce1, sctx->xnonce1_size);
+	memset(job->xnonce2, 0, sctx->xnonce2_size);
+	hex2bin_n(job->xnonce2 + sctx->xnonce2_size, coinb2->p, coinb2_size);
+
+	// a longer id was always cut in the work job_id (after the ntime prefix)
+	int job_id_len = min(job_id->len, STRATUM_MAX_JOBID - 1);
+	if (job_id_len < job_id->len && opt_debug)
+		applog(LOG_DEBUG, "Stratum notify: job id cut to %d chars", job_id_len);
+	memcpy(job->job_id, job_id->p, job_id_len);
+	job->job_id[job_id_len] = '\0';
+	hex2bin_n(job->prevhash, prevhash->p, 32);
+	if (has_claim) hex2bin_n(job->extra, extradata->p, 32);
+	if (has_roots) hex2bin_n(job->extra, extradata->p, 64);
+
+	if (!strcmp(algo, "decred") && coinb1_size >= 96)
+		job->height = le32dec(job->coinbase + 92); // header height, data[32] of the work
+	else
+		job->height = getblocheight(job);
 
-	sctx->job.coinbase = (uchar*) realloc(sctx->job.coinbase, sctx->job.coinbase_size);
-	sctx->job.xnonce2 = sctx->job.coinbase + coinb1_size + sctx->xnonce1_size;
-	hex2bin(sctx->job.coinbase, coinb1, coinb1_size);
-	memcpy(sctx->job.coinbase + coinb1_size, sctx->xnonce1, sctx->xnonce1_size);
+	memcpy(job->merkle, merkle, 32 * merkle_count);
+	job->merkle_count = merkle_count;
 
-	if (!sctx->job.job_id || strcmp(sctx->job.job_id, job_id))
-		memset(sctx->job.xnonce2, 0, sctx->xnonce2_size);
-	hex2bin(sctx->job.xnonce2 + sctx->xnonce2_size, coinb2, coinb2_size);
+	hex2bin_n(job->version, version->p, 4);
+	hex2bin_n(job->nbits, nbits->p, 4);
+	hex2bin_n(job->ntime, stime->p, 4);
+	if (nreward->type == SJSON_STRING && nreward->len == 4)
+		hex2bin_n(job->nreward, nreward->p, 2);
+	job->clean = clean;
 
-	free(sctx->job.job_id);
-	sctx->job.job_id = strdup(job_id);
-	hex2bin(sctx->job.prevhash, prevhash, 32);
-	if (has_claim) hex2bin(sctx->job.extra, extradata, 32);
-	if (has_roots) hex2bin(sctx->job.extra, extradata, 64);
+	job->diff = sctx->next_diff;
 
-	sctx->job.height = getblocheight(sctx);
+	stratum_job_publish(sctx, job);
 
-	for (i = 0; i < sctx->job.merkle_count; i++)
-		free(sctx->job.merkle[i]);
-	free(sctx->job.merkle);
-	sctx->job.merkle = merkle;
-	sctx->job.merkle_count = merkle_count;
+	return true;
+}
 
-	hex2bin(sctx->job.version, version, 4);
-	hex2bin(sctx->job.nbits, nbits, 4);
-	hex2bin(sctx->job.ntime, stime, 4);
-	if(nreward != NULL)
-	{
-		if(strlen(nreward) == 4)
-			hex2bin(sctx->job.nreward, nreward, 2);
+static void json_to_sjson(json_t *v, struct sjson_val *sv)
+{
+	memset(sv, 0, sizeof(*sv));
+	if (json_is_string(v)) {
+		sv->p = json_string_value(v);
+		sv->len = (int) strlen(sv->p);
+		sv->type = SJSON_STRING;
+	} else if (json_is_array(v)) {
+		sv->count = (int) json_array_size(v);
+		sv->type = SJSON_ARRAY;
+	} else if (json_is_true(v)) {
+		sv->type = SJSON_TRUE;
 	}
-	sctx->job.clean = clean;
-
-	sctx->job.diff = sctx->next_diff;
+}
 
-	pthread_mutex_unlock(&stratum_work_lock);
+/* jansson fallback (not handled by stratum_msg_parse) */
+static bool stratum_notify(struct stratum_ctx *sctx, json_t *params)
+{
+	struct sjson_val param[STRATUM_MSG_PARAMS];
+	struct sjson_val merkle[STRATUM_MAX_MERKLE];
+	int count = (int) json_array_size(params);
 
-	ret = true;
+	if (sctx->is_equihash) {
+		return equi_stratum_notify(sctx, params);
+	}
 
-out:
-	return ret;
+	count = min(count, STRATUM_MSG_PARAMS);
+	for (int i = 0; i < count; i++) {
+		json_t *val = json_array_get(params, i);
+		json_to_sjson(val, &param[i]);
+		if (param[i].type == SJSON_ARRAY) {
+			int n = min(param[i].count, STRATUM_MAX_MERKLE);
+			for (int m = 0; m < n; m++)
+				json_to_sjson(json_array_get(val, m), &merkle[m]);
+		}
+	}
+	return stratum_notify_job(sctx, param, count, merkle);
 }
 
 extern volatile time_t g_work_time;
@@ -1656,7 +1886,10 @@ extern int cuda_arch[MAX_GPUS];
 void gpu_increment_reject(int thr_id)
 {
 	struct cgpu_info *gpu = &thr_info[thr_id].gpu;
+	pthread_mutex_lock(&stats_lock);
 	if (gpu) gpu->rejected++;
+	pthread_mutex_unlock(&stats_lock);
+	vstats_false_pos(thr_id);
 }
 
 static bool json_object_set_error(json_t *result, int code, const char *msg)
@@ -1838,6 +2071,36 @@ static bool stratum_unknown_method(struct stratum_ctx *sctx, json_t *id)
 	return ret;
 }
 
+bool stratum_fast_json = true;
+
+/* the frequent messages without jansson, -1 if not handled */
+static int stratum_fast_method(struct stratum_ctx *sctx, const char *s)
+{
+	struct stratum_msg msg;
+
+	if (!stratum_msg_parse(s, &msg))
+		return -1;
+	if (msg.method.type == SJSON_INVALID)
+		return 0; // a response
+	if (sjson_is(&msg.method, "mining.notify") && !sctx->is_equihash && !sctx->rpc2) {
+		if (msg.params.type != SJSON_ARRAY)
+			return 0;
+		if (msg.params_count && msg.param[0].len >= STRATUM_MAX_JOBID)
+			return -1; // long job id, left to jansson
+		return stratum_notify_job(sctx, msg.param, msg.params_count, NULL) ? 1 : 0;
+	}
+	if (sjson_is(&msg.method, "mining.set_difficulty")) {
+		double diff = msg.params_count ? sjson_number(&msg.param[0]) : 0.;
+		if (diff <= 0.0)
+			return 0;
+		pthread_mutex_lock(&stratum_work_lock);
+		sctx->next_diff = diff;
+		pthread_mutex_unlock(&stratum_work_lock);
+		return 1;
+	}
+	return -1;
+}
+
 bool stratum_handle_method(struct stratum_ctx *sctx, const char *s)
 {
 	json_t *val, *id, *params;
@@ -1845,6 +2108,12 @@ bool stratum_handle_method(struct stratum_ctx *sctx, const char *s)
 	const char *method;
 	bool ret = false;
 
+	if (stratum_fast_json) {
+		int rc = stratum_fast_method(sctx, s);
+		if (rc >= 0)
+			return rc > 0;
+	}
+
 	val = JSON_LOADS(s, &err);
 	if (!val) {
 		applog(LOG_ERR, "JSON decode failed(%d): %s", err.line, err.text);
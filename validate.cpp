@@ -0,0 +1,278 @@
+/**
+ * Asynchronous cpu validation of the gpu results (--cpu-validate=N)
+ *
+ * The scan threads push their candidate nonces with a copy of the work and
+ * of the hash input, then continue to launch their kernels. N cpu threads
+ * compute the reference hashes: the valid nonces are submitted like the
+ * miner thread does, the others are counted as gpu rejects.
+ *
+ * The producers only need a work, a be32 encoded 80 bytes header and the
+ * cpu hash function, the queue is bounded to keep the memory in check when
+ * the cpu is slower than the gpus (the producers then check their nonces).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#include "miner.h"
+#include "algos.h"
+
+#define VALIDATE_MAX_QUEUED 256
+
+int opt_validate_threads = 0;
+
+struct validate_req {
+	struct work work;
+	uint32_t data[20];
+	uint32_t nonce;
+	int thr_id;
+	cpu_hash_fn hash;
+};
+
+static struct thread_q *vq = NULL;
+static pthread_t *vthreads = NULL;
+static int vthreads_count = 0;
+static volatile bool vrunning = false;
+
+static pthread_mutex_t vlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t vcond = PTHREAD_COND_INITIALIZER;
+static int vqueued = 0;
+
+// selftest, the results are only counted
+static bool vtest = false;
+static std::atomic<uint32_t> vtest_valid(0), vtest_rejected(0);
+
+static void validate_check(struct validate_req *req)
+{
+	struct work *work = &req->work;
+	uint32_t _ALIGN(64) vhash[8];
+
+	be32enc(&req->data[19], req->nonce);
+	vstats_hash(req->thr_id, req->hash(vhash, req->data));
+
+	bool valid = vhash[7] <= work->target[7] && fulltest(vhash, work->target);
+	if (vtest) {
+		if (valid) vtest_valid++;
+		else vtest_rejected++;
+		return;
+	}
+	if (valid) {
+		work_set_target_ratio(work, vhash);
+		if (!submit_gpu_nonce(req->thr_id, work, req->nonce))
+			gpulog(LOG_ERR, req->thr_id, "unable to submit nonce %08x", req->nonce);
+	} else {
+		gpu_increment_reject(req->thr_id);
+		if (!opt_quiet)
+			gpulog(LOG_WARNING, req->thr_id, "result for %08x does not validate on CPU!", req->nonce);
+	}
+}
+
+static void *validate_thread(void *userdata)
+{
+	while (1) {
+		struct validate_req *req = (struct validate_req *) tq_pop(vq, NULL);
+		if (!req) {
+			if (!vrunning)
+				break;
+			continue;
+		}
+		if (vrunning)
+			validate_check(req);
+		aligned_free(req);
+
+		pthread_mutex_lock(&vlock);
+		if (!--vqueued)
+			pthread_cond_broadcast(&vcond);
+		pthread_mutex_unlock(&vlock);
+	}
+	return NULL;
+}
+
+/* wait for the queued results */
+static void validate_drain()
+{
+	pthread_mutex_lock(&vlock);
+	while (vqueued > 0 && vrunning)
+		pthread_cond_wait(&vcond, &vlock);
+	pthread_mutex_unlock(&vlock);
+}
+
+bool validate_async()
+{
+	return vrunning;
+}
+
+/* the algos pushing their results, see validate_push_nonces(),
+ * the others (cryptonight, scrypt-jane...) still check them inline */
+bool validate_algo_supported(int algo)
+{
+	switch (algo) {
+	case ALGO_ALLIUM:
+	case ALGO_LYRA2Z:
+	case ALGO_PHI2:
+	case ALGO_X11:
+		return true;
+	}
+	return false;
+}
+
+bool validate_push(int thr_id, const struct work *work, const uint32_t *endiandata,
+	uint32_t nonce, cpu_hash_fn hash)
+{
+	struct validate_req *req;
+
+	if (!vrunning)
+		return false;
+
+	req = (struct validate_req *) aligned_calloc(sizeof(*req));
+	if (!req) {
+		gpulog(LOG_ERR, thr_id, "validation queue: out of memory");
+		return false;
+	}
+	memcpy(&req->work, work, sizeof(struct work));
+	memcpy(req->data, endiandata, sizeof(req->data));
+	req->nonce = nonce;
+	req->thr_id = thr_id;
+	req->hash = hash;
+
+	pthread_mutex_lock(&vlock);
+	bool queued = vqueued < VALIDATE_MAX_QUEUED && vrunning;
+	if (queued)
+		vqueued++;
+	pthread_mutex_unlock(&vlock);
+
+	if (queued && !tq_push(vq, req)) {
+		pthread_mutex_lock(&vlock);
+		if (!--vqueued)
+			pthread_cond_broadcast(&vcond);
+		pthread_mutex_unlock(&vlock);
+		queued = false;
+	}
+	if (!queued) {
+		// queue full, checked in the producer thread
+		validate_check(req);
+		aligned_free(req);
+	}
+	return true;
+}
+
+/**
+ * Validate the count first nonces of the scanned work, the scan continues
+ * after them. Return true when the work nonce range is done.
+ */
+bool validate_push_nonces(int thr_id, struct work *work, uint32_t *endiandata,
+	int count, uint32_t max_nonce, cpu_hash_fn hash)
+{
+	uint32_t next = 0;
+	for (int i = 0; i < count; i++) {
+		// the nonces past max_nonce are in the lease of another thread
+		if (nonce_in_lease(thr_id, work->nonces[i]))
+			validate_push(thr_id, work, endiandata, work->nonces[i], hash);
+		next = max(next, work->nonces[i] + 1);
+	}
+	work->data[19] = min(next, max_nonce);
+	return work->data[19] >= max_nonce;
+}
+
+bool validate_start(int nthreads)
+{
+	if (!vq)
+		vq = tq_new();
+	vthreads = (pthread_t *) calloc(nthreads, sizeof(pthread_t));
+	if (!vq || !vthreads) {
+		applog(LOG_ERR, "validation threads: out of memory");
+		return false;
+	}
+	vrunning = true;
+	for (vthreads_count = 0; vthreads_count < nthreads; vthreads_count++) {
+		if (pthread_create(&vthreads[vthreads_count], NULL, validate_thread, NULL)) {
+			applog(LOG_ERR, "validation thread create failed");
+			validate_stop();
+			return false;
+		}
+	}
+	if (!vtest)
+		applog(LOG_INFO, "%d cpu threads will validate the gpu results", nthreads);
+	return true;
+}
+
+void validate_stop()
+{
+	if (!vq)
+		return;
+
+	pthread_mutex_lock(&vlock);
+	vrunning = false;
+	pthread_cond_broadcast(&vcond);
+	pthread_mutex_unlock(&vlock);
+
+	// wake each thread, the pending results are dropped
+	for (int i = 0; i < vthreads_count; i++)
+		tq_push(vq, NULL);
+	for (int i = 0; i < vthreads_count; i++)
+		pthread_join(vthreads[i], NULL);
+
+	free(vthreads);
+	vthreads = NULL;
+	vthreads_count = 0;
+}
+
+/* synthetic producer hash, the odd nonces are above the target */
+static void validate_test_hash(void *output, const void *input)
+{
+	const uint32_t *data = (const uint32_t *) input;
+	memset(output, (be32dec(&data[19]) & 1) ? 0xff : 0, 32);
+}
+
+/**
+ * --selftest, the nonces are pushed before the threads start: the first
+ * ones fill the queue, the others are checked in the producer thread
+ */
+int validate_selftest(void)
+{
+	const int count = 4 * VALIDATE_MAX_QUEUED;
+	uint32_t _ALIGN(64) endiandata[20] = { 0 };
+	uint32_t inline_checked = 0;
+	struct work *work;
+	int errors = 0;
+
+	if (vrunning)
+		return 0;
+	vq = tq_new();
+	work = (struct work *) aligned_calloc(sizeof(*work));
+	if (!vq || !work) {
+		aligned_free(work);
+		return 1;
+	}
+	memset(work->target, 0xff, sizeof(work->target));
+	work->target[7] = 0x0000ffff;
+
+	vtest = true;
+	vtest_valid = vtest_rejected = 0;
+	vrunning = true;
+	for (int n = 0; n < count; n += 2) {
+		work->nonces[0] = n;
+		work->nonces[1] = n + 1;
+		validate_push_nonces(0, work, endiandata, 2, UINT32_MAX, validate_test_hash);
+		if (work->data[19] != (uint32_t) n + 2)
+			errors++;
+	}
+	inline_checked = vtest_valid + vtest_rejected;
+	if (validate_start(2)) {
+		validate_drain();
+		validate_stop();
+	} else {
+		errors++;
+	}
+	vtest = false;
+	aligned_free(work);
+
+	if (errors || inline_checked != count - VALIDATE_MAX_QUEUED ||
+	    vtest_valid != count / 2 || vtest_rejected != count / 2) {
+		applog(LOG_ERR, "selftest: cpu validation failed, %u valid and %u rejected of %d (%u inline)",
+			(uint32_t) vtest_valid, (uint32_t) vtest_rejected, count, inline_checked);
+		return 1;
+	}
+	return 0;
+}
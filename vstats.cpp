@@ -0,0 +1,115 @@
+/**
+ * Counters of the cpu verification of the gpu results (api "vstats")
+ *
+ * Each thread has one block per algo. The scan thread verifies its own
+ * results but the async validation threads and the submit thread also
+ * update them, so the counters are relaxed atomics (no lock). The time
+ * histogram has log2 buckets in microseconds: <1, <2, <4... the last one
+ * also takes the slower verifications.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#ifndef WIN32
+#include <time.h>
+#endif
+
+#include "miner.h"
+#include "algos.h"
+
+struct vstats_block {
+	std::atomic<uint64_t> candidates;
+	std::atomic<uint64_t> false_pos;
+	std::atomic<uint64_t> duplicates;
+	std::atomic<uint64_t> stales;
+	std::atomic<uint64_t> time_ns;
+	std::atomic<uint32_t> hist[VSTATS_BUCKETS];
+};
+
+// the blocks of a thread are contiguous, zeroed as static
+static struct vstats_block _ALIGN(64) vstats[MAX_GPUS][ALGO_COUNT];
+
+static inline struct vstats_block* vstats_get_block(int thr_id)
+{
+	int algo = (int) opt_algo;
+	if (thr_id < 0 || thr_id >= MAX_GPUS || thr_id >= opt_n_threads || algo < 0 || algo >= ALGO_COUNT)
+		return NULL;
+	return &vstats[thr_id][algo];
+}
+
+uint64_t vstats_clock(void)
+{
+#ifdef WIN32
+	static LARGE_INTEGER freq = { 0 };
+	LARGE_INTEGER cnt;
+	if (!freq.QuadPart) QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&cnt);
+	return (uint64_t) ((double) cnt.QuadPart * 1e9 / (double) freq.QuadPart);
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+void vstats_verified(int thr_id, uint64_t start)
+{
+	struct vstats_block *b = vstats_get_block(thr_id);
+	if (!b) return;
+
+	uint64_t ns = vstats_clock() - start;
+	uint64_t us = ns / 1000;
+	int bucket = 0;
+	while (us && bucket < VSTATS_BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
+	}
+	b->candidates.fetch_add(1, std::memory_order_relaxed);
+	b->time_ns.fetch_add(ns, std::memory_order_relaxed);
+	b->hist[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void vstats_false_pos(int thr_id)
+{
+	struct vstats_block *b = vstats_get_block(thr_id);
+	if (b) b->false_pos.fetch_add(1, std::memory_order_relaxed);
+}
+
+void vstats_duplicate(int thr_id)
+{
+	struct vstats_block *b = vstats_get_block(thr_id);
+	if (b) b->duplicates.fetch_add(1, std::memory_order_relaxed);
+}
+
+void vstats_stale(int thr_id)
+{
+	struct vstats_block *b = vstats_get_block(thr_id);
+	if (b) b->stales.fetch_add(1, std::memory_order_relaxed);
+}
+
+/* the used blocks of a thread (or all if -1), return the records count */
+int vstats_get(int thr_id, struct vstats_data *data, int max_records)
+{
+	int records = 0;
+	for (int t = 0; t < MAX_GPUS && records < max_records; t++) {
+		if (thr_id >= 0 && t != thr_id)
+			continue;
+		for (int a = 0; a < ALGO_COUNT && records < max_records; a++) {
+			struct vstats_block *b = &vstats[t][a];
+			struct vstats_data *d = &data[records];
+			d->candidates = b->candidates.load(std::memory_order_relaxed);
+			d->false_pos = b->false_pos.load(std::memory_order_relaxed);
+			d->duplicates = b->duplicates.load(std::memory_order_relaxed);
+			d->stales = b->stales.load(std::memory_order_relaxed);
+			if (!d->candidates && !d->false_pos && !d->duplicates && !d->stales)
+				continue;
+			d->thr_id = t;
+			d->algo = a;
+			d->time_ns = b->time_ns.load(std::memory_order_relaxed);
+			for (int i = 0; i < VSTATS_BUCKETS; i++)
+				d->hist[i] = b->hist[i].load(std::memory_order_relaxed);
+			records++;
+		}
+	}
+	return records;
+}
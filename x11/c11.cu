@@ -207,7 +207,7 @@ extern "C" int scanhash_c11(int thr_id, struct work* work, uint32_t max_nonce, u
 			const uint32_t startNounce = pdata[19];
 			if (!use_compat_kernels[thr_id]) work->nonces[0] += startNounce;
 			be32enc(&endiandata[19], work->nonces[0]);
-			c11hash(vhash, endiandata);
+			vstats_hash(thr_id, c11hash(vhash, endiandata));
 
 			if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
@@ -215,7 +215,7 @@ extern "C" int scanhash_c11(int thr_id, struct work* work, uint32_t max_nonce, u
 				if (work->nonces[1] != UINT32_MAX) {
 					work->nonces[1] += startNounce;
 					be32enc(&endiandata[19], work->nonces[1]);
-					c11hash(vhash, endiandata);
+					vstats_hash(thr_id, c11hash(vhash, endiandata));
 					bn_set_target_ratio(work, vhash, 1);
 					work->valid_nonces++;
 					pdata[19] = max(work->nonces[0], work->nonces[1]) + 1;
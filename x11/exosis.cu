@@ -25,6 +25,7 @@ extern "C" {
 #include "miner.h"
 #include "cuda_helper.h"
 #include "cuda_x11.h"
+#include "travel_order.h"
 
 static uint32_t *d_hash[MAX_GPUS];
 
@@ -52,66 +53,14 @@ static const char* algo_strings[] = {
 	NULL
 };
 
-inline void swap8(uint8_t *a, uint8_t *b)
+static void getAlgoString(char *str, uint32_t seq)
 {
-	uint8_t t = *a;
-	*a = *b;
-	*b = t;
-}
-
-inline void initPerm(uint8_t n[], int count)
-{
-	for (int i = 0; i < count; i++)
-		n[i] = i;
-}
-
-static int nextPerm(uint8_t n[], int count)
-{
-	int tail, i, j;
-
-	if (count <= 1)
-		return 0;
-
-	for (i = count - 1; i>0 && n[i - 1] >= n[i]; i--);
-	tail = i;
-
-	if (tail > 0) {
-		for (j = count - 1; j>tail && n[j] <= n[tail - 1]; j--);
-		swap8(&n[tail - 1], &n[j]);
-	}
-
-	for (i = tail, j = count - 1; i<j; i++, j--)
-		swap8(&n[i], &n[j]);
-
-	return (tail != 0);
-}
-
-static void getAlgoString(char *str, int seq)
-{
-	uint8_t algoList[HASH_FUNC_COUNT];
-	char *sptr;
-
-	initPerm(algoList, HASH_FUNC_COUNT);
-
-	for (int k = 0; k < seq; k++) {
-		nextPerm(algoList, HASH_FUNC_COUNT);
-	}
-
-	sptr = str;
-	for (int j = 0; j < HASH_FUNC_COUNT; j++) {
-		if (algoList[j] >= 10)
-			sprintf(sptr, "%c", 'A' + (algoList[j] - 10));
-		else
-			sprintf(sptr, "%u", (uint32_t) algoList[j]);
-		sptr++;
-	}
-	*sptr = '\0';
+	travel_order_get(str, HASH_FUNC_COUNT, seq);
 }
 
 static __thread uint32_t s_ntime = 0;
-static uint32_t s_sequence = UINT32_MAX;
 static uint8_t s_firstalgo = 0xFF;
-static char hashOrder[HASH_FUNC_COUNT + 1] = { 0 };
+static __thread char hashOrder[HASH_FUNC_COUNT + 1] = { 0 };
 
 #define INITIAL_DATE HASH_FUNC_BASE_TIMESTAMP
 static inline uint32_t getCurrentAlgoSeq(uint32_t ntime)
@@ -123,11 +72,7 @@ static inline uint32_t getCurrentAlgoSeq(uint32_t ntime)
 // To finish...
 static void get_travel_order(uint32_t ntime, char *permstr)
 {
-	uint32_t seq = getCurrentAlgoSeq(ntime);
-	if (s_sequence != seq) {
-		getAlgoString(permstr, seq);
-		s_sequence = seq;
-	}
+	getAlgoString(permstr, getCurrentAlgoSeq(ntime));
 }
 
 // CPU Hash
@@ -144,20 +89,18 @@ extern "C" void exosis_hash(void *output, const void *input)
 	sph_luffa512_context     ctx_luffa1;
 	sph_cubehash512_context  ctx_cubehash1;
 
-	if (s_sequence == UINT32_MAX) {
-		uint32_t *data = (uint32_t*) input;
-		const uint32_t ntime = (opt_benchmark || !data[17]) ? (uint32_t) time(NULL) : data[17];
-		get_travel_order(ntime, hashOrder);
-	}
+	// order of the input ntime, not the one of the last scanned work
+	char order[HASH_FUNC_COUNT + 1];
+	get_travel_order(((uint32_t*) input)[17], order);
 
 	void *in = (void*) input;
 	int size = 80;
 
-	const int hashes = (int) strlen(hashOrder);
+	const int hashes = (int) strlen(order);
 
 	for (int i = 0; i < hashes; i++)
 	{
-		const char elem = hashOrder[i];
+		const char elem = order[i];
 		uint8_t algo = elem >= 'A' ? elem - 'A' + 10 : elem - '0';
 
 		switch (algo) {
@@ -263,7 +206,7 @@ extern "C" int scanhash_exosis(int thr_id, struct work* work, uint32_t max_nonce
 
 	// if (opt_benchmark) pdata[17] = swab32(0x5886a4be); // TO DEBUG GROESTL 80
 
-	if (opt_debug || s_ntime != pdata[17] || s_sequence == UINT32_MAX) {
+	if (opt_debug || s_ntime != pdata[17] || !hashOrder[0]) {
 		uint32_t ntime = swab32(work->data[17]);
 		get_travel_order(ntime, hashOrder);
 		s_ntime = pdata[17];
@@ -441,7 +384,7 @@ extern "C" int scanhash_exosis(int thr_id, struct work* work, uint32_t max_nonce
 			uint32_t _ALIGN(64) vhash[8];
 			const uint32_t Htarg = ptarget[7];
 			be32enc(&endiandata[19], work->nonces[0]);
-			exosis_hash(vhash, endiandata);
+			vstats_hash(thr_id, exosis_hash(vhash, endiandata));
 
 			if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
@@ -450,7 +393,7 @@ extern "C" int scanhash_exosis(int thr_id, struct work* work, uint32_t max_nonce
 				pdata[19] = work->nonces[0];
 				if (work->nonces[1] != 0) {
 					be32enc(&endiandata[19], work->nonces[1]);
-					exosis_hash(vhash, endiandata);
+					vstats_hash(thr_id, exosis_hash(vhash, endiandata));
 					if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
 						bn_set_target_ratio(work, vhash, 1);
 						work->valid_nonces++;
@@ -0,0 +1,83 @@
+/**
+ * Hash chain orders of the timetravel algos
+ *
+ * The order of a sequence is its lexicographic permutation of the hash
+ * functions, unranked with the factorial number system instead of seq
+ * nextPerm() calls. The recent orders are kept in a small cache shared by
+ * the cpu hash and the scan threads, the next sequence is prepared with
+ * the current one.
+ */
+#include <string.h>
+
+#include "miner.h"
+#include "travel_order.h"
+
+#define TRAVEL_CACHE_SIZE 16
+
+struct travel_order_entry {
+	uint32_t seq;
+	int count;
+	char order[TRAVEL_MAX_FUNCS + 1];
+};
+
+static struct travel_order_entry cache[TRAVEL_CACHE_SIZE];
+static int cache_next = 0;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* same result as seq nextPerm() calls on the identity (wraps at count!) */
+void travel_order_unrank(char *order, int count, uint32_t seq)
+{
+	uint32_t fact[TRAVEL_MAX_FUNCS + 1];
+	uint8_t funcs[TRAVEL_MAX_FUNCS];
+
+	if (count > TRAVEL_MAX_FUNCS) count = TRAVEL_MAX_FUNCS;
+	fact[0] = 1;
+	for (int i = 1; i <= count; i++)
+		fact[i] = fact[i - 1] * i;
+	for (int i = 0; i < count; i++)
+		funcs[i] = (uint8_t) i;
+
+	seq %= fact[count];
+	for (int i = 0; i < count; i++) {
+		const int left = count - 1 - i;
+		const int d = (int) (seq / fact[left]);
+		const uint8_t f = funcs[d];
+		seq %= fact[left];
+		memmove(&funcs[d], &funcs[d + 1], left - d);
+		order[i] = f >= 10 ? 'A' + (f - 10) : '0' + f;
+	}
+	order[count] = '\0';
+}
+
+static struct travel_order_entry* cache_find(int count, uint32_t seq)
+{
+	for (int i = 0; i < TRAVEL_CACHE_SIZE; i++) {
+		if (cache[i].count == count && cache[i].seq == seq)
+			return &cache[i];
+	}
+	return NULL;
+}
+
+static struct travel_order_entry* cache_add(int count, uint32_t seq)
+{
+	struct travel_order_entry *e = &cache[cache_next];
+	cache_next = (cache_next + 1) % TRAVEL_CACHE_SIZE;
+	travel_order_unrank(e->order, count, seq);
+	e->count = count;
+	e->seq = seq;
+	return e;
+}
+
+/* thread safe, the order is copied to the caller buffer */
+void travel_order_get(char *order, int count, uint32_t seq)
+{
+	pthread_mutex_lock(&cache_lock);
+	struct travel_order_entry *e = cache_find(count, seq);
+	if (!e) {
+		e = cache_add(count, seq);
+		if (!cache_find(count, seq + 1))
+			cache_add(count, seq + 1);
+	}
+	memcpy(order, e->order, count + 1);
+	pthread_mutex_unlock(&cache_lock);
+}
@@ -0,0 +1,12 @@
+#ifndef TRAVEL_ORDER_H
+#define TRAVEL_ORDER_H
+
+#include <stdint.h>
+
+/* timetravel, bitcore, exosis and x11evo hash chain orders (travel_order.cpp) */
+#define TRAVEL_MAX_FUNCS 12
+
+void travel_order_unrank(char *order, int count, uint32_t seq);
+void travel_order_get(char *order, int count, uint32_t seq);
+
+#endif
@@ -132,7 +132,7 @@ extern "C" int scanhash_veltor(int thr_id, struct work* work, uint32_t max_nonce
 			const uint32_t startNounce = pdata[19];
 
 			be32enc(&endiandata[19], startNounce + h_resNonce[0]);
-			veltorhash(vhash, endiandata);
+			vstats_hash(thr_id, veltorhash(vhash, endiandata));
 			if (vhash[7] <= Htarg && fulltest(vhash, ptarget))
 			{
 				work->nonces[0] = startNounce + h_resNonce[0];
@@ -142,7 +142,7 @@ extern "C" int scanhash_veltor(int thr_id, struct work* work, uint32_t max_nonce
 				{
 					uint32_t secNonce = work->nonces[1] = startNounce + h_resNonce[1];
 					be32enc(&endiandata[19], secNonce);
-					veltorhash(vhash, endiandata);
+					vstats_hash(thr_id, veltorhash(vhash, endiandata));
 					work->nonces[1] = secNonce;
 					if (bn_hash_target_ratio(vhash, ptarget) > work->shareratio[0]) {
 						work_set_target_ratio(work, vhash);
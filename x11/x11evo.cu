@@ -22,6 +22,7 @@ extern "C" {
 #include "miner.h"
 #include "cuda_helper.h"
 #include "cuda_x11.h"
+#include "travel_order.h"
 
 static uint32_t *d_hash[MAX_GPUS];
 
@@ -40,66 +41,14 @@ enum Algo {
 	HASH_FUNC_COUNT
 };
 
-static void swap8(uint8_t *a, uint8_t *b)
-{
-	uint8_t t = *a;
-	*a = *b;
-	*b = t;
-}
-
-static void initPerm(uint8_t n[], int count)
-{
-	for (int i = 0; i < count; i++)
-		n[i] = i;
-}
-
-static int nextPerm(uint8_t n[], int count)
-{
-	int tail, i, j;
-
-	if (count <= 1)
-		return 0;
-
-	for (i = count - 1; i>0 && n[i - 1] >= n[i]; i--);
-	tail = i;
-
-	if (tail > 0) {
-		for (j = count - 1; j>tail && n[j] <= n[tail - 1]; j--);
-		swap8(&n[tail - 1], &n[j]);
-	}
-
-	for (i = tail, j = count - 1; i<j; i++, j--)
-		swap8(&n[i], &n[j]);
-
-	return (tail != 0);
-}
-
 static void getAlgoString(char *str, int seq)
 {
-	uint8_t algoList[HASH_FUNC_COUNT];
-	char *sptr;
-
-	initPerm(algoList, HASH_FUNC_COUNT);
-
-	for (int k = 0; k < seq; k++) {
-		nextPerm(algoList, HASH_FUNC_COUNT);
-	}
-
-	sptr = str;
-	for (int j = 0; j < HASH_FUNC_COUNT; j++) {
-		if (algoList[j] >= 10)
-			sprintf(sptr, "%c", 'A' + (algoList[j] - 10));
-		else
-			sprintf(sptr, "%u", (uint32_t) algoList[j]);
-		sptr++;
-	}
-	*sptr = '\0';
-	//applog(LOG_DEBUG, "nextPerm %s", str);
+	// orders before the initial date are the first one
+	travel_order_get(str, HASH_FUNC_COUNT, seq < 0 ? 0 : (uint32_t) seq);
 }
 
 static __thread uint32_t s_ntime = 0;
-static char hashOrder[HASH_FUNC_COUNT + 1] = { 0 };
-static int  s_sequence = -1;
+static __thread char hashOrder[HASH_FUNC_COUNT + 1] = { 0 };
 
 #define INITIAL_DATE 0x57254700
 static inline int getCurrentAlgoSeq(uint32_t current_time)
@@ -110,11 +59,7 @@ static inline int getCurrentAlgoSeq(uint32_t current_time)
 
 static void evo_twisted_code(uint32_t ntime, char *permstr)
 {
-	int seq = getCurrentAlgoSeq(ntime);
-	if (s_sequence != seq) {
-		getAlgoString(permstr, seq);
-		s_sequence = seq;
-	}
+	getAlgoString(permstr, getCurrentAlgoSeq(ntime));
 }
 
 // X11evo CPU Hash
@@ -134,11 +79,9 @@ extern "C" void x11evo_hash(void *output, const void *input)
 	sph_simd512_context      ctx_simd1;
 	sph_echo512_context      ctx_echo1;
 
-	if (s_sequence == -1) {
-		uint32_t *data = (uint32_t*) input;
-		const uint32_t ntime = data[17];
-		evo_twisted_code(ntime, hashOrder);
-	}
+	// order of the input ntime, not the one of the last scanned work
+	char hashOrder[HASH_FUNC_COUNT + 1];
+	evo_twisted_code(((uint32_t*) input)[17], hashOrder);
 
 	void *in = (void*) input;
 	int size = 80;
@@ -234,7 +177,7 @@ extern "C" int scanhash_x11evo(int thr_id, struct work* work, uint32_t max_nonce
 	uint32_t throughput = cuda_default_throughput(thr_id, 1U << intensity); // 19=256*256*8;
 	//if (init[thr_id]) throughput = min(throughput, max_nonce - first_nonce);
 
-	if (opt_debug || s_ntime != pdata[17] || s_sequence == -1) {
+	if (opt_debug || s_ntime != pdata[17] || !hashOrder[0]) {
 		uint32_t ntime = swab32(work->data[17]);
 		evo_twisted_code(ntime, hashOrder);
 		s_ntime = pdata[17];
@@ -356,7 +299,7 @@ extern "C" int scanhash_x11evo(int thr_id, struct work* work, uint32_t max_nonce
 			const uint32_t Htarg = ptarget[7];
 			uint32_t _ALIGN(64) vhash[8];
 			be32enc(&endiandata[19], work->nonces[0]);
-			x11evo_hash(vhash, endiandata);
+			vstats_hash(thr_id, x11evo_hash(vhash, endiandata));
 
 			if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
@@ -365,7 +308,7 @@ extern "C" int scanhash_x11evo(int thr_id, struct work* work, uint32_t max_nonce
 				pdata[19] = work->nonces[0] + 1; // cursor
 				if (work->nonces[1] != 0) {
 					be32enc(&endiandata[19], work->nonces[1]);
-					x11evo_hash(vhash, endiandata);
+					vstats_hash(thr_id, x11evo_hash(vhash, endiandata));
 					bn_set_target_ratio(work, vhash, 1);
 					pdata[19] = max(work->nonces[0], work->nonces[1]) + 1;
 					gpulog(LOG_DEBUG, thr_id, "second nonce %08x! cursor %08x", work->nonces[1], pdata[19]);
@@ -201,7 +201,7 @@ extern "C" int scanhash_hsr(int thr_id, struct work* work, uint32_t max_nonce, u
 			const uint32_t Htarg = ptarget[7];
 			uint32_t _ALIGN(64) vhash[8];
 			be32enc(&endiandata[19], work->nonces[0]);
-			hsr_hash(vhash, endiandata);
+			vstats_hash(thr_id, hsr_hash(vhash, endiandata));
 
 			if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
@@ -209,7 +209,7 @@ extern "C" int scanhash_hsr(int thr_id, struct work* work, uint32_t max_nonce, u
 				work_set_target_ratio(work, vhash);
 				if (work->nonces[1] != 0) {
 					be32enc(&endiandata[19], work->nonces[1]);
-					hsr_hash(vhash, endiandata);
+					vstats_hash(thr_id, hsr_hash(vhash, endiandata));
 					bn_set_target_ratio(work, vhash, 1);
 					work->valid_nonces++;
 					pdata[19] = max(work->nonces[0], work->nonces[1]) + 1;
@@ -131,18 +131,50 @@ void sm3_final(sm3_ctx_t *ctx, unsigned char *digest)
 #define P1(x) ((x) ^  ROTATELEFT((x),15) ^ ROTATELEFT((x),23))
 
 #define FF0(x,y,z) ( (x) ^ (y) ^ (z))
-#define FF1(x,y,z) (((x) & (y)) | ( (x) & (z)) | ( (y) & (z)))
+#define FF1(x,y,z) (((x) & (y)) | (((x) | (y)) & (z)))
 
 #define GG0(x,y,z) ( (x) ^ (y) ^ (z))
-#define GG1(x,y,z) (((x) & (y)) | ( (~(x)) & (z)) )
-
+#define GG1(x,y,z) ((((y) ^ (z)) & (x)) ^ (z))
+
+/* T[j] <<< (j mod 32) */
+static const uint32_t TJ[64] = {
+	0x79CC4519, 0xF3988A32, 0xE7311465, 0xCE6228CB, 0x9CC45197, 0x3988A32F, 0x7311465E, 0xE6228CBC,
+	0xCC451979, 0x988A32F3, 0x311465E7, 0x6228CBCE, 0xC451979C, 0x88A32F39, 0x11465E73, 0x228CBCE6,
+	0x9D8A7A87, 0x3B14F50F, 0x7629EA1E, 0xEC53D43C, 0xD8A7A879, 0xB14F50F3, 0x629EA1E7, 0xC53D43CE,
+	0x8A7A879D, 0x14F50F3B, 0x29EA1E76, 0x53D43CEC, 0xA7A879D8, 0x4F50F3B1, 0x9EA1E762, 0x3D43CEC5,
+	0x7A879D8A, 0xF50F3B14, 0xEA1E7629, 0xD43CEC53, 0xA879D8A7, 0x50F3B14F, 0xA1E7629E, 0x43CEC53D,
+	0x879D8A7A, 0x0F3B14F5, 0x1E7629EA, 0x3CEC53D4, 0x79D8A7A8, 0xF3B14F50, 0xE7629EA1, 0xCEC53D43,
+	0x9D8A7A87, 0x3B14F50F, 0x7629EA1E, 0xEC53D43C, 0xD8A7A879, 0xB14F50F3, 0x629EA1E7, 0xC53D43CE,
+	0x8A7A879D, 0x14F50F3B, 0x29EA1E76, 0x53D43CEC, 0xA7A879D8, 0x4F50F3B1, 0x9EA1E762, 0x3D43CEC5
+};
+
+/* one round, the registers are renamed by the caller instead of being moved */
+#define R(FF, GG, A, B, C, D, E, F, G, H, j) do { \
+	uint32_t a12 = ROTATELEFT(A, 12); \
+	uint32_t SS1 = ROTATELEFT(a12 + E + TJ[j], 7); \
+	uint32_t SS2 = SS1 ^ a12; \
+	D += FF(A, B, C) + SS2 + (W[j] ^ W[(j) + 4]); \
+	H += GG(E, F, G) + SS1 + W[j]; \
+	H = P0(H); \
+	B = ROTATELEFT(B, 9); \
+	F = ROTATELEFT(F, 19); \
+} while (0)
+
+#define R4(FF, GG, j) do { \
+	R(FF, GG, A, B, C, D, E, F, G, H, (j) + 0); \
+	R(FF, GG, D, A, B, C, H, E, F, G, (j) + 1); \
+	R(FF, GG, C, D, A, B, G, H, E, F, (j) + 2); \
+	R(FF, GG, B, C, D, A, F, G, H, E, (j) + 3); \
+} while (0)
+
+/* message expansion, interleaved with the rounds which use it */
+#define EXP(j) W[j] = P1(W[(j)-16] ^ W[(j)-9] ^ ROTATELEFT(W[(j)-3],15)) ^ ROTATELEFT(W[(j)-13],7) ^ W[(j)-6]
+#define EXP4(j) EXP(j); EXP((j)+1); EXP((j)+2); EXP((j)+3)
 
 void sm3_compress(uint32_t digest[8], const unsigned char block[64])
 {
 	int j;
-	uint32_t W[68], W1[64];
-	const uint32_t *pblock = (const uint32_t *)block;
-
+	uint32_t W[68];
 	uint32_t A = digest[0];
 	uint32_t B = digest[1];
 	uint32_t C = digest[2];
@@ -151,51 +183,18 @@ void sm3_compress(uint32_t digest[8], const unsigned char block[64])
 	uint32_t F = digest[5];
 	uint32_t G = digest[6];
 	uint32_t H = digest[7];
-	uint32_t SS1,SS2,TT1,TT2,T[64];
 
 	for (j = 0; j < 16; j++) {
-		W[j] = cpu_to_be32(pblock[j]);
-	}
-	for (j = 16; j < 68; j++) {
-		W[j] = P1( W[j-16] ^ W[j-9] ^ ROTATELEFT(W[j-3],15)) ^ ROTATELEFT(W[j - 13],7 ) ^ W[j-6];;
-	}
-	for( j = 0; j < 64; j++) {
-		W1[j] = W[j] ^ W[j+4];
+		uint32_t w;
+		memcpy(&w, &block[4*j], 4);
+		W[j] = cpu_to_be32(w);
 	}
 
-	for(j =0; j < 16; j++) {
-
-		T[j] = 0x79CC4519;
-		SS1 = ROTATELEFT((ROTATELEFT(A,12) + E + ROTATELEFT(T[j],j)), 7);
-		SS2 = SS1 ^ ROTATELEFT(A,12);
-		TT1 = FF0(A,B,C) + D + SS2 + W1[j];
-		TT2 = GG0(E,F,G) + H + SS1 + W[j];
-		D = C;
-		C = ROTATELEFT(B,9);
-		B = A;
-		A = TT1;
-		H = G;
-		G = ROTATELEFT(F,19);
-		F = E;
-		E = P0(TT2);
-	}
-
-	for(j =16; j < 64; j++) {
-
-		T[j] = 0x7A879D8A;
-		SS1 = ROTATELEFT((ROTATELEFT(A,12) + E + ROTATELEFT(T[j],j)), 7);
-		SS2 = SS1 ^ ROTATELEFT(A,12);
-		TT1 = FF1(A,B,C) + D + SS2 + W1[j];
-		TT2 = GG1(E,F,G) + H + SS1 + W[j];
-		D = C;
-		C = ROTATELEFT(B,9);
-		B = A;
-		A = TT1;
-		H = G;
-		G = ROTATELEFT(F,19);
-		F = E;
-		E = P0(TT2);
-	}
+	EXP4(16);
+	R4(FF0, GG0, 0);  EXP4(20); R4(FF0, GG0, 4);  EXP4(24); R4(FF0, GG0, 8);  EXP4(28); R4(FF0, GG0, 12); EXP4(32);
+	R4(FF1, GG1, 16); EXP4(36); R4(FF1, GG1, 20); EXP4(40); R4(FF1, GG1, 24); EXP4(44); R4(FF1, GG1, 28); EXP4(48);
+	R4(FF1, GG1, 32); EXP4(52); R4(FF1, GG1, 36); EXP4(56); R4(FF1, GG1, 40); EXP4(60); R4(FF1, GG1, 44); EXP4(64);
+	R4(FF1, GG1, 48); R4(FF1, GG1, 52); R4(FF1, GG1, 56); R4(FF1, GG1, 60);
 
 	digest[0] ^= A;
 	digest[1] ^= B;
@@ -85,7 +85,7 @@ extern "C" int scanhash_whirlx(int thr_id,  struct work* work, uint32_t max_nonc
 			const uint32_t Htarg = ptarget[7];
 			uint32_t vhash64[8];
 			be32enc(&endiandata[19], foundNonce);
-			whirlxHash(vhash64, endiandata);
+			vstats_hash(thr_id, whirlxHash(vhash64, endiandata));
 
 			if (vhash64[7] <= Htarg && fulltest(vhash64, ptarget)) {
 				work_set_target_ratio(work, vhash64);
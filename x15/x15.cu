@@ -212,7 +212,7 @@ extern "C" int scanhash_x15(int thr_id,  struct work* work, uint32_t max_nonce,
 			uint32_t _ALIGN(64) vhash[8];
 			/* check now with the CPU to confirm */
 			be32enc(&endiandata[19], work->nonces[0]);
-			x15hash(vhash, endiandata);
+			vstats_hash(thr_id, x15hash(vhash, endiandata));
 
 			if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
@@ -220,7 +220,7 @@ extern "C" int scanhash_x15(int thr_id,  struct work* work, uint32_t max_nonce,
 				work_set_target_ratio(work, vhash);
 				if (work->nonces[1] != 0) {
 					be32enc(&endiandata[19], work->nonces[1]);
-					x15hash(vhash, endiandata);
+					vstats_hash(thr_id, x15hash(vhash, endiandata));
 					bn_set_target_ratio(work, vhash, 1);
 					work->valid_nonces++;
 					pdata[19] = max(work->nonces[0], work->nonces[1]) + 1;
@@ -468,7 +468,7 @@ extern "C" int scanhash_hmq17(int thr_id, struct work* work, uint32_t max_nonce,
 			const uint32_t Htarg = ptarget[7];
 			uint32_t _ALIGN(64) vhash[8];
 			be32enc(&endiandata[19], work->nonces[0]);
-			hmq17hash(vhash, endiandata);
+			vstats_hash(thr_id, hmq17hash(vhash, endiandata));
 
 			if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
@@ -476,7 +476,7 @@ extern "C" int scanhash_hmq17(int thr_id, struct work* work, uint32_t max_nonce,
 				work_set_target_ratio(work, vhash);
 				if (work->nonces[1] != 0 && work->nonces[1] != work->nonces[0]) {
 					be32enc(&endiandata[19], work->nonces[1]);
-					hmq17hash(vhash, endiandata);
+					vstats_hash(thr_id, hmq17hash(vhash, endiandata));
 					if (vhash[7] <= Htarg && fulltest(vhash, ptarget)) {
 						bn_set_target_ratio(work, vhash, 1);
 						work->valid_nonces++;
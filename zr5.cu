@@ -445,7 +445,7 @@ extern "C" int scanhash_zr5(int thr_id, struct work *work,
 			cudaMemcpy(&h_pok, d_poks[thr_id] + offset, sizeof(uint16_t), cudaMemcpyDeviceToHost);
 			pok = version | (0x10000UL * h_pok);
 			pdata[0] = pok; pdata[19] = work->nonces[0];
-			zr5hash(vhash, pdata);
+			vstats_hash(thr_id, zr5hash(vhash, pdata));
 			if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 				work->valid_nonces = 1;
 				work_set_target_ratio(work, vhash);
@@ -456,7 +456,7 @@ extern "C" int scanhash_zr5(int thr_id, struct work *work,
 					pok = version | (0x10000UL * h_pok);
 					memcpy(tmpdata, pdata, 80);
 					tmpdata[0] = pok; tmpdata[19] = work->nonces[1];
-					zr5hash(vhash, tmpdata);
+					vstats_hash(thr_id, zr5hash(vhash, tmpdata));
 					if (vhash[7] <= ptarget[7] && fulltest(vhash, ptarget)) {
 						bn_set_target_ratio(work, vhash, 1);
 						pdata[19] = max(pdata[19], work->nonces[1]); // cursor